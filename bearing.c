@@ -0,0 +1,143 @@
+/**
+*
+* @file bearing.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the phase difference to bearing and servo pulse width conversion.
+*
+* The table holds the bearing in millidegrees at evenly spaced phase differences, 2^n
+* counts apart, from one end-fire delay to the other.  A lookup splits the phase
+* difference into an index (shift) and a fraction (mask) and interpolates between two
+* entries: one multiply and no division.  The servo pulse width is linear in the bearing,
+* so it is one more multiply and shift.
+*
+* Interpolation error is largest near end-fire, where the arcsine is steepest.  With the
+* default 64 count step and 85 mm spacing it is below 0.01 degree within 75 degrees of
+* broadside and 0.06 degree within 85; only the last step before end-fire is worse (1.5
+* degrees), where one count of timing error alone moves the bearing by half a degree
+* (see host/bench_bearing).
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <math.h>
+
+#include "bearing.h"
+
+
+/*****************************************************************************/
+/**
+* Builds the conversion table
+*
+* @param    InstancePtr is a pointer to the table to build
+* @param	spacing_um is the distance between mic 1 and mic 2, in micrometers
+* @param	clk_hz is the Phase_Detection timestamp clock
+* @param	step_log2 is the phase difference step between entries (2^step_log2 counts)
+* @param	pwm_clk_hz is the PWM timer clock
+* @param	center_ns is the servo pulse width that points at 0 degrees (broadside)
+* @param	span_ns is the change in pulse width from 0 to +90 degrees (mic 1 hears
+*			the sound last, a positive phase difference)
+*
+* @return
+*
+*   - XST_SUCCESS if the table was built
+*   - XST_INVALID_PARAM if a parameter is 0 or the table would not fit in
+*	  BEARING_MAX_ENTRIES entries (increase step_log2)
+*
+* @note
+* Uses floating point (asin) once per entry; lookups do not.
+*
+******************************************************************************/
+int BEARING_Initialize(BearingTable *InstancePtr, u32 spacing_um, u32 clk_hz, int step_log2,
+		u32 pwm_clk_hz, u32 center_ns, u32 span_ns)
+{
+	double	x;
+	s32		max_delay;
+	int		entries, i;
+
+	if ((spacing_um == 0) || (clk_hz == 0) || (pwm_clk_hz == 0) || (step_log2 < 0) || (step_log2 > 12))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	// end-fire delay in clock counts; the table spans +/- that, rounded out to whole steps
+	max_delay = (s32) (((u64) spacing_um * clk_hz + BEARING_SOUND_UM_PER_SEC / 2) / BEARING_SOUND_UM_PER_SEC);
+	if (max_delay == 0)
+	{
+		return XST_INVALID_PARAM;
+	}
+	entries = 2 * ((max_delay + (1 << step_log2) - 1) >> step_log2) + 1;
+	if (entries > BEARING_MAX_ENTRIES)
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	InstancePtr->step_log2 = step_log2;
+	InstancePtr->entries = entries;
+	InstancePtr->max_delay = max_delay;
+	InstancePtr->first = -(s32) (((entries - 1) / 2) << step_log2);
+	InstancePtr->last = InstancePtr->first + ((s32) (entries - 1) << step_log2);
+	for (i = 0; i < entries; i++)
+	{
+		// beyond end-fire (timing noise) is clamped to +/- 90 degrees
+		x = (double) (InstancePtr->first + ((s32) i << step_log2)) / max_delay;
+		x = (x > 1.0) ? 1.0 : ((x < -1.0) ? -1.0 : x);
+		InstancePtr->mdeg[i] = (s32) lround(asin(x) * 180000.0 / M_PI);
+	}
+
+	// pulse width = center + bearing * span / 90 degrees, in PWM timer ticks
+	InstancePtr->center_ticks = (u32) (((u64) center_ns * pwm_clk_hz + 500000000) / 1000000000);
+	InstancePtr->ticks_gain = (s32) lround((double) span_ns * pwm_clk_hz / 1.0e9 / 90000.0 *
+		(1 << BEARING_PULSE_FRAC));
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the bearing for a phase difference
+*
+* @param    InstancePtr is a pointer to the table
+* @param	phase_diff is time_1 - time_2 in clock counts
+*
+* @return	the bearing in millidegrees, -90000 to 90000 (positive toward mic 2)
+*
+******************************************************************************/
+s32 BEARING_Lookup(const BearingTable *InstancePtr, int phase_diff)
+{
+	const s32	*e;
+	u32			offset;
+	s32			frac;
+
+	if (phase_diff <= InstancePtr->first)
+	{
+		return InstancePtr->mdeg[0];
+	}
+	if (phase_diff >= InstancePtr->last)
+	{
+		return InstancePtr->mdeg[InstancePtr->entries - 1];
+	}
+	offset = (u32) (phase_diff - InstancePtr->first);
+	e = &InstancePtr->mdeg[offset >> InstancePtr->step_log2];
+	frac = (s32) (offset & ((1u << InstancePtr->step_log2) - 1));
+	return e[0] + (((e[1] - e[0]) * frac) >> InstancePtr->step_log2);
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the servo pulse width (PWM timer ticks) that points at the source
+*
+* @param    InstancePtr is a pointer to the table
+* @param	phase_diff is time_1 - time_2 in clock counts
+*
+* @return	the pulse width for PWM_SetHighTicks()
+*
+******************************************************************************/
+u32 BEARING_PulseTicks(const BearingTable *InstancePtr, int phase_diff)
+{
+	s32 mdeg = BEARING_Lookup(InstancePtr, phase_diff);
+
+	return InstancePtr->center_ticks + (s32) (((s64) mdeg * InstancePtr->ticks_gain) >> BEARING_PULSE_FRAC);
+}
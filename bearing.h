@@ -0,0 +1,60 @@
+/**
+*
+* @file bearing.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for bearing.c.
+* bearing.c converts a phase difference to the bearing of the source and to the servo
+* pulse width that points at it.  The bearing of a far source is asin(c * dt / d) for a
+* delay dt between microphones d apart, so a linear phase to servo mapping is only right
+* near broadside.  BEARING_Initialize() tabulates the arcsine once for the microphone
+* spacing, speed of sound and clock rate; a conversion is then one table lookup with
+* linear interpolation, in integer arithmetic.
+*
+******************************************************************************/
+
+#ifndef BEARING_H	/* prevent circular inclusions */
+#define BEARING_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef BEARING_MAX_ENTRIES
+#define BEARING_MAX_ENTRIES		1024		// largest table (4 bytes per entry)
+#endif
+#define BEARING_STEP_LOG2		6			// default phase difference step between entries, 2^n counts
+
+#define BEARING_SOUND_UM_PER_SEC	343000000	// speed of sound, um/sec
+#define BEARING_PULSE_FRAC		16			// fraction bits of the bearing to pulse width gain
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	int		step_log2;						// phase difference step between entries, 2^n counts
+	s32		first;							// phase difference of entry 0
+	s32		last;							// phase difference of the last entry
+	s32		max_delay;						// end-fire phase difference (|dt| for +/- 90 degrees)
+	u32		center_ticks;					// servo pulse width at 0 degrees, PWM timer ticks
+	s32		ticks_gain;						// PWM ticks per millidegree << BEARING_PULSE_FRAC
+	int		entries;
+	s32		mdeg[BEARING_MAX_ENTRIES];		// bearing at first + (i << step_log2), millidegrees
+} BearingTable;
+
+/************************** Function Prototypes ******************************/
+int BEARING_Initialize(BearingTable *InstancePtr, u32 spacing_um, u32 clk_hz, int step_log2,
+		u32 pwm_clk_hz, u32 center_ns, u32 span_ns);
+s32 BEARING_Lookup(const BearingTable *InstancePtr, int phase_diff);
+u32 BEARING_PulseTicks(const BearingTable *InstancePtr, int phase_diff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -0,0 +1,368 @@
+/**
+*
+* @file edge_fifo.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the burst drain API for the Phase_Detection edge timestamp FIFOs.
+* One status read tells how many edges are queued on each channel.  Each queued entry
+* is then read from the FIFO head and both channels are popped with a single write to
+* the pop toggles.  The hardware echoes the toggles back in the status register once the
+* pop has taken effect, so the driver never reads a head that is about to change.  The
+* status is read across clock domains: the counts are Gray coded, so a read that lands on
+* a change gives the old or the new count, and they are clamped to the FIFO depth anyway
+* so a bad read cannot overrun the batch.
+*
+* The latched pair is read without a handshake.  Its words change together in the
+* Phase_Detection clock, which is not the bus clock, so a read can still land on an
+* update: the driver reads the info word before and after the timestamp and keeps the
+* pair only if the two agree.  The sequence number is Gray coded, so a first read that
+* lands on an update sees either the old or the new number and an unchanged pair is
+* recognized from that one read.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "edge_fifo.h"
+
+
+/************************** Function Prototypes ******************************/
+static int wait_ack(EdgeFifo *InstancePtr, u32 *status);
+static u32 gray_decode(u32 gray);
+
+
+/*****************************************************************************/
+/**
+* Initializes the edge FIFO driver
+*
+* @param    InstancePtr is a pointer to the EdgeFifo instance
+* @param	DataInstPtr is the (initialized) GPIO instance that carries the FIFO heads
+* @param	CtlDeviceId is the device id of the GPIO used for FIFO status and control
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_FAILURE if the control GPIO could not be initialized or the FIFOs do
+*	  not acknowledge
+*
+******************************************************************************/
+int EDGE_Initialize(EdgeFifo *InstancePtr, XGpio *DataInstPtr, u16 CtlDeviceId)
+{
+	int status;
+	u32 sts;
+
+	InstancePtr->DataInstPtr = DataInstPtr;
+	InstancePtr->overflow_1 = 0;
+	InstancePtr->overflow_2 = 0;
+	InstancePtr->bus_reads = 0;
+	InstancePtr->bus_writes = 0;
+
+	status = XGpio_Initialize(&InstancePtr->CtlInst, CtlDeviceId);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	XGpio_SetDataDirection(&InstancePtr->CtlInst, EDGE_STATUS_CHANNEL, 0xFFFFFFFF);
+	XGpio_SetDataDirection(&InstancePtr->CtlInst, EDGE_POP_CHANNEL, 0x00000000);
+
+	// start from the toggle state the hardware is already in so nothing is popped
+	sts = XGpio_DiscreteRead(&InstancePtr->CtlInst, EDGE_STATUS_CHANNEL);
+	InstancePtr->pop = ((sts & EDGE_STS_ACK_1_MASK) ? EDGE_POP_1_MASK : 0) |
+					   ((sts & EDGE_STS_ACK_2_MASK) ? EDGE_POP_2_MASK : 0);
+	InstancePtr->ovf_last = sts & (EDGE_STS_OVF_1_MASK | EDGE_STS_OVF_2_MASK);
+	XGpio_DiscreteWrite(&InstancePtr->CtlInst, EDGE_POP_CHANNEL, InstancePtr->pop);
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Drains all queued edges from both FIFOs
+*
+* Reads every entry queued when the status was sampled.  Edges that arrive during
+* the drain are left for the next call.
+*
+* @param    InstancePtr is a pointer to the EdgeFifo instance
+* @param	BatchPtr receives the edges, oldest first, for each channel
+*
+* @return
+*
+*   - XST_SUCCESS if the FIFOs were drained (the batch may be empty)
+*   - XST_FAILURE if the hardware did not acknowledge a pop.  The batch holds the
+*	  edges read up to that point
+*
+******************************************************************************/
+int EDGE_Drain(EdgeFifo *InstancePtr, EdgeBatch *BatchPtr)
+{
+	XGpio	*data = InstancePtr->DataInstPtr;
+	u32		sts, ovf;
+	int		n_1, n_2, i;
+
+	BatchPtr->n_1 = 0;
+	BatchPtr->n_2 = 0;
+
+	if (wait_ack(InstancePtr, &sts) != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+
+	// accumulate the (wrapping) hardware overflow counters
+	ovf = sts & (EDGE_STS_OVF_1_MASK | EDGE_STS_OVF_2_MASK);
+	if (ovf != InstancePtr->ovf_last)
+	{
+		InstancePtr->overflow_1 += ((ovf >> EDGE_STS_OVF_1_SHIFT) - (InstancePtr->ovf_last >> EDGE_STS_OVF_1_SHIFT)) & 0xFF;
+		InstancePtr->overflow_2 += ((ovf >> EDGE_STS_OVF_2_SHIFT) - (InstancePtr->ovf_last >> EDGE_STS_OVF_2_SHIFT)) & 0xFF;
+		InstancePtr->ovf_last = ovf;
+	}
+
+	n_1 = gray_decode((sts & EDGE_STS_COUNT_1_MASK) >> EDGE_STS_COUNT_1_SHIFT);
+	n_2 = gray_decode((sts & EDGE_STS_COUNT_2_MASK) >> EDGE_STS_COUNT_2_SHIFT);
+	n_1 = (n_1 > EDGE_FIFO_DEPTH) ? EDGE_FIFO_DEPTH : n_1;
+	n_2 = (n_2 > EDGE_FIFO_DEPTH) ? EDGE_FIFO_DEPTH : n_2;
+
+	for (i = 0; (i < n_1) || (i < n_2); i++)
+	{
+		u32 pop = 0;
+
+		if (i < n_1)
+		{
+			BatchPtr->time_1[BatchPtr->n_1++] = XGpio_DiscreteRead(data, EDGE_DATA_CHANNEL_1);
+			InstancePtr->bus_reads++;
+			pop |= EDGE_POP_1_MASK;
+		}
+		if (i < n_2)
+		{
+			BatchPtr->time_2[BatchPtr->n_2++] = XGpio_DiscreteRead(data, EDGE_DATA_CHANNEL_2);
+			InstancePtr->bus_reads++;
+			pop |= EDGE_POP_2_MASK;
+		}
+
+		InstancePtr->pop ^= pop;
+		XGpio_DiscreteWrite(&InstancePtr->CtlInst, EDGE_POP_CHANNEL, InstancePtr->pop);
+		InstancePtr->bus_writes++;
+
+		// the last pop is confirmed at the start of the next drain
+		if (((i + 1) < n_1) || ((i + 1) < n_2))
+		{
+			if (wait_ack(InstancePtr, &sts) != XST_SUCCESS)
+			{
+				return XST_FAILURE;
+			}
+		}
+	}
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Starts pairing with no edges outstanding
+*
+* @param    PairerPtr is a pointer to the pairing state
+* @param	window is the largest valid time between the edges of a pair, in clock counts
+*
+******************************************************************************/
+void EDGE_PairerInitialize(EdgePairer *PairerPtr, u32 window)
+{
+	PairerPtr->window = window;
+	PairerPtr->have_1 = false;
+	PairerPtr->have_2 = false;
+}
+
+
+/*****************************************************************************/
+/**
+* Pairs up the edges of a batch
+*
+* The two channels are merged in time order and each edge is paired with the outstanding
+* edge on the other channel if it is within the window, otherwise it waits for a partner.
+* Unpaired edges carry over to the next batch.  Phase_Detection raises capture_irq by the
+* same rule.
+*
+* @param    PairerPtr is a pointer to the pairing state
+* @param	BatchPtr is the batch drained by EDGE_Drain()
+* @param	PairsPtr receives the pairs, up to EDGE_MAX_PAIRS, in the order they completed
+*
+* @return	the number of pairs
+*
+******************************************************************************/
+int EDGE_Pair(EdgePairer *PairerPtr, const EdgeBatch *BatchPtr, EdgePair *PairsPtr)
+{
+	int i = 0, j = 0, n = 0;
+	u32 t;
+
+	while ((i < BatchPtr->n_1) || (j < BatchPtr->n_2))
+	{
+		if ((j >= BatchPtr->n_2) || ((i < BatchPtr->n_1) && ((s32)(BatchPtr->time_1[i] - BatchPtr->time_2[j]) <= 0)))
+		{
+			// Signal 1 edge - valid if signal 2 led by no more than the window
+			t = BatchPtr->time_1[i++];
+			if (PairerPtr->have_2 && (t - PairerPtr->pend_2 <= PairerPtr->window))
+			{
+				PairsPtr[n].time_1 = t;
+				PairsPtr[n++].time_2 = PairerPtr->pend_2;
+				PairerPtr->have_1 = false;
+				PairerPtr->have_2 = false;
+			}
+			else
+			{
+				PairerPtr->pend_1 = t;
+				PairerPtr->have_1 = true;
+			}
+		}
+		else
+		{
+			// Signal 2 edge - valid if signal 1 led by no more than the window
+			t = BatchPtr->time_2[j++];
+			if (PairerPtr->have_1 && (t - PairerPtr->pend_1 <= PairerPtr->window))
+			{
+				PairsPtr[n].time_1 = PairerPtr->pend_1;
+				PairsPtr[n++].time_2 = t;
+				PairerPtr->have_1 = false;
+				PairerPtr->have_2 = false;
+			}
+			else
+			{
+				PairerPtr->pend_2 = t;
+				PairerPtr->have_2 = true;
+			}
+		}
+	}
+	return n;
+}
+
+
+/*****************************************************************************/
+/**
+* Initializes the latched pair driver
+*
+* A pair latched before initialization is not reported.
+*
+* @param    InstancePtr is a pointer to the EdgeLatch instance
+* @param	DeviceId is the device id of the GPIO that carries the latched pair
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_FAILURE if the GPIO could not be initialized
+*
+******************************************************************************/
+int EDGE_LatchInitialize(EdgeLatch *InstancePtr, u16 DeviceId)
+{
+	int status;
+
+	status = XGpio_Initialize(&InstancePtr->Inst, DeviceId);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	XGpio_SetDataDirection(&InstancePtr->Inst, EDGE_LATCH_TIME_CHANNEL, 0xFFFFFFFF);
+	XGpio_SetDataDirection(&InstancePtr->Inst, EDGE_LATCH_INFO_CHANNEL, 0xFFFFFFFF);
+
+	InstancePtr->seq_last = XGpio_DiscreteRead(&InstancePtr->Inst, EDGE_LATCH_INFO_CHANNEL) &
+		EDGE_INFO_SEQ_MASK;
+	InstancePtr->pairs = 0;
+	InstancePtr->missed = 0;
+	InstancePtr->unchanged = 0;
+	InstancePtr->torn = 0;
+	InstancePtr->bus_reads = 1;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Reads the latched pair if it is new
+*
+* Pairs latched over since the last read are counted in InstancePtr->missed.
+*
+* @param    InstancePtr is a pointer to the EdgeLatch instance
+* @param	PairPtr receives the pair
+*
+* @return
+*
+*   - XST_SUCCESS if a new pair was read
+*   - XST_NO_DATA if the pair has already been read (or none has been latched)
+*   - XST_FAILURE if the pair kept changing under EDGE_LATCH_RETRY_LIMIT reads
+*
+******************************************************************************/
+int EDGE_ReadLatch(EdgeLatch *InstancePtr, EdgePair *PairPtr)
+{
+	u32 info, check, time_1;
+	int retry;
+
+	info = XGpio_DiscreteRead(&InstancePtr->Inst, EDGE_LATCH_INFO_CHANNEL);
+	InstancePtr->bus_reads++;
+	for (retry = 0; retry < EDGE_LATCH_RETRY_LIMIT; retry++)
+	{
+		if (((info & EDGE_INFO_VALID_MASK) == 0) ||
+			((info & EDGE_INFO_SEQ_MASK) == InstancePtr->seq_last))
+		{
+			InstancePtr->unchanged++;
+			return XST_NO_DATA;
+		}
+
+		time_1 = XGpio_DiscreteRead(&InstancePtr->Inst, EDGE_LATCH_TIME_CHANNEL);
+		check = XGpio_DiscreteRead(&InstancePtr->Inst, EDGE_LATCH_INFO_CHANNEL);
+		InstancePtr->bus_reads += 2;
+		if (check == info)
+		{
+			InstancePtr->missed += (gray_decode(info >> EDGE_INFO_SEQ_SHIFT) -
+				gray_decode(InstancePtr->seq_last >> EDGE_INFO_SEQ_SHIFT) - 1) &
+				(EDGE_INFO_SEQ_MASK >> EDGE_INFO_SEQ_SHIFT);
+			InstancePtr->seq_last = info & EDGE_INFO_SEQ_MASK;
+			InstancePtr->pairs++;
+			PairPtr->time_1 = time_1;
+			PairPtr->time_2 = time_1 - (u32)(s32)(s16)(info & EDGE_INFO_DIFF_MASK);
+			return XST_SUCCESS;
+		}
+		InstancePtr->torn++;
+		info = check;
+	}
+	return XST_FAILURE;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Polls the status register until both pop acknowledges match the toggles
+*
+* Returns the matching status in *status.
+*****************************************************************************/
+static int wait_ack(EdgeFifo *InstancePtr, u32 *status)
+{
+	u32 sts, ack;
+	int spin;
+
+	for (spin = 0; spin < EDGE_ACK_SPIN_LIMIT; spin++)
+	{
+		sts = XGpio_DiscreteRead(&InstancePtr->CtlInst, EDGE_STATUS_CHANNEL);
+		InstancePtr->bus_reads++;
+		ack = ((sts & EDGE_STS_ACK_1_MASK) ? EDGE_POP_1_MASK : 0) |
+			  ((sts & EDGE_STS_ACK_2_MASK) ? EDGE_POP_2_MASK : 0);
+		if (ack == InstancePtr->pop)
+		{
+			*status = sts;
+			return XST_SUCCESS;
+		}
+	}
+	return XST_FAILURE;
+}
+
+
+/****************************************************************************/
+/**
+* Converts a Gray coded number to binary
+*****************************************************************************/
+static u32 gray_decode(u32 gray)
+{
+	u32 bin = gray;
+
+	while (gray >>= 1)
+	{
+		bin ^= gray;
+	}
+	return bin;
+}
@@ -0,0 +1,129 @@
+/**
+*
+* @file edge_fifo.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for edge_fifo.c.
+* edge_fifo.c drains the per-channel edge timestamp FIFOs in Phase_Detection.  The FIFO
+* heads are read through GPIO 1 (channel 1 = signal 1, channel 2 = signal 2) and the
+* FIFOs are controlled through GPIO 2 (channel 1 = status input, channel 2 = pop toggle
+* output).  See phase_detection.v for the status register layout.
+*
+* Phase_Detection also latches the last pair of mic 1 and 2, read through GPIO 9
+* (channel 1 = signal 1 timestamp, channel 2 = difference, valid flag and sequence
+* number).  EDGE_ReadLatch() reads it instead of draining the FIFOs when only the latest
+* pair is wanted: one read when there is no new pair, three when there is.
+*
+******************************************************************************/
+
+#ifndef EDGE_FIFO_H	/* prevent circular inclusions */
+#define EDGE_FIFO_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xgpio.h"
+
+/************************** Constant Definitions *****************************/
+#define EDGE_FIFO_DEPTH			16			// entries per channel in Phase_Detection
+
+#define EDGE_DATA_CHANNEL_1		1			// GPIO 1 channels
+#define EDGE_DATA_CHANNEL_2		2
+#define EDGE_STATUS_CHANNEL		1			// GPIO 2 channels
+#define EDGE_POP_CHANNEL		2
+
+// status register fields (the counts are Gray coded)
+#define EDGE_STS_COUNT_1_MASK	0x0000001F
+#define EDGE_STS_COUNT_1_SHIFT	0
+#define EDGE_STS_ACK_1_MASK		0x00000080
+#define EDGE_STS_COUNT_2_MASK	0x00001F00
+#define EDGE_STS_COUNT_2_SHIFT	8
+#define EDGE_STS_ACK_2_MASK		0x00008000
+#define EDGE_STS_OVF_1_MASK		0x00FF0000
+#define EDGE_STS_OVF_1_SHIFT	16
+#define EDGE_STS_OVF_2_MASK		0xFF000000
+#define EDGE_STS_OVF_2_SHIFT	24
+
+// pop toggle bits
+#define EDGE_POP_1_MASK			0x01
+#define EDGE_POP_2_MASK			0x02
+
+// status polls to wait for a pop acknowledge before giving up
+#define EDGE_ACK_SPIN_LIMIT		64
+
+// latched pair (GPIO 9)
+#define EDGE_LATCH_TIME_CHANNEL	1
+#define EDGE_LATCH_INFO_CHANNEL	2
+#define EDGE_INFO_DIFF_MASK		0x0000FFFF	// time_1 - time_2, signed
+#define EDGE_INFO_VALID_MASK	0x00010000
+#define EDGE_INFO_SEQ_MASK		0xFFFE0000	// Gray coded
+#define EDGE_INFO_SEQ_SHIFT		17
+
+// latched pair reads to retry when the pair changes under the read
+#define EDGE_LATCH_RETRY_LIMIT	4
+
+// most pairs EDGE_Pair() can find in one batch (both FIFOs full plus two edges carried over)
+#define EDGE_MAX_PAIRS			(EDGE_FIFO_DEPTH + 1)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	XGpio	*DataInstPtr;		// GPIO 1 - FIFO heads
+	XGpio	CtlInst;			// GPIO 2 - status and pop toggles
+	u32		pop;				// pop toggle bits last written
+	u32		ovf_last;			// overflow counter fields at the last drain
+	u32		overflow_1;			// edges dropped by the hardware since initialization
+	u32		overflow_2;
+	u32		bus_reads;			// GPIO reads/writes issued by the driver
+	u32		bus_writes;
+} EdgeFifo;
+
+typedef struct {
+	XGpio	Inst;				// GPIO 9 - latched pair
+	u32		seq_last;			// Gray coded sequence number of the last pair read
+	u32		pairs;				// pairs read
+	u32		missed;				// pairs latched over before they were read
+	u32		unchanged;			// reads that found no new pair
+	u32		torn;				// reads that landed on an update and were retried
+	u32		bus_reads;			// GPIO reads issued by the driver
+} EdgeLatch;
+
+typedef struct {
+	u32		time_1[EDGE_FIFO_DEPTH];	// signal 1 edge timestamps, oldest first
+	u32		time_2[EDGE_FIFO_DEPTH];	// signal 2 edge timestamps, oldest first
+	int		n_1;						// entries in time_1
+	int		n_2;						// entries in time_2
+} EdgeBatch;
+
+typedef struct {
+	u32		window;						// largest valid time between the edges of a pair
+	u32		pend_1;						// unpaired edge timestamps
+	u32		pend_2;
+	bool	have_1;
+	bool	have_2;
+} EdgePairer;
+
+typedef struct {
+	u32		time_1;						// signal 1 edge timestamp
+	u32		time_2;						// signal 2 edge timestamp
+} EdgePair;
+
+/************************** Function Prototypes ******************************/
+int EDGE_Initialize(EdgeFifo *InstancePtr, XGpio *DataInstPtr, u16 CtlDeviceId);
+int EDGE_Drain(EdgeFifo *InstancePtr, EdgeBatch *BatchPtr);
+void EDGE_PairerInitialize(EdgePairer *PairerPtr, u32 window);
+int EDGE_Pair(EdgePairer *PairerPtr, const EdgeBatch *BatchPtr, EdgePair *PairsPtr);
+int EDGE_LatchInitialize(EdgeLatch *InstancePtr, u16 DeviceId);
+int EDGE_ReadLatch(EdgeLatch *InstancePtr, EdgePair *PairPtr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -0,0 +1,213 @@
+/**
+*
+* @file edge_stream.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the binary edge pair stream.  See edge_stream.h for the frame
+* layout.  STREAM_Push() (in edge_stream.h) is the ISR side; everything here runs in
+* the main loop.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "edge_stream.h"
+
+
+/************************** Function Prototypes ******************************/
+static void frame_add(EdgeStream *InstancePtr, const StreamPair *PairPtr);
+static void frame_close(EdgeStream *InstancePtr);
+static void put_varint(EdgeStream *InstancePtr, u32 value);
+static u8 crc8(const u8 *buf, int len);
+
+
+/*****************************************************************************/
+/**
+* Initializes the stream
+*
+* @param    InstancePtr is a pointer to the EdgeStream instance
+* @param	put writes one byte to the UART
+* @param	clk_per_tick is the capture clock counts per FIT tick, used to predict time_1
+* @param	flush_ticks is the longest a pair may wait for its frame to fill, in FIT ticks
+* @param	bytes_per_run is the most bytes to write per STREAM_Run() call; keep it within
+*			what the UART sends between calls so writing never waits on the UART
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_INVALID_PARAM if a parameter is out of range
+*
+******************************************************************************/
+int STREAM_Initialize(EdgeStream *InstancePtr, void (*put)(u8 byte), u32 clk_per_tick,
+		u32 flush_ticks, int bytes_per_run)
+{
+	if ((put == NULL) || (clk_per_tick == 0) || (flush_ticks == 0) || (bytes_per_run <= 0))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	InstancePtr->head = 0;
+	InstancePtr->tail = 0;
+	InstancePtr->next_seq = 0;
+	InstancePtr->ring_overflows = 0;
+	InstancePtr->frame_len = 0;
+	InstancePtr->frame_pairs = 0;
+	InstancePtr->tx_head = 0;
+	InstancePtr->tx_tail = 0;
+	InstancePtr->put = put;
+	InstancePtr->clk_per_tick = clk_per_tick;
+	InstancePtr->flush_ticks = flush_ticks;
+	InstancePtr->bytes_per_run = bytes_per_run;
+	InstancePtr->pairs_sent = 0;
+	InstancePtr->pairs_dropped = 0;
+	InstancePtr->frames_sent = 0;
+	InstancePtr->bytes_sent = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Packs the queued pairs into frames and writes up to bytes_per_run bytes to the UART
+*
+* A frame is closed when it is full, when the next pair does not follow on in sequence
+* (the ISR ring overflowed) or when its first pair has waited flush_ticks.  A closed
+* frame that does not fit in the transmit buffer is dropped.
+*
+* @param    InstancePtr is a pointer to the EdgeStream instance
+* @param	tick is the current FIT tick
+*
+******************************************************************************/
+void STREAM_Run(EdgeStream *InstancePtr, u32 tick)
+{
+	u32 tail = InstancePtr->tail;
+	u32 head = RING_LOAD_ACQUIRE(&InstancePtr->head);
+	StreamPair *p;
+	int i;
+
+	for (; tail != head; tail++)
+	{
+		p = &InstancePtr->ring[tail & STREAM_RING_MASK];
+		if ((InstancePtr->frame_pairs > 0) &&
+			((InstancePtr->frame_pairs == STREAM_FRAME_PAIRS) || (p->seq != InstancePtr->last.seq + 1)))
+		{
+			frame_close(InstancePtr);
+		}
+		frame_add(InstancePtr, p);
+	}
+	RING_STORE_RELEASE(&InstancePtr->tail, tail);
+
+	if ((InstancePtr->frame_pairs > 0) && (tick - InstancePtr->frame_tick >= InstancePtr->flush_ticks))
+	{
+		frame_close(InstancePtr);
+	}
+
+	for (i = 0; (i < InstancePtr->bytes_per_run) && (InstancePtr->tx_tail != InstancePtr->tx_head); i++)
+	{
+		InstancePtr->put(InstancePtr->tx[InstancePtr->tx_tail++ & STREAM_TX_MASK]);
+	}
+	InstancePtr->bytes_sent += i;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Appends a pair to the frame, starting the frame with absolute values if it is empty
+*****************************************************************************/
+static void frame_add(EdgeStream *InstancePtr, const StreamPair *PairPtr)
+{
+	u32 dtick;
+	s32 resid;
+
+	if (InstancePtr->frame_pairs == 0)
+	{
+		InstancePtr->frame[0] = STREAM_MAGIC_0;
+		InstancePtr->frame[1] = STREAM_MAGIC_1;
+		InstancePtr->frame_len = 3;				// the pair count goes in frame[2]
+		put_varint(InstancePtr, PairPtr->seq);
+		put_varint(InstancePtr, PairPtr->tick);
+		put_varint(InstancePtr, PairPtr->time_1);
+		InstancePtr->frame_tick = PairPtr->tick;
+	}
+	else
+	{
+		// time_1 moves on by about clk_per_tick a tick; send the difference from that
+		dtick = PairPtr->tick - InstancePtr->last.tick;
+		resid = (s32) (PairPtr->time_1 - InstancePtr->last.time_1 - dtick * InstancePtr->clk_per_tick);
+		put_varint(InstancePtr, dtick);
+		put_varint(InstancePtr, ((u32) resid << 1) ^ (u32) (resid >> 31));
+	}
+	resid = (s32) (PairPtr->time_2 - PairPtr->time_1);
+	put_varint(InstancePtr, ((u32) resid << 1) ^ (u32) (resid >> 31));
+
+	InstancePtr->frame[2] = (u8) ++InstancePtr->frame_pairs;
+	InstancePtr->last = *PairPtr;
+}
+
+
+/****************************************************************************/
+/**
+* Finishes the frame and queues it for the UART, or drops it if there is no room
+*****************************************************************************/
+static void frame_close(EdgeStream *InstancePtr)
+{
+	int len, i;
+
+	len = InstancePtr->frame_len;
+	InstancePtr->frame[len] = crc8(&InstancePtr->frame[2], len - 2);
+	len++;
+
+	if (STREAM_TX_SIZE - (InstancePtr->tx_head - InstancePtr->tx_tail) >= (u32) len)
+	{
+		for (i = 0; i < len; i++)
+		{
+			InstancePtr->tx[InstancePtr->tx_head++ & STREAM_TX_MASK] = InstancePtr->frame[i];
+		}
+		InstancePtr->frames_sent++;
+		InstancePtr->pairs_sent += InstancePtr->frame_pairs;
+	}
+	else
+	{
+		InstancePtr->pairs_dropped += InstancePtr->frame_pairs;
+	}
+	InstancePtr->frame_pairs = 0;
+	InstancePtr->frame_len = 0;
+}
+
+
+/****************************************************************************/
+/**
+* Appends a varint to the frame
+*****************************************************************************/
+static void put_varint(EdgeStream *InstancePtr, u32 value)
+{
+	while (value >= 0x80)
+	{
+		InstancePtr->frame[InstancePtr->frame_len++] = (u8) (value | 0x80);
+		value >>= 7;
+	}
+	InstancePtr->frame[InstancePtr->frame_len++] = (u8) value;
+}
+
+
+/****************************************************************************/
+/**
+* Returns the CRC-8 (polynomial x^8 + x^2 + x + 1, initial value 0) of buf
+*****************************************************************************/
+static u8 crc8(const u8 *buf, int len)
+{
+	u8 crc = 0;
+	int i, b;
+
+	for (i = 0; i < len; i++)
+	{
+		crc ^= buf[i];
+		for (b = 0; b < 8; b++)
+		{
+			crc = (crc & 0x80) ? (u8) ((crc << 1) ^ 0x07) : (u8) (crc << 1);
+		}
+	}
+	return crc;
+}
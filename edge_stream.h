@@ -0,0 +1,144 @@
+/**
+*
+* @file edge_stream.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions, type definitions and function prototypes
+* for edge_stream.c.  edge_stream.c streams every accepted time_1/time_2 edge pair out of
+* the console UART in a compact binary form, for capturing field data that the host
+* replay (host/replay) can run the firmware against.
+*
+* Capture_Handler() queues each pair with STREAM_Push(), a few stores into a ring.  The
+* main loop (STREAM_Run()) packs the pairs into frames and hands the UART a few bytes
+* per call, no more than the line can take, so the stream never blocks the loop.  A
+* frame that does not fit in the transmit buffer is dropped whole; the pair sequence
+* numbers let the host see exactly how many pairs were lost and where.
+*
+* Frame layout (varints are 7 bits per byte, least significant first, bit 7 set on all
+* but the last byte; zigzag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...):
+*
+*	u8		STREAM_MAGIC_0, STREAM_MAGIC_1
+*	u8		pair count, 1 to STREAM_FRAME_PAIRS
+*	varint	sequence number of the first pair
+*	varint	FIT tick of the first pair
+*	varint	time_1 of the first pair
+*	zigzag	time_2 - time_1
+*	then for each further pair, whose sequence number is one more than the last:
+*	varint	FIT ticks since the last pair
+*	zigzag	time_1 change less the clock counts in those ticks (clk_per_tick each)
+*	zigzag	time_2 - time_1
+*	u8		CRC-8 (polynomial 0x07) of the bytes after the magic
+*
+* Each frame starts from absolute values, so it is a resync point: a receiver that
+* joins late or loses bytes picks up at the next magic with a good CRC.  Console text
+* is 7-bit ASCII and cannot contain the magic, so it can share the line.  A pair costs
+* about 6 bytes against about 25 as text.
+*
+******************************************************************************/
+
+#ifndef EDGE_STREAM_H	/* prevent circular inclusions */
+#define EDGE_STREAM_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+#include "phase_ring.h"		// RING_LOAD_ACQUIRE, RING_STORE_RELEASE
+
+/************************** Constant Definitions *****************************/
+#ifndef STREAM_RING_SIZE
+#define STREAM_RING_SIZE		64			// pairs queued by the ISR, must be a power of 2
+#endif
+#define STREAM_RING_MASK		(STREAM_RING_SIZE - 1)
+#ifndef STREAM_TX_SIZE
+#define STREAM_TX_SIZE			512			// transmit buffer bytes, must be a power of 2
+#endif
+#define STREAM_TX_MASK			(STREAM_TX_SIZE - 1)
+
+#define STREAM_FRAME_PAIRS		32			// most pairs in a frame
+#define STREAM_MAGIC_0			0xA5
+#define STREAM_MAGIC_1			0x5A
+#define STREAM_VARINT_MAX		5			// bytes in the longest 32 bit varint
+#define STREAM_FRAME_MAX		(2 + 1 + 4 * STREAM_VARINT_MAX + \
+								 (STREAM_FRAME_PAIRS - 1) * 3 * STREAM_VARINT_MAX + 1)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		seq;					// sequence number
+	u32		tick;					// FIT tick the pair was accepted on
+	u32		time_1;					// signal 1 edge timestamp, clock counts
+	u32		time_2;					// signal 2 edge timestamp, clock counts
+} StreamPair;
+
+typedef struct {
+	// pairs from the ISR
+	StreamPair	ring[STREAM_RING_SIZE];
+	u32			head;				// written by the producer only
+	u32			tail;				// written by the consumer only
+	u32			next_seq;			// sequence number of the next pair (producer)
+	u32			ring_overflows;		// pairs dropped because the ring was full (producer)
+
+	// frame being built
+	u8			frame[STREAM_FRAME_MAX];
+	int			frame_len;
+	int			frame_pairs;
+	u32			frame_tick;			// tick of the first pair in the frame
+	StreamPair	last;				// last pair added to the frame
+
+	// bytes waiting for the UART
+	u8			tx[STREAM_TX_SIZE];
+	u32			tx_head;
+	u32			tx_tail;
+
+	void		(*put)(u8 byte);	// writes one byte to the UART
+	u32			clk_per_tick;		// capture clock counts per FIT tick
+	u32			flush_ticks;		// longest a pair waits in an unfinished frame
+	int			bytes_per_run;		// UART bytes per STREAM_Run() call
+
+	u32			pairs_sent;			// pairs in frames queued for the UART
+	u32			pairs_dropped;		// pairs in frames that did not fit
+	u32			frames_sent;
+	u32			bytes_sent;
+} EdgeStream;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+/*****************************************************************************/
+/**
+* Queues one edge pair.  Producer (ISR) side only.  The pair takes a sequence number
+* even if the ring is full, so the loss shows up in the stream.
+******************************************************************************/
+static inline void STREAM_Push(EdgeStream *InstancePtr, u32 tick, u32 time_1, u32 time_2)
+{
+	u32 head = InstancePtr->head;
+	StreamPair *p;
+
+	if (head - RING_LOAD_ACQUIRE(&InstancePtr->tail) >= STREAM_RING_SIZE)
+	{
+		InstancePtr->next_seq++;
+		InstancePtr->ring_overflows++;
+		return;
+	}
+	p = &InstancePtr->ring[head & STREAM_RING_MASK];
+	p->seq = InstancePtr->next_seq++;
+	p->tick = tick;
+	p->time_1 = time_1;
+	p->time_2 = time_2;
+	RING_STORE_RELEASE(&InstancePtr->head, head + 1);
+}
+
+/************************** Function Prototypes ******************************/
+int  STREAM_Initialize(EdgeStream *InstancePtr, void (*put)(u8 byte), u32 clk_per_tick,
+		u32 flush_ticks, int bytes_per_run);
+void STREAM_Run(EdgeStream *InstancePtr, u32 tick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -30,11 +30,38 @@
 #include "xtmrctr.h"
 #include "xgpio.h"
 #include "mb_interface.h"
+#include "xil_printf.h"
+#include "xil_io.h"
 #include "platform.h"
 #include "Nexys4IO.h"
 #include "PMod544IOR2.h"
 #include "pwm_tmrctr.h"
+#include "edge_fifo.h"
+#include "sched.h"
+#include "phase_ring.h"
+#include "median_filter.h"
+#include "latency_trace.h"
+#include "mic_array.h"
+#include "servo_pipeline.h"
+#include "bearing.h"
+#include "tracker.h"
+#include "edge_stream.h"
+#include "microbench.h"
+#include "pdm_frontend.h"
+#include "gcc_phat.h"
+#include "goertzel.h"
+#include "motion.h"
 
+// Host simulation builds (see host/) advance simulated time wherever the
+// firmware would otherwise spin waiting for an interrupt, and until the next
+// interrupt where it would sleep
+#ifdef HOST_SIM
+#include "sim_hal.h"
+#define CPU_SLEEP()				sim_sleep()
+#else
+#define SIM_IDLE()
+#define CPU_SLEEP()				mbar(16)		// MicroBlaze sleep, until an interrupt
+#endif
 
 /************************** Constant Definitions ****************************/
 
@@ -58,6 +85,13 @@
 // GPIO parameters
 #define GPIO_DEVICE_ID			XPAR_AXI_GPIO_0_DEVICE_ID
 #define GPIO_1_DEVICE_ID		XPAR_AXI_GPIO_1_DEVICE_ID
+#define GPIO_2_DEVICE_ID		XPAR_AXI_GPIO_2_DEVICE_ID
+#define GPIO_4_DEVICE_ID		XPAR_AXI_GPIO_4_DEVICE_ID
+#define GPIO_5_DEVICE_ID		XPAR_AXI_GPIO_5_DEVICE_ID
+#define GPIO_6_DEVICE_ID		XPAR_AXI_GPIO_6_DEVICE_ID
+#define GPIO_7_DEVICE_ID		XPAR_AXI_GPIO_7_DEVICE_ID
+#define GPIO_8_DEVICE_ID		XPAR_AXI_GPIO_8_DEVICE_ID
+#define GPIO_9_DEVICE_ID		XPAR_AXI_GPIO_9_DEVICE_ID
 #define GPIO_INPUT_CHANNEL		1
 #define GPIO_OUTPUT_CHANNEL		2									
 		
@@ -65,6 +99,39 @@
 #define INTC_DEVICE_ID			XPAR_INTC_0_DEVICE_ID
 #define FIT_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_FIT_TIMER_0_INTERRUPT_INTR
 #define PWM_TIMER_INTERRUPT_ID	XPAR_MICROBLAZE_0_AXI_INTC_AXI_TIMER_0_INTERRUPT_INTR
+#define CAPTURE_INTERRUPT_ID	XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_CAPTURE_IRQ_INTR
+#define PDM_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_PDM_IRQ_INTR
+#define WAKE_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_WAKE_IRQ_INTR
+
+// Edge capture.  Capture_Handler drains the Phase_Detection FIFOs when Phase_Detection
+// signals that an edge pair is ready (capture_irq, a rising edge interrupt) and FIT_Handler
+// only keeps time.  With PHASE_POLLED defined, for a block design without capture_irq,
+// FIT_Handler drains the FIFOs itself on every tick as it used to
+
+// Tickless idle.  With TICKLESS_IDLE defined the main loop sleeps (MicroBlaze sleep, mbar 16)
+// whenever no task is due instead of spinning, and delay_msecs() sleeps between FIT ticks.
+// If the next task release is at least IDLE_MIN_SLEEP_TICKS away the FIT interrupt is masked
+// as well and the Phase_Detection wakeup (WAKE, wake_irq on axi_intc input 4) is set for the
+// release, so the processor sleeps through the FIT ticks in between; an edge pair or a PCM
+// frame wakes it early.  Whichever handler runs first brings fit_ticks and timestamp forward
+// from the Phase_Detection counter (GPIO 3) and unmasks the FIT.  The telemetry task reports
+// the fraction of the time the processor was awake.  The FIT clock output stops while the
+// FIT is masked.  The FIFOs are only drained on the capture interrupt, so a PHASE_POLLED
+// build cannot be tickless
+#ifndef IDLE_MIN_SLEEP_TICKS
+#define IDLE_MIN_SLEEP_TICKS	4			// 100 usec; a shorter sleep leaves the FIT running
+#endif
+#define IDLE_COUNTS_PER_TICK	(PHASE_COUNT_FREQ_HZ / FIT_CLOCK_FREQ_HZ)
+#define IDLE_CLOCK_ADDR			XPAR_AXI_GPIO_3_BASEADDR	// Phase_Detection counter
+#define IDLE_CLOCK_SPREAD		(64 << PHASE_TIME_FRAC_BITS)	// two counter reads this close agree
+#define IDLE_CLOCK_TRIES		4
+#define IDLE_AWAKE				0			// idle_state
+#define IDLE_SLEEP				1			// asleep, the FIT running
+#define IDLE_DEEP				2			// asleep, the FIT masked until a handler runs
+
+#if defined(TICKLESS_IDLE) && defined(PHASE_POLLED)
+#error "TICKLESS_IDLE masks the FIT between tasks; PHASE_POLLED needs every FIT tick"
+#endif
 
 // Fixed Interval timer - 100 MHz input clock, 40KHz output clock
 // FIT_COUNT_1MSEC = FIT_CLOCK_FREQ_HZ * .001
@@ -73,43 +140,350 @@
 #define FIT_COUNT				(FIT_IN_CLOCK_FREQ_HZ / FIT_CLOCK_FREQ_HZ)
 #define FIT_COUNT_1MSEC			40	
 
+// Main loop tasks - periods and deadlines in FIT ticks
+#define PHASE_TASK_PERIOD		FIT_COUNT_1MSEC								// look for a new phase difference every 1 msec
+#define PHASE_TASK_DEADLINE		FIT_COUNT_1MSEC
+#define SERVO_TASK_DEADLINE		(FIT_CLOCK_FREQ_HZ / SERVO_NEUTRAL_FREQ)	// one-shot, within one PWM period
+#define TELEM_TASK_PERIOD		(1000 * FIT_COUNT_1MSEC)					// status report every second
+#define TELEM_TASK_DEADLINE		(100 * FIT_COUNT_1MSEC)
+#define STREAM_TASK_PERIOD		FIT_COUNT_1MSEC								// edge stream, a few bytes every 1 msec
+#define STREAM_TASK_DEADLINE	FIT_COUNT_1MSEC
+#define PDM_TASK_PERIOD			FIT_COUNT_1MSEC								// look for a new PCM frame every 1 msec
+#define PDM_TASK_DEADLINE		(5 * FIT_COUNT_1MSEC)						// within a frame (5.2 msec)
+#define MOTION_TASK_PERIOD		(FIT_CLOCK_FREQ_HZ / SERVO_NEUTRAL_FREQ)	// plan a setpoint every PWM period
+#define MOTION_TASK_DEADLINE	(MOTION_TASK_PERIOD / 2)
+
+// Sub-clock timestamps.  Phase_Detection counts 2^PHASE_TIME_FRAC_BITS timestamp counts per
+// clk2 clock and places each edge between clock edges by sampling it on both edges of clk2 (1)
+// and of its 90 degree copy (2), so a phase difference resolves to 5 or 2.5 nsec instead of 10.
+// Must match TIME_FRAC_BITS in n4fpga.v.  Every timestamp, phase difference and edge filter
+// time is in timestamp counts; the servo pulse widths stay in clk2 clocks
+#ifndef PHASE_TIME_FRAC_BITS
+#define PHASE_TIME_FRAC_BITS	0
+#endif
+#if (PHASE_TIME_FRAC_BITS < 0) || (PHASE_TIME_FRAC_BITS > 2)
+#error "PHASE_TIME_FRAC_BITS must be 0, 1 or 2"
+#endif
+
+// Largest valid phase difference between a signal 1 and a signal 2 edge, in timestamp counts
+#define PHASE_VALID_WINDOW		(25000 << PHASE_TIME_FRAC_BITS)
+
+// Microphones connected to Phase_Detection (2 or 4).  With more than two the edges are
+// grouped into sound events and solved by least squares over the whole array (mic_array.c);
+// the servo still follows the phase difference, now projected onto the mic 1 - mic 2 baseline.
+// Mic 3 and 4 use the second edge FIFO bank (GPIO 4 and 5), built with NUM_MICS = 4 in n4fpga.v
+#ifndef PHASE_NUM_MICS
+#define PHASE_NUM_MICS			2
+#endif
+
+// Latched pair capture.  With PHASE_PAIR_LATCH defined Capture_Handler reads the last mic 1/2
+// pair Phase_Detection latched (GPIO 9) instead of draining the FIFOs, which are turned off:
+// one bus read when there is no new pair, three when there is, and a pair torn by an edge
+// landing between the reads is read again rather than used.  Only the latest pair is seen at
+// each interrupt, so pairs closer together than the interrupt latency are counted as missed
+#if defined(PHASE_PAIR_LATCH) && (PHASE_NUM_MICS != 2)
+#error "PHASE_PAIR_LATCH reads the mic 1 and mic 2 pair; build it with PHASE_NUM_MICS 2"
+#endif
+#ifdef PHASE_PAIR_LATCH
+#define PHASE_EDGE_CTRL_LATCH	SPIPE_EDGE_CTRL_LATCH
+#if (PHASE_VALID_WINDOW > 32767)
+#error "the latched pair holds a 16-bit phase difference; PHASE_PAIR_LATCH needs PHASE_TIME_FRAC_BITS 0"
+#endif
+#else
+#define PHASE_EDGE_CTRL_LATCH	0
+#endif
+
+// Edge capture streaming (edge_stream.c).  With EDGE_STREAM defined every edge pair
+// Capture_Handler accepts is sent on the console UART in binary frames for
+// host/stream_decode, which turns a capture into a trace for host/replay.  The stream
+// takes the console, so the telemetry task is not run.  STREAM_UART_BAUD is the
+// axi_uartlite baud rate; the stream uses 80% of it, a few bytes per msec, so the
+// 16 byte transmit FIFO never fills and the main loop never waits on it
+#ifndef STREAM_UART_BAUD
+#define STREAM_UART_BAUD		115200
+#endif
+#define STREAM_BYTES_PER_MSEC	(STREAM_UART_BAUD / 10 * 8 / 10 / 1000)
+#define STREAM_FLUSH_TICKS		(100 * FIT_COUNT_1MSEC)	// longest a pair waits to be sent
+
+#if defined(EDGE_STREAM) && (PHASE_NUM_MICS != 2)
+#error "EDGE_STREAM streams the mic 1 and mic 2 edge pairs; build it with PHASE_NUM_MICS 2"
+#endif
+#if defined(EDGE_STREAM) && (STREAM_BYTES_PER_MSEC < 1)
+#error "STREAM_UART_BAUD is too slow for the edge stream"
+#endif
+#define PHASE_NUM_BANKS			(PHASE_NUM_MICS / 2)
+#define PHASE_CLOCK_FREQ_HZ		100000000									// Phase_Detection clock (clk2)
+#define PHASE_COUNT_FREQ_HZ		(PHASE_CLOCK_FREQ_HZ << PHASE_TIME_FRAC_BITS)	// timestamp counts per second
+
+#if (PHASE_NUM_MICS != 2) && (PHASE_NUM_MICS != 4)
+#error "PHASE_NUM_MICS must be 2 or 4"
+#endif
+
+// Phase_Detection edge filters, loaded through the fabric register port (GPIO 6).  A rising
+// edge counts once the input has been high for PHASE_EDGE_MIN_HIGH clocks (noise spikes near
+// the threshold), edges within PHASE_EDGE_HOLDOFF counts of a captured edge are ignored
+// (ringing and chatter), and with PHASE_EDGE_ONSET only the first edge after PHASE_EDGE_QUIET
+// counts without one is captured, so each sound burst gives one pair.  The holdoff must be
+// shorter than the period of the highest tone to be followed
+#ifndef PHASE_EDGE_MIN_HIGH
+#define PHASE_EDGE_MIN_HIGH		8			// 80 nsec
+#endif
+#ifndef PHASE_EDGE_HOLDOFF
+#define PHASE_EDGE_HOLDOFF		(PHASE_COUNT_FREQ_HZ / 50000)	// 20 usec
+#endif
+#ifndef PHASE_EDGE_ONSET
+#define PHASE_EDGE_ONSET		0
+#endif
+#define PHASE_EDGE_QUIET		(5 * (PHASE_COUNT_FREQ_HZ / 1000))	// 5 msec
+
+// Phase sample filtering - median of the last PHASE_MEDIAN_WINDOW samples (1 = off)
+// followed by an exponential smoother of weight 1/2^PHASE_EMA_SHIFT (0 = off)
+#ifndef PHASE_MEDIAN_WINDOW
+#define PHASE_MEDIAN_WINDOW		5
+#endif
+#ifndef PHASE_EMA_SHIFT
+#define PHASE_EMA_SHIFT			1
+#endif
+
+// Multi-source tracking (tracker.c) - up to PHASE_TRACKS sources are followed in a decaying
+// histogram of the phase samples and the servo points at the selected one, the strongest
+// (TRACK_SELECT_STRONGEST) or the newest (TRACK_SELECT_NEWEST).  0 = off, the servo follows
+// the median filter output
+#ifndef PHASE_TRACKS
+#define PHASE_TRACKS			3
+#endif
+#ifndef PHASE_TRACK_SELECT
+#define PHASE_TRACK_SELECT		TRACK_SELECT_STRONGEST
+#endif
+#define PHASE_TRACK_BINS		64			// 781 clocks, about 1.8 degrees at broadside
+#define PHASE_TRACK_HALF_LIFE	(1000 * FIT_COUNT_1MSEC)	// histogram memory
+
 // Neutral frequency and duty cycle for servo
 #define SERVO_NEUTRAL_FREQ	50	// 50Hz neutral frequency
 #define SERVO_NEUTRAL_DUTY	7	// 7% neutral duty cycle
+#define SERVO_DUTY_SPAN		4	// +/- 4% over the phase difference window
+
+// Servo pointing - the phase difference is converted to a bearing (arcsine, bearing.c) and
+// the bearing to a pulse width of SERVO_CENTER_NS +/- SERVO_SPAN_NS over +/- 90 degrees
+// (7% +/- 4% of the 20 msec period).  The pulse width is only rewritten when it moves by at
+// least SERVO_MIN_STEP_TICKS PWM timer ticks so filter noise does not chatter the servo
+#define MIC_SPACING_UM			85000		// mic 1 to mic 2, PHASE_VALID_WINDOW is the end-fire delay
+#define SERVO_CENTER_NS			1400000
+#define SERVO_SPAN_NS			800000
+#ifndef SERVO_MIN_STEP_TICKS
+#define SERVO_MIN_STEP_TICKS	50			// 0.5 usec, about 0.06 degree
+#endif
+
+// Fabric servo path (Servo_Pipeline, GPIO 6 and 7).  With SERVO_FABRIC defined the fabric
+// pairs the mic 1 and mic 2 edges and drives the servo itself; the firmware loads its pulse
+// width table from PhaseBearing, phase_task()'s arcsine mapping, every SERVO_TABLE_STEP_LOG2
+// counts of phase difference (in clk2 counts, interpolated in between), and falls back to the
+// axi_timer PWM if the fabric stops producing pairs while the FIFOs still do.  The linear
+// SERVO_GAIN mapping is the pipeline's own, in effect only until the table is selected
+#define SERVO_PERIOD_COUNTS		(PHASE_CLOCK_FREQ_HZ / SERVO_NEUTRAL_FREQ)
+#define SERVO_CENTER_COUNTS		(SERVO_PERIOD_COUNTS / 100 * SERVO_NEUTRAL_DUTY)
+#define SERVO_SPAN_COUNTS		(SERVO_PERIOD_COUNTS / 100 * SERVO_DUTY_SPAN)
+#define SERVO_GAIN				((s32) (((s64) SERVO_SPAN_COUNTS << SPIPE_GAIN_FRAC) / PHASE_VALID_WINDOW))
+#define SERVO_TABLE_STEP_LOG2	(10 + PHASE_TIME_FRAC_BITS)	// 1024 clocks, about 2.4 degrees at broadside
+#define SERVO_FABRIC_MIN_PAIRS	10	// software pairs per telemetry period that the fabric must match
+#if ((SPIPE_TABLE_HALF - 1) << SERVO_TABLE_STEP_LOG2) <= PHASE_VALID_WINDOW
+#error "SERVO_TABLE_STEP_LOG2 is too small for the table to cover PHASE_VALID_WINDOW"
+#endif
+
+// Servo motion planning (motion.c).  With SERVO_PLANNER defined the pulse widths phase_task()
+// looks up are measurements for an alpha-beta estimate of where the source is and how fast it
+// moves, and the motion task moves the servo once every PWM period toward where the source
+// will be when the pulse goes out: by at most SERVO_SLEW_DEG_PER_SEC, and only if the move is
+// at least SERVO_MIN_STEP_TICKS.  A moving source is followed instead of lagged, and a large
+// jump becomes a ramp the servo does not overshoot.  The fabric drives the servo without the
+// firmware, so SERVO_FABRIC has no use for the planner
+#ifndef SERVO_SLEW_DEG_PER_SEC
+#define SERVO_SLEW_DEG_PER_SEC	300			// half the speed of a typical hobby servo
+#endif
+#define SERVO_SPAN_TICKS		((u32) ((u64) SERVO_SPAN_NS * AXI_CLOCK_FREQ_HZ / 1000000000))
+#define SERVO_SLEW_TICKS		(SERVO_SPAN_TICKS * SERVO_SLEW_DEG_PER_SEC / 90 / SERVO_NEUTRAL_FREQ)
+#ifndef SERVO_PLAN_ALPHA
+#define SERVO_PLAN_ALPHA		(MOTION_GAIN_ONE / 2)
+#endif
+#ifndef SERVO_PLAN_BETA
+#define SERVO_PLAN_BETA			(MOTION_GAIN_ONE / 8)	// a little under critical damping for alpha 1/2
+#endif
+#define SERVO_PLAN_HOLD			(200 * FIT_COUNT_1MSEC)	// no extrapolation longer than this
+#define SERVO_PLAN_RESET		(SERVO_SPAN_TICKS / 4)	// a 22 degree jump is a new source
+#ifndef SERVO_PLAN_LEAD
+#define SERVO_PLAN_LEAD			(100 * FIT_COUNT_1MSEC)	// the next pulse, plus the phase filter delay
+#endif
+
+#if defined(SERVO_PLANNER) && defined(SERVO_FABRIC)
+#error "SERVO_PLANNER plans the firmware servo commands; SERVO_FABRIC leaves the servo to the fabric"
+#endif
+
+// PDM microphone front end (PDM_Frontend, GPIO 8).  With PDM_FRONTEND defined the firmware also
+// reads the PCM frames of a pair of PDM microphones, mounted like mic 1 and mic 2, and finds the
+// time difference of arrival over each whole frame by GCC-PHAT (gcc_phat.c).  PDM_Handler notes
+// the tick frame_irq says a frame is ready on, and the pdm task copies the frame out of the front
+// end, releases it and transforms it; estimates with at least PDM_MIN_CONFIDENCE join the edge
+// pairs as phase samples.  The front end holds the frame until it is released, and drops (counts
+// as overruns) the frames it completes in the meantime.  The GCC-PHAT instance takes about 30 KB;
+// -DPHAT_MAX_LOG2N=9 halves that and still fits the default 256 sample frames
+#define PDM_SAMPLE_RATE_HZ		PDM_SAMPLE_HZ(PHASE_CLOCK_FREQ_HZ)			// 48828 Hz
+#define PDM_FRAME_MAX			(PHAT_MAX_N / 2)
+#define PDM_MAX_LAG				(PHASE_VALID_WINDOW / (PHASE_COUNT_FREQ_HZ / PDM_SAMPLE_RATE_HZ) + 1)
+#ifndef PDM_MIN_CONFIDENCE
+#define PDM_MIN_CONFIDENCE		0.2f
+#endif
+
+// Tone bands (goertzel.c).  With PDM_GOERTZEL defined as well, the pdm task runs a bank of
+// Goertzel detectors over each frame instead of GCC-PHAT.  Each band of PDM_GOERTZEL_BANDS_HZ
+// whose level passes the gate in both microphones gives a phase sample, and the comparator
+// edge pairs are dropped, so clicks, HVAC noise and hum do not steer the servo.  The bands
+// have to be below 2 kHz, where half a period still covers the end-fire delay
+#ifndef PDM_GOERTZEL_BANDS_HZ
+#define PDM_GOERTZEL_BANDS_HZ	600, 1000, 1400
+#endif
+#ifndef PDM_GOERTZEL_MIN_LEVEL
+#define PDM_GOERTZEL_MIN_LEVEL	GOERTZEL_DEFAULT_LEVEL		// tone amplitude, PCM units
+#endif
+#ifndef PDM_GOERTZEL_MIN_RATIO
+#define PDM_GOERTZEL_MIN_RATIO	GOERTZEL_DEFAULT_RATIO		// over a flat spectrum of the same power
+#endif
+
+#if defined(PDM_GOERTZEL) && !defined(PDM_FRONTEND)
+#error "PDM_GOERTZEL runs over the PCM frames of PDM_FRONTEND"
+#endif
+#if defined(PDM_GOERTZEL) && defined(SERVO_FABRIC)
+#error "PDM_GOERTZEL steers from the tone bands; SERVO_FABRIC steers from the edge pairs"
+#endif
 
 #define	PWM_SIGNAL_MSK			0x01
 #define CLKFIT_MSK				0x01
 #define PWM_FREQ_MSK			0x03
 #define PWM_DUTY_MSK			0xFF
 
+// Hot path microbenchmarks (microbench.c).  With MICROBENCH defined the firmware runs every
+// benchmark once initialization is done, before the servo starts, and prints a line for each
+// with the best of MICROBENCH_REPEATS runs of MICROBENCH_OPS operations, timed with the
+// Phase_Detection counter (GPIO 3).  host/microbench -b compares a saved console log with a
+// later one, or with a host run
+#ifndef MICROBENCH_OPS
+#define MICROBENCH_OPS			1000
+#endif
+#define MICROBENCH_REPEATS		5
+#define MICROBENCH_CLOCK_ADDR	XPAR_AXI_GPIO_3_BASEADDR	// Phase_Detection counter
+
 /**************************** Type Definitions ******************************/
 
+/***************************** Constant Tables ******************************/
+#if PHASE_NUM_MICS > 2
+// Microphone positions (x, y, z) in micrometers: two perpendicular pairs on a
+// 42.5 mm radius circle.  Mic 1 and mic 2 are the original pair on the x axis
+static const s32 MicPositions[PHASE_NUM_MICS][3] = {
+	{  42500,      0, 0 },
+	{ -42500,      0, 0 },
+	{      0,  42500, 0 },
+	{      0, -42500, 0 }
+};
+#endif
+
 /***************** Macros (Inline Functions) Definitions ********************/
 #define MIN(a, b)  ( ((a) <= (b)) ? (a) : (b) )
 #define MAX(a, b)  ( ((a) >= (b)) ? (a) : (b) )
 
+// first thing in every interrupt handler: the interrupt may end a sleep
+#ifdef TICKLESS_IDLE
+#define IDLE_WAKE()				do { if (idle_state != IDLE_AWAKE) { idle_wake(); } } while (0)
+#else
+#define IDLE_WAKE()
+#endif
+
 /************************** Variable Definitions ****************************/	
 // Microblaze peripheral instances
 XIntc 	IntrptCtlrInst;						// Interrupt Controller instance
 XTmrCtr	PWMTimerInst;						// PWM timer instance
 XGpio	GPIOInst;							// GPIO 0 instance
 XGpio	GPIO_1_Inst;						// GPIO 1 instance
+EdgeFifo EdgeFifoInst;						// Phase_Detection edge FIFOs (GPIO 1 and 2)
+#if PHASE_NUM_MICS <= 2
+EdgePairer EdgePairerInst;					// pairs the edges of mic 1 and 2
+#endif
+#ifdef PHASE_PAIR_LATCH
+EdgeLatch EdgeLatchInst;					// last mic 1/2 pair latched by Phase_Detection (GPIO 9)
+#endif
+#if PHASE_NUM_MICS > 2
+XGpio	GPIO_4_Inst;						// GPIO 4 instance
+EdgeFifo EdgeFifo2Inst;						// mic 3 and 4 edge FIFOs (GPIO 4 and 5)
+MicArray MicArrayInst;						// groups the edges of all microphones into events
+volatile int			azimuth_mdeg;		// bearing of the last fully solved event, millidegrees
+#endif
+
+// Main loop scheduler and its tasks
+Sched		Scheduler;
+SchedTask	PhaseTask;						// maps a new phase difference to a duty cycle
+SchedTask	ServoTask;						// writes a new duty cycle to the PWM (one-shot)
+SchedTask	TelemTask;						// periodic status report
+#ifdef EDGE_STREAM
+SchedTask	StreamTask;						// sends the edge stream
+EdgeStream	EdgeStreamInst;					// edge pairs waiting to be sent
+#endif
 
 // The following variables are shared between non-interrupt processing and
 // interrupt processing such that they must be global(and declared volatile)
 // These variables are controlled by the FIT timer interrupt handler
-// "clkfit" toggles each time the FIT interrupt handler is called so its frequency will
-// be 1/2 FIT_CLOCK_FREQ_HZ.  timestamp increments every 1msec and is used in delay_msecs()
+// "clkfit" toggles every msec (every FIT interrupt with PHASE_POLLED, so its frequency will
+// be 1/2 FIT_CLOCK_FREQ_HZ).  timestamp increments every 1msec and is used in delay_msecs()
 volatile unsigned int	clkfit;				// clock signal is bit[0] (rightmost) of gpio 0 output port									
 volatile unsigned long  timestamp;			// timestamp since the program began
+volatile u32			fit_ticks;			// FIT interrupts since the program began - scheduler clock
+static int				ts_interval = 0;	// interval counter for incrementing timestamp
+#ifdef TICKLESS_IDLE
+volatile int			idle_state;			// IDLE_AWAKE, or how the main loop is sleeping
+u32						idle_tick;			// a FIT tick and the Phase_Detection counter at it,
+u32						idle_count;			// to bring fit_ticks forward after a deep sleep
+u32						idle_enter;			// counter when the last sleep began
+u32						idle_slept;			// counts asleep, wraps
+u32						idle_sleeps;		// sleeps, and those with the FIT masked
+u32						idle_deep;
+#endif
+PhaseRing				PhaseSamples;		// every phase difference measured by Capture_Handler, oldest first
 volatile u32			gpio_in;			// GPIO input port
 
+ServoPipe				ServoPipeInst;		// fabric register port, edge filters and TDOA to servo pipeline
+#ifdef SERVO_FABRIC
+bool					servo_fabric;		// the fabric is driving the servo
+#endif
+#ifdef SERVO_PLANNER
+SchedTask				MotionTask;			// plans the next servo setpoint
+MotionPlanner			ServoPlanner;		// source motion estimate and servo motion profile
+#endif
+#ifdef PDM_FRONTEND
+SchedTask				PdmTask;			// GCC-PHAT (or the tone bands) over the last PCM frame
+PdmFrontend				PdmInst;			// PDM microphone front end (GPIO 8)
+#ifdef PDM_GOERTZEL
+GoertzelBank			PdmBands;			// tone band levels and phase differences
+const u32				pdm_bands_hz[] = { PDM_GOERTZEL_BANDS_HZ };
+#else
+GccPhat					PdmPhat;			// frame TDOA estimator
+#endif
+s16						pdm_signal_1[PDM_FRAME_MAX];	// last PCM frame, mic 1
+s16						pdm_signal_2[PDM_FRAME_MAX];	// and mic 2
+volatile bool			pdm_frame_full;		// a frame is waiting for the pdm task
+volatile u32			pdm_frame_tick;		// FIT tick it became ready on
+PhaseRing				PdmSamples;			// GCC-PHAT phase differences for phase_task()
+u32						pdm_estimates;		// frames with a confident estimate (or a band that passed)
+#endif
+
 // The following variables are shared between the functions in the program
 // such that they must be global
 int						pwm_freq;			// PWM frequency 
 int						pwm_duty;			// PWM duty cycle
+u32						pwm_high;			// servo pulse width, PWM timer ticks
+BearingTable			PhaseBearing;		// phase difference to bearing and pulse width
 bool					new_perduty;		// new period/duty cycle flag
-int						phase_diff = 0;		// phase difference between signal 1 and 2, in clock count
+int						phase_diff = 0;		// latest filtered phase difference between signal 1 and 2, in timestamp counts
+MedianFilter			PhaseFilter;		// rejects outlying phase samples before the duty calculation
+#if PHASE_TRACKS > 0
+Tracker					PhaseTracker;		// sound sources, one of which the servo points at
+#endif
 
 
 				
@@ -126,7 +500,39 @@ void			delay_msecs(unsigned int msecs);						// busy-wait delay for "msecs" mili
 void			voltstostrng(float v, char* s);							// converts volts to a string
 void			update_lcd(int freq, int dutyccyle, u32 linenum);		// update LCD display
 				
+void			phase_task(void *CallBackRef);							// main loop tasks
+void			servo_task(void *CallBackRef);
+void			telem_task(void *CallBackRef);
+#ifdef EDGE_STREAM
+void			stream_task(void *CallBackRef);
+#endif
+#ifdef PDM_FRONTEND
+void			pdm_task(void *CallBackRef);
+#endif
+#ifdef SERVO_PLANNER
+void			motion_task(void *CallBackRef);
+#endif
+#if defined(LTRACE_ENABLE) || defined(EDGE_STREAM)
+static void		trace_put(u8 byte);										// binary output to the console UART
+#endif
+#ifdef MICROBENCH
+static void		microbench(void);										// runs the hot path microbenchmarks
+#endif
+
 void			FIT_Handler(void);										// fixed interval timer interrupt handler
+void			Capture_Handler(void);									// edge capture interrupt handler
+#ifdef PDM_FRONTEND
+void			PDM_Handler(void);										// PCM frame interrupt handler
+#endif
+#if PHASE_NUM_MICS > 2
+static void		array_events(const EdgeBatch *batch);					// solves the sound events in a batch
+#endif
+#ifdef TICKLESS_IDLE
+void			Wake_Handler(void);										// Phase_Detection wakeup interrupt handler
+static void		idle_sleep(void);										// sleeps until the next interrupt
+static void		idle_wake(void);										// brings the clocks forward after a sleep
+static u32		idle_clock(void);										// reads the Phase_Detection counter
+#endif
 
 
 /************************** MAIN PROGRAM ************************************/
@@ -152,56 +558,66 @@ int main()
 	// There's no new period/duty to output to pwm
 	new_perduty = false;
     
+#ifdef MICROBENCH
+	microbench();
+#endif
+
 	// set the initial servo position to neutral
 	pwm_freq = SERVO_NEUTRAL_FREQ;
 	pwm_duty = SERVO_NEUTRAL_DUTY;
 
 	// start the PWM timer and kick of the processing by enabling the Microblaze interrupt
 	PWM_SetParams(&PWMTimerInst, pwm_freq, pwm_duty);
+	pwm_high = BEARING_PulseTicks(&PhaseBearing, 0);
+	PWM_SetHighTicks(&PWMTimerInst, pwm_high);
 	PWM_Start(&PWMTimerInst);
     microblaze_enable_interrupts();
     delay_msecs(50);
+#ifdef TICKLESS_IDLE
+	// anchor the tick mapping just after a FIT tick: delay_msecs() returns right after one
+	idle_tick = fit_ticks;
+	idle_count = idle_clock();
+#endif
 	// display the greeting   
     xil_printf("Greetings!\n\r");
     
-	// Set up old phase variable
-	// It's compared to the new phase difference
-	// If new phase difference is different, then update the corresponding pwm parameters
-	int old_phase_diff = 0;
+	// set up the main loop tasks.  The phase task checks for a new phase difference every
+	// msec and releases the servo task when the duty cycle changes, so a new sound reaches
+	// the PWM within a couple of msec.  Nothing in the loop blocks.
+	MEDIAN_Initialize(&PhaseFilter, PHASE_MEDIAN_WINDOW, PHASE_EMA_SHIFT);
+#if PHASE_TRACKS > 0
+	TRACK_Initialize(&PhaseTracker, PHASE_TRACK_BINS, PHASE_VALID_WINDOW, PHASE_TRACKS,
+		PHASE_TRACK_SELECT, PHASE_TASK_PERIOD, PHASE_TRACK_HALF_LIFE);
+#endif
+	LTRACE_INIT();
+	SCHED_Initialize(&Scheduler, &fit_ticks);
+	SCHED_AddTask(&Scheduler, &PhaseTask, "phase", phase_task, NULL, PHASE_TASK_PERIOD, PHASE_TASK_DEADLINE);
+	SCHED_AddTask(&Scheduler, &ServoTask, "servo", servo_task, NULL, 0, SERVO_TASK_DEADLINE);
+#ifdef SERVO_PLANNER
+	MOTION_Initialize(&ServoPlanner, pwm_high, PhaseBearing.center_ticks - SERVO_SPAN_TICKS,
+		PhaseBearing.center_ticks + SERVO_SPAN_TICKS);
+	MOTION_SetFilter(&ServoPlanner, SERVO_PLAN_ALPHA, SERVO_PLAN_BETA, SERVO_PLAN_HOLD, SERVO_PLAN_RESET);
+	MOTION_SetProfile(&ServoPlanner, SERVO_SLEW_TICKS, SERVO_MIN_STEP_TICKS, SERVO_PLAN_LEAD);
+	SCHED_AddTask(&Scheduler, &MotionTask, "motion", motion_task, NULL, MOTION_TASK_PERIOD, MOTION_TASK_DEADLINE);
+#endif
+#ifdef EDGE_STREAM
+	SCHED_AddTask(&Scheduler, &StreamTask, "stream", stream_task, NULL, STREAM_TASK_PERIOD, STREAM_TASK_DEADLINE);
+#else
+	SCHED_AddTask(&Scheduler, &TelemTask, "telem", telem_task, NULL, TELEM_TASK_PERIOD, TELEM_TASK_DEADLINE);
+#endif
+#ifdef PDM_FRONTEND
+	SCHED_AddTask(&Scheduler, &PdmTask, "pdm", pdm_task, NULL, PDM_TASK_PERIOD, PDM_TASK_DEADLINE);
+#endif
 		
     // main loop
 	do
 	{
-			// If new phase diff is different than old
-			if (phase_diff != old_phase_diff)
-			{
-				// calculate the corresponding pwm duty cycle.
-				// phase diff can vary from -2500 to +2500, we need to limit the duty cycle to
-				// 7%(+-4%)
-				pwm_duty = phase_diff * 4 / 25000 + SERVO_NEUTRAL_DUTY;
-				
-				// update the old_phase_diff for next comparison				
-				old_phase_diff = phase_diff;
-				
-				// set flag to update pwm parameters
-				new_perduty = true;
-			}
-			
-			// else there's no new parameters to be updated
-			else new_perduty = false;
-		
-			// update generated frequency and duty cycle
-			if (new_perduty)
-			{
-				// set the new PWM parameters - PWM_SetParams stops the timer
-				status = PWM_SetParams(&PWMTimerInst, pwm_freq, pwm_duty);
-				PWM_Start(&PWMTimerInst);
-				delay_msecs(1000);
-				xil_printf("pwm output successful\n\r");
-				
-				// pwm parameters updated. wait for next comparison
-				new_perduty = false;
-			}
+#ifdef TICKLESS_IDLE
+			idle_sleep();
+#else
+			SIM_IDLE();
+#endif
+			SCHED_Run(&Scheduler);
 	} while (!done);
 	
 	
@@ -213,6 +629,368 @@ int main()
  }
 
 
+#if defined(LTRACE_ENABLE) || defined(EDGE_STREAM)
+/****************************************************************************/
+/**
+* latency trace and edge stream output - one byte of binary to the console UART
+*****************************************************************************/
+static void trace_put(u8 byte)
+{
+	outbyte((char) byte);
+}
+#endif
+
+
+#ifdef MICROBENCH
+/****************************************************************************/
+/**
+* runs the hot path microbenchmarks against the real PWM timer and bearing table and
+* prints the clock counts of the best run of each
+*****************************************************************************/
+static void microbench(void)
+{
+	static volatile u32 sink;
+	u32 t0, ticks, best;
+	int i, r;
+
+	if (MBENCH_Initialize(&PWMTimerInst, &PhaseBearing, PHASE_VALID_WINDOW, FIT_COUNT) != XST_SUCCESS)
+	{
+		xil_printf("MBENCH initialization failed\n\r");
+		return;
+	}
+	for (i = 0; i < MBENCH_Count(); i++)
+	{
+		best = 0xFFFFFFFF;
+		for (r = 0; r < MICROBENCH_REPEATS; r++)
+		{
+			MBENCH_Prepare(i);
+			t0 = Xil_In32(MICROBENCH_CLOCK_ADDR);
+			sink = MBENCH_Run(i, MICROBENCH_OPS);
+			ticks = Xil_In32(MICROBENCH_CLOCK_ADDR) - t0;
+			best = MIN(best, ticks);
+		}
+		xil_printf("MBENCH name=%s ops=%d ticks=%d clock_hz=%d\n\r", MBENCH_Name(i), MICROBENCH_OPS,
+			best, PHASE_COUNT_FREQ_HZ);
+	}
+	(void) sink;			// only stored, so the runs are not optimized away
+}
+#endif
+
+
+/**************************** MAIN LOOP TASKS *******************************/
+
+/****************************************************************************/
+/**
+* phase processing task (periodic)
+*
+* Takes the phase samples queued by Capture_Handler (and the pdm task) since the last run and passes each
+* through the phase filter, so a single spurious edge pair does not move the servo.
+* With PHASE_TRACKS the samples go to the tracker instead, which runs every period whether
+* or not there are samples, and the phase difference is that of the selected track.
+* If the filtered phase difference has changed, look up the corresponding servo pulse width and
+* release the servo task to write it.  With SERVO_PLANNER the pulse width of every run with
+* new samples goes to the motion planner instead, and the motion task moves the servo
+*****************************************************************************/
+void phase_task(void *CallBackRef)
+{
+#ifndef SERVO_PLANNER
+	// It's compared to the new phase difference
+	// If new phase difference is different, then update the corresponding pwm parameters
+	static int old_phase_diff = 0;
+	u32 high;
+#endif
+	PhaseSample samples[PHASE_RING_SIZE];
+	int i, n;
+
+#if PHASE_TRACKS > 0
+	const Track *track;
+
+	n = RING_PopBatch(&PhaseSamples, samples, PHASE_RING_SIZE);
+#ifdef PDM_GOERTZEL
+	n = 0;					// only the tone bands steer
+#endif
+#ifdef PDM_FRONTEND
+	n += RING_PopBatch(&PdmSamples, samples + n, PHASE_RING_SIZE - n);
+#endif
+	for (i = 0; i < n; i++)
+	{
+		TRACK_Add(&PhaseTracker, samples[i].phase_diff, samples[i].tick);
+	}
+	track = TRACK_Update(&PhaseTracker, fit_ticks);
+	if (track == NULL)
+	{
+		return;
+	}
+	phase_diff = track->phase_diff;
+#else
+	n = RING_PopBatch(&PhaseSamples, samples, PHASE_RING_SIZE);
+#ifdef PDM_GOERTZEL
+	n = 0;					// only the tone bands steer
+#endif
+#ifdef PDM_FRONTEND
+	n += RING_PopBatch(&PdmSamples, samples + n, PHASE_RING_SIZE - n);
+#endif
+	if (n == 0)
+	{
+		return;
+	}
+	for (i = 0; i < n; i++)
+	{
+		phase_diff = MEDIAN_Update(&PhaseFilter, samples[i].phase_diff);
+	}
+#endif
+
+#ifdef SERVO_PLANNER
+	if (n > 0)
+	{
+		LTRACE(LTRACE_PHASE, samples[n - 1].tick);
+		MOTION_Measure(&ServoPlanner, BEARING_PulseTicks(&PhaseBearing, phase_diff), samples[n - 1].tick);
+		LTRACE_NEXT(LTRACE_DUTY);
+	}
+#else
+	if (phase_diff == old_phase_diff)
+	{
+		return;
+	}
+	old_phase_diff = phase_diff;
+	LTRACE(LTRACE_PHASE, (n > 0) ? samples[n - 1].tick : fit_ticks);
+
+	// look up the pulse width that points at the source.
+	// phase diff can vary from -25000 to +25000 (end-fire), the pulse width from
+	// 7%(+-4%) of the period
+	high = BEARING_PulseTicks(&PhaseBearing, old_phase_diff);
+	LTRACE_NEXT(LTRACE_DUTY);
+	if (abs((int) (high - pwm_high)) >= SERVO_MIN_STEP_TICKS)
+	{
+		pwm_high = high;
+		new_perduty = true;
+#ifdef SERVO_FABRIC
+		// the fabric already moved the servo; keep the pulse width current for a fallback
+		if (servo_fabric)
+		{
+			return;
+		}
+#endif
+		SCHED_Release(&Scheduler, &ServoTask, 0);
+	}
+#endif
+}
+
+
+/****************************************************************************/
+/**
+* servo update task (one-shot)
+*
+* Sets the new pulse width - the PWM keeps running and picks it up at the next period
+*****************************************************************************/
+void servo_task(void *CallBackRef)
+{
+	if (new_perduty)
+	{
+		PWM_SetHighTicks(&PWMTimerInst, pwm_high);
+		new_perduty = false;
+	}
+}
+
+
+#ifdef SERVO_PLANNER
+/****************************************************************************/
+/**
+* servo motion task (periodic)
+*
+* Plans the next servo setpoint from the motion estimate and writes it if it moved.  Runs
+* once per PWM period; the PWM keeps running and picks the new pulse width up at the next
+* period
+*****************************************************************************/
+void motion_task(void *CallBackRef)
+{
+	u32 setpoint;
+
+	if (MOTION_Step(&ServoPlanner, fit_ticks, &setpoint))
+	{
+		pwm_high = setpoint;
+		PWM_SetHighTicks(&PWMTimerInst, pwm_high);
+	}
+}
+#endif
+
+
+/****************************************************************************/
+/**
+* telemetry task (periodic)
+*
+* Reports the servo position and the scheduler statistics on the console.  Task
+* run times are in FIT ticks (25 usec).  In latency trace builds the trace buffer
+* is sent (in binary) once it fills.  With the fabric servo path it also checks
+* that the fabric is still pairing edges and hands the servo back to the firmware
+* if it is not
+*****************************************************************************/
+void telem_task(void *CallBackRef)
+{
+	int i;
+#ifdef SERVO_FABRIC
+	static u32 pushed_last = 0;
+	int fabric_pairs, fabric_phase;
+#endif
+#ifdef LTRACE_ENABLE
+	static bool trace_dumped = false;
+
+	// send the latency trace once the capture is complete (host/ltrace_decode)
+	if (!trace_dumped && LTRACE_Full())
+	{
+		xil_printf("latency trace:\n\r");
+		LTRACE_Dump(trace_put);
+		xil_printf("\n\r");
+		trace_dumped = true;
+	}
+#endif
+
+	xil_printf("phase %d bearing %d mdeg pulse %d ticks servo updates %d\n\r", phase_diff,
+		BEARING_Lookup(&PhaseBearing, phase_diff), pwm_high, ServoTask.runs);
+#ifdef SERVO_FABRIC
+	fabric_pairs = SPIPE_Poll(&ServoPipeInst, &fabric_phase);
+	xil_printf("  fabric %s pairs %d phase %d\n\r", servo_fabric ? "on" : "off",
+		ServoPipeInst.pairs, fabric_phase);
+	if (servo_fabric && (fabric_pairs == 0) &&
+		(PhaseSamples.pushed - pushed_last >= SERVO_FABRIC_MIN_PAIRS))
+	{
+		SPIPE_Enable(&ServoPipeInst, false);
+		servo_fabric = false;
+		new_perduty = true;
+		SCHED_Release(&Scheduler, &ServoTask, 0);
+		xil_printf("  fabric stalled, servo back on the PWM timer\n\r");
+	}
+	pushed_last = PhaseSamples.pushed;
+#endif
+#if PHASE_NUM_MICS > 2
+	xil_printf("  bearing %d mdeg events solved %d partial %d dropped %d\n\r", azimuth_mdeg,
+		MicArrayInst.solved, MicArrayInst.partial, MicArrayInst.dropped);
+#endif
+	xil_printf("  samples %d high water %d overflows %d\n\r", PhaseSamples.pushed,
+		PhaseSamples.high_water, PhaseSamples.overflows);
+#ifdef SERVO_PLANNER
+	xil_printf("  planner measurements %d resets %d steps %d writes %d\n\r", ServoPlanner.measurements,
+		ServoPlanner.resets, ServoPlanner.steps, ServoPlanner.writes);
+#endif
+#ifdef PHASE_PAIR_LATCH
+	xil_printf("  latch pairs %d missed %d unchanged %d torn %d\n\r", EdgeLatchInst.pairs,
+		EdgeLatchInst.missed, EdgeLatchInst.unchanged, EdgeLatchInst.torn);
+#endif
+#ifdef PDM_FRONTEND
+	xil_printf("  pdm frames %d estimates %d unread %d dropped %d\n\r", PdmInst.frames,
+		pdm_estimates, PdmInst.discarded, PdmInst.overruns);
+#ifdef PDM_GOERTZEL
+	for (i = 0; i < PdmBands.num_bands; i++)
+	{
+		xil_printf("  band %d Hz detections %d rejected %d\n\r", PdmBands.band[i].freq_hz,
+			PdmBands.band[i].detections, PdmBands.band[i].rejected);
+	}
+#endif
+#endif
+#if PHASE_TRACKS > 0
+	for (i = 0; i < PHASE_TRACKS; i++)
+	{
+		Track *t = &PhaseTracker.tracks[i];
+
+		if (t->id != 0)
+		{
+			xil_printf("  track %d%s phase %d strength %d age %d ms\n\r", t->id,
+				(i == PhaseTracker.selected) ? "*" : "", t->phase_diff, t->strength >> 16,
+				(fit_ticks - t->born_tick) / FIT_COUNT_1MSEC);
+		}
+	}
+	xil_printf("  tracks created %d switches %d\n\r", PhaseTracker.created, PhaseTracker.switches);
+#endif
+#ifdef TICKLESS_IDLE
+	{
+		static u32 slept_last = 0, clock_last = 0;
+		u32 now = idle_clock();
+		u32 slept = idle_slept - slept_last, elapsed = now - clock_last;
+		u32 busy = (slept >= elapsed) ? 0 : 1000 - (u32) (((u64) slept * 1000) / elapsed);
+
+		xil_printf("  idle busy %d.%d%% sleeps %d deep %d\n\r", busy / 10, busy % 10,
+			idle_sleeps, idle_deep);
+		slept_last = idle_slept;
+		clock_last = now;
+	}
+#endif
+	for (i = 0; i < Scheduler.num_tasks; i++)
+	{
+		SchedTask *task = Scheduler.tasks[i];
+
+		xil_printf("  %s: runs %d misses %d max run %d max late %d\n\r", task->name,
+			task->runs, task->misses, task->run_ticks_max, task->late_max);
+	}
+}
+
+
+#ifdef EDGE_STREAM
+/****************************************************************************/
+/**
+* edge stream task (periodic)
+*
+* Frames the edge pairs queued by Capture_Handler and sends a few bytes of the stream,
+* no more than the UART sends in a period
+*****************************************************************************/
+void stream_task(void *CallBackRef)
+{
+	STREAM_Run(&EdgeStreamInst, fit_ticks);
+}
+#endif
+
+
+#ifdef PDM_FRONTEND
+/****************************************************************************/
+/**
+* PDM frame task (periodic)
+*
+* Copies the frame PDM_Handler found ready, if there is one, and releases it, so the front
+* end can hand over the next one while this one is worked on.  Estimates the time difference
+* of arrival over the frame and queues it as a phase sample if the correlation peak is clear
+* enough.  With PDM_GOERTZEL each tone band that passes the gate queues its own phase sample
+* instead
+*****************************************************************************/
+void pdm_task(void *CallBackRef)
+{
+#ifdef PDM_GOERTZEL
+	int i;
+#else
+	GccPhatResult result;
+#endif
+
+	if (!pdm_frame_full)
+	{
+		return;
+	}
+	pdm_frame_full = false;
+	if (PDM_ReadFrame(&PdmInst, pdm_signal_1, pdm_signal_2) != XST_SUCCESS)
+	{
+		return;
+	}
+#ifdef PDM_GOERTZEL
+	if (GOERTZEL_Block(&PdmBands, pdm_signal_1, pdm_signal_2) > 0)
+	{
+		for (i = 0; i < PdmBands.num_bands; i++)
+		{
+			if (PdmBands.band[i].valid)
+			{
+				RING_Push(&PdmSamples, pdm_frame_tick, PdmBands.band[i].phase_diff);
+			}
+		}
+		pdm_estimates++;
+	}
+#else
+	if ((PHAT_Frame(&PdmPhat, pdm_signal_1, pdm_signal_2, &result) == XST_SUCCESS) &&
+		(result.confidence >= PDM_MIN_CONFIDENCE))
+	{
+		RING_Push(&PdmSamples, pdm_frame_tick, result.phase_diff);
+		pdm_estimates++;
+	}
+#endif
+}
+#endif
+
+
 /**************************** HELPER FUNCTIONS ******************************/
 		
 /****************************************************************************/
@@ -225,6 +1003,10 @@ int main()
 int do_init(void)
 {
 	int status;				// status from Xilinx Lib calls
+#ifdef SERVO_FABRIC
+	int i;
+	u32 ticks;				// fabric table pulse width, PWM timer ticks
+#endif
 	
 	// initialize the Nexys4IO and Pmod544IO hardware and drivers
 	// rotary encoder is set to increment from 0 by DUTY_CYCLE_CHANGE 
@@ -261,7 +1043,102 @@ int do_init(void)
 	// GPIO channel 2 is an 32-bit input port time2.
 	XGpio_SetDataDirection(&GPIO_1_Inst, 1, 0xFFFFFFFF);
 	XGpio_SetDataDirection(&GPIO_1_Inst, 2, 0xFFFFFFFF);
+
+	// initialize the edge FIFO driver.  GPIO 2 carries the FIFO status and pop toggles
+	status = EDGE_Initialize(&EdgeFifoInst, &GPIO_1_Inst, GPIO_2_DEVICE_ID);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+#if PHASE_NUM_MICS <= 2
+	EDGE_PairerInitialize(&EdgePairerInst, PHASE_VALID_WINDOW);
+#endif
+	// the handlers push phase samples from the first interrupt on, so the ring is set up here
+	RING_Initialize(&PhaseSamples);
+#ifdef EDGE_STREAM
+	// and so does Capture_Handler the streamed pairs
+	status = STREAM_Initialize(&EdgeStreamInst, trace_put, PHASE_COUNT_FREQ_HZ / FIT_CLOCK_FREQ_HZ,
+		STREAM_FLUSH_TICKS, STREAM_BYTES_PER_MSEC);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+#endif
+#ifdef PHASE_PAIR_LATCH
+	status = EDGE_LatchInitialize(&EdgeLatchInst, GPIO_9_DEVICE_ID);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+#endif
+
+#if PHASE_NUM_MICS > 2
+	// second edge FIFO bank: GPIO 4 carries the mic 3 and 4 FIFO heads, GPIO 5 their status and pop toggles
+	status = XGpio_Initialize(&GPIO_4_Inst, GPIO_4_DEVICE_ID);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	XGpio_SetDataDirection(&GPIO_4_Inst, 1, 0xFFFFFFFF);
+	XGpio_SetDataDirection(&GPIO_4_Inst, 2, 0xFFFFFFFF);
+	status = EDGE_Initialize(&EdgeFifo2Inst, &GPIO_4_Inst, GPIO_5_DEVICE_ID);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+
+	// bearing in the plane of the microphones
+	status = ARRAY_Initialize(&MicArrayInst, PHASE_NUM_MICS, MicPositions, 2,
+		PHASE_COUNT_FREQ_HZ, FIT_CLOCK_FREQ_HZ);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+#endif
 			
+	// set up the Phase_Detection edge filters through the fabric register port
+	status = SPIPE_Initialize(&ServoPipeInst, GPIO_6_DEVICE_ID, GPIO_7_DEVICE_ID);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	status = SPIPE_SetEdgeFilter(&ServoPipeInst, PHASE_EDGE_MIN_HIGH, PHASE_EDGE_HOLDOFF,
+		(PHASE_EDGE_ONSET ? SPIPE_EDGE_CTRL_ONSET : 0) | PHASE_EDGE_CTRL_LATCH, PHASE_EDGE_QUIET);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+
+#ifdef PDM_FRONTEND
+	// PDM microphone frames, one GCC-PHAT transform of twice the frame length each
+	status = PDM_Initialize(&PdmInst, GPIO_8_DEVICE_ID);
+	if ((status != XST_SUCCESS) || (PdmInst.frame_len > PDM_FRAME_MAX))
+	{
+		return XST_FAILURE;
+	}
+#ifdef PDM_GOERTZEL
+	// or the tone bands, one block per frame
+	status = GOERTZEL_Initialize(&PdmBands, pdm_bands_hz, sizeof(pdm_bands_hz) / sizeof(pdm_bands_hz[0]),
+		PdmInst.frame_log2, PDM_SAMPLE_RATE_HZ, PHASE_COUNT_FREQ_HZ, PHASE_VALID_WINDOW);
+	if ((status != XST_SUCCESS) ||
+		(GOERTZEL_SetGate(&PdmBands, PDM_GOERTZEL_MIN_LEVEL, PDM_GOERTZEL_MIN_RATIO) != XST_SUCCESS))
+	{
+		return XST_FAILURE;
+	}
+#else
+	status = PHAT_Initialize(&PdmPhat, PdmInst.frame_log2 + 1, PDM_SAMPLE_RATE_HZ, PHASE_COUNT_FREQ_HZ,
+		PDM_MAX_LAG);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+#endif
+	RING_Initialize(&PdmSamples);
+	// the interrupt is edge triggered, so a frame already waiting has to be picked up here
+	pdm_frame_tick = 0;
+	pdm_frame_full = PDM_FrameReady(&PdmInst);
+#endif
+
 	// initialize the PWM timer/counter instance but do not start it
 	// do not enable PWM interrupts.  Clock frequency is the AXI clock frequency
 	status = PWM_Initialize(&PWMTimerInst, PWM_TIMER_DEVICE_ID, false, AXI_CLOCK_FREQ_HZ);
@@ -269,6 +1146,48 @@ int do_init(void)
 	{
 		return XST_FAILURE;
 	}
+
+	// tabulate the phase difference to servo pulse width conversion
+	status = BEARING_Initialize(&PhaseBearing, MIC_SPACING_UM, PHASE_COUNT_FREQ_HZ,
+		BEARING_STEP_LOG2 + PHASE_TIME_FRAC_BITS,
+		AXI_CLOCK_FREQ_HZ, SERVO_CENTER_NS, SERVO_SPAN_NS);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+
+#ifdef SERVO_FABRIC
+	// load the phase difference to servo mapping into the fabric and let it drive the servo:
+	// phase_task()'s pulse widths, converted from PWM timer ticks to clk2 counts
+	status = SPIPE_SetMapping(&ServoPipeInst, PHASE_VALID_WINDOW, SERVO_GAIN, SERVO_CENTER_COUNTS,
+		SERVO_CENTER_COUNTS - SERVO_SPAN_COUNTS, SERVO_CENTER_COUNTS + SERVO_SPAN_COUNTS,
+		SERVO_PERIOD_COUNTS);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	for (i = 0; i < SPIPE_TABLE_ENTRIES; i++)
+	{
+		ticks = BEARING_PulseTicks(&PhaseBearing, (i - SPIPE_TABLE_HALF) * (1 << SERVO_TABLE_STEP_LOG2));
+		status = SPIPE_SetTableEntry(&ServoPipeInst, i,
+			(u32) ((u64) ticks * PHASE_CLOCK_FREQ_HZ / AXI_CLOCK_FREQ_HZ));
+		if (status != XST_SUCCESS)
+		{
+			return XST_FAILURE;
+		}
+	}
+	status = SPIPE_UseTable(&ServoPipeInst, SERVO_TABLE_STEP_LOG2);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	status = SPIPE_Enable(&ServoPipeInst, true);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	servo_fabric = true;
+#endif
 	
 	// initialize the interrupt controller
 	status = XIntc_Initialize(&IntrptCtlrInst, INTC_DEVICE_ID);
@@ -297,6 +1216,42 @@ int do_init(void)
 	// enable the FIT interrupt
     XIntc_Enable(&IntrptCtlrInst, FIT_INTERRUPT_ID);
 
+#ifndef PHASE_POLLED
+	// connect and enable the edge capture interrupt
+    status = XIntc_Connect(&IntrptCtlrInst, CAPTURE_INTERRUPT_ID,
+                           (XInterruptHandler)Capture_Handler,
+                           (void *)0);
+    if (status != XST_SUCCESS)
+    {
+        return XST_FAILURE;
+    }
+    XIntc_Enable(&IntrptCtlrInst, CAPTURE_INTERRUPT_ID);
+#endif
+
+#ifdef PDM_FRONTEND
+	// connect and enable the PCM frame interrupt
+    status = XIntc_Connect(&IntrptCtlrInst, PDM_INTERRUPT_ID,
+                           (XInterruptHandler)PDM_Handler,
+                           (void *)0);
+    if (status != XST_SUCCESS)
+    {
+        return XST_FAILURE;
+    }
+    XIntc_Enable(&IntrptCtlrInst, PDM_INTERRUPT_ID);
+#endif
+
+#ifdef TICKLESS_IDLE
+	// connect and enable the wakeup interrupt, which ends a sleep with the FIT masked
+    status = XIntc_Connect(&IntrptCtlrInst, WAKE_INTERRUPT_ID,
+                           (XInterruptHandler)Wake_Handler,
+                           (void *)0);
+    if (status != XST_SUCCESS)
+    {
+        return XST_FAILURE;
+    }
+    XIntc_Enable(&IntrptCtlrInst, WAKE_INTERRUPT_ID);
+#endif
+
 	return XST_SUCCESS;
 }
 		
@@ -329,10 +1284,143 @@ void delay_msecs(unsigned int msecs)
 	target = timestamp + msecs;
 	while ( timestamp != target )
 	{
-		// spin until delay is over
+		// spin (sleep until the next tick with TICKLESS_IDLE) until delay is over
+#ifdef TICKLESS_IDLE
+		CPU_SLEEP();
+#else
+		SIM_IDLE();
+#endif
+	}
+}
+
+
+#ifdef TICKLESS_IDLE
+/****************************************************************************/
+/**
+* Sleeps until the next interrupt, unless a task is due
+*
+* Sleeps deep if the next task release is at least IDLE_MIN_SLEEP_TICKS away and no sound
+* event is open (closing one needs the FIT): the FIT is masked and the Phase_Detection
+* wakeup is set for the release.  Otherwise the next FIT tick ends the sleep.  An interrupt
+* between enabling interrupts and the sleep is handled and the sleep then lasts until the
+* next FIT tick, which the handler has unmasked
+*****************************************************************************/
+static void idle_sleep(void)
+{
+	u32 release;
+	s32 ahead;
+
+	microblaze_disable_interrupts();
+	if (!SCHED_NextRelease(&Scheduler, &release))
+	{
+		release = fit_ticks + IDLE_MIN_SLEEP_TICKS;
 	}
+	ahead = (s32) (release - fit_ticks);
+	if (ahead <= 0)
+	{
+		microblaze_enable_interrupts();
+		return;
+	}
+
+	idle_enter = idle_clock();
+	idle_state = IDLE_SLEEP;
+#if PHASE_NUM_MICS > 2
+	if ((ahead >= IDLE_MIN_SLEEP_TICKS) && !MicArrayInst.open)
+#else
+	if (ahead >= IDLE_MIN_SLEEP_TICKS)
+#endif
+	{
+		// move the anchor up to the last tick so the release time is close to it
+		idle_count += ((fit_ticks - idle_tick) * IDLE_COUNTS_PER_TICK);
+		idle_tick = fit_ticks;
+		XIntc_Disable(&IntrptCtlrInst, FIT_INTERRUPT_ID);
+		if (SPIPE_Write(&ServoPipeInst, SPIPE_REG_WAKE,
+			idle_count + (release - idle_tick) * IDLE_COUNTS_PER_TICK) == XST_SUCCESS)
+		{
+			idle_state = IDLE_DEEP;
+			idle_deep++;
+		}
+		else
+		{
+			// no wakeup, so the FIT has to end this sleep
+			XIntc_Enable(&IntrptCtlrInst, FIT_INTERRUPT_ID);
+		}
+	}
+	idle_sleeps++;
+	microblaze_enable_interrupts();
+	CPU_SLEEP();
 }
 
+
+/****************************************************************************/
+/**
+* Ends a sleep, called with interrupts off by the first handler to run
+*
+* After a deep sleep fit_ticks and timestamp are brought forward by the FIT ticks that
+* were masked, counted on the Phase_Detection counter from the anchor idle_tick/idle_count.
+* The FIT and the counter run off the same board clock and the anchor only ever moves in
+* whole ticks, so the mapping keeps its phase just after the FIT ticks.  A FIT interrupt
+* left pending by a masked tick is acknowledged, since the mapping counts that tick, and the
+* FIT is unmasked.  A wakeup in the few clocks between a FIT tick and the mapping loses that
+* tick until the next wakeup brings fit_ticks up to the mapping again
+*****************************************************************************/
+static void idle_wake(void)
+{
+	u32 now, ticks;
+
+	now = idle_clock();
+	idle_slept += now - idle_enter;
+	if (idle_state == IDLE_DEEP)
+	{
+		ticks = (now - idle_count) / IDLE_COUNTS_PER_TICK;
+		idle_count += ticks * IDLE_COUNTS_PER_TICK;
+		idle_tick += ticks;
+		if ((s32) (idle_tick - fit_ticks) > 0)
+		{
+			ticks = idle_tick - fit_ticks;
+			fit_ticks = idle_tick;
+			ts_interval += ticks;
+			if (ts_interval > FIT_COUNT_1MSEC)
+			{
+				timestamp += (ts_interval - 1) / FIT_COUNT_1MSEC;
+				ts_interval = ((ts_interval - 1) % FIT_COUNT_1MSEC) + 1;
+			}
+		}
+		XIntc_Acknowledge(&IntrptCtlrInst, FIT_INTERRUPT_ID);
+		XIntc_Enable(&IntrptCtlrInst, FIT_INTERRUPT_ID);
+	}
+	idle_state = IDLE_AWAKE;
+}
+
+
+/****************************************************************************/
+/**
+* Reads the Phase_Detection counter
+*
+* The counter is binary and runs on clk2, not the bus clock, so a read that lands on an
+* increment can take some bits from each value, and a carry makes that an arbitrary
+* time.  The counter is read until two reads in a row are within IDLE_CLOCK_SPREAD counts
+* (a read torn by more than that is that far from its neighbours), and the second is kept
+*****************************************************************************/
+static u32 idle_clock(void)
+{
+	u32 first, now;
+	int tries;
+
+	now = Xil_In32(IDLE_CLOCK_ADDR);
+	for (tries = 0; tries < IDLE_CLOCK_TRIES; tries++)
+	{
+		first = now;
+		now = Xil_In32(IDLE_CLOCK_ADDR);
+		if (now - first <= IDLE_CLOCK_SPREAD)
+		{
+			break;
+		}
+	}
+	return now;
+}
+#endif
+
 	
 /**************************** INTERRUPT HANDLERS ******************************/
 
@@ -342,7 +1430,12 @@ void delay_msecs(unsigned int msecs)
 *  
 * updates the global "timestamp" every millisecond.  "timestamp" is used for the delay_msecs() function
 * and as a time stamp for data collection and reporting.  Toggles the FIT clock which can be used as a visual
-* indication that the interrupt handler is being called.  Also makes RGB1 a PWM duty cycle indicator
+* indication that the interrupt handler is being called.  Also makes RGB1 a PWM duty cycle indicator.
+* Advances the scheduler clock.
+*
+* That is all it does unless the edges are polled (PHASE_POLLED), in which case it also runs
+* Capture_Handler() on every tick.  With more than two microphones it closes a sound event once
+* its window has passed, which needs no bus access.
 *
 * @note
 * ECE 544 students - When you implement your software solution for pulse width detection in
@@ -351,20 +1444,19 @@ void delay_msecs(unsigned int msecs)
 void FIT_Handler(void)
 {
 		
-	static int ts_interval = 0;			// interval counter for incrementing timestamp
-	u32 time1_count = 0;			// signal 1 posedge counter
-    u32 time2_count = 0;			// signal 2 posedge counter
-	u32 diff = 0;					// slock count difference between 2 signals
-	int direction;					// indicator of which signal is ahead
-	
-	// Read timestamp1 and timestamp2 from GPIO 1
-	time1_count = XGpio_DiscreteRead(&GPIO_1_Inst, 1);
-	time2_count = XGpio_DiscreteRead(&GPIO_1_Inst, 2);
-	
+#if (PHASE_NUM_MICS > 2) && !defined(PHASE_POLLED)
+	static const EdgeBatch no_edges[PHASE_NUM_BANKS];
+#endif
+
+	IDLE_WAKE();
 
+	// advance the scheduler clock
+	fit_ticks++;
+#ifdef PHASE_POLLED
 	// toggle FIT clock
 	clkfit ^= 0x01;
 	XGpio_DiscreteWrite(&GPIOInst, GPIO_OUTPUT_CHANNEL, clkfit);	
+#endif
 
 	// update timestamp	
 	ts_interval++;	
@@ -372,38 +1464,140 @@ void FIT_Handler(void)
 	{
 		timestamp++;
 		ts_interval = 1;
+#ifndef PHASE_POLLED
+		clkfit ^= 0x01;
+		XGpio_DiscreteWrite(&GPIOInst, GPIO_OUTPUT_CHANNEL, clkfit);	
+#endif
 	}
 
-	// Compare them to see which leads and by how much
-	// If the count between them is valid, update global "difference"
-	if(time1_count > time2_count)
+#ifdef PHASE_POLLED
+	Capture_Handler();
+#elif PHASE_NUM_MICS > 2
+	if (MicArrayInst.open)
 	{
-		// See if phase difference is valid
-		if(time1_count - time2_count > 25000) return;
-		
-		// Valid, signal 1 is ahead
-		direction = 1;
-		
-		// Calculate phase difference
-		diff = time1_count - time2_count;
-		
-		// Combine phase difference with direction
-		phase_diff = (int)diff * direction;
+		array_events(no_edges);
 	}
+#endif
+}
+
+
+/****************************************************************************/
+/**
+* Edge capture interrupt handler
+*
+* Drains every edge queued in the Phase_Detection FIFOs and pairs them up in arrival order: each
+* edge is paired with the most recent unpaired edge on the other channel if it is within
+* PHASE_VALID_WINDOW counts, otherwise it waits for a partner.  Each pair is queued as a phase
+* sample (positive when signal 1 arrived last) for the main loop.  Unpaired edges carry over to
+* the next interrupt.
+*
+* Phase_Detection raises the interrupt when an edge completes a pair by the same rule, or when a
+* FIFO is half full.  The interrupt is edge triggered and acknowledged before this handler runs,
+* so a pair completed during the drain raises it again.
+*
+* With more than two microphones the edges of every bank are handed to the array instead, which
+* groups them into sound events; each event becomes one phase sample.
+*
+* With PHASE_PAIR_LATCH the handler reads the pair Phase_Detection latched instead and returns
+* after a single read if it is not new (the FIFOs are off, so the interrupt only comes from pairs).
+ *****************************************************************************/
+void Capture_Handler(void)
+{
+#if PHASE_NUM_MICS > 2
+	EdgeBatch batch[PHASE_NUM_BANKS];	// edges drained
+	
+	IDLE_WAKE();
+
+	// Read every queued edge from all FIFOs
+	EDGE_Drain(&EdgeFifoInst, &batch[0]);
+	EDGE_Drain(&EdgeFifo2Inst, &batch[1]);
+	array_events(batch);
+#else
+#ifndef PHASE_PAIR_LATCH
+	EdgeBatch batch;					// edges drained
+#endif
+	EdgePair pairs[EDGE_MAX_PAIRS];
+	int i, n;
 	
-	else if(time2_count > time1_count)
+	IDLE_WAKE();
+
+#ifdef PHASE_PAIR_LATCH
+	// Read the latched pair, if it is new
+	n = (EDGE_ReadLatch(&EdgeLatchInst, &pairs[0]) == XST_SUCCESS) ? 1 : 0;
+#else
+	// Read every queued edge from both FIFOs and pair them up
+	EDGE_Drain(&EdgeFifoInst, &batch);
+	n = EDGE_Pair(&EdgePairerInst, &batch, pairs);
+#endif
+
+	for (i = 0; i < n; i++)
 	{
-		// See if phase difference is valid
-		if(time2_count - time1_count > 25000) return;
-		
-		// Valid, signal 2 is ahead
-		direction = -1;
-		
-		// Calculate the phase difference
-		diff = time2_count - time1_count;
-		
-		// Combine phase difference with direction
-		phase_diff = (int)diff * direction;
+		RING_Push(&PhaseSamples, fit_ticks, (int)(pairs[i].time_1 - pairs[i].time_2));
+#ifdef EDGE_STREAM
+		STREAM_Push(&EdgeStreamInst, fit_ticks, pairs[i].time_1, pairs[i].time_2);
+#endif
+		LTRACE_AT(LTRACE_EDGE, fit_ticks,
+			((s32)(pairs[i].time_1 - pairs[i].time_2) > 0) ? pairs[i].time_1 : pairs[i].time_2);
+		LTRACE(LTRACE_READ, fit_ticks);
 	}
-	
-}	
+#endif
+}
+
+#if PHASE_NUM_MICS > 2
+/****************************************************************************/
+/**
+* Groups a batch of edges into sound events and queues each event's baseline phase difference
+*****************************************************************************/
+static void array_events(const EdgeBatch *batch)
+{
+	ArrayEvent events[ARRAY_MAX_EVENTS];
+	int azimuth, elevation;
+	int i, n;
+
+	n = ARRAY_AddBatch(&MicArrayInst, batch, PHASE_NUM_BANKS, fit_ticks, events, ARRAY_MAX_EVENTS);
+	for (i = 0; i < n; i++)
+	{
+		RING_Push(&PhaseSamples, fit_ticks, events[i].phase_diff);
+		LTRACE_AT(LTRACE_EDGE, fit_ticks, events[i].time);
+		LTRACE(LTRACE_READ, fit_ticks);
+		if (ARRAY_Bearing(&events[i], &azimuth, &elevation) == XST_SUCCESS)
+		{
+			azimuth_mdeg = azimuth;
+		}
+	}
+}
+#endif
+
+
+#ifdef PDM_FRONTEND
+/****************************************************************************/
+/**
+* PCM frame interrupt handler
+*
+* Notes that PDM_Frontend has a frame ready, and the tick it became ready on, for the pdm
+* task.  The copy (a select and two reads per sample) is left to the task so it does not
+* hold off the FIT interrupt; the front end keeps the frame until the task releases it.  The
+* interrupt is edge triggered, on the frame becoming ready
+ *****************************************************************************/
+void PDM_Handler(void)
+{
+	IDLE_WAKE();
+	pdm_frame_tick = fit_ticks;
+	pdm_frame_full = true;
+}
+#endif
+
+
+#ifdef TICKLESS_IDLE
+/****************************************************************************/
+/**
+* Phase_Detection wakeup interrupt handler
+*
+* The wakeup set by idle_sleep() is due: ends the sleep so the main loop runs the task
+* released at that tick.  The interrupt is edge triggered
+ *****************************************************************************/
+void Wake_Handler(void)
+{
+	IDLE_WAKE();
+}
+#endif
@@ -0,0 +1,289 @@
+/**
+*
+* @file gcc_phat.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides a frame based GCC-PHAT time delay estimator for two sampled
+* microphone channels.  Each frame:
+*
+*	1. packs signal 1 and signal 2 into the real and imaginary parts of one complex
+*	   sequence (zero padded to twice the frame length) and transforms it with a
+*	   single radix-2 FFT,
+*	2. separates the two spectra and forms the cross spectrum X1 * conj(X2) weighted
+*	   by 1 / |X1 * conj(X2)| (the phase transform).  This loop is vectorized with SSE
+*	   on hosts that have it,
+*	3. inverse transforms to the generalized cross-correlation, finds the peak within
+*	   +/- max_lag samples and refines it with parabolic interpolation.
+*
+* The peak of the PHAT weighted correlation is 1 for a pure delay and falls towards
+* 0 as the channels become incoherent, so it is reported as the confidence.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "gcc_phat.h"
+
+
+/************************** Constant Definitions *****************************/
+#define PHAT_EPSILON		1.0e-20f	// cross spectrum bins below this (squared) are dropped
+
+/************************** Function Prototypes ******************************/
+static void fft(const GccPhat *InstancePtr, float *re, float *im);
+static void phat_cross_spectrum(GccPhat *InstancePtr);
+
+
+/*****************************************************************************/
+/**
+* Initializes a GCC-PHAT instance
+*
+* Computes the FFT plan for a 2^log2n point transform.  Frames are 2^(log2n-1)
+* samples per channel.
+*
+* @param    InstancePtr is a pointer to the instance to initialize
+* @param	log2n is the base 2 log of the FFT size (2 to PHAT_MAX_LOG2N)
+* @param	sample_hz is the sample rate of both channels
+* @param	clk2_hz is the Phase_Detection clock that phase_diff is expressed in
+* @param	max_lag is the largest delay to search for, in samples
+*
+* @return
+*
+*   - XST_SUCCESS if the instance was initialized
+*	- XST_INVALID_PARAM if the FFT size or lag window is out of range
+*
+******************************************************************************/
+int PHAT_Initialize(GccPhat *InstancePtr, int log2n, u32 sample_hz, u32 clk2_hz, int max_lag)
+{
+	int		i, j, b;
+	int		n;
+
+	if ((log2n < 2) || (log2n > PHAT_MAX_LOG2N) || (sample_hz == 0))
+	{
+		return XST_INVALID_PARAM;
+	}
+	n = 1 << log2n;
+	if ((max_lag < 1) || (max_lag >= n / 2))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	InstancePtr->log2n = log2n;
+	InstancePtr->n = n;
+	InstancePtr->frame = n / 2;
+	InstancePtr->max_lag = max_lag;
+	InstancePtr->counts_per_sample = (float) clk2_hz / (float) sample_hz;
+
+	// twiddle factors exp(-2*pi*i*k/n)
+	for (i = 0; i < n / 2; i++)
+	{
+		InstancePtr->twr[i] = cosf(2.0f * (float) M_PI * i / n);
+		InstancePtr->twi[i] = -sinf(2.0f * (float) M_PI * i / n);
+	}
+
+	// bit reversal permutation
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0, b = 0; b < log2n; b++)
+		{
+			j |= ((i >> b) & 1) << (log2n - 1 - b);
+		}
+		InstancePtr->bitrev[i] = (u16) j;
+	}
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Estimates the delay between one frame of each channel
+*
+* @param    InstancePtr is a pointer to an initialized instance
+* @param	signal_1 is InstancePtr->frame samples from microphone 1
+* @param	signal_2 is InstancePtr->frame samples from microphone 2
+* @param	result receives the delay estimate
+*
+* @return
+*
+*   - XST_SUCCESS if a delay was estimated
+*	- XST_FAILURE if the frames have no usable energy (result is zeroed)
+*
+* @note
+* A positive phase_diff means signal 1 arrived later, matching time_1 - time_2
+* as computed by FIT_Handler().
+*
+******************************************************************************/
+int PHAT_Frame(GccPhat *InstancePtr, const s16 *signal_1, const s16 *signal_2,
+		GccPhatResult *result)
+{
+	const int	n = InstancePtr->n;
+	const int	mask = n - 1;
+	float		*zr = InstancePtr->zr;
+	float		*zi = InstancePtr->zi;
+	int			i, lag, peak_idx;
+	float		peak, ym, yp, denom, delta;
+
+	// pack both channels into one complex sequence and zero pad
+	for (i = 0; i < InstancePtr->frame; i++)
+	{
+		zr[i] = (float) signal_1[i];
+		zi[i] = (float) signal_2[i];
+	}
+	memset(&zr[i], 0, (n - i) * sizeof(float));
+	memset(&zi[i], 0, (n - i) * sizeof(float));
+	fft(InstancePtr, zr, zi);
+
+	// separate the spectra: X1 = (Z[k] + conj(Z[n-k])) / 2, X2 = (Z[k] - conj(Z[n-k])) / 2j.
+	// The common factor of 1/2 cancels in the phase transform so it is dropped.
+	for (i = 0; i < n; i++)
+	{
+		int m = (n - i) & mask;
+
+		InstancePtr->x1r[i] = zr[i] + zr[m];
+		InstancePtr->x1i[i] = zi[i] - zi[m];
+		InstancePtr->x2r[i] = zi[i] + zi[m];
+		InstancePtr->x2i[i] = zr[m] - zr[i];
+	}
+	phat_cross_spectrum(InstancePtr);
+
+	// inverse transform by swapping real and imaginary parts; zr = n * correlation
+	fft(InstancePtr, zi, zr);
+
+	// find the correlation peak within the lag window
+	peak = zr[0];
+	peak_idx = 0;
+	for (lag = -InstancePtr->max_lag; lag <= InstancePtr->max_lag; lag++)
+	{
+		i = lag & mask;
+		if (zr[i] > peak)
+		{
+			peak = zr[i];
+			peak_idx = lag;
+		}
+	}
+	if (peak <= 0.0f)
+	{
+		memset(result, 0, sizeof(*result));
+		return XST_FAILURE;
+	}
+
+	// parabolic interpolation through the peak and its neighbours
+	ym = zr[(peak_idx - 1) & mask];
+	yp = zr[(peak_idx + 1) & mask];
+	denom = ym - 2.0f * peak + yp;
+	delta = (denom < 0.0f) ? 0.5f * (ym - yp) / denom : 0.0f;
+
+	result->lag = (float) peak_idx + delta;
+	result->phase_diff = (int) lroundf(result->lag * InstancePtr->counts_per_sample);
+	result->confidence = peak / (float) n;
+	if (result->confidence > 1.0f)
+	{
+		result->confidence = 1.0f;
+	}
+	return XST_SUCCESS;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* In-place radix-2 decimation in time FFT on split real/imaginary arrays
+*
+* Passing the imaginary array as "re" and the real array as "im" computes
+* n times the inverse transform.
+*****************************************************************************/
+static void fft(const GccPhat *InstancePtr, float *re, float *im)
+{
+	const int	n = InstancePtr->n;
+	int			i, j, k, len, half, step;
+	float		t, tr, ti, wr, wi;
+
+	for (i = 0; i < n; i++)
+	{
+		j = InstancePtr->bitrev[i];
+		if (j > i)
+		{
+			t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	for (len = 2; len <= n; len <<= 1)
+	{
+		half = len >> 1;
+		step = n / len;
+		for (i = 0; i < n; i += len)
+		{
+			for (k = 0; k < half; k++)
+			{
+				int a = i + k;
+				int b = a + half;
+
+				wr = InstancePtr->twr[k * step];
+				wi = InstancePtr->twi[k * step];
+				tr = re[b] * wr - im[b] * wi;
+				ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+
+/****************************************************************************/
+/**
+* Phase transform weighted cross spectrum
+*
+* Writes G = X1 * conj(X2) / |X1 * conj(X2)| into zr/zi.
+*****************************************************************************/
+static void phat_cross_spectrum(GccPhat *InstancePtr)
+{
+	const float	*ar = InstancePtr->x1r;
+	const float	*ai = InstancePtr->x1i;
+	const float	*br = InstancePtr->x2r;
+	const float	*bi = InstancePtr->x2i;
+	float		*gr = InstancePtr->zr;
+	float		*gi = InstancePtr->zi;
+	int			k;
+
+#if defined(__SSE2__)
+	const __m128	eps = _mm_set1_ps(PHAT_EPSILON);
+	const __m128	one = _mm_set1_ps(1.0f);
+
+	for (k = 0; k < InstancePtr->n; k += 4)
+	{
+		__m128 xr = _mm_load_ps(&ar[k]);
+		__m128 xi = _mm_load_ps(&ai[k]);
+		__m128 yr = _mm_load_ps(&br[k]);
+		__m128 yi = _mm_load_ps(&bi[k]);
+		__m128 re = _mm_add_ps(_mm_mul_ps(xr, yr), _mm_mul_ps(xi, yi));
+		__m128 im = _mm_sub_ps(_mm_mul_ps(xi, yr), _mm_mul_ps(xr, yi));
+		__m128 mag2 = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+		__m128 inv = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(mag2)), _mm_cmpgt_ps(mag2, eps));
+
+		_mm_store_ps(&gr[k], _mm_mul_ps(re, inv));
+		_mm_store_ps(&gi[k], _mm_mul_ps(im, inv));
+	}
+#else
+	for (k = 0; k < InstancePtr->n; k++)
+	{
+		float re = ar[k] * br[k] + ai[k] * bi[k];
+		float im = ai[k] * br[k] - ar[k] * bi[k];
+		float mag2 = re * re + im * im;
+		float inv = (mag2 > PHAT_EPSILON) ? 1.0f / sqrtf(mag2) : 0.0f;
+
+		gr[k] = re * inv;
+		gi[k] = im * inv;
+	}
+#endif
+}
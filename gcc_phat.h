@@ -0,0 +1,78 @@
+/**
+*
+* @file gcc_phat.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for gcc_phat.c.
+* gcc_phat.c estimates the time difference of arrival between two sampled microphone
+* channels using the generalized cross-correlation with phase transform (GCC-PHAT).
+* It is an alternative to taking the TDOA from a single comparator edge per channel
+* and produces the same signed clk2 count "phase_diff" that the servo mapping uses.
+*
+* All storage is inside the GccPhat instance: the FFT plan (twiddles and bit
+* reversal table) is computed once by PHAT_Initialize() and the work buffers are reused
+* for every frame, so PHAT_Frame() does no allocation.
+*
+******************************************************************************/
+
+#ifndef GCC_PHAT_H	/* prevent circular inclusions */
+#define GCC_PHAT_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+// Largest supported FFT.  Frames are half the FFT size (the other half is
+// zero padding so the correlation is linear rather than circular).
+#ifndef PHAT_MAX_LOG2N
+#define PHAT_MAX_LOG2N		10
+#endif
+#define PHAT_MAX_N			(1 << PHAT_MAX_LOG2N)
+
+#define PHAT_ALIGN			16
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	int		phase_diff;			// time_1 - time_2 in clk2 counts
+	float	lag;				// signal 1 delay relative to signal 2, in samples
+	float	confidence;			// normalized PHAT peak height, 0 (none) to 1 (pure delay)
+} GccPhatResult;
+
+typedef struct {
+	int		log2n;				// FFT size is 2^log2n
+	int		n;
+	int		frame;				// samples per channel per frame (n / 2)
+	int		max_lag;			// peak search window, +/- samples
+	float	counts_per_sample;	// clk2 counts per sample period
+
+	// FFT plan
+	float	twr[PHAT_MAX_N / 2] __attribute__((aligned(PHAT_ALIGN)));
+	float	twi[PHAT_MAX_N / 2] __attribute__((aligned(PHAT_ALIGN)));
+	u16		bitrev[PHAT_MAX_N];
+
+	// work buffers (split real/imaginary)
+	float	zr[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+	float	zi[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+	float	x1r[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+	float	x1i[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+	float	x2r[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+	float	x2i[PHAT_MAX_N] __attribute__((aligned(PHAT_ALIGN)));
+} GccPhat;
+
+/************************** Function Prototypes ******************************/
+int PHAT_Initialize(GccPhat *InstancePtr, int log2n, u32 sample_hz, u32 clk2_hz, int max_lag);
+int PHAT_Frame(GccPhat *InstancePtr, const s16 *signal_1, const s16 *signal_2,
+		GccPhatResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -0,0 +1,353 @@
+/**
+*
+* @file goertzel.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides a bank of fixed-point Goertzel detectors for two sampled microphone
+* channels.  For each band and block:
+*
+*	1. the first difference of both channels, times a Hann window, runs through the
+*	   Goertzel recursion s = x + 2cos(w) s' - s'', the state kept in 32 bits (the input
+*	   is scaled down for the long blocks and low bands where it could otherwise
+*	   overflow).  This is the only per-sample work.  The difference takes the same
+*	   phase off both channels, but puts the hum and rumble below the bands 20 to 40 dB
+*	   down, so they do not leak into them,
+*	2. the last two states give the band's complex amplitude Y = s' - exp(-jw) s'' in
+*	   each channel, and |Y|^2 / |1 - exp(-jw)|^2 its level.  A band passes the gate if
+*	   in both channels its mean square level is at least min_power, and min_ratio times
+*	   the level white noise with the power of the whole block would have in one band
+*	   (2 / block_len of it).  A tone alone in the block is block_len / 2 times that
+*	   level, broadband sound about 1.5 (the window's noise bandwidth),
+*	3. for the bands that pass, the phase of Y1 * conj(Y2) (found by CORDIC) is the
+*	   phase difference between the channels, and phase / (2 pi f) the delay.
+*
+* Both channels carry the same exp(jw(N-1)) factor, which cancels in Y1 * conj(Y2).  What
+* does not cancel is the leakage of everything else in the block into the band, above all
+* the tone's own image at -f and the hum, and it moves the phase by an amount that depends
+* on where the block falls.  Unwindowed, a 1000 Hz band over 256 samples at 48828 Hz (10.5
+* bins from its image) read a noise-free 12000 count delay with a spread of 490 counts.
+* The Hann window, computed once by GOERTZEL_Initialize(), brings that down to 11 counts
+* (bench_goertzel -s 200 -c 0), so a band need not sit on a multiple of
+* sample_hz / block_len, though it should be a few bins clear of 0 Hz: the window's main
+* lobe reaches 2 bins either side.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <math.h>
+
+#include "goertzel.h"
+
+
+/************************** Constant Definitions *****************************/
+#define ANGLE_HALF_TURN		0x80000000u		// angles are in 2^-32 turns
+#define CORDIC_STEPS		20
+#define CORDIC_INPUT_BITS	29				// the vector is scaled to within +/- 2^this
+
+/************************** Variable Definitions *****************************/
+// atan(2^-i) in 2^-32 turns
+static const u32 cordic_atan[CORDIC_STEPS] =
+{
+	536870912,	316933406,	167458907,	85004756,	42667331,
+	21354465,	10679838,	5340245,	2670163,	1335087,
+	667544,		333772,		166886,		83443,		41722,
+	20861,		10430,		5215,		2608,		1304
+};
+
+/************************** Function Prototypes ******************************/
+static u32 goertzel_power(const GoertzelBank *InstancePtr, const GoertzelBand *band, s32 re, s32 im);
+static bool goertzel_gate(const GoertzelBank *InstancePtr, u32 power, u32 block_power);
+static s32 goertzel_angle(s64 y, s64 x);
+
+
+/*****************************************************************************/
+/**
+* Initializes a Goertzel bank
+*
+* Computes the window and the coefficients and input scaling of every band, and sets the
+* default gate.
+*
+* @param    InstancePtr is a pointer to the GoertzelBank instance to initialize
+* @param	freq_hz is the center frequency of each band
+* @param	num_bands is the number of bands (1 to GOERTZEL_MAX_BANDS)
+* @param	block_log2 is the base 2 log of the block length in samples
+* @param	sample_hz is the sample rate of both channels
+* @param	count_hz is the rate of the counts phase_diff is expressed in
+* @param	max_counts is the largest possible |phase_diff| (the end-fire delay)
+*
+* @return
+*
+*   - XST_SUCCESS if the bank was initialized
+*	- XST_INVALID_PARAM if the block length is out of range, or a band is not below
+*	  sample_hz / 2 and count_hz / (2 * max_counts)
+*
+******************************************************************************/
+int GOERTZEL_Initialize(GoertzelBank *InstancePtr, const u32 *freq_hz, int num_bands, int block_log2,
+		u32 sample_hz, u32 count_hz, u32 max_counts)
+{
+	int i;
+
+	if ((num_bands < 1) || (num_bands > GOERTZEL_MAX_BANDS) || (sample_hz == 0) || (max_counts == 0) ||
+		(block_log2 < GOERTZEL_MIN_BLOCK_LOG2) || (block_log2 > GOERTZEL_MAX_BLOCK_LOG2))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	InstancePtr->num_bands = num_bands;
+	InstancePtr->block_log2 = block_log2;
+	InstancePtr->block_len = 1 << block_log2;
+	InstancePtr->max_counts = max_counts;
+	InstancePtr->block_power_1 = 0;
+	InstancePtr->block_power_2 = 0;
+	InstancePtr->blocks = 0;
+
+	// the periodic Hann window is symmetric about block_len / 2, so half of it is kept
+	for (i = 0; i <= InstancePtr->block_len / 2; i++)
+	{
+		InstancePtr->window[i] = (u16) lround((0.5 - 0.5 * cos(2.0 * M_PI * i / InstancePtr->block_len)) *
+			(1 << GOERTZEL_WINDOW_FRAC));
+	}
+
+	for (i = 0; i < num_bands; i++)
+	{
+		GoertzelBand *band = &InstancePtr->band[i];
+		double w, bound;
+
+		// the phase of a band only tells the delay apart within half a period
+		if ((freq_hz[i] == 0) || (2 * (u64) freq_hz[i] >= sample_hz) ||
+			(2 * (u64) freq_hz[i] * max_counts > count_hz))
+		{
+			return XST_INVALID_PARAM;
+		}
+		w = 2.0 * M_PI * freq_hz[i] / sample_hz;
+		band->freq_hz = freq_hz[i];
+		band->coef = (s32) lround(2.0 * cos(w) * (1 << GOERTZEL_COEF_FRAC));
+		band->cos_w = (s32) lround(cos(w) * (1 << GOERTZEL_COEF_FRAC));
+		band->sin_w = (s32) lround(sin(w) * (1 << GOERTZEL_COEF_FRAC));
+		band->counts_per_turn = (count_hz + freq_hz[i] / 2) / freq_hz[i];
+
+		band->deemphasis = (u32) lround(65536.0 / (2.0 - 2.0 * cos(w)));
+
+		// the impulse response is sin((n+1)w) / sin(w), so a block of full scale
+		// differences keeps the state within 2^16 * block_len / sin(w)
+		bound = 65536.0 * InstancePtr->block_len / sin(w);
+		for (band->shift = 0; bound > (double) (1 << GOERTZEL_STATE_BITS); band->shift++)
+		{
+			bound /= 2.0;
+		}
+		if ((band->shift > 16) || (band->deemphasis > (1u << 30)))
+		{
+			return XST_INVALID_PARAM;
+		}
+
+		band->power_1 = 0;
+		band->power_2 = 0;
+		band->phase_diff = 0;
+		band->valid = false;
+		band->detections = 0;
+		band->rejected = 0;
+	}
+	return GOERTZEL_SetGate(InstancePtr, GOERTZEL_DEFAULT_LEVEL, GOERTZEL_DEFAULT_RATIO);
+}
+
+
+/*****************************************************************************/
+/**
+* Sets the gate a band has to pass to produce a phase difference
+*
+* @param    InstancePtr is a pointer to the GoertzelBank instance
+* @param	min_level is the smallest tone amplitude, in PCM units, in each channel
+* @param	min_ratio is the smallest band level, in each channel, relative to that of a
+*			flat spectrum with the power of the block, GOERTZEL_RATIO_ONE = 1.0
+*
+* @return
+*
+*   - XST_SUCCESS if the gate was set
+*	- XST_INVALID_PARAM if min_level is beyond full scale or min_ratio beyond what a
+*	  band can reach (block_len / 2)
+*
+******************************************************************************/
+int GOERTZEL_SetGate(GoertzelBank *InstancePtr, u32 min_level, u32 min_ratio)
+{
+	if ((min_level > 32767) || (min_ratio > (GOERTZEL_RATIO_ONE << (GOERTZEL_MAX_BLOCK_LOG2 - 1))))
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->min_power = (min_level * min_level) / 2;		// mean square of the tone
+	InstancePtr->min_ratio = min_ratio;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Runs every band over one block of each channel
+*
+* @param    InstancePtr is a pointer to the GoertzelBank instance
+* @param	signal_1 is InstancePtr->block_len samples from microphone 1
+* @param	signal_2 is InstancePtr->block_len samples from microphone 2
+*
+* @return	the number of bands with a valid phase difference.  Each band's valid,
+*			phase_diff and levels are left in InstancePtr->band[]
+*
+* @note
+* A positive phase_diff means signal 1 arrived later, matching time_1 - time_2
+* as computed by FIT_Handler().
+*
+******************************************************************************/
+int GOERTZEL_Block(GoertzelBank *InstancePtr, const s16 *signal_1, const s16 *signal_2)
+{
+	const int	n = InstancePtr->block_len;
+	const u16	*window = InstancePtr->window;
+	u64			energy_1 = 0, energy_2 = 0;
+	int			i, b, valid = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		energy_1 += (u32) (signal_1[i] * signal_1[i]);
+		energy_2 += (u32) (signal_2[i] * signal_2[i]);
+	}
+	InstancePtr->block_power_1 = (u32) (energy_1 >> InstancePtr->block_log2);
+	InstancePtr->block_power_2 = (u32) (energy_2 >> InstancePtr->block_log2);
+	InstancePtr->blocks++;
+
+	for (b = 0; b < InstancePtr->num_bands; b++)
+	{
+		GoertzelBand	*band = &InstancePtr->band[b];
+		const s32		coef = band->coef;
+		const int		shift = GOERTZEL_WINDOW_FRAC + band->shift;
+		s32				p1 = 0, q1 = 0, p2 = 0, q2 = 0, s;		// s' and s'' of each channel
+		s32				x1 = signal_1[0], x2 = signal_2[0];		// last sample
+		s32				re_1, im_1, re_2, im_2;
+		s32				angle;
+
+		for (i = 0; i < n; i++)
+		{
+			const s32 w = window[(i <= n / 2) ? i : n - i];
+
+			s = (((signal_1[i] - x1) * w) >> shift) + (s32) (((s64) coef * p1) >> GOERTZEL_COEF_FRAC) - q1;
+			x1 = signal_1[i];
+			q1 = p1;
+			p1 = s;
+			s = (((signal_2[i] - x2) * w) >> shift) + (s32) (((s64) coef * p2) >> GOERTZEL_COEF_FRAC) - q2;
+			x2 = signal_2[i];
+			q2 = p2;
+			p2 = s;
+		}
+
+		// Y = s' - exp(-jw) s''
+		re_1 = p1 - (s32) (((s64) band->cos_w * q1) >> GOERTZEL_COEF_FRAC);
+		im_1 = (s32) (((s64) band->sin_w * q1) >> GOERTZEL_COEF_FRAC);
+		re_2 = p2 - (s32) (((s64) band->cos_w * q2) >> GOERTZEL_COEF_FRAC);
+		im_2 = (s32) (((s64) band->sin_w * q2) >> GOERTZEL_COEF_FRAC);
+		band->power_1 = goertzel_power(InstancePtr, band, re_1, im_1);
+		band->power_2 = goertzel_power(InstancePtr, band, re_2, im_2);
+
+		band->valid = false;
+		if (!goertzel_gate(InstancePtr, band->power_1, InstancePtr->block_power_1) ||
+			!goertzel_gate(InstancePtr, band->power_2, InstancePtr->block_power_2))
+		{
+			continue;
+		}
+		band->detections++;
+
+		// phase of Y1 * conj(Y2) is phase 1 - phase 2, and a later signal 1 lags
+		angle = goertzel_angle((s64) im_1 * re_2 - (s64) re_1 * im_2, (s64) re_1 * re_2 + (s64) im_1 * im_2);
+		band->phase_diff = (int) (-(((s64) angle * band->counts_per_turn + ANGLE_HALF_TURN) >> 32));
+		if ((band->phase_diff > (int) InstancePtr->max_counts) || (band->phase_diff < -(int) InstancePtr->max_counts))
+		{
+			band->rejected++;
+			continue;
+		}
+		band->valid = true;
+		valid++;
+	}
+	return valid;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the mean square level of a band, in PCM units squared, from its complex
+* amplitude Y.  A tone of amplitude A gives |Y| = A * block_len / 4 (before the first
+* difference and the input scaling; the window averages 1/2), so the level is
+* 8 |Y|^2 / block_len^2 = A^2 / 2
+******************************************************************************/
+static u32 goertzel_power(const GoertzelBank *InstancePtr, const GoertzelBand *band, s32 re, s32 im)
+{
+	u64 mag2 = (u64) ((s64) re * re) + (u64) ((s64) im * im);
+	int sh = 2 * InstancePtr->block_log2 - 2 * band->shift - 3 + 16;
+
+	// undo the first difference, keeping 16 bits of the larger levels to do it
+	if ((mag2 >> 32) != 0)
+	{
+		mag2 = (mag2 >> 16) * band->deemphasis;
+		sh -= 16;
+	}
+	else
+	{
+		mag2 *= band->deemphasis;
+	}
+	mag2 = (sh >= 0) ? (mag2 >> sh) : (mag2 << -sh);
+	return (mag2 > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (u32) mag2;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns true if a band level passes the gate: power >= min_power and
+* power / (2 * block_power / block_len) >= min_ratio
+******************************************************************************/
+static bool goertzel_gate(const GoertzelBank *InstancePtr, u32 power, u32 block_power)
+{
+	return (power > 0) && (power >= InstancePtr->min_power) &&
+		(((u64) power << InstancePtr->block_log2) * GOERTZEL_RATIO_ONE >= 2 * (u64) InstancePtr->min_ratio * block_power);
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the angle of (x, y) in 2^-32 turns, from -1/2 up to 1/2 turn.  The vector is
+* scaled to CORDIC_INPUT_BITS and rotated onto the x axis
+******************************************************************************/
+static s32 goertzel_angle(s64 y, s64 x)
+{
+	u64	mag = (u64) ((x < 0) ? -x : x) | (u64) ((y < 0) ? -y : y);
+	u32	angle = 0;
+	s32	xi, yi, t;
+	int	scale = 0, i;
+
+	while ((mag >> scale) >= (1u << CORDIC_INPUT_BITS))
+	{
+		scale++;
+	}
+	xi = (s32) (x >> scale);
+	yi = (s32) (y >> scale);
+
+	// into the right half plane, then toward y = 0 by the angles atan(2^-i)
+	if (xi < 0)
+	{
+		xi = -xi;
+		yi = -yi;
+		angle = ANGLE_HALF_TURN;
+	}
+	for (i = 0; i < CORDIC_STEPS; i++)
+	{
+		if (yi > 0)
+		{
+			t = xi + (yi >> i);
+			yi -= xi >> i;
+			xi = t;
+			angle += cordic_atan[i];
+		}
+		else
+		{
+			t = xi - (yi >> i);
+			yi += xi >> i;
+			xi = t;
+			angle -= cordic_atan[i];
+		}
+	}
+	return (s32) angle;
+}
@@ -0,0 +1,97 @@
+/**
+*
+* @file goertzel.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for goertzel.c.
+* goertzel.c is a bank of Goertzel detectors over the two sampled microphone channels, one
+* per tone band the source is expected to have.  Over each block it measures the level of
+* every band in both channels and, for the bands loud enough and well above the rest of
+* the spectrum, the phase difference between the channels, converted to the same signed
+* "phase_diff" counts as an edge pair.  Broadband sounds (clicks, HVAC noise) and hum
+* outside the bands do not produce phase samples.
+*
+* The per-sample work is integer only: a difference, a window multiply and one
+* multiply-accumulate per band and channel.  The coefficients and the window are computed
+* once by GOERTZEL_Initialize().  A band's phase difference is only unambiguous while half
+* its period covers the largest delay between the microphones, so the bands have to lie
+* below count_hz / (2 * max_counts), 2 kHz for the 85 mm spacing.
+*
+******************************************************************************/
+
+#ifndef GOERTZEL_H	/* prevent circular inclusions */
+#define GOERTZEL_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef GOERTZEL_MAX_BANDS
+#define GOERTZEL_MAX_BANDS		8
+#endif
+#define GOERTZEL_MIN_BLOCK_LOG2	4
+#define GOERTZEL_MAX_BLOCK_LOG2	12
+
+#define GOERTZEL_COEF_FRAC		28			// fraction bits of the coefficients
+#define GOERTZEL_STATE_BITS		29			// the filter state stays within +/- 2^this
+#define GOERTZEL_RATIO_ONE		(1 << 8)	// band level ratio of 1.0
+#define GOERTZEL_WINDOW_FRAC	15			// fraction bits of the window
+
+// default gate
+#define GOERTZEL_DEFAULT_LEVEL	100			// tone amplitude, PCM units
+#define GOERTZEL_DEFAULT_RATIO	(8 * GOERTZEL_RATIO_ONE)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		freq_hz;			// band center
+	s32		coef;				// 2 cos(w), GOERTZEL_COEF_FRAC fraction bits
+	s32		cos_w;				// cos(w) and sin(w), the same
+	s32		sin_w;
+	int		shift;				// input right shift that keeps the state in range
+	u32		deemphasis;			// 1 / |1 - exp(-jw)|^2, 16 fraction bits
+	u32		counts_per_turn;	// phase counts per period of freq_hz
+	// last block
+	u32		power_1;			// mean square band level, PCM units squared
+	u32		power_2;
+	int		phase_diff;			// time_1 - time_2 in phase counts, if valid
+	bool	valid;				// both channels passed the gate and the delay is possible
+	// statistics
+	u32		detections;			// blocks that passed the gate
+	u32		rejected;			// ... with a delay beyond max_counts (not a single source)
+} GoertzelBand;
+
+typedef struct {
+	int		num_bands;
+	int		block_log2;			// samples per block = 2^block_log2
+	int		block_len;
+	u32		max_counts;			// largest possible |phase_diff|
+	// gate
+	u32		min_power;			// mean square band level, PCM units squared
+	u32		min_ratio;			// band level over that of a flat spectrum, GOERTZEL_RATIO_ONE = 1
+	// last block
+	u32		block_power_1;		// mean square level, PCM units squared
+	u32		block_power_2;
+	u32		blocks;
+	GoertzelBand band[GOERTZEL_MAX_BANDS];
+	u16		window[(1 << (GOERTZEL_MAX_BLOCK_LOG2 - 1)) + 1];	// Hann, first half of the block
+} GoertzelBank;
+
+/************************** Function Prototypes ******************************/
+int  GOERTZEL_Initialize(GoertzelBank *InstancePtr, const u32 *freq_hz, int num_bands, int block_log2,
+		u32 sample_hz, u32 count_hz, u32 max_counts);
+int  GOERTZEL_SetGate(GoertzelBank *InstancePtr, u32 min_level, u32 min_ratio);
+int  GOERTZEL_Block(GoertzelBank *InstancePtr, const s16 *signal_1, const s16 *signal_2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
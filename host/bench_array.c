@@ -0,0 +1,183 @@
+/**
+*
+* @file bench_array.c
+*
+* Measures the microphone array solver in mic_array.c on synthetic sound events.
+* Each event is a plane wave from a random bearing; every microphone gets its
+* geometric arrival time plus uniform timing jitter, and a given fraction of
+* microphone edges are missed.
+*
+* For arrays of 2, 4, 6 and 8 microphones (the original pair, then pairs added
+* around a 42.5 mm radius circle) it reports the mean host cycles per event spent
+* in ARRAY_AddBatch(), the RMS error of the mic 1 - mic 2 phase difference against
+* the noise-free value, the RMS bearing error of the fully solved events, and how
+* many events were solved, fell back to the mic 1 - mic 2 pair, or were dropped.
+*
+* usage: bench_array [-n events] [-j jitter] [-m miss_pct] [-s seed]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "mic_array.h"
+
+/************************** Constant Definitions *****************************/
+#define CLK_HZ				100000000	// Phase_Detection clock
+#define TICK_HZ				40000		// FIT rate
+#define EVENT_SPACING		100000		// counts between events (1 msec)
+#define TICKS_PER_EVENT		(EVENT_SPACING / (CLK_HZ / TICK_HZ))
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	int			num_mics;
+	int			dims;
+	s32			pos[ARRAY_MAX_MICS][3];		// um
+} geometry_t;
+
+/************************** Variable Definitions *****************************/
+static const geometry_t geometries[] = {
+	{ 2, 1, { { 42500, 0, 0 }, { -42500, 0, 0 } } },
+	{ 4, 2, { { 42500, 0, 0 }, { -42500, 0, 0 }, { 0, 42500, 0 }, { 0, -42500, 0 } } },
+	{ 6, 2, { { 42500, 0, 0 }, { -42500, 0, 0 }, { 21250, 36806, 0 }, { -21250, -36806, 0 },
+			  { -21250, 36806, 0 }, { 21250, -36806, 0 } } },
+	{ 8, 2, { { 42500, 0, 0 }, { -42500, 0, 0 }, { 30052, 30052, 0 }, { -30052, -30052, 0 },
+			  { 0, 42500, 0 }, { 0, -42500, 0 }, { -30052, 30052, 0 }, { 30052, -30052, 0 } } },
+};
+static u32 rng_state = 1;
+
+/*****************************************************************************/
+static u32 rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	int		n = 200000, jitter = 20, miss_pct = 0, opt;
+	int		g, k, m;
+
+	while ((opt = getopt(argc, argv, "n:j:m:s:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': n = atoi(optarg); break;
+			case 'j': jitter = atoi(optarg); break;
+			case 'm': miss_pct = atoi(optarg); break;
+			case 's': rng_state = (u32) strtoul(optarg, NULL, 0) | 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n events] [-j jitter] [-m miss_pct] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	printf("%d events, jitter +/-%d counts, %d%% of edges missed\n", n, jitter, miss_pct);
+	printf("mics  cycles/event  phase rms  bearing rms (deg)    solved   partial   dropped\n");
+
+	for (g = 0; g < (int) (sizeof(geometries) / sizeof(geometries[0])); g++)
+	{
+		const geometry_t	*geo = &geometries[g];
+		MicArray			array;
+		EdgeBatch			batch[ARRAY_MAX_MICS / 2];
+		ArrayEvent			events[ARRAY_MAX_EVENTS];
+		int					banks = (geo->num_mics + 1) / 2;
+		int					truth = 0, got, azimuth, elevation;
+		u64					c0, total = 0;
+		u32					base = 12345;
+		double				phase_err2 = 0.0, bearing_err2 = 0.0;
+		int					phase_n = 0, bearing_n = 0;
+
+		if (ARRAY_Initialize(&array, geo->num_mics, geo->pos, geo->dims, CLK_HZ, TICK_HZ) != XST_SUCCESS)
+		{
+			printf("FAILED: %d microphone geometry rejected\n", geo->num_mics);
+			return 1;
+		}
+
+		for (k = 0; k <= n; k++)
+		{
+			double	a = 2.0 * M_PI * (rng() % 360000) / 360000.0;
+			double	ux = cos(a), uy = sin(a);
+			u32		t[ARRAY_MAX_MICS];
+
+			memset(batch, 0, sizeof(batch));
+			for (m = 0; (k < n) && (m < geo->num_mics); m++)
+			{
+				// the wavefront reaches the microphones nearest the source first
+				double	lead = (geo->pos[m][0] * ux + geo->pos[m][1] * uy) * CLK_HZ / ARRAY_SOUND_UM_PER_SEC;
+
+				t[m] = base - (s32) lround(lead);
+				if ((int) (rng() % 100) < miss_pct)
+				{
+					continue;
+				}
+				if (m & 1)
+				{
+					batch[m >> 1].time_2[batch[m >> 1].n_2++] = t[m] + (jitter ? (int) (rng() % (2 * jitter + 1)) - jitter : 0);
+				}
+				else
+				{
+					batch[m >> 1].time_1[batch[m >> 1].n_1++] = t[m] + (jitter ? (int) (rng() % (2 * jitter + 1)) - jitter : 0);
+				}
+			}
+
+			c0 = cycles();
+			got = ARRAY_AddBatch(&array, batch, banks, (u32) k * TICKS_PER_EVENT, events, ARRAY_MAX_EVENTS);
+			total += cycles() - c0;
+
+			// an incomplete event is only closed by the next one, so score against the previous truth
+			for (m = 0; m < got; m++)
+			{
+				int p = (events[m].mask == (1u << geo->num_mics) - 1) ? (int) (t[0] - t[1]) : truth;
+
+				phase_err2 += (double) (events[m].phase_diff - p) * (events[m].phase_diff - p);
+				phase_n++;
+				if (ARRAY_Bearing(&events[m], &azimuth, &elevation) == XST_SUCCESS)
+				{
+					double err = azimuth / 1000.0 - a * 180.0 / M_PI;
+
+					err = fmod(err + 540.0, 360.0) - 180.0;
+					bearing_err2 += err * err;
+					bearing_n++;
+				}
+			}
+			if (k < n)
+			{
+				truth = (int) (t[0] - t[1]);
+			}
+			base += EVENT_SPACING;
+		}
+
+		printf("%4d  %12.1f  %9.1f", geo->num_mics, (double) total / n,
+			phase_n ? sqrt(phase_err2 / phase_n) : 0.0);
+		if (bearing_n)
+		{
+			printf("  %17.3f", sqrt(bearing_err2 / bearing_n));
+		}
+		else
+		{
+			printf("  %17s", "-");
+		}
+		printf("  %8u  %8u  %8u\n", array.solved, array.partial, array.dropped);
+	}
+	return 0;
+}
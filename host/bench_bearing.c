@@ -0,0 +1,211 @@
+/**
+*
+* @file bench_bearing.c
+*
+* Measures the phase difference to bearing conversion in bearing.c against the exact
+* arcsine, for every phase difference from one end-fire delay to the other.
+*
+* For each table step it reports the table size, the host cycles per lookup (TSC where
+* available) and the maximum and RMS bearing error within 60, 75 and 85 degrees of
+* broadside and over the whole field.  It then compares the servo pointing error of
+* the table against the old linear mapping in phase_task() (duty = 7% + 4% * phase
+* difference / window, in whole percents) and counts the distinct servo positions each
+* can command.
+*
+* usage: bench_bearing [-d spacing_um] [-c clk_hz] [-r repeats]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "bearing.h"
+
+/************************** Constant Definitions *****************************/
+#define PWM_CLK_HZ			100000000	// axi_timer clock
+#define CENTER_NS			1400000		// 7% of the period
+#define SPAN_NS				800000		// 4% of the period for 90 degrees
+#define VALID_WINDOW		25000		// phase differences span +/- this many counts
+#define NEUTRAL_DUTY		7
+#define DUTY_SPAN			4
+
+/************************** Variable Definitions *****************************/
+static const int	steps[] = { 0, 2, 4, 6, 8, 10 };
+static const int	limits[] = { 60, 75, 85, 90 };		// degrees off broadside
+#define NUM_LIMITS	((int) (sizeof(limits) / sizeof(limits[0])))
+
+static BearingTable	table;
+static volatile s32	sink;
+
+/*****************************************************************************/
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double exact_deg(int phase_diff, s32 max_delay)
+{
+	double x = (double) phase_diff / max_delay;
+
+	x = (x > 1.0) ? 1.0 : ((x < -1.0) ? -1.0 : x);
+	return asin(x) * 180.0 / M_PI;
+}
+
+int main(int argc, char *argv[])
+{
+	u32		spacing_um = 85000, clk_hz = 100000000;
+	int		repeats = 20, opt, s, l, r, x, status, n, failures = 0;
+	s32		max_delay;
+	u64		c0, total;
+
+	while ((opt = getopt(argc, argv, "d:c:r:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': spacing_um = (u32) strtoul(optarg, NULL, 0); break;
+			case 'c': clk_hz = (u32) strtoul(optarg, NULL, 0); break;
+			case 'r': repeats = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-d spacing_um] [-c clk_hz] [-r repeats]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	printf("spacing %u um, clock %u Hz\n", spacing_um, clk_hz);
+	printf("%37s  max/rms bearing error (deg) within\n", "");
+	printf("step  entries  bytes  cycles/lookup");
+	for (l = 0; l < NUM_LIMITS; l++)
+	{
+		printf("  %9d deg", limits[l]);
+	}
+	printf("\n");
+
+	for (s = 0; s < (int) (sizeof(steps) / sizeof(steps[0])); s++)
+	{
+		double	max_err[NUM_LIMITS], err2[NUM_LIMITS], exact, err;
+		int		count[NUM_LIMITS];
+
+		status = BEARING_Initialize(&table, spacing_um, clk_hz, steps[s], PWM_CLK_HZ,
+			CENTER_NS, SPAN_NS);
+		if (status != XST_SUCCESS)
+		{
+			printf("%4d  (table does not fit in %d entries)\n", 1 << steps[s], BEARING_MAX_ENTRIES);
+			continue;
+		}
+		max_delay = table.max_delay;
+
+		total = 0;
+		n = 0;
+		for (r = 0; r < repeats; r++)
+		{
+			c0 = cycles();
+			for (x = -max_delay; x <= max_delay; x++)
+			{
+				sink = BEARING_Lookup(&table, x);
+			}
+			total += cycles() - c0;
+			n += 2 * max_delay + 1;
+		}
+
+		memset(max_err, 0, sizeof(max_err));
+		memset(err2, 0, sizeof(err2));
+		memset(count, 0, sizeof(count));
+		for (x = -max_delay; x <= max_delay; x++)
+		{
+			exact = exact_deg(x, max_delay);
+			err = fabs(BEARING_Lookup(&table, x) / 1000.0 - exact);
+			for (l = 0; l < NUM_LIMITS; l++)
+			{
+				if (fabs(exact) <= limits[l])
+				{
+					max_err[l] = (err > max_err[l]) ? err : max_err[l];
+					err2[l] += err * err;
+					count[l]++;
+				}
+			}
+
+			// the table entries themselves are exact to the rounding
+			if (((x - table.first) & ((1 << steps[s]) - 1)) == 0 && (err > 0.0005 + 1e-9))
+			{
+				failures++;
+			}
+		}
+
+		printf("%4d  %7d  %5d  %13.1f", 1 << steps[s], table.entries,
+			table.entries * (int) sizeof(s32), (double) total / n);
+		for (l = 0; l < NUM_LIMITS; l++)
+		{
+			printf("  %6.3f/%6.3f", max_err[l], count[l] ? sqrt(err2[l] / count[l]) : 0.0);
+		}
+		printf("\n");
+	}
+
+	// servo pointing with the default table against the old linear duty cycle mapping
+	status = BEARING_Initialize(&table, spacing_um, clk_hz, BEARING_STEP_LOG2, PWM_CLK_HZ,
+		CENTER_NS, SPAN_NS);
+	if (status != XST_SUCCESS)
+	{
+		printf("FAILED: default table does not fit\n");
+		return 1;
+	}
+	max_delay = table.max_delay;
+	{
+		double	lin_max = 0.0, lin2 = 0.0, tab_max = 0.0, tab2 = 0.0, exact, pointed;
+		int		lin_positions = 0, tab_positions = 0, last_duty = -1;
+		u32		ticks, last_ticks = 0;
+
+		for (x = -max_delay; x <= max_delay; x++)
+		{
+			int duty = x * DUTY_SPAN / VALID_WINDOW + NEUTRAL_DUTY;
+
+			exact = exact_deg(x, max_delay);
+
+			// duty cycle in whole percents, 4% for 90 degrees
+			pointed = (duty - NEUTRAL_DUTY) * 90.0 / DUTY_SPAN;
+			lin_max = (fabs(pointed - exact) > lin_max) ? fabs(pointed - exact) : lin_max;
+			lin2 += (pointed - exact) * (pointed - exact);
+			if (duty != last_duty)
+			{
+				lin_positions++;
+				last_duty = duty;
+			}
+
+			// pulse width in PWM timer ticks
+			ticks = BEARING_PulseTicks(&table, x);
+			pointed = ((double) ticks - (double) CENTER_NS * PWM_CLK_HZ / 1e9) * 1e9 / PWM_CLK_HZ *
+				90.0 / SPAN_NS;
+			tab_max = (fabs(pointed - exact) > tab_max) ? fabs(pointed - exact) : tab_max;
+			tab2 += (pointed - exact) * (pointed - exact);
+			if ((x == -max_delay) || (ticks != last_ticks))
+			{
+				tab_positions++;
+				last_ticks = ticks;
+			}
+		}
+		n = 2 * max_delay + 1;
+		printf("\nservo pointing over +/-90 deg   max error  rms error  positions\n");
+		printf("  linear duty cycle (%%)         %9.2f  %9.2f  %9d\n", lin_max, sqrt(lin2 / n),
+			lin_positions);
+		printf("  bearing table (%d count step)  %9.2f  %9.2f  %9d\n", 1 << BEARING_STEP_LOG2,
+			tab_max, sqrt(tab2 / n), tab_positions);
+	}
+
+	if (failures)
+	{
+		printf("FAILED: %d table entries differ from the arcsine\n", failures);
+		return 1;
+	}
+	return 0;
+}
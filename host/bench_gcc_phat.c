@@ -0,0 +1,132 @@
+/**
+*
+* @file bench_gcc_phat.c
+*
+* Throughput and accuracy benchmark for the GCC-PHAT delay estimator.
+*
+* Band-limited noise is generated at 8x the sample rate, and signal 1 is a copy of
+* signal 2 delayed by a known (fractional) number of samples plus independent
+* noise.  Both are decimated to the sample rate and run through PHAT_Frame().
+* The run is single threaded, so frames/sec is per core.
+*
+* usage: bench_gcc_phat [-l log2n] [-f frames] [-d delay] [-s snr_db] [-r sample_hz]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include "gcc_phat.h"
+#include "trace.h"
+
+/************************** Constant Definitions *****************************/
+#define OVERSAMPLE		8
+#define NUM_FRAMES_GEN	64		// distinct frames generated, cycled through the run
+
+/************************** Variable Definitions *****************************/
+static GccPhat		phat;
+static s16			sig_1[NUM_FRAMES_GEN][PHAT_MAX_N / 2];
+static s16			sig_2[NUM_FRAMES_GEN][PHAT_MAX_N / 2];
+
+/*****************************************************************************/
+static double gauss(void)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	int			log2n = 9, frames = 200000, opt;
+	double		delay = 3.375, snr_db = 10.0;
+	u32			sample_hz = 48000;
+	int			frame, shift, f, i, k;
+	double		*raw, noise_gain, err = 0.0, conf = 0.0, t0, elapsed;
+	GccPhatResult res;
+
+	while ((opt = getopt(argc, argv, "l:f:d:s:r:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'l': log2n = atoi(optarg); break;
+			case 'f': frames = atoi(optarg); break;
+			case 'd': delay = atof(optarg); break;
+			case 's': snr_db = atof(optarg); break;
+			case 'r': sample_hz = (u32) atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-l log2n] [-f frames] [-d delay] [-s snr_db] [-r sample_hz]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (PHAT_Initialize(&phat, log2n, sample_hz, TRACE_CLK2_FREQ_HZ, (1 << log2n) / 4) != XST_SUCCESS)
+	{
+		fprintf(stderr, "invalid FFT size or lag window\n");
+		return 1;
+	}
+
+	// generate the frames: moving average band limits the oversampled noise
+	frame = phat.frame;
+	shift = (int) lround(delay * OVERSAMPLE);
+	noise_gain = pow(10.0, -snr_db / 20.0);
+	raw = malloc(sizeof(double) * (frame * OVERSAMPLE + abs(shift) + 2 * OVERSAMPLE));
+	srand(1);
+	for (f = 0; f < NUM_FRAMES_GEN; f++)
+	{
+		int len = frame * OVERSAMPLE + abs(shift) + 2 * OVERSAMPLE;
+
+		for (i = 0; i < len; i++)
+		{
+			raw[i] = gauss();
+		}
+		for (i = 0; i < frame; i++)
+		{
+			double a = 0.0, b = 0.0;
+			int base = i * OVERSAMPLE + OVERSAMPLE + (shift < 0 ? -shift : 0);
+
+			for (k = 0; k < OVERSAMPLE; k++)
+			{
+				a += raw[base + k - shift];
+				b += raw[base + k];
+			}
+			sig_1[f][i] = (s16) lround(3000.0 * (a / OVERSAMPLE + noise_gain * gauss()));
+			sig_2[f][i] = (s16) lround(3000.0 * (b / OVERSAMPLE + noise_gain * gauss()));
+		}
+	}
+	free(raw);
+
+	t0 = now_secs();
+	for (f = 0; f < frames; f++)
+	{
+		PHAT_Frame(&phat, sig_1[f % NUM_FRAMES_GEN], sig_2[f % NUM_FRAMES_GEN], &res);
+		if (f < NUM_FRAMES_GEN)
+		{
+			err += fabs(res.lag - (double) shift / OVERSAMPLE);
+			conf += res.confidence;
+		}
+	}
+	elapsed = now_secs() - t0;
+
+	printf("fft size        %d (%d samples/frame @ %u Hz)\n", phat.n, frame, sample_hz);
+	printf("injected delay  %.3f samples\n", (double) shift / OVERSAMPLE);
+	printf("last estimate   %.3f samples, phase_diff %d counts, confidence %.3f\n",
+		res.lag, res.phase_diff, res.confidence);
+	printf("mean abs error  %.3f samples (mean confidence %.3f)\n",
+		err / NUM_FRAMES_GEN, conf / NUM_FRAMES_GEN);
+	printf("throughput      %.0f frames/sec/core (%.2f us/frame, %.0fx real time)\n",
+		frames / elapsed, 1e6 * elapsed / frames,
+		(double) frames * frame / sample_hz / elapsed);
+	return 0;
+}
@@ -0,0 +1,238 @@
+/**
+*
+* @file bench_goertzel.c
+*
+* Throughput and selectivity benchmark for the Goertzel bank in goertzel.c.
+*
+* The two channels carry a target tone that reaches microphone 1 a known delay after
+* microphone 2, switched on and off every other block, over mains hum (60 Hz and its
+* third harmonic, the same in both channels), independent broadband noise and clicks
+* from another direction.  For each band the report gives the blocks that passed the gate
+* with and without the tone, and the mean (signed, so a bias shows) and standard deviation
+* of the phase difference errors against the injected delay.  The throughput is per band: samples/sec of one band over both channels,
+* and host cycles per sample (TSC where available).  The run is single threaded.
+*
+* usage: bench_goertzel [-b bands_hz] [-t tone_hz] [-l block_log2] [-f blocks] [-d delay_us]
+*                       [-s snr_db] [-c clicks_per_sec] [-L level] [-R ratio] [-r sample_hz]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "goertzel.h"
+#include "trace.h"
+
+/************************** Constant Definitions *****************************/
+#define NUM_BLOCKS_GEN	64			// distinct blocks generated, cycled through the run
+#define TONE_AMPLITUDE	2000.0
+#define HUM_AMPLITUDE	6000.0		// 60 Hz, a third of it at 180 Hz
+#define CLICK_AMPLITUDE	20000.0
+#define CLICK_DELAY_US	(-150.0)	// clicks reach microphone 1 first
+
+/************************** Variable Definitions *****************************/
+static GoertzelBank	bank;
+static s16			sig_1[NUM_BLOCKS_GEN][1 << GOERTZEL_MAX_BLOCK_LOG2];
+static s16			sig_2[NUM_BLOCKS_GEN][1 << GOERTZEL_MAX_BLOCK_LOG2];
+
+/*****************************************************************************/
+static double gauss(void)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static s16 clamp16(double v)
+{
+	return (s16) ((v > 32767.0) ? 32767 : (v < -32768.0) ? -32768 : lround(v));
+}
+
+/*****************************************************************************/
+/**
+* Decaying click at time t after its onset
+******************************************************************************/
+static double click(double t, u32 sample_hz)
+{
+	double k = t * sample_hz;
+
+	return ((k < 0.0) || (k > 16.0)) ? 0.0 : CLICK_AMPLITUDE * exp(-k / 3.0) * cos(2.5 * k);
+}
+
+int main(int argc, char *argv[])
+{
+	u32			bands_hz[GOERTZEL_MAX_BANDS] = { 600, 1000, 1400 };
+	int			num_bands = 3, log2n = 8, blocks = 200000, opt;
+	double		tone_hz = 1000.0, delay_us = 120.0, snr_db = 10.0, click_rate = 20.0;
+	u32			sample_hz = 48828, level = GOERTZEL_DEFAULT_LEVEL;
+	double		ratio = (double) GOERTZEL_DEFAULT_RATIO / GOERTZEL_RATIO_ONE;
+	int			n, f, i, b, on;
+	int			hits[GOERTZEL_MAX_BANDS][2] = { { 0 } };
+	double		err[GOERTZEL_MAX_BANDS] = { 0 }, err2[GOERTZEL_MAX_BANDS] = { 0 };
+	double		noise_sd, truth, t, t0, elapsed, clicks[64];
+	int			num_clicks = 0;
+	u64			c0, c;
+	char		*arg, *end;
+
+	while ((opt = getopt(argc, argv, "b:t:l:f:d:s:c:L:R:r:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'b':
+				for (num_bands = 0, arg = optarg; num_bands < GOERTZEL_MAX_BANDS; arg = end + 1)
+				{
+					bands_hz[num_bands++] = (u32) strtoul(arg, &end, 0);
+					if (*end != ',')
+					{
+						break;
+					}
+				}
+				break;
+			case 't': tone_hz = atof(optarg); break;
+			case 'l': log2n = atoi(optarg); break;
+			case 'f': blocks = atoi(optarg); break;
+			case 'd': delay_us = atof(optarg); break;
+			case 's': snr_db = atof(optarg); break;
+			case 'c': click_rate = atof(optarg); break;
+			case 'L': level = (u32) atoi(optarg); break;
+			case 'R': ratio = atof(optarg); break;
+			case 'r': sample_hz = (u32) atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-b bands_hz] [-t tone_hz] [-l block_log2] [-f blocks] [-d delay_us]\n"
+					"       [-s snr_db] [-c clicks_per_sec] [-L level] [-R ratio] [-r sample_hz]\n", argv[0]);
+				return 1;
+		}
+	}
+	if ((GOERTZEL_Initialize(&bank, bands_hz, num_bands, log2n, sample_hz, TRACE_CLK2_FREQ_HZ,
+			TRACE_MAX_TDOA) != XST_SUCCESS) ||
+		(GOERTZEL_SetGate(&bank, level, (u32) (ratio * GOERTZEL_RATIO_ONE)) != XST_SUCCESS))
+	{
+		fprintf(stderr, "invalid bands, block length or gate (bands must be below %u Hz)\n",
+			TRACE_CLK2_FREQ_HZ / (2 * TRACE_MAX_TDOA));
+		return 1;
+	}
+
+	// one continuous recording; the tone is on in the even blocks
+	n = bank.block_len;
+	noise_sd = TONE_AMPLITUDE / sqrt(2.0) * pow(10.0, -snr_db / 20.0);
+	truth = delay_us * 1e-6 * TRACE_CLK2_FREQ_HZ;
+	srand(1);
+	for (t = 0.0; t < (double) NUM_BLOCKS_GEN * n / sample_hz; )
+	{
+		t += -log((rand() + 1.0) / (RAND_MAX + 2.0)) / click_rate;
+		if (num_clicks < 64)
+		{
+			clicks[num_clicks++] = t;
+		}
+	}
+	for (f = 0; f < NUM_BLOCKS_GEN; f++)
+	{
+		on = (f % 2) == 0;
+		for (i = 0; i < n; i++)
+		{
+			double x1, x2;
+			int k;
+
+			t = (double) (f * n + i) / sample_hz;
+			x1 = x2 = HUM_AMPLITUDE * (sin(2.0 * M_PI * 60.0 * t) + sin(2.0 * M_PI * 180.0 * t) / 3.0);
+			if (on)
+			{
+				x1 += TONE_AMPLITUDE * sin(2.0 * M_PI * tone_hz * (t - delay_us * 1e-6));
+				x2 += TONE_AMPLITUDE * sin(2.0 * M_PI * tone_hz * t);
+			}
+			for (k = 0; k < num_clicks; k++)
+			{
+				x1 += click(t - clicks[k] - CLICK_DELAY_US * 1e-6, sample_hz);
+				x2 += click(t - clicks[k], sample_hz);
+			}
+			sig_1[f][i] = clamp16(x1 + noise_sd * gauss());
+			sig_2[f][i] = clamp16(x2 + noise_sd * gauss());
+		}
+	}
+
+	// selectivity, over the generated blocks
+	for (f = 0; f < NUM_BLOCKS_GEN; f++)
+	{
+		on = (f % 2) == 0;
+		GOERTZEL_Block(&bank, sig_1[f], sig_2[f]);
+		for (b = 0; b < num_bands; b++)
+		{
+			if (bank.band[b].valid)
+			{
+				double e = on ? bank.band[b].phase_diff - truth : 0.0;
+
+				hits[b][on]++;
+				err[b] += e;
+				err2[b] += e * e;
+			}
+		}
+	}
+
+	t0 = now_secs();
+	c0 = cycles();
+	for (f = 0; f < blocks; f++)
+	{
+		GOERTZEL_Block(&bank, sig_1[f % NUM_BLOCKS_GEN], sig_2[f % NUM_BLOCKS_GEN]);
+	}
+	c = cycles() - c0;
+	elapsed = now_secs() - t0;
+
+	printf("block           %d samples @ %u Hz, tone %.0f Hz delayed %.1f us (%.0f counts)\n",
+		n, sample_hz, tone_hz, delay_us, truth);
+	printf("gate            level %u, ratio %.1f\n", level, ratio);
+	printf("%-15s %12s %12s %14s %14s\n", "band", "tone on", "tone off", "mean error", "spread");
+	for (b = 0; b < num_bands; b++)
+	{
+		char label[16], mean[24], spread[24];
+
+		snprintf(label, sizeof(label), "%u Hz", bank.band[b].freq_hz);
+		if (hits[b][1] > 0)
+		{
+			double m = err[b] / hits[b][1];
+
+			snprintf(mean, sizeof(mean), "%+.1f counts", m);
+			snprintf(spread, sizeof(spread), "%.1f counts", sqrt(fmax(err2[b] / hits[b][1] - m * m, 0.0)));
+		}
+		else
+		{
+			snprintf(mean, sizeof(mean), "-");
+			snprintf(spread, sizeof(spread), "-");
+		}
+		printf("%-15s %9d/%-2d %9d/%-2d %14s %14s\n", label, hits[b][1], NUM_BLOCKS_GEN / 2,
+			hits[b][0], NUM_BLOCKS_GEN / 2, mean, spread);
+	}
+	printf("throughput      %.0f samples/sec/band (%.2f ns", (double) blocks * n * num_bands / elapsed,
+		1e9 * elapsed / ((double) blocks * n * num_bands));
+#ifdef HAVE_TSC
+	printf(", %.1f cycles", (double) c / ((double) blocks * n * num_bands));
+#endif
+	printf("/sample/band, %.0f bands in real time)\n",
+		(double) blocks * n * num_bands / elapsed / sample_hz);
+	return 0;
+}
@@ -0,0 +1,176 @@
+/**
+*
+* @file bench_median.c
+*
+* Measures the phase filter in median_filter.c on a synthetic phase sample stream:
+* a slowly moving source with timing jitter and a given fraction of outliers (the
+* phase difference of a spurious edge pair, uniform over the valid window).
+*
+* For each median window it reports the mean and 99th percentile host cycles per
+* sample (TSC where available; the maximum mostly measures host interrupts), the RMS error against the true phase difference, and how many
+* times the duty cycle computed by phase_task() would change - each one is a PWM
+* reprogram.  Every output is also checked against a brute-force sorted median.
+*
+* usage: bench_median [-n samples] [-o outlier_pct] [-j jitter] [-e ema_shift] [-s seed]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "median_filter.h"
+
+/************************** Constant Definitions *****************************/
+#define VALID_WINDOW		25000		// phase differences span +/- this many counts
+#define NEUTRAL_DUTY		7
+#define CYCLE_BINS			4096		// per-sample cycle histogram, last bin catches the rest
+
+/************************** Variable Definitions *****************************/
+static const int windows[] = { 1, 3, 5, 9, 15, 31 };
+static u32 rng_state = 1;
+static u32 cycle_hist[CYCLE_BINS];
+
+/*****************************************************************************/
+static u32 rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+	int x = *(const int *) a, y = *(const int *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int duty_of(int phase_diff)
+{
+	return phase_diff * 4 / VALID_WINDOW + NEUTRAL_DUTY;
+}
+
+int main(int argc, char *argv[])
+{
+	int		n = 1000000, outlier_pct = 5, jitter = 500, ema_shift = 0, opt;
+	int		*truth, *in, w, i, k, failures = 0;
+
+	while ((opt = getopt(argc, argv, "n:o:j:e:s:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': n = atoi(optarg); break;
+			case 'o': outlier_pct = atoi(optarg); break;
+			case 'j': jitter = atoi(optarg); break;
+			case 'e': ema_shift = atoi(optarg); break;
+			case 's': rng_state = (u32) strtoul(optarg, NULL, 0) | 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n samples] [-o outlier_pct] [-j jitter] "
+					"[-e ema_shift] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	// source sweeps the full field every 20000 samples
+	truth = malloc(n * sizeof(int));
+	in = malloc(n * sizeof(int));
+	for (i = 0; i < n; i++)
+	{
+		truth[i] = (int) (0.9 * VALID_WINDOW * sin(2.0 * M_PI * i / 20000.0));
+		if ((int) (rng() % 100) < outlier_pct)
+		{
+			in[i] = (int) (rng() % (2 * VALID_WINDOW + 1)) - VALID_WINDOW;
+		}
+		else
+		{
+			in[i] = truth[i] + (jitter ? (int) (rng() % (2 * jitter + 1)) - jitter : 0);
+		}
+	}
+
+	printf("%d samples, %d%% outliers, jitter +/-%d counts, ema shift %d\n",
+		n, outlier_pct, jitter, ema_shift);
+	printf("window  cycles/sample    p99  rms error  duty changes\n");
+
+	for (w = 0; w < (int) (sizeof(windows) / sizeof(windows[0])); w++)
+	{
+		MedianFilter	filter;
+		int				window = windows[w];
+		int				sorted[MEDIAN_MAX_WINDOW];
+		int				out, duty, last_duty = NEUTRAL_DUTY, changes = 0;
+		u64				c0, c, total = 0, p99;
+		double			err2 = 0.0;
+
+		MEDIAN_Initialize(&filter, window, ema_shift);
+		memset(cycle_hist, 0, sizeof(cycle_hist));
+		for (i = 0; i < n; i++)
+		{
+			c0 = cycles();
+			out = MEDIAN_Update(&filter, in[i]);
+			c = cycles() - c0;
+			total += c;
+			cycle_hist[(c < CYCLE_BINS) ? c : CYCLE_BINS - 1]++;
+
+			// check against a sorted copy of the window (median only)
+			if ((ema_shift == 0) && ((i & 63) == 0))
+			{
+				int len = (i + 1 < window) ? i + 1 : window;
+
+				for (k = 0; k < len; k++)
+				{
+					sorted[k] = in[i - k];
+				}
+				qsort(sorted, len, sizeof(int), cmp_int);
+				k = (len & 1) ? sorted[len / 2] : (sorted[len / 2 - 1] + sorted[len / 2]) / 2;
+				if (k != out)
+				{
+					failures++;
+				}
+			}
+
+			err2 += (double) (out - truth[i]) * (out - truth[i]);
+			duty = duty_of(out);
+			if (duty != last_duty)
+			{
+				changes++;
+				last_duty = duty;
+			}
+		}
+		for (p99 = 0, k = 0; p99 < CYCLE_BINS - 1; p99++)
+		{
+			k += cycle_hist[p99];
+			if (k >= n - n / 100)
+			{
+				break;
+			}
+		}
+		printf("%6d  %13.1f  %5llu  %9.0f  %12d\n", window, (double) total / n,
+			(unsigned long long) p99, sqrt(err2 / n), changes);
+	}
+
+	free(truth);
+	free(in);
+	if (failures)
+	{
+		printf("FAILED: %d outputs differ from the sorted median\n", failures);
+		return 1;
+	}
+	return 0;
+}
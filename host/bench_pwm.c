@@ -0,0 +1,156 @@
+/**
+*
+* @file bench_pwm.c
+*
+* Compares the two PWM update paths in pwm_tmrctr.c against the simulated timer:
+*
+*	- PWM_SetParams() + PWM_Start() - float period/duty math, stops and restarts
+*	  the timer (the output glitches on every update)
+*	- PWM_SetDuty() - table lookup and a single TLR1 write while running
+*	- PWM_SetHighTicks() - the same TLR1 write at full timer resolution
+*
+* For each path it reports host cycles (TSC where available) and nanoseconds per
+* update, plus timer register accesses per update.  The host has a hardware FPU,
+* so the float path is cheaper here than on a soft-float MicroBlaze; the register
+* access counts carry over to the target directly.  Both paths are also checked to
+* produce the same TLR1 (within the float path's one count
+* truncation error) for every duty cycle, and PWM_SetHighNs() is checked to load
+* the exact tick count for servo pulses of 1 to 2 msec.
+*
+* usage: bench_pwm [-n iterations] [-f freq]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "xparameters.h"
+#include "pwm_tmrctr.h"
+#include "sim_hal.h"
+
+/************************** Variable Definitions *****************************/
+static XTmrCtr		PWMTimerInst;
+static volatile u32	sink;
+
+/*****************************************************************************/
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void report(const char *name, int iters, double secs, u64 cyc, u64 reg_accesses)
+{
+	printf("%-24s %8.1f ns/update", name, 1e9 * secs / iters);
+#ifdef HAVE_TSC
+	printf("  %8.1f cycles/update", (double) cyc / iters);
+#endif
+	printf("  %5.1f register accesses/update\n", (double) reg_accesses / iters);
+}
+
+int main(int argc, char *argv[])
+{
+	int		iters = 2000000, opt, i;
+	u32		freq = 50, duty, tlr_float;
+	int		mismatches = 0, diff, max_diff = 0;
+	double	t0, secs;
+	u64		c0, cyc, regs;
+
+	while ((opt = getopt(argc, argv, "n:f:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': iters = atoi(optarg); break;
+			case 'f': freq = (u32) atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-n iterations] [-f freq]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	sim_quiet = 1;
+	if (PWM_Initialize(&PWMTimerInst, XPAR_TMRCTR_0_DEVICE_ID, false, XPAR_CPU_M_AXI_DP_FREQ_HZ) != XST_SUCCESS)
+	{
+		fprintf(stderr, "PWM_Initialize failed\n");
+		return 1;
+	}
+
+	// both paths must load the same duty cycle count, give or take the float
+	// path's truncation error
+	for (duty = 0; duty <= PWM_DUTY_STEPS; duty++)
+	{
+		PWM_SetParams(&PWMTimerInst, freq, duty);
+		tlr_float = sim_tmrctr_reg(PWM_DUTY_TIMER, XTC_TLR_OFFSET);
+		PWM_Start(&PWMTimerInst);
+		PWM_SetDuty(&PWMTimerInst, duty);
+		diff = (int) (sim_tmrctr_reg(PWM_DUTY_TIMER, XTC_TLR_OFFSET) - tlr_float);
+		diff = (diff < 0) ? -diff : diff;
+		max_diff = (diff > max_diff) ? diff : max_diff;
+		mismatches += (diff > 1);
+	}
+	printf("TLR1 float vs table      max difference %d count(s) over 0-%d%% at %u Hz\n",
+		max_diff, PWM_DUTY_STEPS, freq);
+
+	// a servo pulse given in nanoseconds must land on TLR1 = ticks - 2
+	PWM_SetParams(&PWMTimerInst, freq, 7);
+	for (i = 1000000; i <= 2000000; i += 500)
+	{
+		PWM_SetHighNs(&PWMTimerInst, i);
+		mismatches += (sim_tmrctr_reg(PWM_DUTY_TIMER, XTC_TLR_OFFSET) !=
+			(u32) ((u64) i * XPAR_CPU_M_AXI_DP_FREQ_HZ / 1000000000) - 2);
+	}
+	printf("TLR1 for 1-2 msec pulses %s\n", mismatches ? "MISMATCH" : "ok");
+
+	regs = sim_stats.reg_reads + sim_stats.reg_writes;
+	t0 = now_secs();
+	c0 = cycles();
+	for (i = 0; i < iters; i++)
+	{
+		sink = PWM_SetParams(&PWMTimerInst, freq, 3 + (i & 7));
+		PWM_Start(&PWMTimerInst);
+	}
+	cyc = cycles() - c0;
+	secs = now_secs() - t0;
+	report("SetParams+Start (float)", iters, secs, cyc, sim_stats.reg_reads + sim_stats.reg_writes - regs);
+
+	regs = sim_stats.reg_reads + sim_stats.reg_writes;
+	t0 = now_secs();
+	c0 = cycles();
+	for (i = 0; i < iters; i++)
+	{
+		sink = PWM_SetDuty(&PWMTimerInst, 3 + (i & 7));
+	}
+	cyc = cycles() - c0;
+	secs = now_secs() - t0;
+	report("SetDuty (table)", iters, secs, cyc, sim_stats.reg_reads + sim_stats.reg_writes - regs);
+
+	regs = sim_stats.reg_reads + sim_stats.reg_writes;
+	t0 = now_secs();
+	c0 = cycles();
+	for (i = 0; i < iters; i++)
+	{
+		sink = PWM_SetHighTicks(&PWMTimerInst, 140000 + (i & 1023));
+	}
+	cyc = cycles() - c0;
+	secs = now_secs() - t0;
+	report("SetHighTicks", iters, secs, cyc, sim_stats.reg_reads + sim_stats.reg_writes - regs);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+/**
+*
+* @file bench_track.c
+*
+* Measures the multi-source tracker in tracker.c on a synthetic two-source trace: a talker
+* (source A) moving slowly around +8000 counts from the start, and a fan (source B) fixed at
+* -12000 counts that turns on a third of the way through.  Each sound event is a phase
+* sample from one of them, with timing jitter and a given fraction of outliers.
+*
+* The samples are fed the way phase_task() does, in 1 msec batches, to the median filter
+* alone (the single-source pipeline) and to the tracker selecting the strongest and the
+* newest track.  For each it reports how often the output jumps between the sources, the
+* RMS error against the source it should follow (the busier source for the median and the
+* strongest track, the one that started last for the newest), the tracks created and the
+* host cycles per sample and per update (TSC where available).
+*
+* usage: bench_track [-a rate_a] [-b rate_b] [-j jitter] [-o outlier_pct] [-s secs]
+*                    [-k tracks] [-n bins] [-h half_life_ms] [-S seed]
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "median_filter.h"
+#include "tracker.h"
+
+/************************** Constant Definitions *****************************/
+#define VALID_WINDOW		25000		// phase differences span +/- this many counts
+#define FIT_HZ				40000
+#define BATCH_TICKS			40			// phase_task() period, 1 msec
+#define POS_B				(-12000)
+#define JUMP_COUNTS			8000		// an output step this large is a jump between sources
+
+enum { RUN_MEDIAN, RUN_STRONGEST, RUN_NEWEST, NUM_RUNS };
+
+/************************** Variable Definitions *****************************/
+static const char	*run_names[NUM_RUNS] = { "median", "tracker strongest", "tracker newest" };
+static u32			rng_state = 1;
+
+/*****************************************************************************/
+static u32 rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static double urand(void)
+{
+	return (rng() >> 8) / 16777216.0;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int pos_a(double t)
+{
+	return (int) (8000.0 + 4000.0 * sin(2.0 * M_PI * t / 10.0));
+}
+
+int main(int argc, char *argv[])
+{
+	double		rate_a = 20.0, rate_b = 12.0, seconds = 30.0, t_b;
+	int			jitter = 300, outlier_pct = 5, tracks = 3, bins = 64, half_life_ms = 1000, opt;
+	u32			seed = 1;
+	int			run;
+
+	while ((opt = getopt(argc, argv, "a:b:j:o:s:k:n:h:S:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'a': rate_a = atof(optarg); break;
+			case 'b': rate_b = atof(optarg); break;
+			case 'j': jitter = atoi(optarg); break;
+			case 'o': outlier_pct = atoi(optarg); break;
+			case 's': seconds = atof(optarg); break;
+			case 'k': tracks = atoi(optarg); break;
+			case 'n': bins = atoi(optarg); break;
+			case 'h': half_life_ms = atoi(optarg); break;
+			case 'S': seed = (u32) strtoul(optarg, NULL, 0) | 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-a rate_a] [-b rate_b] [-j jitter] [-o outlier_pct] "
+					"[-s secs] [-k tracks] [-n bins] [-h half_life_ms] [-S seed]\n", argv[0]);
+				return 2;
+		}
+	}
+	t_b = seconds / 3.0;
+
+	printf("source A %.0f/s from 0 s, source B %.0f/s at %d from %.1f s, jitter +/-%d, %d%% outliers\n",
+		rate_a, rate_b, POS_B, t_b, jitter, outlier_pct);
+	printf("%d bins, %d tracks, half life %d ms\n", bins, tracks, half_life_ms);
+	printf("%-18s %6s %10s %7s %13s %13s %12s\n", "", "jumps", "rms error", "tracks",
+		"cycles/sample", "cycles/update", "max/update");
+
+	for (run = 0; run < NUM_RUNS; run++)
+	{
+		MedianFilter	filter;
+		Tracker			tracker;
+		const Track		*sel;
+		double			next_a, next_b, t, err2 = 0.0, target;
+		u64				tick, end_tick, c0, c, add_cycles = 0, upd_cycles = 0, upd_max = 0;
+		u64				samples = 0, updates = 0, scored = 0;
+		int				out = 0, have_out = 0, last_out = 0, jumps = 0, x;
+
+		rng_state = seed;
+		MEDIAN_Initialize(&filter, 5, 1);
+		if (TRACK_Initialize(&tracker, bins, VALID_WINDOW, tracks,
+			(run == RUN_NEWEST) ? TRACK_SELECT_NEWEST : TRACK_SELECT_STRONGEST,
+			BATCH_TICKS, (u32) half_life_ms * (FIT_HZ / 1000)) != XST_SUCCESS)
+		{
+			fprintf(stderr, "TRACK_Initialize failed\n");
+			return 2;
+		}
+
+		// Poisson arrivals for each source
+		next_a = -log(1.0 - urand()) / rate_a;
+		next_b = t_b + ((rate_b > 0.0) ? -log(1.0 - urand()) / rate_b : seconds);
+		end_tick = (u64) (seconds * FIT_HZ);
+		for (tick = BATCH_TICKS; tick <= end_tick; tick += BATCH_TICKS)
+		{
+			t = (double) tick / FIT_HZ;
+			while ((next_a <= t) || (next_b <= t))
+			{
+				bool from_a = (next_a <= next_b);
+				double te = from_a ? next_a : next_b;
+
+				if ((int) (rng() % 100) < outlier_pct)
+				{
+					x = (int) (rng() % (2 * VALID_WINDOW + 1)) - VALID_WINDOW;
+				}
+				else
+				{
+					x = (from_a ? pos_a(te) : POS_B) + (jitter ? (int) (rng() % (2 * jitter + 1)) - jitter : 0);
+				}
+				if (from_a)
+				{
+					next_a += -log(1.0 - urand()) / rate_a;
+				}
+				else
+				{
+					next_b += -log(1.0 - urand()) / rate_b;
+				}
+
+				c0 = cycles();
+				if (run == RUN_MEDIAN)
+				{
+					out = MEDIAN_Update(&filter, x);
+					have_out = 1;
+				}
+				else
+				{
+					TRACK_Add(&tracker, x, (u32) tick);
+				}
+				add_cycles += cycles() - c0;
+				samples++;
+			}
+
+			if (run != RUN_MEDIAN)
+			{
+				c0 = cycles();
+				sel = TRACK_Update(&tracker, (u32) tick);
+				c = cycles() - c0;
+				upd_cycles += c;
+				upd_max = (c > upd_max) ? c : upd_max;
+				updates++;
+				if (sel != NULL)
+				{
+					out = sel->phase_diff;
+					have_out = 1;
+				}
+			}
+			if (!have_out)
+			{
+				continue;
+			}
+
+			// the source to follow: the busier one, or for the newest track B once it starts
+			if ((t >= t_b) && (rate_b > 0.0) && ((run == RUN_NEWEST) || (rate_b > rate_a)))
+			{
+				target = POS_B;
+			}
+			else
+			{
+				target = pos_a(t);
+			}
+			// allow a second for a new source to build up and take over
+			if ((t > 1.0) && ((t < t_b) || (t > t_b + 1.0)))
+			{
+				err2 += (out - target) * (out - target);
+				scored++;
+			}
+			if (scored && (abs(out - last_out) >= JUMP_COUNTS))
+			{
+				jumps++;
+			}
+			last_out = out;
+		}
+
+		printf("%-18s %6d %10.0f", run_names[run], jumps, scored ? sqrt(err2 / scored) : 0.0);
+		if (run == RUN_MEDIAN)
+		{
+			printf(" %7s %13.1f %13s %12s\n", "-", samples ? (double) add_cycles / samples : 0.0,
+				"-", "-");
+		}
+		else
+		{
+			printf(" %7u %13.1f %13.1f %12llu\n", tracker.created,
+				samples ? (double) add_cycles / samples : 0.0,
+				updates ? (double) upd_cycles / updates : 0.0, (unsigned long long) upd_max);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,18 @@
+/**
+*
+* @file Nexys4IO.h
+*
+* Host simulation stand-in for the Nexys4IO driver.  The firmware only
+* initializes the peripheral so that is all that is provided.
+*
+******************************************************************************/
+
+#ifndef NEXYS4IO_H
+#define NEXYS4IO_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+
+int NX4IO_initialize(u32 BaseAddr);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+*
+* @file PMod544IOR2.h
+*
+* Host simulation stand-in for the PMod544IOR2 driver.  The firmware only
+* initializes the peripheral so that is all that is provided.
+*
+******************************************************************************/
+
+#ifndef PMOD544IOR2_H
+#define PMOD544IOR2_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+
+int PMDIO_initialize(u32 BaseAddr);
+
+#endif
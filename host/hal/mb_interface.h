@@ -0,0 +1,18 @@
+/**
+*
+* @file mb_interface.h
+*
+* Host simulation stand-in for the MicroBlaze processor interface.  The
+* interrupt enable is a flag checked by the simulated interrupt controller and
+* is reported as MSR[IE] by mfmsr().
+*
+******************************************************************************/
+
+#ifndef MB_INTERFACE_H
+#define MB_INTERFACE_H
+
+void microblaze_enable_interrupts(void);
+void microblaze_disable_interrupts(void);
+unsigned int mfmsr(void);
+
+#endif
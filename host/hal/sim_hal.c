@@ -0,0 +1,844 @@
+/**
+*
+* @file sim_hal.c
+*
+* Host simulation of the Xilinx peripherals used by the firmware.  See
+* sim_hal.h for the model.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "xparameters.h"
+#include "xil_io.h"
+#include "xgpio.h"
+#include "xtmrctr.h"
+#include "xintc.h"
+#include "mb_interface.h"
+#include "Nexys4IO.h"
+#include "PMod544IOR2.h"
+#include "edge_fifo.h"
+#include "servo_pipeline.h"
+#include "pdm_frontend.h"
+#include "sim_hal.h"
+
+/************************** Constant Definitions *****************************/
+#define TMRCTR_NUM_REGS		8		// two timers x (TCSR, TLR, TCR, reserved)
+#define CAPTURE_WINDOW		(25000 << PHASE_TIME_FRAC_BITS)	// Phase_Detection PAIR_WINDOW
+#define PDM_FRAME_LOG2		8		// PDM_Frontend FRAME_LOG2
+#define PDM_FRAME_LEN		(1 << PDM_FRAME_LOG2)
+#define PDM_FRAME_COUNTS	((PDM_CLK_DIV * PDM_DECIMATION * PDM_FRAME_LEN) << PHASE_TIME_FRAC_BITS)
+
+/************************** Variable Definitions *****************************/
+sim_stats_t	sim_stats;
+int			sim_quiet = 0;
+FILE		*sim_console = NULL;
+
+static u32		gpio_data[SIM_GPIO_DEVICES][2];		// channel inputs/outputs
+static u32		tmrctr_regs[TMRCTR_NUM_REGS];		// axi_timer register file
+static XIntc	*intc;								// the (only) interrupt controller
+
+// Phase_Detection edge FIFOs, one per microphone.  Bank 0 (mics 1 and 2) is read
+// through GPIO 1 and 2, bank 1 (mics 3 and 4) through GPIO 4 and 5
+static struct {
+	u32 mem[EDGE_FIFO_DEPTH];
+	u32 rd, wr;
+	u32 last;				// last popped entry
+	u32 overflow;
+	int ack;
+} edge_fifo[SIM_NUM_MICS];
+// Servo_Pipeline: registers (power-up values as in servo_pipeline.v) and pairing state
+static struct {
+	u32 regs[SPIPE_REG_QUIET + 1];		// and the Phase_Detection edge filter registers
+	int ack;
+	u32 pend_1, pend_2;
+	int have_1, have_2;
+	u32 pairs;
+	s32 phase_diff;
+	s32 high;				// pulse width the PWM picks up next period
+	s32 widths[SPIPE_TABLE_ENTRIES];	// TABLE pulse widths
+} fabric = { { 0, 25000 << PHASE_TIME_FRAC_BITS, 209715 >> PHASE_TIME_FRAC_BITS, 140000, 60000, 220000, 2000000 },
+	0, 0, 0, 0, 0, 0, 0, 140000, { 0 } };
+// Phase_Detection wakeup
+static struct {
+	u32 time;
+	int armed;
+} wake;
+// Phase_Detection capture_irq: pairing state per bank and the strobe since the driver last looked
+static struct {
+	u32 pend[2];
+	int have[2];
+} capture_bank[SIM_NUM_MICS / 2];
+static int		capture_strobe;
+// Phase_Detection latched pair of bank 0 (GPIO 9)
+static struct {
+	u32 time_1;
+	u32 info;
+	u32 seq;
+} pair_latch;
+// Phase_Detection edge filters: last accepted and last captured edge per microphone
+static struct {
+	u32 last_edge, last_capture;
+	int have_edge, have_capture;
+} edge_filter[SIM_NUM_MICS];
+// PDM_Frontend: the frame handed to the processor, and the tone the microphones hear
+static struct {
+	s16 frame_1[PDM_FRAME_LEN];
+	s16 frame_2[PDM_FRAME_LEN];
+	int on;					// a tone has been set, frames are being written
+	int ready;				// the processor owns the frame
+	int irq;				// frame_irq since the driver last looked
+	u32 release;			// release toggle last seen
+	u32 end;				// time the frame being written completes
+	u64 sample;				// index of its first sample
+	double cycles_per_count;
+	double level;
+	s32 delay;				// at mic 1, timestamp counts
+} pdm;
+static int		irq_enabled = 0;					// MicroBlaze MSR[IE]
+static u32		clk2_now;							// Phase_Detection timestamp counter
+
+static void		(*idle_hook)(void);
+static void		(*tlr_hook)(int timer, u32 value);
+
+static int		edge_filter_pass(int channel, u32 t);
+static void		fabric_edge(int channel, u32 t);
+static void		capture_edge(int channel, u32 t);
+static u64		cycles(void);
+
+/*****************************************************************************/
+/**
+* Simulation driver hooks
+******************************************************************************/
+void sim_set_idle_hook(void (*hook)(void))
+{
+	idle_hook = hook;
+}
+
+void sim_set_tlr_hook(void (*hook)(int timer, u32 value))
+{
+	tlr_hook = hook;
+}
+
+void sim_idle(void)
+{
+	if (idle_hook)
+	{
+		idle_hook();
+	}
+}
+
+void sim_sleep(void)
+{
+	u64 interrupts = sim_stats.interrupts;
+
+	sim_stats.sleeps++;
+	while (idle_hook && (sim_stats.interrupts == interrupts))
+	{
+		sim_stats.sleep_idles++;
+		idle_hook();
+	}
+}
+
+/*****************************************************************************/
+/**
+* Console
+******************************************************************************/
+void xil_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (sim_console)
+	{
+		va_start(ap, fmt);
+		vfprintf(sim_console, fmt, ap);
+		va_end(ap);
+	}
+	if (sim_quiet)
+	{
+		return;
+	}
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+void outbyte(char c)
+{
+	if (sim_console)
+	{
+		fputc(c, sim_console);
+	}
+	if (!sim_quiet)
+	{
+		putchar(c);
+	}
+}
+
+/*****************************************************************************/
+/**
+* Register access - only the axi_timer is memory mapped in the simulation
+******************************************************************************/
+static u32 *tmrctr_reg_ptr(u32 Addr)
+{
+	u32 offset = Addr - XPAR_TMRCTR_0_BASEADDR;
+
+	if ((Addr < XPAR_TMRCTR_0_BASEADDR) || (offset >= TMRCTR_NUM_REGS * 4))
+	{
+		return NULL;
+	}
+	return &tmrctr_regs[offset >> 2];
+}
+
+u32 Xil_In32(u32 Addr)
+{
+	u32 *reg = tmrctr_reg_ptr(Addr);
+
+	sim_stats.reg_reads++;
+	clk2_now += SIM_BUS_ACCESS_COUNTS;
+	if (Addr == XPAR_AXI_GPIO_3_BASEADDR)
+	{
+		return clk2_now;
+	}
+	return reg ? *reg : 0;
+}
+
+void Xil_Out32(u32 Addr, u32 Value)
+{
+	u32 *reg = tmrctr_reg_ptr(Addr);
+	u32 offset;
+	int timer;
+
+	sim_stats.reg_writes++;
+	clk2_now += SIM_BUS_ACCESS_COUNTS;
+	if (reg == NULL)
+	{
+		return;
+	}
+	offset = (Addr - XPAR_TMRCTR_0_BASEADDR) % XTC_TIMER_COUNTER_OFFSET;
+	timer = (Addr - XPAR_TMRCTR_0_BASEADDR) / XTC_TIMER_COUNTER_OFFSET;
+	*reg = Value;
+
+	if (offset == XTC_TLR_OFFSET)
+	{
+		sim_stats.tlr_writes++;
+		if (tlr_hook)
+		{
+			tlr_hook(timer, Value);
+		}
+	}
+	else if (offset == XTC_TCSR_OFFSET)
+	{
+		// LOAD copies TLR into TCR; ENABLE_ALL starts both timers
+		if (Value & XTC_CSR_LOAD_MASK)
+		{
+			reg[XTC_TCR_OFFSET >> 2] = reg[XTC_TLR_OFFSET >> 2];
+		}
+		if (Value & XTC_CSR_ENABLE_ALL_MASK)
+		{
+			tmrctr_regs[0] |= XTC_CSR_ENABLE_TMR_MASK;
+			tmrctr_regs[XTC_TIMER_COUNTER_OFFSET >> 2] |= XTC_CSR_ENABLE_TMR_MASK;
+		}
+	}
+}
+
+u32 sim_tmrctr_reg(int timer, u32 offset)
+{
+	return tmrctr_regs[((timer * XTC_TIMER_COUNTER_OFFSET) + offset) >> 2];
+}
+
+/*****************************************************************************/
+/**
+* axi_timer
+******************************************************************************/
+int XTmrCtr_Initialize(XTmrCtr *InstancePtr, u16 DeviceId)
+{
+	if (DeviceId != XPAR_TMRCTR_0_DEVICE_ID)
+	{
+		return XST_DEVICE_NOT_FOUND;
+	}
+	memset(tmrctr_regs, 0, sizeof(tmrctr_regs));
+	InstancePtr->BaseAddress = XPAR_TMRCTR_0_BASEADDR;
+	InstancePtr->DeviceId = DeviceId;
+	InstancePtr->IsReady = XIL_COMPONENT_IS_READY;
+	return XST_SUCCESS;
+}
+
+/*****************************************************************************/
+/**
+* Phase_Detection edge FIFOs
+******************************************************************************/
+void sim_edge_push(int channel, u32 timestamp)
+{
+	typeof(edge_fifo[0]) *f = &edge_fifo[channel - 1];
+
+	sim_stats.edges++;
+	if (!edge_filter_pass(channel, timestamp))
+	{
+		sim_stats.edges_filtered++;
+		return;
+	}
+	if (channel <= 2)
+	{
+		fabric_edge(channel, timestamp);
+	}
+	capture_edge(channel, timestamp);
+	if (fabric.regs[SPIPE_REG_EDGE_CTRL] & SPIPE_EDGE_CTRL_LATCH)
+	{
+		return;
+	}
+	if (f->wr - f->rd == EDGE_FIFO_DEPTH)
+	{
+		f->overflow++;
+		sim_stats.edges_dropped++;
+		capture_strobe = 1;
+		return;
+	}
+	f->mem[f->wr++ % EDGE_FIFO_DEPTH] = timestamp;
+	if (f->wr - f->rd >= EDGE_FIFO_DEPTH / 2)
+	{
+		capture_strobe = 1;
+	}
+}
+
+/*****************************************************************************/
+/**
+* Phase_Detection edge filters - holdoff and onset mode.  Trace edges carry no pulse
+* widths, so the glitch filter (MIN_HIGH) is not modelled
+******************************************************************************/
+static int edge_filter_pass(int channel, u32 t)
+{
+	typeof(edge_filter[0]) *e = &edge_filter[channel - 1];
+	int held_off = e->have_capture && (t - e->last_capture < fabric.regs[SPIPE_REG_HOLDOFF]);
+	int new_burst = !e->have_edge || (t - e->last_edge >= fabric.regs[SPIPE_REG_QUIET]);
+	int onset = (fabric.regs[SPIPE_REG_EDGE_CTRL] & SPIPE_EDGE_CTRL_ONSET) != 0;
+
+	e->last_edge = t;
+	e->have_edge = 1;
+	if (held_off || (onset && !new_burst))
+	{
+		return 0;
+	}
+	e->last_capture = t;
+	e->have_capture = 1;
+	return 1;
+}
+
+/*****************************************************************************/
+/**
+* Phase_Detection capture_irq - strobes when an edge completes a pair (the same
+* rule as Capture_Handler()) or leaves its FIFO half full.  Bank 0 pairs are latched
+* for GPIO 9
+******************************************************************************/
+static void capture_edge(int channel, u32 t)
+{
+	typeof(capture_bank[0]) *b = &capture_bank[(channel - 1) / 2];
+	int c = (channel - 1) % 2;
+
+	if (b->have[!c] && (t - b->pend[!c] <= CAPTURE_WINDOW))
+	{
+		if (channel <= 2)
+		{
+			u32 time_1 = c ? b->pend[0] : t;
+			u32 time_2 = c ? t : b->pend[1];
+
+			pair_latch.seq++;
+			pair_latch.time_1 = time_1;
+			pair_latch.info = (((pair_latch.seq ^ (pair_latch.seq >> 1)) << EDGE_INFO_SEQ_SHIFT) & EDGE_INFO_SEQ_MASK) |
+				EDGE_INFO_VALID_MASK | ((time_1 - time_2) & EDGE_INFO_DIFF_MASK);
+		}
+		b->have[0] = b->have[1] = 0;
+		capture_strobe = 1;
+	}
+	else
+	{
+		b->pend[c] = t;
+		b->have[c] = 1;
+	}
+}
+
+int sim_capture_irq(void)
+{
+	int strobe = capture_strobe;
+
+	capture_strobe = 0;
+	return strobe;
+}
+
+/*****************************************************************************/
+/**
+* Servo_Pipeline - pairs mic 1 and mic 2 edges as they are captured (edges are
+* pushed in time order) and maps them to a pulse width
+******************************************************************************/
+static void fabric_map(s32 diff)
+{
+	s32 high = (s32) fabric.regs[SPIPE_REG_CENTER] +
+		(s32) (((s64) diff * (s32) fabric.regs[SPIPE_REG_GAIN]) >> SPIPE_GAIN_FRAC);
+
+	if (fabric.regs[SPIPE_REG_CTRL] & SPIPE_CTRL_TABLE)
+	{
+		// the entry below diff and the rest of diff scaled to 16 bits, as the hardware does
+		int step = (fabric.regs[SPIPE_REG_CTRL] >> SPIPE_CTRL_STEP_SHIFT) & 0x1F;
+		int i = ((diff >> step) + SPIPE_TABLE_HALF) & (SPIPE_TABLE_ENTRIES - 1);
+		s32 frac = (s32) (((u32) diff & ((1u << step) - 1)) << (16 - step));
+		s32 rise = fabric.widths[(i + 1) & (SPIPE_TABLE_ENTRIES - 1)] - fabric.widths[i];
+
+		high = fabric.widths[i] + (s32) (((s64) rise * frac) >> 16);
+	}
+
+	if (high < (s32) fabric.regs[SPIPE_REG_MIN])
+	{
+		high = fabric.regs[SPIPE_REG_MIN];
+	}
+	else if (high > (s32) fabric.regs[SPIPE_REG_MAX])
+	{
+		high = fabric.regs[SPIPE_REG_MAX];
+	}
+	fabric.pairs++;
+	fabric.phase_diff = diff;
+	sim_stats.fabric_pairs++;
+	if ((fabric.regs[SPIPE_REG_CTRL] & SPIPE_CTRL_ENABLE) && (high != fabric.high))
+	{
+		sim_stats.fabric_updates++;
+		if ((u32) abs(high - fabric.high) > sim_stats.fabric_step_max)
+		{
+			sim_stats.fabric_step_max = (u32) abs(high - fabric.high);
+		}
+	}
+	fabric.high = high;
+}
+
+static void fabric_edge(int channel, u32 t)
+{
+	u32 window = fabric.regs[SPIPE_REG_WINDOW];
+
+	if ((channel == 1) && fabric.have_2 && (t - fabric.pend_2 <= window))
+	{
+		fabric_map((s32) (t - fabric.pend_2));
+		fabric.have_1 = fabric.have_2 = 0;
+	}
+	else if ((channel == 2) && fabric.have_1 && (t - fabric.pend_1 <= window))
+	{
+		fabric_map(-(s32) (t - fabric.pend_1));
+		fabric.have_1 = fabric.have_2 = 0;
+	}
+	else if (channel == 1)
+	{
+		fabric.pend_1 = t;
+		fabric.have_1 = 1;
+	}
+	else
+	{
+		fabric.pend_2 = t;
+		fabric.have_2 = 1;
+	}
+}
+
+/*****************************************************************************/
+/**
+* Servo_Pipeline PWM - true while the pipeline drives the servo instead of the
+* axi_timer, with the pulse width it puts out (clk2 clocks) in high
+******************************************************************************/
+int sim_fabric_servo(u32 *high)
+{
+	if (!(fabric.regs[SPIPE_REG_CTRL] & SPIPE_CTRL_ENABLE))
+	{
+		return 0;
+	}
+	*high = (u32) fabric.high;
+	return 1;
+}
+
+static u32 fabric_status(void)
+{
+	return ((fabric.pairs << SPIPE_STS_PAIRS_SHIFT) & SPIPE_STS_PAIRS_MASK) |
+		(fabric.ack ? SPIPE_STS_ACK_MASK : 0) |
+		((fabric.regs[SPIPE_REG_CTRL] & SPIPE_CTRL_ENABLE) ? SPIPE_STS_ENABLED_MASK : 0);
+}
+
+static void fabric_write(u32 ctl)
+{
+	int t = (ctl & SPIPE_CTL_WRITE_MASK) != 0;
+
+	if (t != fabric.ack)
+	{
+		u32 reg = ctl & SPIPE_CTL_ADDR_MASK;
+
+		if ((reg <= SPIPE_REG_PERIOD) || ((reg >= SPIPE_REG_EDGE_CTRL) && (reg <= SPIPE_REG_QUIET)))
+		{
+			fabric.regs[reg] = gpio_data[XPAR_AXI_GPIO_6_DEVICE_ID][SPIPE_DATA_CHANNEL - 1];
+		}
+		else if (reg == SPIPE_REG_TABLE)
+		{
+			u32 v = gpio_data[XPAR_AXI_GPIO_6_DEVICE_ID][SPIPE_DATA_CHANNEL - 1];
+
+			fabric.widths[(v >> SPIPE_TABLE_INDEX_SHIFT) & (SPIPE_TABLE_ENTRIES - 1)] = v & SPIPE_TABLE_WIDTH_MASK;
+		}
+		else if (reg == SPIPE_REG_WAKE)
+		{
+			wake.time = gpio_data[XPAR_AXI_GPIO_6_DEVICE_ID][SPIPE_DATA_CHANNEL - 1];
+			wake.armed = 1;
+		}
+		fabric.ack = t;
+	}
+}
+
+static u32 edge_head(int channel)
+{
+	typeof(edge_fifo[0]) *f = &edge_fifo[channel - 1];
+
+	return (f->wr != f->rd) ? f->mem[f->rd % EDGE_FIFO_DEPTH] : f->last;
+}
+
+static u32 edge_status(int bank)
+{
+	typeof(edge_fifo[0]) *f = &edge_fifo[2 * bank];
+	u32 n_1 = f[0].wr - f[0].rd, n_2 = f[1].wr - f[1].rd;
+
+	// the counts are Gray coded
+	return (((n_1 ^ (n_1 >> 1)) << EDGE_STS_COUNT_1_SHIFT) & EDGE_STS_COUNT_1_MASK) |
+		(f[0].ack ? EDGE_STS_ACK_1_MASK : 0) |
+		(((n_2 ^ (n_2 >> 1)) << EDGE_STS_COUNT_2_SHIFT) & EDGE_STS_COUNT_2_MASK) |
+		(f[1].ack ? EDGE_STS_ACK_2_MASK : 0) |
+		((f[0].overflow << EDGE_STS_OVF_1_SHIFT) & EDGE_STS_OVF_1_MASK) |
+		((f[1].overflow << EDGE_STS_OVF_2_SHIFT) & EDGE_STS_OVF_2_MASK);
+}
+
+static void edge_pop(int bank, u32 toggles)
+{
+	int ch;
+
+	for (ch = 2 * bank; ch < 2 * bank + 2; ch++)
+	{
+		int t = (toggles >> (ch & 1)) & 1;
+
+		if (t != edge_fifo[ch].ack)
+		{
+			if (edge_fifo[ch].wr != edge_fifo[ch].rd)
+			{
+				edge_fifo[ch].last = edge_fifo[ch].mem[edge_fifo[ch].rd++ % EDGE_FIFO_DEPTH];
+			}
+			edge_fifo[ch].ack = t;
+		}
+	}
+}
+
+// PDM_Frontend read port.  A flip of the release toggle releases the frame
+static u32 pdm_read(void)
+{
+	u32 ctl = gpio_data[XPAR_AXI_GPIO_8_DEVICE_ID][PDM_CTL_CHANNEL - 1];
+	u32 i;
+
+	if ((ctl & PDM_CTL_RELEASE_MASK) != pdm.release)
+	{
+		pdm.release = ctl & PDM_CTL_RELEASE_MASK;
+		pdm.ready = 0;
+		sim_stats.pdm_releases++;
+	}
+	if (ctl & PDM_CTL_STATUS_MASK)
+	{
+		return (((u32) sim_stats.pdm_frames << PDM_STS_FRAMES_SHIFT) & PDM_STS_FRAMES_MASK) |
+			(((u32) sim_stats.pdm_overruns << PDM_STS_OVERRUNS_SHIFT) & PDM_STS_OVERRUNS_MASK) |
+			(pdm.release ? PDM_STS_ACK_MASK : 0) | (PDM_FRAME_LOG2 << PDM_STS_LOG2_SHIFT) |
+			(pdm.ready ? PDM_STS_READY_MASK : 0);
+	}
+	i = ctl & (PDM_FRAME_LEN - 1);
+	return (u16) pdm.frame_1[i] | ((u32) (u16) pdm.frame_2[i] << 16);
+}
+
+/*****************************************************************************/
+/**
+* PDM_Frontend microphones - a tone of freq_hz and amplitude level (PCM units) that
+* reaches mic 1 delay counts after mic 2.  Frames are written from the first call on
+******************************************************************************/
+void sim_pdm_tone(u32 freq_hz, u32 count_hz, u32 level, s32 delay)
+{
+	if (!pdm.on)
+	{
+		pdm.on = 1;
+		pdm.end = clk2_now + PDM_FRAME_COUNTS;
+	}
+	pdm.cycles_per_count = (double) freq_hz / count_hz;
+	pdm.level = level;
+	pdm.delay = delay;
+}
+
+/*****************************************************************************/
+/**
+* PDM_Frontend frames - completes the frames due by now.  A frame that completes while
+* the processor holds one is dropped, as in the hardware.  True if frame_irq rose
+******************************************************************************/
+int sim_pdm_irq(void)
+{
+	int irq, i;
+
+	while (pdm.on && ((s32) (clk2_now - pdm.end) >= 0))
+	{
+		if (pdm.ready)
+		{
+			sim_stats.pdm_overruns++;
+		}
+		else
+		{
+			for (i = 0; i < PDM_FRAME_LEN; i++)
+			{
+				double t = (double) (pdm.sample + i) * (PDM_FRAME_COUNTS / PDM_FRAME_LEN);
+
+				pdm.frame_1[i] = (s16) lround(pdm.level * sin(2.0 * M_PI *
+					fmod(pdm.cycles_per_count * (t - pdm.delay), 1.0)));
+				pdm.frame_2[i] = (s16) lround(pdm.level * sin(2.0 * M_PI * fmod(pdm.cycles_per_count * t, 1.0)));
+			}
+			pdm.ready = 1;
+			pdm.irq = 1;
+		}
+		sim_stats.pdm_frames++;
+		pdm.end += PDM_FRAME_COUNTS;
+		pdm.sample += PDM_FRAME_LEN;
+	}
+	irq = pdm.irq;
+	pdm.irq = 0;
+	return irq;
+}
+
+/*****************************************************************************/
+/**
+* axi_gpio
+******************************************************************************/
+int XGpio_Initialize(XGpio *InstancePtr, u16 DeviceId)
+{
+	if (DeviceId >= SIM_GPIO_DEVICES)
+	{
+		return XST_DEVICE_NOT_FOUND;
+	}
+	InstancePtr->BaseAddress = XPAR_AXI_GPIO_0_BASEADDR + DeviceId * 0x10000;
+	InstancePtr->DeviceId = DeviceId;
+	InstancePtr->InterruptPresent = 0;
+	InstancePtr->IsDual = 1;
+	InstancePtr->IsReady = XIL_COMPONENT_IS_READY;
+	return XST_SUCCESS;
+}
+
+void XGpio_SetDataDirection(XGpio *InstancePtr, unsigned Channel, u32 DirectionMask)
+{
+	(void) InstancePtr;
+	(void) Channel;
+	(void) DirectionMask;
+}
+
+u32 XGpio_DiscreteRead(XGpio *InstancePtr, unsigned Channel)
+{
+	sim_stats.gpio_reads++;
+	clk2_now += SIM_BUS_ACCESS_COUNTS;
+	if (InstancePtr->DeviceId == XPAR_AXI_GPIO_3_DEVICE_ID)
+	{
+		return clk2_now;
+	}
+	if (InstancePtr->DeviceId == XPAR_AXI_GPIO_1_DEVICE_ID)
+	{
+		return edge_head(Channel);
+	}
+	if (InstancePtr->DeviceId == XPAR_AXI_GPIO_4_DEVICE_ID)
+	{
+		return edge_head(Channel + 2);
+	}
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_2_DEVICE_ID) && (Channel == EDGE_STATUS_CHANNEL))
+	{
+		return edge_status(0);
+	}
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_5_DEVICE_ID) && (Channel == EDGE_STATUS_CHANNEL))
+	{
+		return edge_status(1);
+	}
+	if (InstancePtr->DeviceId == XPAR_AXI_GPIO_7_DEVICE_ID)
+	{
+		return (Channel == SPIPE_STATUS_CHANNEL) ? fabric_status() : (u32) fabric.phase_diff;
+	}
+	if (InstancePtr->DeviceId == XPAR_AXI_GPIO_9_DEVICE_ID)
+	{
+		return (Channel == EDGE_LATCH_INFO_CHANNEL) ? pair_latch.info : pair_latch.time_1;
+	}
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_8_DEVICE_ID) && (Channel == PDM_DATA_CHANNEL))
+	{
+		return pdm_read();
+	}
+	return gpio_data[InstancePtr->DeviceId][(Channel - 1) & 1];
+}
+
+void XGpio_DiscreteWrite(XGpio *InstancePtr, unsigned Channel, u32 Mask)
+{
+	sim_stats.gpio_writes++;
+	clk2_now += SIM_BUS_ACCESS_COUNTS;
+	gpio_data[InstancePtr->DeviceId][(Channel - 1) & 1] = Mask;
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_2_DEVICE_ID) && (Channel == EDGE_POP_CHANNEL))
+	{
+		edge_pop(0, Mask);
+	}
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_5_DEVICE_ID) && (Channel == EDGE_POP_CHANNEL))
+	{
+		edge_pop(1, Mask);
+	}
+	if ((InstancePtr->DeviceId == XPAR_AXI_GPIO_6_DEVICE_ID) && (Channel == SPIPE_CTL_CHANNEL))
+	{
+		fabric_write(Mask);
+	}
+}
+
+void sim_gpio_set(u16 DeviceId, unsigned Channel, u32 Value)
+{
+	gpio_data[DeviceId][(Channel - 1) & 1] = Value;
+}
+
+u32 sim_gpio_get(u16 DeviceId, unsigned Channel)
+{
+	return gpio_data[DeviceId][(Channel - 1) & 1];
+}
+
+/*****************************************************************************/
+/**
+* axi_intc and the MicroBlaze interrupt enable
+******************************************************************************/
+int XIntc_Initialize(XIntc *InstancePtr, u16 DeviceId)
+{
+	(void) DeviceId;
+	memset(InstancePtr, 0, sizeof(*InstancePtr));
+	InstancePtr->IsReady = XIL_COMPONENT_IS_READY;
+	intc = InstancePtr;
+	return XST_SUCCESS;
+}
+
+int XIntc_Connect(XIntc *InstancePtr, u8 Id, XInterruptHandler Handler, void *CallBackRef)
+{
+	if (Id >= XPAR_INTC_MAX_NUM_INTR_INPUTS)
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->HandlerTable[Id].Handler = Handler;
+	InstancePtr->HandlerTable[Id].CallBackRef = CallBackRef;
+	return XST_SUCCESS;
+}
+
+int XIntc_Start(XIntc *InstancePtr, u8 Mode)
+{
+	InstancePtr->IsStarted = (Mode == XIN_REAL_MODE) ? XIL_COMPONENT_IS_STARTED : 0;
+	return XST_SUCCESS;
+}
+
+void XIntc_Enable(XIntc *InstancePtr, u8 Id)
+{
+	InstancePtr->EnabledMask |= (1U << Id);
+}
+
+void XIntc_Disable(XIntc *InstancePtr, u8 Id)
+{
+	InstancePtr->EnabledMask &= ~(1U << Id);
+}
+
+void XIntc_Acknowledge(XIntc *InstancePtr, u8 Id)
+{
+	(void) InstancePtr;
+	(void) Id;
+}
+
+void microblaze_enable_interrupts(void)
+{
+	irq_enabled = 1;
+}
+
+void microblaze_disable_interrupts(void)
+{
+	irq_enabled = 0;
+}
+
+unsigned int mfmsr(void)
+{
+	return irq_enabled ? 0x2 : 0;
+}
+
+/*****************************************************************************/
+/**
+* Phase_Detection timestamp counter - never moves backwards
+******************************************************************************/
+void sim_clock_set(u32 now)
+{
+	if ((s32) (now - clk2_now) > 0)
+	{
+		clk2_now = now;
+	}
+}
+
+/*****************************************************************************/
+/**
+* Phase_Detection wakeup - true if it fires before until, and then the counter is
+* at the time it was set for (or later, if that time had already gone)
+******************************************************************************/
+int sim_wake_irq(u32 until)
+{
+	if (!wake.armed || ((s32) (until - wake.time) <= 0))
+	{
+		return 0;
+	}
+	wake.armed = 0;
+	sim_clock_set(wake.time);
+	return 1;
+}
+
+void sim_intc_raise(u8 Id)
+{
+	XIntc_VectorTableEntry *entry;
+
+	if (!irq_enabled || (intc == NULL) || (intc->IsStarted != XIL_COMPONENT_IS_STARTED) ||
+		!(intc->EnabledMask & (1U << Id)))
+	{
+		return;
+	}
+	entry = &intc->HandlerTable[Id];
+	if (entry->Handler)
+	{
+		u64 c0 = cycles();
+		u64 bus = sim_stats.gpio_reads + sim_stats.gpio_writes + sim_stats.reg_reads + sim_stats.reg_writes;
+
+		sim_stats.interrupts++;
+		entry->Handler(entry->CallBackRef);
+		if (Id < SIM_INTC_INPUTS)
+		{
+			sim_stats.isr_count[Id]++;
+			sim_stats.isr_cycles[Id] += cycles() - c0;
+			sim_stats.isr_bus[Id] += sim_stats.gpio_reads + sim_stats.gpio_writes +
+				sim_stats.reg_reads + sim_stats.reg_writes - bus;
+		}
+	}
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/*****************************************************************************/
+/**
+* Nexys4IO and PMod544IOR2 - initialization only
+******************************************************************************/
+int NX4IO_initialize(u32 BaseAddr)
+{
+	(void) BaseAddr;
+	return XST_SUCCESS;
+}
+
+int PMDIO_initialize(u32 BaseAddr)
+{
+	(void) BaseAddr;
+	return XST_SUCCESS;
+}
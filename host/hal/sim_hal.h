@@ -0,0 +1,113 @@
+/**
+*
+* @file sim_hal.h
+*
+* Host simulation of the Xilinx peripherals used by the firmware.
+*
+* The firmware is compiled unchanged against the stand-in BSP headers in this
+* directory.  Peripheral state lives here: each axi_gpio has two channels whose
+* inputs are driven by the simulation driver, the axi_timer is a register file
+* reached through Xil_In32()/Xil_Out32(), and the axi_intc dispatches connected
+* handlers when the driver raises an interrupt.
+*
+* The Phase_Detection edge FIFOs are modelled behind GPIO 1 (FIFO heads) and
+* GPIO 2 (status and pop toggles).  The driver queues edges with sim_edge_push();
+* pops take effect immediately.  Edges go through the holdoff and onset edge
+* filters first, set through the GPIO 6 register port.  GPIO 3 (also read
+* directly through Xil_In32()) returns the Phase_Detection timestamp counter: the
+* driver sets it at each FIT tick with sim_clock_set() and every bus access
+* advances it by SIM_BUS_ACCESS_COUNTS, a rough AXI-Lite round trip.
+* Phase_Detection's capture interrupt is modelled as a strobe the driver collects
+* with sim_capture_irq() after queueing edges, and raises if it is set.  GPIO 9
+* returns the last mic 1/2 pair Phase_Detection latched; with latch only set the
+* FIFOs are not pushed.  Servo_Pipeline (GPIO 6 and 7) pairs the mic 1 and mic 2
+* edges as they are queued and maps them to a pulse width; while it is enabled
+* it drives the servo instead of the axi_timer, and sim_fabric_servo() gives the
+* driver the pulse width it puts out.
+* GPIO 8 answers as a PDM_Frontend.  Until the driver sets a tone with sim_pdm_tone()
+* no frame is ever ready; from then on a frame of that tone (plain samples, no PDM
+* modulation) completes every 256 samples, and the driver collects frame_irq with
+* sim_pdm_irq() and raises the interrupt if it is set.  The Phase_Detection wakeup
+* (WAKE, set through the GPIO 6 register port) is collected by the driver with
+* sim_wake_irq(), which also moves the counter up to the time the wakeup was set for.
+*
+* Each dispatched interrupt handler is timed (host TSC cycles) and its bus
+* accesses counted, per interrupt input, so polled and interrupt driven capture
+* can be compared.
+*
+* There is no concurrency on the host.  Instead the firmware calls SIM_IDLE()
+* wherever it would spin waiting for an interrupt, and the driver's idle hook
+* advances simulated time (sets GPIO inputs, raises the FIT interrupt, ...).
+* Where the firmware would sleep until an interrupt it calls sim_sleep(), which
+* runs the idle hook until one is dispatched.  Interrupts raised while masked are
+* dropped, so there is nothing pending to acknowledge.
+*
+******************************************************************************/
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdio.h>
+
+#include "xil_types.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef PHASE_TIME_FRAC_BITS
+#define PHASE_TIME_FRAC_BITS	0		// Phase_Detection sub-clock timestamp bits (n4fpga TIME_FRAC_BITS)
+#endif
+#define SIM_GPIO_DEVICES	10
+#define SIM_NUM_MICS		4			// Phase_Detection edge FIFOs (sim_edge_push() channels 1 to 4)
+#define SIM_BUS_ACCESS_COUNTS	(10 << PHASE_TIME_FRAC_BITS)	// timestamp counts per simulated bus access
+#define SIM_INTC_INPUTS		5			// interrupt inputs with handler statistics
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u64 gpio_reads;			// XGpio_DiscreteRead() calls
+	u64 gpio_writes;		// XGpio_DiscreteWrite() calls
+	u64 reg_reads;			// Xil_In32() accesses
+	u64 reg_writes;			// Xil_Out32() accesses
+	u64 tlr_writes;			// writes to either timer load register
+	u64 interrupts;			// handlers dispatched by the interrupt controller
+	u64 edges;				// edges queued by the driver
+	u64 edges_dropped;		// edges lost to a full FIFO
+	u64 edges_filtered;		// edges ignored by the Phase_Detection edge filters
+	u64 fabric_pairs;		// edge pairs mapped by Servo_Pipeline
+	u64 fabric_updates;		// pulse width changes while Servo_Pipeline drives the servo
+	u32 fabric_step_max;	// ... and the largest of them, clk2 clocks
+	u64 pdm_frames;			// PDM_Frontend frames completed
+	u64 pdm_overruns;		// ... and dropped because the processor held one
+	u64 pdm_releases;		// frames the processor released
+	u64 sleeps;				// sim_sleep() calls
+	u64 sleep_idles;		// idle hook calls made asleep
+	u64 isr_count[SIM_INTC_INPUTS];		// handler runs per interrupt input
+	u64 isr_cycles[SIM_INTC_INPUTS];	// host cycles in the handler (TSC, 0 without one)
+	u64 isr_bus[SIM_INTC_INPUTS];		// bus accesses made by the handler
+} sim_stats_t;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+#define SIM_IDLE()		sim_idle()
+
+/************************** Function Prototypes ******************************/
+void sim_set_idle_hook(void (*hook)(void));
+void sim_set_tlr_hook(void (*hook)(int timer, u32 value));
+void sim_idle(void);
+void sim_sleep(void);
+
+void sim_gpio_set(u16 DeviceId, unsigned Channel, u32 Value);
+u32  sim_gpio_get(u16 DeviceId, unsigned Channel);
+void sim_intc_raise(u8 Id);
+void sim_edge_push(int channel, u32 timestamp);
+int  sim_capture_irq(void);
+u32  sim_tmrctr_reg(int timer, u32 offset);
+void sim_clock_set(u32 now);
+int  sim_wake_irq(u32 until);
+int  sim_fabric_servo(u32 *high);
+void sim_pdm_tone(u32 freq_hz, u32 count_hz, u32 level, s32 delay);
+int  sim_pdm_irq(void);
+
+/************************** Variable Definitions *****************************/
+extern sim_stats_t	sim_stats;
+extern int			sim_quiet;		// suppress xil_printf() output
+extern FILE			*sim_console;	// console output (xil_printf(), outbyte()) goes here instead of stdout
+
+#endif
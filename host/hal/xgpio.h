@@ -0,0 +1,30 @@
+/**
+*
+* @file xgpio.h
+*
+* Host simulation stand-in for the axi_gpio driver.  Each device has two
+* 32-bit channels whose input values are set by the simulation driver with
+* sim_gpio_set() and whose outputs are latched for inspection.
+*
+******************************************************************************/
+
+#ifndef XGPIO_H
+#define XGPIO_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+
+typedef struct {
+	u32 BaseAddress;
+	u32 IsReady;
+	int InterruptPresent;
+	int IsDual;
+	u16 DeviceId;
+} XGpio;
+
+int  XGpio_Initialize(XGpio *InstancePtr, u16 DeviceId);
+void XGpio_SetDataDirection(XGpio *InstancePtr, unsigned Channel, u32 DirectionMask);
+u32  XGpio_DiscreteRead(XGpio *InstancePtr, unsigned Channel);
+void XGpio_DiscreteWrite(XGpio *InstancePtr, unsigned Channel, u32 Mask);
+
+#endif
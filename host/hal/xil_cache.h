@@ -0,0 +1,18 @@
+/**
+*
+* @file xil_cache.h
+*
+* Host simulation stand-in for the BSP cache control.  There are no caches to
+* manage on the host so these are no-ops.
+*
+******************************************************************************/
+
+#ifndef XIL_CACHE_H
+#define XIL_CACHE_H
+
+#define Xil_ICacheEnable()
+#define Xil_DCacheEnable()
+#define Xil_ICacheDisable()
+#define Xil_DCacheDisable()
+
+#endif
@@ -0,0 +1,18 @@
+/**
+*
+* @file xil_io.h
+*
+* Host simulation stand-in for the BSP register accessors.  Accesses are routed
+* to the simulated register files in sim_hal.c.
+*
+******************************************************************************/
+
+#ifndef XIL_IO_H
+#define XIL_IO_H
+
+#include "xil_types.h"
+
+u32  Xil_In32(u32 Addr);
+void Xil_Out32(u32 Addr, u32 Value);
+
+#endif
@@ -0,0 +1,16 @@
+/**
+*
+* @file xil_printf.h
+*
+* Host simulation stand-in for the BSP console.  Output goes to stdout unless
+* the simulation has been made quiet (see sim_hal.h).
+*
+******************************************************************************/
+
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+
+void xil_printf(const char *fmt, ...);
+void outbyte(char c);
+
+#endif
@@ -0,0 +1,30 @@
+/**
+*
+* @file xil_types.h
+*
+* Host simulation stand-in for the Xilinx BSP basic types.  Only the types and
+* constants used by the firmware are provided.
+*
+******************************************************************************/
+
+#ifndef XIL_TYPES_H
+#define XIL_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "xil_printf.h"
+
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+typedef int8_t		s8;
+typedef int16_t		s16;
+typedef int32_t		s32;
+typedef int64_t		s64;
+
+#define XIL_COMPONENT_IS_READY		0x11111111U
+#define XIL_COMPONENT_IS_STARTED	0x22222222U
+
+#endif
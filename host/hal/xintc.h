@@ -0,0 +1,44 @@
+/**
+*
+* @file xintc.h
+*
+* Host simulation stand-in for the axi_intc driver.  Connected handlers are
+* dispatched by sim_intc_raise() when both the source and the processor
+* interrupt are enabled.
+*
+******************************************************************************/
+
+#ifndef XINTC_H
+#define XINTC_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+
+#define XIN_SIMULATION_MODE		0
+#define XIN_REAL_MODE			1
+
+#define XPAR_INTC_MAX_NUM_INTR_INPUTS	32
+
+typedef void (*XInterruptHandler)(void *InstancePtr);
+
+typedef struct {
+	XInterruptHandler	Handler;
+	void				*CallBackRef;
+} XIntc_VectorTableEntry;
+
+typedef struct {
+	u32 BaseAddress;
+	u32 IsReady;
+	u32 IsStarted;
+	u32 EnabledMask;
+	XIntc_VectorTableEntry HandlerTable[XPAR_INTC_MAX_NUM_INTR_INPUTS];
+} XIntc;
+
+int  XIntc_Initialize(XIntc *InstancePtr, u16 DeviceId);
+int  XIntc_Connect(XIntc *InstancePtr, u8 Id, XInterruptHandler Handler, void *CallBackRef);
+int  XIntc_Start(XIntc *InstancePtr, u8 Mode);
+void XIntc_Enable(XIntc *InstancePtr, u8 Id);
+void XIntc_Disable(XIntc *InstancePtr, u8 Id);
+void XIntc_Acknowledge(XIntc *InstancePtr, u8 Id);
+
+#endif
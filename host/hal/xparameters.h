@@ -0,0 +1,56 @@
+/**
+*
+* @file xparameters.h
+*
+* Host simulation stand-in for the generated hardware parameters.  The values
+* mirror the Nexys4 final project block design; base addresses are only used
+* to index the simulated register files in sim_hal.c.
+*
+******************************************************************************/
+
+#ifndef XPARAMETERS_H
+#define XPARAMETERS_H
+
+#define XPAR_CPU_CORE_CLOCK_FREQ_HZ		100000000
+#define XPAR_CPU_M_AXI_DP_FREQ_HZ		100000000
+
+#define XPAR_TMRCTR_0_DEVICE_ID			0
+#define XPAR_TMRCTR_0_BASEADDR			0x41C00000
+
+#define XPAR_NEXYS4IO_0_DEVICE_ID				0
+#define XPAR_NEXYS4IO_0_S00_AXI_BASEADDR		0x44A00000
+#define XPAR_NEXYS4IO_0_S00_AXI_HIGHADDR		0x44A0FFFF
+
+#define XPAR_PMOD544IOR2_0_DEVICE_ID			0
+#define XPAR_PMOD544IOR2_0_S00_AXI_BASEADDR		0x44A10000
+#define XPAR_PMOD544IOR2_0_S00_AXI_HIGHADDR		0x44A1FFFF
+
+#define XPAR_AXI_GPIO_0_DEVICE_ID		0
+#define XPAR_AXI_GPIO_0_BASEADDR		0x40000000
+#define XPAR_AXI_GPIO_1_DEVICE_ID		1
+#define XPAR_AXI_GPIO_1_BASEADDR		0x40010000
+#define XPAR_AXI_GPIO_2_DEVICE_ID		2
+#define XPAR_AXI_GPIO_2_BASEADDR		0x40020000
+#define XPAR_AXI_GPIO_3_DEVICE_ID		3
+#define XPAR_AXI_GPIO_3_BASEADDR		0x40030000
+#define XPAR_AXI_GPIO_4_DEVICE_ID		4
+#define XPAR_AXI_GPIO_4_BASEADDR		0x40040000
+#define XPAR_AXI_GPIO_5_DEVICE_ID		5
+#define XPAR_AXI_GPIO_5_BASEADDR		0x40050000
+#define XPAR_AXI_GPIO_6_DEVICE_ID		6
+#define XPAR_AXI_GPIO_6_BASEADDR		0x40060000
+#define XPAR_AXI_GPIO_7_DEVICE_ID		7
+#define XPAR_AXI_GPIO_7_BASEADDR		0x40070000
+#define XPAR_AXI_GPIO_8_DEVICE_ID		8
+#define XPAR_AXI_GPIO_8_BASEADDR		0x40080000
+#define XPAR_AXI_GPIO_9_DEVICE_ID		9
+#define XPAR_AXI_GPIO_9_BASEADDR		0x40090000
+
+#define XPAR_INTC_0_DEVICE_ID			0
+#define XPAR_MICROBLAZE_0_AXI_INTC_FIT_TIMER_0_INTERRUPT_INTR		0
+#define XPAR_MICROBLAZE_0_AXI_INTC_AXI_TIMER_0_INTERRUPT_INTR		1
+#define XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_CAPTURE_IRQ_INTR			2
+#define XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_PDM_IRQ_INTR				3
+#define XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_WAKE_IRQ_INTR				4
+
+#endif
@@ -0,0 +1,23 @@
+/**
+*
+* @file xstatus.h
+*
+* Host simulation stand-in for the Xilinx status codes.
+*
+******************************************************************************/
+
+#ifndef XSTATUS_H
+#define XSTATUS_H
+
+#include "xil_types.h"
+
+typedef int XStatus;
+
+#define XST_SUCCESS				0L
+#define XST_FAILURE				1L
+#define XST_DEVICE_NOT_FOUND	2L
+#define XST_DEVICE_IS_STARTED	5L
+#define XST_NO_DATA				13L
+#define XST_INVALID_PARAM		15L
+
+#endif
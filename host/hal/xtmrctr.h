@@ -0,0 +1,82 @@
+/**
+*
+* @file xtmrctr.h
+*
+* Host simulation stand-in for the axi_timer driver.  The low level register
+* macros follow xtmrctr_l.h so pwm_tmrctr.c runs unchanged against the
+* simulated timer register file in sim_hal.c.
+*
+******************************************************************************/
+
+#ifndef XTMRCTR_H
+#define XTMRCTR_H
+
+#include "xil_types.h"
+#include "xil_io.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#define XTC_TIMER_COUNTER_OFFSET	16
+
+#define XTC_TCSR_OFFSET		0	// control/status register
+#define XTC_TLR_OFFSET		4	// load register
+#define XTC_TCR_OFFSET		8	// timer counter register
+
+#define XTC_CSR_CASC_MASK			0x00000800
+#define XTC_CSR_ENABLE_ALL_MASK		0x00000400
+#define XTC_CSR_ENABLE_PWM_MASK		0x00000200
+#define XTC_CSR_INT_OCCURED_MASK	0x00000100
+#define XTC_CSR_ENABLE_TMR_MASK		0x00000080
+#define XTC_CSR_ENABLE_INT_MASK		0x00000040
+#define XTC_CSR_LOAD_MASK			0x00000020
+#define XTC_CSR_AUTO_RELOAD_MASK	0x00000010
+#define XTC_CSR_EXT_CAPTURE_MASK	0x00000008
+#define XTC_CSR_EXT_GENERATE_MASK	0x00000004
+#define XTC_CSR_DOWN_COUNT_MASK		0x00000002
+#define XTC_CSR_CAPTURE_MODE_MASK	0x00000001
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32 BaseAddress;
+	u32 IsReady;
+	u16 DeviceId;
+} XTmrCtr;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+#define XTmrCtr_ReadReg(BaseAddress, TmrCtrNumber, RegOffset) \
+	Xil_In32((BaseAddress) + ((TmrCtrNumber) * XTC_TIMER_COUNTER_OFFSET) + (RegOffset))
+
+#define XTmrCtr_WriteReg(BaseAddress, TmrCtrNumber, RegOffset, ValueToWrite) \
+	Xil_Out32((BaseAddress) + ((TmrCtrNumber) * XTC_TIMER_COUNTER_OFFSET) + (RegOffset), (ValueToWrite))
+
+#define XTmrCtr_SetControlStatusReg(BaseAddress, TmrCtrNumber, RegisterValue) \
+	XTmrCtr_WriteReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET, (RegisterValue))
+
+#define XTmrCtr_GetControlStatusReg(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET)
+
+#define XTmrCtr_GetTimerCounterReg(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TCR_OFFSET)
+
+#define XTmrCtr_SetLoadReg(BaseAddress, TmrCtrNumber, RegisterValue) \
+	XTmrCtr_WriteReg((BaseAddress), (TmrCtrNumber), XTC_TLR_OFFSET, (RegisterValue))
+
+#define XTmrCtr_GetLoadReg(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TLR_OFFSET)
+
+#define XTmrCtr_Enable(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_WriteReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET, \
+		(XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET) | XTC_CSR_ENABLE_TMR_MASK))
+
+#define XTmrCtr_Disable(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_WriteReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET, \
+		(XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET) & ~XTC_CSR_ENABLE_TMR_MASK))
+
+#define XTmrCtr_LoadTimerCounterReg(BaseAddress, TmrCtrNumber) \
+	XTmrCtr_WriteReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET, \
+		(XTmrCtr_ReadReg((BaseAddress), (TmrCtrNumber), XTC_TCSR_OFFSET) | XTC_CSR_LOAD_MASK))
+
+/************************** Function Prototypes ******************************/
+int XTmrCtr_Initialize(XTmrCtr *InstancePtr, u16 DeviceId);
+
+#endif
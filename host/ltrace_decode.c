@@ -0,0 +1,254 @@
+/**
+*
+* @file ltrace_decode.c
+*
+* Decodes a firmware latency trace (see latency_trace.h) into per-stage latency
+* statistics.  The input is either a dump written by "replay -L" or a raw console
+* capture from the board: anything before the trace header is skipped.
+*
+* Records are grouped by tag (the FIT tick the edge pair was read on) and the time
+* between consecutive stages of the same measurement is collected:
+*
+*	edge -> read	Phase_Detection capture to FIT_Handler()
+*	read -> phase	FIT_Handler() to phase_task() accepting a new phase_diff
+*	phase -> duty	duty cycle calculation
+*	duty -> tlr		servo task release to the PWM load register write
+*	edge -> tlr		end to end
+*
+* For each it prints the count, p50, p99 and max in microseconds and a log2
+* histogram.  Measurements that stop at a stage (the filtered phase or the duty
+* cycle did not change) only contribute to the stages they reached.
+*
+* usage: ltrace_decode [-q] trace-file
+*	-q		statistics only, no histograms
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "latency_trace.h"
+
+/************************** Constant Definitions *****************************/
+#define HIST_BUCKETS		24			// log2 buckets of clock counts
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	uint32_t	tag;
+	uint32_t	seen;					// stage bit mask, 0 = free slot
+	uint32_t	time[LTRACE_NUM_STAGES];
+} meas_t;
+
+typedef struct {
+	const char	*name;
+	int			from, to;
+	uint32_t	*lat;
+	size_t		n;
+} interval_t;
+
+/************************** Variable Definitions *****************************/
+static interval_t intervals[] = {
+	{ "edge -> read",	LTRACE_EDGE,	LTRACE_READ,	NULL, 0 },
+	{ "read -> phase",	LTRACE_READ,	LTRACE_PHASE,	NULL, 0 },
+	{ "phase -> duty",	LTRACE_PHASE,	LTRACE_DUTY,	NULL, 0 },
+	{ "duty -> tlr",	LTRACE_DUTY,	LTRACE_TLR,	NULL, 0 },
+	{ "edge -> tlr",	LTRACE_EDGE,	LTRACE_TLR,	NULL, 0 },
+};
+#define NUM_INTERVALS	(sizeof(intervals) / sizeof(intervals[0]))
+
+/*****************************************************************************/
+static uint32_t get_u32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE	*fp = fopen(path, "rb");
+	uint8_t	*buf = NULL;
+	size_t	cap = 0, n;
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+	*len = 0;
+	do
+	{
+		if (*len == cap)
+		{
+			cap = cap ? 2 * cap : 65536;
+			buf = realloc(buf, cap);
+		}
+		n = fread(buf + *len, 1, cap - *len, fp);
+		*len += n;
+	} while (n > 0);
+	fclose(fp);
+	return buf;
+}
+
+// open addressing on the tag; the table is at least twice the record count
+static meas_t *lookup(meas_t *table, size_t mask, uint32_t tag)
+{
+	size_t i = (tag * 2654435761u) & mask;
+
+	while (table[i].seen && (table[i].tag != tag))
+	{
+		i = (i + 1) & mask;
+	}
+	table[i].tag = tag;
+	return &table[i];
+}
+
+static void report(interval_t *iv, double us_per_count, int histograms)
+{
+	size_t		hist[HIST_BUCKETS] = { 0 };
+	size_t		i, peak = 0;
+	int			b;
+
+	if (iv->n == 0)
+	{
+		printf("%-14s %8d\n", iv->name, 0);
+		return;
+	}
+	qsort(iv->lat, iv->n, sizeof(uint32_t), cmp_u32);
+	printf("%-14s %8zu %10.2f %10.2f %10.2f\n", iv->name, iv->n,
+		us_per_count * iv->lat[iv->n / 2],
+		us_per_count * iv->lat[iv->n - 1 - iv->n / 100],
+		us_per_count * iv->lat[iv->n - 1]);
+	if (!histograms)
+	{
+		return;
+	}
+
+	for (i = 0; i < iv->n; i++)
+	{
+		for (b = 0; (b < HIST_BUCKETS - 1) && (iv->lat[i] >> b) > 1; b++)
+			;
+		hist[b]++;
+	}
+	for (b = 0; b < HIST_BUCKETS; b++)
+	{
+		peak = (hist[b] > peak) ? hist[b] : peak;
+	}
+	for (b = 0; b < HIST_BUCKETS; b++)
+	{
+		if (hist[b])
+		{
+			printf("    < %10.2f us %8zu %.*s\n", us_per_count * (2u << b), hist[b],
+				(int) (50 * hist[b] / peak + 1), "##################################################");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t		*buf, *p;
+	size_t		len, off, n, i, size, nmeas = 0;
+	uint32_t	magic = LTRACE_MAGIC, version, clock_hz;
+	meas_t		*table;
+	int			opt, histograms = 1, k;
+
+	while ((opt = getopt(argc, argv, "q")) != -1)
+	{
+		switch (opt)
+		{
+			case 'q': histograms = 0; break;
+			default: optind = argc; break;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-q] trace-file\n", argv[0]);
+		return 2;
+	}
+	if ((buf = read_file(argv[optind], &len)) == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	// find the header, skipping console output before it
+	for (off = 0; (off + 16 <= len) && memcmp(buf + off, &magic, 4); off++)
+		;
+	if ((off + 16 > len) || (get_u32(buf + off) != LTRACE_MAGIC))
+	{
+		fprintf(stderr, "%s: no latency trace found\n", argv[optind]);
+		return 1;
+	}
+	version = get_u32(buf + off + 4);
+	n = get_u32(buf + off + 8);
+	clock_hz = get_u32(buf + off + 12);
+	if (((version & 0xFFFF) != LTRACE_VERSION) || ((version >> 16) != sizeof(LTraceRec)) || (clock_hz == 0))
+	{
+		fprintf(stderr, "%s: unsupported trace version\n", argv[optind]);
+		return 1;
+	}
+	p = buf + off + 16;
+	if ((size_t) (buf + len - p) < n * sizeof(LTraceRec))
+	{
+		fprintf(stderr, "%s: trace truncated, decoding %zu of %zu records\n", argv[optind],
+			(size_t) (buf + len - p) / sizeof(LTraceRec), n);
+		n = (size_t) (buf + len - p) / sizeof(LTraceRec);
+	}
+
+	// group the records by measurement; the first record of a stage wins
+	for (size = 16; size < 2 * n; size <<= 1)
+		;
+	table = calloc(size, sizeof(meas_t));
+	for (i = 0; i < n; i++, p += sizeof(LTraceRec))
+	{
+		uint32_t	time = get_u32(p);
+		uint32_t	tag = get_u32(p + 4) & LTRACE_TAG_MASK;
+		int			stage = get_u32(p + 4) >> LTRACE_STAGE_SHIFT;
+		meas_t		*m;
+
+		if (stage >= LTRACE_NUM_STAGES)
+		{
+			continue;
+		}
+		m = lookup(table, size - 1, tag);
+		nmeas += (m->seen == 0);
+		if (!(m->seen & (1u << stage)))
+		{
+			m->seen |= 1u << stage;
+			m->time[stage] = time;
+		}
+	}
+
+	for (k = 0; k < (int) NUM_INTERVALS; k++)
+	{
+		intervals[k].lat = malloc((nmeas + 1) * sizeof(uint32_t));
+	}
+	for (i = 0; i < size; i++)
+	{
+		for (k = 0; k < (int) NUM_INTERVALS; k++)
+		{
+			interval_t *iv = &intervals[k];
+			uint32_t need = (1u << iv->from) | (1u << iv->to);
+
+			if ((table[i].seen & need) == need)
+			{
+				iv->lat[iv->n++] = table[i].time[iv->to] - table[i].time[iv->from];
+			}
+		}
+	}
+
+	printf("%zu records, %zu measurements, clock %u Hz\n", n, nmeas, clock_hz);
+	printf("%-14s %8s %10s %10s %10s\n", "stage", "count", "p50 us", "p99 us", "max us");
+	for (k = 0; k < (int) NUM_INTERVALS; k++)
+	{
+		report(&intervals[k], 1e6 / clock_hz, histograms);
+	}
+	return 0;
+}
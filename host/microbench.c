@@ -0,0 +1,340 @@
+/**
+*
+* @file microbench.c
+*
+* Host harness for the hot path microbenchmarks in microbench.c, built against the
+* simulated Xilinx HAL.  Each benchmark is run for about the minimum time, repeatedly,
+* and reported as one line of key=value fields:
+*
+*	MBENCH name=median ops=4194304 ns_per_op=7.91 ns_median=8.02 cycles_per_op=23.7
+*		ops_per_sec=126422250 allocs=0
+*
+* ns_per_op and cycles_per_op (TSC where available) are the fastest repeat, ns_median
+* the median.  allocs counts the heap allocations made while the benchmarks run (malloc
+* and friends are wrapped at link time); the hot paths must make none, so any fails the
+* run.  Lines starting with '#' are comments.
+*
+* With -b the results are compared with an earlier run, saved from this tool or from the
+* board console of a MICROBENCH build of the firmware (whose lines carry ticks and
+* clock_hz instead of ns_per_op), and the run fails if a benchmark got slower by more
+* than the threshold.  With -i the results are read from a file instead of measured.
+*
+* usage: microbench [-t min_ms] [-r repeats] [-f name] [-b baseline] [-T pct] [-i results] [-l]
+*	-t		least time per repeat (100 ms)
+*	-r		repeats (5)
+*	-f		only run benchmarks whose names contain name
+*	-b		compare with an earlier run
+*	-T		slowdown to fail on, percent (10)
+*	-i		compare results read from a file instead of measuring
+*	-l		list the benchmarks
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC	1
+#endif
+
+#include "microbench.h"
+#include "pwm_tmrctr.h"
+#include "sim_hal.h"
+
+/************************** Constant Definitions *****************************/
+#define MAX_RESULTS			64
+#define MAX_REPEATS			64
+#define PHASE_WINDOW		25000		// finalproject.c PHASE_VALID_WINDOW
+#define MIC_SPACING_UM		85000
+#define PHASE_CLK_HZ		100000000
+#define FIT_HZ				40000
+#define SERVO_CENTER_NS		1400000
+#define SERVO_SPAN_NS		800000
+#define USAGE				"usage: %s [-t min_ms] [-r repeats] [-f name] [-b baseline] [-T pct] [-i results] [-l]\n"
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	char	name[32];
+	double	ns_per_op;
+} result_t;
+
+/************************** Variable Definitions *****************************/
+static XTmrCtr			timer;
+static BearingTable		bearing;
+static volatile u32		sink;
+static volatile long	allocs;			// heap allocations while counting
+static volatile int		counting;
+
+/*****************************************************************************/
+// heap allocation counters, linked in with -Wl,--wrap=malloc etc.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t n, size_t size);
+void *__wrap_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	allocs += counting;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	allocs += counting;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+	allocs += counting;
+	return __real_realloc(p, size);
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/*****************************************************************************/
+/**
+* Reads the MBENCH lines of a results file, from this tool or from the board
+*
+* @return	the number of results, or -1 if the file cannot be read
+******************************************************************************/
+static int read_results(const char *path, result_t *results, int max)
+{
+	FILE	*fp = fopen(path, "r");
+	char	line[512], *tok;
+	int		n = 0;
+	double	ops, ticks, clock_hz, ns;
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	while ((n < max) && fgets(line, sizeof(line), fp))
+	{
+		// the board console may put other text before the line
+		if ((tok = strstr(line, "MBENCH ")) == NULL)
+		{
+			continue;
+		}
+		results[n].name[0] = '\0';
+		ops = ticks = clock_hz = ns = 0.0;
+		for (tok = strtok(tok + 7, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n"))
+		{
+			if (strncmp(tok, "name=", 5) == 0)
+			{
+				snprintf(results[n].name, sizeof(results[n].name), "%s", tok + 5);
+			}
+			else if (strncmp(tok, "ops=", 4) == 0)
+			{
+				ops = atof(tok + 4);
+			}
+			else if (strncmp(tok, "ticks=", 6) == 0)
+			{
+				ticks = atof(tok + 6);
+			}
+			else if (strncmp(tok, "clock_hz=", 9) == 0)
+			{
+				clock_hz = atof(tok + 9);
+			}
+			else if (strncmp(tok, "ns_per_op=", 10) == 0)
+			{
+				ns = atof(tok + 10);
+			}
+		}
+		if ((ns == 0.0) && (ops > 0.0) && (clock_hz > 0.0))
+		{
+			ns = ticks * 1e9 / clock_hz / ops;
+		}
+		if ((results[n].name[0] != '\0') && (ns > 0.0))
+		{
+			results[n++].ns_per_op = ns;
+		}
+	}
+	fclose(fp);
+	return n;
+}
+
+/*****************************************************************************/
+/**
+* Measures one benchmark and prints its line
+*
+* @return	0 if it ran without allocating, otherwise 1
+******************************************************************************/
+static int measure(int index, double min_ns, int repeats, result_t *result)
+{
+	double	ns[MAX_REPEATS], t0, best_ns = 0.0;
+	u64		c0, cyc, best_cyc = 0;
+	u32		ops;
+	long	alloc_count;
+	int		r;
+
+	// calibrate: double the operations until a run takes the minimum time
+	for (ops = 1024; ; ops *= 2)
+	{
+		MBENCH_Prepare(index);
+		t0 = now_ns();
+		sink = MBENCH_Run(index, ops);
+		if ((now_ns() - t0 >= min_ns) || (ops >= 0x40000000))
+		{
+			break;
+		}
+	}
+
+	allocs = 0;
+	for (r = 0; r < repeats; r++)
+	{
+		MBENCH_Prepare(index);
+		counting = 1;
+		t0 = now_ns();
+		c0 = cycles();
+		sink = MBENCH_Run(index, ops);
+		cyc = cycles() - c0;
+		ns[r] = now_ns() - t0;
+		counting = 0;
+		if ((r == 0) || (ns[r] < best_ns))
+		{
+			best_ns = ns[r];
+			best_cyc = cyc;
+		}
+	}
+	alloc_count = allocs;
+	qsort(ns, repeats, sizeof(ns[0]), cmp_double);
+
+	snprintf(result->name, sizeof(result->name), "%s", MBENCH_Name(index));
+	result->ns_per_op = best_ns / ops;
+	printf("MBENCH name=%s ops=%u ns_per_op=%.2f ns_median=%.2f cycles_per_op=%.1f ops_per_sec=%.0f allocs=%ld\n",
+		result->name, ops, result->ns_per_op, ns[repeats / 2] / ops, (double) best_cyc / ops,
+		ops * 1e9 / best_ns, alloc_count);
+	fflush(stdout);
+	return (alloc_count != 0);
+}
+
+int main(int argc, char *argv[])
+{
+	result_t	results[MAX_RESULTS], base[MAX_RESULTS];
+	const char	*filter = NULL, *base_path = NULL, *in_path = NULL;
+	double		min_ms = 100.0, threshold = 10.0, change;
+	int			repeats = 5, list = 0, opt, i, j, n = 0, nbase = 0, failures = 0, regressions = 0;
+
+	while ((opt = getopt(argc, argv, "t:r:f:b:T:i:l")) != -1)
+	{
+		switch (opt)
+		{
+			case 't': min_ms = atof(optarg); break;
+			case 'r': repeats = atoi(optarg); break;
+			case 'f': filter = optarg; break;
+			case 'b': base_path = optarg; break;
+			case 'T': threshold = atof(optarg); break;
+			case 'i': in_path = optarg; break;
+			case 'l': list = 1; break;
+			default:
+				fprintf(stderr, USAGE, argv[0]);
+				return 2;
+		}
+	}
+	if ((optind != argc) || (repeats < 1) || (repeats > MAX_REPEATS) || (in_path && !base_path))
+	{
+		fprintf(stderr, USAGE, argv[0]);
+		return 2;
+	}
+	if (list)
+	{
+		for (i = 0; i < MBENCH_Count(); i++)
+		{
+			printf("%s\n", MBENCH_Name(i));
+		}
+		return 0;
+	}
+
+	if (in_path)
+	{
+		if ((n = read_results(in_path, results, MAX_RESULTS)) < 0)
+		{
+			perror(in_path);
+			return 1;
+		}
+	}
+	else
+	{
+		sim_quiet = 1;
+		if ((PWM_Initialize(&timer, XPAR_TMRCTR_0_DEVICE_ID, false, XPAR_CPU_M_AXI_DP_FREQ_HZ) != XST_SUCCESS) ||
+			(BEARING_Initialize(&bearing, MIC_SPACING_UM, PHASE_CLK_HZ, BEARING_STEP_LOG2,
+				XPAR_CPU_M_AXI_DP_FREQ_HZ, SERVO_CENTER_NS, SERVO_SPAN_NS) != XST_SUCCESS) ||
+			(MBENCH_Initialize(&timer, &bearing, PHASE_WINDOW, PHASE_CLK_HZ / FIT_HZ) != XST_SUCCESS))
+		{
+			fprintf(stderr, "initialization failed\n");
+			return 1;
+		}
+		printf("# microbench: %d repeats of at least %.0f ms, best and median\n", repeats, min_ms);
+		for (i = 0; (i < MBENCH_Count()) && (n < MAX_RESULTS); i++)
+		{
+			if ((filter == NULL) || strstr(MBENCH_Name(i), filter))
+			{
+				failures += measure(i, min_ms * 1e6, repeats, &results[n++]);
+			}
+		}
+	}
+
+	if (base_path)
+	{
+		if ((nbase = read_results(base_path, base, MAX_RESULTS)) < 0)
+		{
+			perror(base_path);
+			return 1;
+		}
+		printf("# against %s, fail above +%.0f%%\n", base_path, threshold);
+		for (i = 0; i < n; i++)
+		{
+			for (j = 0; (j < nbase) && strcmp(base[j].name, results[i].name); j++)
+			{
+			}
+			if (j == nbase)
+			{
+				printf("# %-20s %10s -> %10.2f ns/op  (new)\n", results[i].name, "", results[i].ns_per_op);
+				continue;
+			}
+			change = 100.0 * (results[i].ns_per_op - base[j].ns_per_op) / base[j].ns_per_op;
+			printf("# %-20s %10.2f -> %10.2f ns/op  %+6.1f%%%s\n", results[i].name, base[j].ns_per_op,
+				results[i].ns_per_op, change, (change > threshold) ? "  REGRESSION" : "");
+			regressions += (change > threshold);
+		}
+	}
+
+	if (failures)
+	{
+		printf("FAILED: %d benchmarks allocated memory\n", failures);
+	}
+	if (regressions)
+	{
+		printf("FAILED: %d benchmarks slower than the baseline\n", regressions);
+	}
+	return (failures || regressions) ? 1 : 0;
+}
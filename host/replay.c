@@ -0,0 +1,470 @@
+/**
+*
+* @file replay.c
+*
+* Faster-than-real-time trace replay of the localization firmware on the host.
+*
+* finalproject.c is compiled with main() renamed to firmware_main() and linked
+* against the simulated HAL.  Every time the firmware idles (SIM_IDLE()) this
+* driver advances simulated time by one FIT tick: capture-register records due
+* at that tick are turned into edges (a changed time_1/time_2 value is a new
+* edge on that channel) and queued in the simulated Phase_Detection FIFOs, the
+* capture interrupt is raised if Phase_Detection would have, then the FIT
+* interrupt is raised.  No wall-clock pacing is done so the firmware runs as fast as the host
+* allows.  When the trace is exhausted the run is summarized and the program
+* exits.  The summary includes the cost of each interrupt handler per simulated
+* second; -r 0 runs -s seconds with no sound at all.  Servo tracking is scored
+* every millisecond as the difference between the bearing the servo points at and
+* the bearing of the last event in the trace, both directly and at the lag that
+* fits best, so a servo that follows the source late shows as a large lag rather
+* than a large error.  While Servo_Pipeline drives the servo (make FABRIC=1) the pulse
+* width it puts out is scored instead of the axi_timer's.
+*
+* From the first event on the simulated PDM microphones hear a tone (-t) that reaches
+* mic 1 the TDOA of the last event after mic 2, so a build with the PDM front end
+* (make TONES=1) has frames to work on.
+*
+* usage: replay [options] [trace-file]
+*	-s secs		synthetic trace length (used when no trace file is given)
+*	-r rate		synthetic sound events per second
+*	-p secs		synthetic source sweep period
+*	-J secs		synthetic source jumps to a random bearing every secs instead of sweeping
+*	-j counts	synthetic TDOA jitter (+/- timestamp counts)
+*	-n pct		synthetic percentage of events with a spurious edge
+*	-S seed		synthetic random seed
+*	-t hz		PDM microphone tone frequency (0 for silence)
+*	-w file		write the replayed trace to file
+*	-o file		log servo commands (FIT tick, TLR1) to file
+*	-L file		write the firmware latency trace to file (build with make LTRACE=1)
+*	-c file		write the firmware console output to file (the edge stream with make STREAM=1)
+*	-v			show the firmware console output
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "xparameters.h"
+#include "sim_hal.h"
+#include "trace.h"
+#include "latency_trace.h"
+#include "bearing.h"
+
+/************************** Constant Definitions *****************************/
+#define FIT_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_FIT_TIMER_0_INTERRUPT_INTR
+#define CAPTURE_INTERRUPT_ID	XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_CAPTURE_IRQ_INTR
+#define WAKE_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_WAKE_IRQ_INTR
+#define PDM_INTERRUPT_ID		XPAR_MICROBLAZE_0_AXI_INTC_SYSTEM_PDM_IRQ_INTR
+
+#define PDM_TONE_HZ				1000		// default -t, one of the default tone bands
+#define PDM_TONE_LEVEL			2000		// PCM units
+
+// ticks to keep running after the last record so the firmware can react to it
+#define SETTLE_TICKS			(2 * TRACE_FIT_FREQ_HZ)
+
+// tracking is sampled every millisecond and scored at lags up to a second
+#define TRACK_SAMPLE_TICKS		(TRACE_FIT_FREQ_HZ / 1000)
+#define TRACK_MAX_LAG			1000
+
+/************************** Function Prototypes ******************************/
+int				firmware_main(void);
+static void		replay_tick(void);
+static void		replay_tlr(int timer, u32 value);
+static void		replay_finish(void);
+static void		ltrace_put(u8 byte);
+static double	now_secs(void);
+static void		track_sample(void);
+static void		track_summary(void);
+
+/************************** Variable Definitions *****************************/
+extern BearingTable	PhaseBearing;		// the firmware's bearing table
+
+static trace_src_t	src;
+static trace_rec_t	rec;
+static trace_rec_t	prev;				// register values before rec
+static int			have_rec;
+static uint64_t		tick;				// current FIT tick
+static uint64_t		end_tick;			// tick at which the run stops
+static uint64_t		records;			// records applied
+static uint64_t		servo_cmds;			// TLR1 writes after start-up
+static uint64_t		last_rec_tick;		// tick the most recent record was applied
+static uint64_t		latency_sum;		// record-to-servo-command ticks, summed over commands
+static uint64_t		latency_max;
+static FILE			*trace_out;
+static FILE			*servo_log;
+static FILE			*ltrace_out;
+static uint32_t		clk2_per_tick;		// Phase_Detection counts per FIT tick
+static int			have_src;			// an event has set the source bearing
+static int32_t		src_tdoa;			// TDOA of the last event, timestamp counts
+static u32			tone_hz = PDM_TONE_HZ;
+static int			have_servo;			// the servo has been commanded
+static u32			servo_ticks;		// pulse width last commanded, PWM ticks
+static u32			servo_step_max;		// largest pulse width change, PWM ticks
+static int32_t		*track_src;			// bearing of the source and the servo, mdeg,
+static int32_t		*track_cmd;			// one sample per millisecond once both are known
+static size_t		track_len;
+static size_t		track_cap;
+static double		wall_start;
+
+/*****************************************************************************/
+int main(int argc, char *argv[])
+{
+	trace_synth_t	synth;
+	int				opt;
+
+	trace_synth_defaults(&synth);
+	sim_quiet = 1;
+	while ((opt = getopt(argc, argv, "s:r:p:J:j:n:S:t:w:o:L:c:v")) != -1)
+	{
+		switch (opt)
+		{
+			case 's': synth.seconds = atof(optarg); break;
+			case 'r': synth.event_rate = atof(optarg); break;
+			case 'p': synth.sweep_period = atof(optarg); break;
+			case 'J': synth.hop_period = atof(optarg); break;
+			case 'j': synth.jitter = atoi(optarg); break;
+			case 'n': synth.noise_pct = (uint32_t) atoi(optarg); break;
+			case 'S': synth.seed = (uint32_t) strtoul(optarg, NULL, 0); break;
+			case 't': tone_hz = (u32) atoi(optarg); break;
+			case 'w':
+			case 'o':
+			case 'L':
+				if ((*(opt == 'w' ? &trace_out : (opt == 'o' ? &servo_log : &ltrace_out)) =
+					fopen(optarg, "w")) == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'c':
+				if ((sim_console = fopen(optarg, "wb")) == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'v': sim_quiet = 0; break;
+			default:
+				fprintf(stderr, "usage: %s [-s secs] [-r rate] [-p secs] [-j counts] [-n pct] "
+					"[-S seed] [-t tone-hz] [-w trace-out] [-o servo-log] [-L latency-trace] [-c console-out] [-v] [trace-file]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind < argc)
+	{
+		if (trace_open(&src, argv[optind]) != 0)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	else
+	{
+		trace_open_synth(&src, &synth);
+	}
+
+	clk2_per_tick = synth.clk2_hz / TRACE_FIT_FREQ_HZ;
+	have_rec = trace_next(&src, &rec);
+	end_tick = have_rec ? UINT64_MAX : (uint64_t) (synth.seconds * TRACE_FIT_FREQ_HZ);
+	sim_set_idle_hook(replay_tick);
+	sim_set_tlr_hook(replay_tlr);
+	wall_start = now_secs();
+	return firmware_main();
+}
+
+/*****************************************************************************/
+/**
+* Idle hook - advance simulated time by one FIT tick
+******************************************************************************/
+static void replay_tick(void)
+{
+	while (have_rec && (rec.tick <= tick))
+	{
+		// both edges of a pair can land in one record (a decoded edge stream); they
+		// reach Phase_Detection in time order
+		if ((rec.time_1 != prev.time_1) && (rec.time_2 != prev.time_2) &&
+			((int32_t) (rec.time_2 - rec.time_1) < 0))
+		{
+			sim_edge_push(2, rec.time_2);
+			sim_edge_push(1, rec.time_1);
+		}
+		else
+		{
+			if (rec.time_1 != prev.time_1)
+			{
+				sim_edge_push(1, rec.time_1);
+			}
+			if (rec.time_2 != prev.time_2)
+			{
+				sim_edge_push(2, rec.time_2);
+			}
+		}
+		if (abs((int32_t) (rec.time_1 - rec.time_2)) <= TRACE_MAX_TDOA)
+		{
+			have_src = 1;
+			src_tdoa = (int32_t) (rec.time_1 - rec.time_2);
+			if (tone_hz)
+			{
+				sim_pdm_tone(tone_hz, clk2_per_tick * TRACE_FIT_FREQ_HZ, PDM_TONE_LEVEL, src_tdoa);
+			}
+		}
+		prev = rec;
+		last_rec_tick = tick;
+		if (trace_out)
+		{
+			trace_write(trace_out, &rec);
+		}
+		records++;
+		have_rec = trace_next(&src, &rec);
+		if (!have_rec)
+		{
+			end_tick = tick + SETTLE_TICKS;
+		}
+	}
+	if (tick >= end_tick)
+	{
+		replay_finish();
+		exit(0);
+	}
+	if ((tick % TRACK_SAMPLE_TICKS) == 0)
+	{
+		track_sample();
+	}
+	// the edges of this tick came in just before it
+	sim_clock_set((u32) (tick * clk2_per_tick) - 1);
+	if (sim_capture_irq())
+	{
+		sim_intc_raise(CAPTURE_INTERRUPT_ID);
+	}
+	sim_clock_set((u32) (tick * clk2_per_tick));
+	sim_intc_raise(FIT_INTERRUPT_ID);
+	if (sim_pdm_irq())
+	{
+		sim_intc_raise(PDM_INTERRUPT_ID);
+	}
+	// a wakeup fires between the ticks, at the time it was set for
+	if (sim_wake_irq((u32) ((tick + 1) * clk2_per_tick)))
+	{
+		sim_intc_raise(WAKE_INTERRUPT_ID);
+	}
+	tick++;
+}
+
+static void replay_tlr(int timer, u32 value)
+{
+	if (timer != 1)
+	{
+		return;
+	}
+	// TLR1 is the pulse width less the two reload clocks
+	if (have_servo && ((u32) abs((int32_t) (value + 2 - servo_ticks)) > servo_step_max))
+	{
+		servo_step_max = (u32) abs((int32_t) (value + 2 - servo_ticks));
+	}
+	have_servo = 1;
+	servo_ticks = value + 2;
+	// the initial neutral setting happens before the first tick
+	if (tick == 0)
+	{
+		return;
+	}
+	servo_cmds++;
+	latency_sum += tick - last_rec_tick;
+	if (tick - last_rec_tick > latency_max)
+	{
+		latency_max = tick - last_rec_tick;
+	}
+	if (servo_log)
+	{
+		fprintf(servo_log, "%" PRIu64 " %" PRIu32 "\n", tick, value);
+	}
+}
+
+/*****************************************************************************/
+/**
+* Summarize the run
+******************************************************************************/
+static void replay_finish(void)
+{
+	double wall = now_secs() - wall_start;
+	static const char *isr_names[SIM_INTC_INPUTS] = { "fit", "pwm timer", "capture", "pdm", "wake" };
+	double simulated = (double) tick / TRACE_FIT_FREQ_HZ;
+	int i;
+
+	if (wall <= 0.0)
+	{
+		wall = 1e-9;
+	}
+	trace_close(&src);
+	if (trace_out)
+	{
+		fclose(trace_out);
+	}
+	if (servo_log)
+	{
+		fclose(servo_log);
+	}
+	if (sim_console)
+	{
+		fclose(sim_console);
+		sim_console = NULL;
+	}
+	if (ltrace_out)
+	{
+		if (LTRACE_Dump(ltrace_put) != XST_SUCCESS)
+		{
+			fprintf(stderr, "latency trace not compiled in (make LTRACE=1)\n");
+		}
+		fclose(ltrace_out);
+	}
+
+	printf("records         %" PRIu64 "\n", records);
+	printf("fit ticks       %" PRIu64 "\n", tick);
+	printf("simulated       %.3f s\n", simulated);
+	printf("wall            %.3f s (%.1fx real time)\n", wall, simulated / wall);
+	printf("ticks/sec       %.0f\n", tick / wall);
+	printf("servo commands  %" PRIu64 " (%.1f decisions/sec)\n", servo_cmds, servo_cmds / wall);
+	printf("edge-to-servo   %.2f ms mean, %.2f ms max\n",
+		servo_cmds ? 1000.0 * latency_sum / servo_cmds / TRACE_FIT_FREQ_HZ : 0.0,
+		1000.0 * latency_max / TRACE_FIT_FREQ_HZ);
+	if (sim_stats.fabric_pairs)
+	{
+		printf("fabric servo    %" PRIu64 " pairs, %" PRIu64 " pulse width changes (at the edge)\n",
+			sim_stats.fabric_pairs, sim_stats.fabric_updates);
+	}
+	if (sim_stats.pdm_releases)
+	{
+		printf("pdm frames      %" PRIu64 " (%" PRIu64 " dropped while one was held)\n",
+			sim_stats.pdm_frames, sim_stats.pdm_overruns);
+	}
+	track_summary();
+	printf("gpio reads      %" PRIu64 " (%.2f per tick)\n", sim_stats.gpio_reads,
+		tick ? (double) sim_stats.gpio_reads / tick : 0.0);
+	printf("interrupts      %" PRIu64 "\n", sim_stats.interrupts);
+	if (sim_stats.sleeps)
+	{
+		printf("sleeps          %.0f/s, asleep %.1f%% of the ticks\n", sim_stats.sleeps / simulated,
+			tick ? 100.0 * sim_stats.sleep_idles / tick : 0.0);
+	}
+	for (i = 0; i < SIM_INTC_INPUTS; i++)
+	{
+		if (sim_stats.isr_count[i] == 0)
+		{
+			continue;
+		}
+		printf("  %-13s %9.0f/s %11.0f cycles/s %9.0f bus accesses/s (%.0f cycles, %.1f accesses each)\n",
+			isr_names[i], sim_stats.isr_count[i] / simulated, sim_stats.isr_cycles[i] / simulated,
+			sim_stats.isr_bus[i] / simulated, (double) sim_stats.isr_cycles[i] / sim_stats.isr_count[i],
+			(double) sim_stats.isr_bus[i] / sim_stats.isr_count[i]);
+	}
+	printf("edges           %" PRIu64 " (%" PRIu64 " filtered, %" PRIu64 " dropped, %.2f gpio accesses per edge)\n",
+		sim_stats.edges, sim_stats.edges_filtered, sim_stats.edges_dropped,
+		sim_stats.edges ? (double) (sim_stats.gpio_reads + sim_stats.gpio_writes) / sim_stats.edges : 0.0);
+}
+
+static void ltrace_put(u8 byte)
+{
+	fputc(byte, ltrace_out);
+}
+
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+/**
+* Servo tracking
+******************************************************************************/
+static int32_t servo_mdeg(u32 ticks)
+{
+	// invert BEARING_PulseTicks(): ticks = center + (mdeg * gain) >> BEARING_PULSE_FRAC
+	return (int32_t) ((((int64_t) ticks - PhaseBearing.center_ticks) << BEARING_PULSE_FRAC) /
+		PhaseBearing.ticks_gain);
+}
+
+// Servo_Pipeline pulse widths are in clk2 clocks, the PWM timer's in AXI clocks
+static u32 fabric_ticks(u32 clocks)
+{
+	return (u32) ((u64) clocks * XPAR_CPU_M_AXI_DP_FREQ_HZ / (TRACE_CLK2_FREQ_HZ >> PHASE_TIME_FRAC_BITS));
+}
+
+static void track_sample(void)
+{
+	u32 high;
+
+	if (!have_src || !have_servo || (PhaseBearing.ticks_gain == 0))
+	{
+		return;
+	}
+	if (track_len == track_cap)
+	{
+		track_cap = track_cap ? 2 * track_cap : 65536;
+		track_src = realloc(track_src, track_cap * sizeof(*track_src));
+		track_cmd = realloc(track_cmd, track_cap * sizeof(*track_cmd));
+		if (!track_src || !track_cmd)
+		{
+			perror("tracking");
+			exit(1);
+		}
+	}
+	track_src[track_len] = BEARING_Lookup(&PhaseBearing, src_tdoa);
+	if (sim_fabric_servo(&high))
+	{
+		track_cmd[track_len] = servo_mdeg(fabric_ticks(high));
+	}
+	else
+	{
+		track_cmd[track_len] = servo_mdeg(servo_ticks);
+	}
+	track_len++;
+}
+
+static double track_error(size_t lag)
+{
+	double sum = 0.0;
+	size_t i;
+
+	for (i = 0; i + lag < track_len; i++)
+	{
+		sum += abs(track_cmd[i + lag] - track_src[i]);
+	}
+	return (i > 0) ? sum / i / 1000.0 : 0.0;
+}
+
+static void track_summary(void)
+{
+	double error, best_error;
+	size_t lag, best_lag;
+
+	if (track_len <= TRACK_MAX_LAG)
+	{
+		return;
+	}
+	if (fabric_ticks(sim_stats.fabric_step_max) > servo_step_max)
+	{
+		servo_step_max = fabric_ticks(sim_stats.fabric_step_max);
+	}
+	best_lag = 0;
+	best_error = track_error(0);
+	for (lag = 1; lag <= TRACK_MAX_LAG; lag++)
+	{
+		error = track_error(lag);
+		if (error < best_error)
+		{
+			best_lag = lag;
+			best_error = error;
+		}
+	}
+	printf("tracking        %.2f deg mean error, %.2f deg at the best lag of %zu ms, largest step %.2f deg\n",
+		track_error(0), best_error, best_lag * TRACK_SAMPLE_TICKS * 1000 / TRACE_FIT_FREQ_HZ,
+		abs(servo_mdeg(PhaseBearing.center_ticks + servo_step_max)) / 1000.0);
+}
@@ -0,0 +1,259 @@
+/**
+*
+* @file stream_decode.c
+*
+* Decodes a binary edge stream (see edge_stream.h) into a trace file that host/replay
+* can run the firmware against.  The input is a raw console capture from the board, or
+* the console written by "replay -c" from a STREAM=1 build: console text and anything
+* else outside a frame with a good CRC is skipped.
+*
+* Every frame carries the sequence number of its first pair, so pairs lost on the way
+* (the firmware ring or transmit buffer overflowed, or bytes were dropped on the link)
+* show up as gaps.  The report lists the gaps with the FIT ticks they fall between, the
+* totals, and the bytes per pair against the same pairs as text trace lines.
+*
+* usage: stream_decode [-c clk_per_tick] [-o trace-out] [-g max_gaps] capture-file
+*	-c		capture clock counts per FIT tick (2500, 10000 with FRAC=2)
+*	-o		write the decoded pairs as a trace file
+*	-g		most gaps to list (20), the totals count them all
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "edge_stream.h"
+#include "trace.h"
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	const uint8_t	*p;
+	const uint8_t	*end;
+	int				bad;					// ran past the end or a varint too long
+} reader_t;
+
+/*****************************************************************************/
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE	*fp = fopen(path, "rb");
+	uint8_t	*buf = NULL;
+	size_t	cap = 0, n;
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+	*len = 0;
+	do
+	{
+		if (*len == cap)
+		{
+			cap = cap ? 2 * cap : 65536;
+			buf = realloc(buf, cap);
+		}
+		n = fread(buf + *len, 1, cap - *len, fp);
+		*len += n;
+	} while (n > 0);
+	fclose(fp);
+	return buf;
+}
+
+static uint32_t get_varint(reader_t *r)
+{
+	uint32_t	value = 0;
+	int			shift;
+
+	for (shift = 0; shift < 7 * STREAM_VARINT_MAX; shift += 7)
+	{
+		if (r->p >= r->end)
+		{
+			break;
+		}
+		value |= (uint32_t) (*r->p & 0x7F) << shift;
+		if (!(*r->p++ & 0x80))
+		{
+			return value;
+		}
+	}
+	r->bad = 1;
+	return 0;
+}
+
+static int32_t get_zigzag(reader_t *r)
+{
+	uint32_t v = get_varint(r);
+
+	return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static uint8_t crc8(const uint8_t *buf, size_t len)
+{
+	uint8_t	crc = 0;
+	size_t	i;
+	int		b;
+
+	for (i = 0; i < len; i++)
+	{
+		crc ^= buf[i];
+		for (b = 0; b < 8; b++)
+		{
+			crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : (uint8_t) (crc << 1);
+		}
+	}
+	return crc;
+}
+
+/*****************************************************************************/
+/**
+* Decodes the frame at buf[0] into pairs.
+*
+* @return	the frame length, or 0 if it is not a complete frame with a good CRC
+******************************************************************************/
+static size_t decode_frame(const uint8_t *buf, const uint8_t *end, uint32_t clk_per_tick,
+	StreamPair *pairs, int *count)
+{
+	reader_t	r = { buf + 3, end, 0 };
+	int			n, i;
+	uint32_t	dtick;
+
+	if ((end - buf < 4) || (buf[0] != STREAM_MAGIC_0) || (buf[1] != STREAM_MAGIC_1))
+	{
+		return 0;
+	}
+	n = buf[2];
+	if ((n < 1) || (n > STREAM_FRAME_PAIRS))
+	{
+		return 0;
+	}
+	pairs[0].seq = get_varint(&r);
+	pairs[0].tick = get_varint(&r);
+	pairs[0].time_1 = get_varint(&r);
+	pairs[0].time_2 = pairs[0].time_1 + (uint32_t) get_zigzag(&r);
+	for (i = 1; (i < n) && !r.bad; i++)
+	{
+		dtick = get_varint(&r);
+		pairs[i].seq = pairs[i - 1].seq + 1;
+		pairs[i].tick = pairs[i - 1].tick + dtick;
+		pairs[i].time_1 = pairs[i - 1].time_1 + dtick * clk_per_tick + (uint32_t) get_zigzag(&r);
+		pairs[i].time_2 = pairs[i].time_1 + (uint32_t) get_zigzag(&r);
+	}
+	if (r.bad || (r.p >= end) || (crc8(buf + 2, (size_t) (r.p - buf - 2)) != *r.p))
+	{
+		return 0;
+	}
+	*count = n;
+	return (size_t) (r.p + 1 - buf);
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t		*buf;
+	size_t		len, off, flen;
+	uint32_t	clk_per_tick = TRACE_CLK2_FREQ_HZ / TRACE_FIT_FREQ_HZ, expect = 0, last_tick = 0;
+	uint64_t	tick = 0, pairs = 0, lost = 0, frames = 0, frame_bytes = 0, skipped = 0;
+	uint64_t	text_bytes = 0, gaps = 0;
+	FILE		*out = NULL;
+	int			opt, max_gaps = 20, n, i, started = 0;
+	StreamPair	frame[STREAM_FRAME_PAIRS];
+	trace_rec_t	rec;
+	char		line[64];
+
+	while ((opt = getopt(argc, argv, "c:o:g:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'c': clk_per_tick = (uint32_t) strtoul(optarg, NULL, 0); break;
+			case 'g': max_gaps = atoi(optarg); break;
+			case 'o':
+				if ((out = fopen(optarg, "w")) == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default: optind = argc; break;
+		}
+	}
+	if ((optind != argc - 1) || (clk_per_tick == 0))
+	{
+		fprintf(stderr, "usage: %s [-c clk_per_tick] [-o trace-out] [-g max_gaps] capture-file\n", argv[0]);
+		return 2;
+	}
+	if ((buf = read_file(argv[optind], &len)) == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if (out)
+	{
+		fprintf(out, "# decoded from %s, FIT tick, time_1, time_2\n", argv[optind]);
+	}
+
+	for (off = 0; off < len; )
+	{
+		flen = decode_frame(buf + off, buf + len, clk_per_tick, frame, &n);
+		if (flen == 0)
+		{
+			off++;
+			skipped++;
+			continue;
+		}
+		off += flen;
+		frames++;
+		frame_bytes += flen;
+
+		// the first frame sets the sequence and the tick base; the ticks are 32 bits on
+		// the board, so follow their wrap
+		if (started && (frame[0].seq != expect))
+		{
+			uint32_t missing = frame[0].seq - expect;
+
+			gaps++;
+			lost += missing;
+			if (gaps <= (uint64_t) max_gaps)
+			{
+				printf("gap: pairs %" PRIu32 " to %" PRIu32 " lost (%" PRIu32 "), between ticks %" PRIu32
+					" and %" PRIu32 "\n", expect, frame[0].seq - 1, missing, last_tick, frame[0].tick);
+			}
+		}
+		for (i = 0; i < n; i++)
+		{
+			tick = started ? tick + (uint32_t) (frame[i].tick - last_tick) : frame[i].tick;
+			started = 1;
+			last_tick = frame[i].tick;
+
+			rec.tick = tick;
+			rec.time_1 = frame[i].time_1;
+			rec.time_2 = frame[i].time_2;
+			text_bytes += (size_t) snprintf(line, sizeof(line), "%" PRIu64 " %" PRIu32 " %" PRIu32 "\n",
+				rec.tick, rec.time_1, rec.time_2);
+			if (out)
+			{
+				trace_write(out, &rec);
+			}
+		}
+		pairs += n;
+		expect = frame[n - 1].seq + 1;
+	}
+	if (out)
+	{
+		fclose(out);
+	}
+	free(buf);
+
+	if (gaps > (uint64_t) max_gaps)
+	{
+		printf("... %" PRIu64 " more gaps\n", gaps - max_gaps);
+	}
+	printf("frames          %" PRIu64 " (%" PRIu64 " bytes outside frames skipped)\n", frames, skipped);
+	printf("pairs           %" PRIu64 " decoded, %" PRIu64 " lost in %" PRIu64 " gaps (%.2f%%)\n",
+		pairs, lost, gaps, (pairs + lost) ? 100.0 * lost / (pairs + lost) : 0.0);
+	printf("bytes/pair      %.2f binary, %.2f as text (%.1fx)\n",
+		pairs ? (double) frame_bytes / pairs : 0.0, pairs ? (double) text_bytes / pairs : 0.0,
+		frame_bytes ? (double) text_bytes / frame_bytes : 0.0);
+	return (frames == 0) ? 1 : 0;
+}
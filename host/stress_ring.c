@@ -0,0 +1,172 @@
+/**
+*
+* @file stress_ring.c
+*
+* Host stress run of the phase sample ring with the producer and consumer on
+* separate threads.  The producer stands in for FIT_Handler() and pushes a numbered
+* sequence as fast as it can (optionally pausing every so often); the consumer stands
+* in for the main loop and drains the ring in batches, optionally dawdling between
+* batches to force overflows.
+*
+* Every sample carries its sequence number in "tick" and a value derived from it in
+* "phase_diff".  The consumer checks that samples arrive in order and uncorrupted,
+* and at the end that every pushed sample was consumed and every rejected push was
+* counted as an overflow.
+*
+* usage: stress_ring [-n samples] [-b batch] [-c consumer_delay_spins] [-p producer_delay_spins] [-y]
+*
+* -y makes the producer yield the CPU every 64 pushes and the consumer yield when
+* the ring is empty, which keeps both threads interleaving on a single-core host.
+*
+* Exits non-zero if any check fails.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "phase_ring.h"
+
+/************************** Variable Definitions *****************************/
+static PhaseRing	ring;
+static u32			num_samples = 50000000;
+static int			batch = 32;
+static int			consumer_delay = 0;
+static int			producer_delay = 0;
+static int			producer_yield = 0;
+static volatile int	producer_done;
+static u32			rejected;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+#define EXPECTED_DIFF(seq)		((int)((seq) * 2654435761U) >> 8)
+
+/*****************************************************************************/
+static void spin(int n)
+{
+	volatile int i;
+
+	for (i = 0; i < n; i++)
+	{
+	}
+}
+
+static void *producer(void *arg)
+{
+	u32 seq;
+
+	(void) arg;
+	for (seq = 0; seq < num_samples; seq++)
+	{
+		if (!RING_Push(&ring, seq, EXPECTED_DIFF(seq)))
+		{
+			rejected++;
+		}
+		if ((seq & 63) == 0)
+		{
+			spin(producer_delay);
+			if (producer_yield)
+			{
+				sched_yield();
+			}
+		}
+	}
+	__atomic_store_n(&producer_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t	thread;
+	PhaseSample	*samples;
+	u64			consumed = 0, batches = 0, errors = 0;
+	u32			last = 0;
+	int			have_last = 0, opt, n, i, done;
+	double		t0, secs;
+
+	while ((opt = getopt(argc, argv, "n:b:c:p:y")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': num_samples = (u32) strtoul(optarg, NULL, 0); break;
+			case 'b': batch = atoi(optarg); break;
+			case 'c': consumer_delay = atoi(optarg); break;
+			case 'p': producer_delay = atoi(optarg); break;
+			case 'y': producer_yield = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n samples] [-b batch] [-c consumer_delay] [-p producer_delay] [-y]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (batch < 1)
+	{
+		batch = 1;
+	}
+	samples = malloc(sizeof(PhaseSample) * batch);
+
+	RING_Initialize(&ring);
+	t0 = now_secs();
+	pthread_create(&thread, NULL, producer, NULL);
+
+	do
+	{
+		// sample the producer flag before draining so nothing pushed before it is missed
+		done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+		while ((n = RING_PopBatch(&ring, samples, batch)) > 0)
+		{
+			batches++;
+			for (i = 0; i < n; i++)
+			{
+				if ((samples[i].phase_diff != EXPECTED_DIFF(samples[i].tick)) ||
+					(have_last && ((s32)(samples[i].tick - last) <= 0)))
+				{
+					errors++;
+				}
+				last = samples[i].tick;
+				have_last = 1;
+			}
+			consumed += n;
+			if (consumer_delay)
+			{
+				spin(consumer_delay);
+			}
+		}
+		if (producer_yield)
+		{
+			sched_yield();
+		}
+	} while (!done);
+
+	pthread_join(thread, NULL);
+	secs = now_secs() - t0;
+
+	printf("pushed          %u (%u rejected)\n", ring.pushed, rejected);
+	printf("consumed        %llu in %llu batches (%.1f per batch)\n", (unsigned long long) consumed,
+		(unsigned long long) batches, batches ? (double) consumed / batches : 0.0);
+	printf("overflows       %u\n", ring.overflows);
+	printf("high water      %u of %d\n", ring.high_water, PHASE_RING_SIZE);
+	printf("order/value     %llu errors\n", (unsigned long long) errors);
+	// samples that made it through the ring; rejected pushes are not throughput
+	printf("throughput      %.1f M samples/sec consumed (%.1f M pushes/sec attempted)\n",
+		consumed / secs / 1e6, num_samples / secs / 1e6);
+
+	if (errors || (consumed != ring.pushed) || (rejected != ring.overflows) ||
+		(ring.pushed + ring.overflows != num_samples))
+	{
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("PASSED\n");
+	return 0;
+}
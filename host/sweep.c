@@ -0,0 +1,734 @@
+/**
+*
+* @file sweep.c
+*
+* Tunes the localization pipeline on the host.  The constants that shape it - the pairing
+* window, the phase filter (median and smoother, or the tracker), the servo deadband and
+* the servo calibration (center and span of the pulse width) - are compile-time constants
+* in finalproject.c, so trying a value on the board means a rebuild and a reflash.  This
+* tool runs the same pipeline over a corpus of traces for every combination of the values
+* given and reports, for each configuration:
+*
+*	error		mean |pointing error|, degrees, against the source sampled every msec
+*	jitter		standard deviation of the pointing error, degrees
+*	updates		servo commands per second
+*	cost		host CPU time per phase sample, nsec (pairing, filtering and lookup)
+*
+* and the Pareto front over the four: the configurations no other one beats on all of them
+* at once.  The servo parameters (deadband, center and span) do not change the work per
+* sample, so the cost is measured per pipeline: the configurations that only differ in them
+* all get the least time measured for any of them, and timing noise does not decide
+* between them.  The pipeline is the firmware's own code (EDGE_Pair(), MEDIAN_Update(),
+* TRACK_Update(), BEARING_PulseTicks()) driven the way Capture_Handler() and phase_task()
+* drive it: the edges of a record are paired on its FIT tick and the samples filtered every
+* msec.  The pointing is scored with the real servo calibration (SERVO_CENTER_NS and
+* SERVO_SPAN_NS), so a wrong center or span in the configuration shows up as error.
+*
+* The source is known exactly for the synthetic traces (before the TDOA jitter).  For a
+* trace file it is taken from the records the way replay does: the difference of the last
+* record whose two times lie within TRACE_MAX_TDOA.
+*
+* The configurations are run on a thread per core.  Each thread starts with an equal share
+* of them and, once done, steals half of what is left to the busiest other thread, so the
+* slower tracker configurations do not leave threads idle at the end.
+*
+* usage: sweep [-W windows] [-k tracks] [-m medians] [-e shifts] [-h half_lives_ms] [-d steps]
+*              [-c centers_ns] [-g spans_ns] [-t threads] [-n traces] [-s secs] [-r rate]
+*              [-j counts] [-o csv] [trace-file ...]
+*	-W		pairing windows, counts (15000,20000,25000,30000)
+*	-k		tracks, 0 for the median filter alone (0,3)
+*	-m		median windows (1,3,5,9), with -k 0
+*	-e		smoother shifts (0,1,2), with -k 0
+*	-h		tracker half lives, msec (250,1000,4000), with -k above 0
+*	-d		servo deadbands, PWM timer ticks (0,25,50,100)
+*	-c		servo center pulse widths, nsec (1400000)
+*	-g		servo pulse width spans for 90 degrees, nsec (800000)
+*	-t		threads (one per core)
+*	-n		synthetic traces when no file is given (4), alternately sweeping and jumping
+*	-s		seconds per synthetic trace (30)
+*	-r		synthetic sound events per second (20)
+*	-j		synthetic TDOA jitter, +/- counts (trace.c default)
+*	-o		write every configuration's results to a CSV file
+* A list is comma separated values or a range first:last:step.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+
+#include "trace.h"
+#include "edge_fifo.h"
+#include "median_filter.h"
+#include "tracker.h"
+#include "bearing.h"
+#include "phase_ring.h"
+
+/************************** Constant Definitions *****************************/
+#define MIC_SPACING_UM		85000
+#define PWM_CLK_HZ			100000000	// axi_timer clock
+#define SERVO_CENTER_NS		1400000		// the servo: pulse width at 0 degrees
+#define SERVO_SPAN_NS		800000		// and the change for 90 degrees
+#define BATCH_TICKS			(TRACE_FIT_FREQ_HZ / 1000)	// phase_task() period, 1 msec
+#define SETTLE_TICKS		TRACE_FIT_FREQ_HZ			// run on after the last record
+#define TRACK_BINS			64			// PHASE_TRACK_BINS
+#define MAX_VALUES			64			// values per parameter
+
+// the servo parameters come last, so the configurations of one pipeline are consecutive
+enum { P_WINDOW, P_TRACKS, P_MEDIAN, P_EMA, P_HALF_LIFE, P_DEADBAND, P_CENTER, P_SPAN, NUM_PARAMS };
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	const char	*name;
+	char		opt;
+	const char	*defaults;
+	int			values[MAX_VALUES];
+	int			count;
+} param_t;
+
+typedef struct {
+	trace_rec_t	*recs;
+	int32_t		*truth;			// source TDOA as of each record
+	char		*have_truth;
+	size_t		n;
+} corpus_trace_t;
+
+typedef struct {
+	int			skipped;		// same pipeline as a configuration with a lower index
+	double		error;			// degrees
+	double		jitter;			// degrees
+	double		updates;		// per second
+	double		cost;			// nsec per sample
+	int			pareto;
+} result_t;
+
+typedef struct {
+	pthread_mutex_t	lock;
+	int				next;		// configurations [next, end) still to run
+	int				end;
+	int				steals;
+	pthread_t		thread;
+} worker_t;
+
+/************************** Variable Definitions *****************************/
+static param_t params[NUM_PARAMS] = {
+	{ "window",		'W', "15000,20000,25000,30000", { 0 }, 0 },
+	{ "tracks",		'k', "0,3", { 0 }, 0 },
+	{ "median",		'm', "1,3,5,9", { 0 }, 0 },
+	{ "ema",		'e', "0,1,2", { 0 }, 0 },
+	{ "half_life",	'h', "250,1000,4000", { 0 }, 0 },
+	{ "deadband",	'd', "0,25,50,100", { 0 }, 0 },
+	{ "center_ns",	'c', "1400000", { 0 }, 0 },
+	{ "span_ns",	'g', "800000", { 0 }, 0 },
+};
+
+static corpus_trace_t	*corpus;
+static int				corpus_len;
+static double			corpus_secs;
+static BearingTable		truth_table;		// the real servo calibration
+static result_t			*results;
+static int				num_configs;
+static worker_t			*workers;
+static int				num_workers;
+
+/*****************************************************************************/
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+/**
+* Parses a list of values: "a,b,c" or "first:last:step".
+*
+* @return	0 on success, -1 if the list is malformed or too long
+******************************************************************************/
+static int parse_list(param_t *p, const char *arg)
+{
+	char	*end;
+	long	first, last, step, v;
+
+	p->count = 0;
+	if (sscanf(arg, "%ld:%ld:%ld", &first, &last, &step) == 3)
+	{
+		if ((step <= 0) || (last < first))
+		{
+			return -1;
+		}
+		for (v = first; v <= last; v += step)
+		{
+			if (p->count == MAX_VALUES)
+			{
+				return -1;
+			}
+			p->values[p->count++] = (int) v;
+		}
+		return 0;
+	}
+	do
+	{
+		if (p->count == MAX_VALUES)
+		{
+			return -1;
+		}
+		p->values[p->count++] = (int) strtol(arg, &end, 0);
+		if (end == arg)
+		{
+			return -1;
+		}
+		arg = end + 1;
+	} while (*end == ',');
+	return (*end == '\0') ? 0 : -1;
+}
+
+/*****************************************************************************/
+/**
+* Splits a configuration number into a value index per parameter; the first parameter
+* varies slowest.
+*
+* @return	1 if the configuration only differs from a lower numbered one in parameters its
+*			pipeline does not use
+******************************************************************************/
+static int decode(int config, int *v)
+{
+	int i, idx[NUM_PARAMS];
+
+	for (i = NUM_PARAMS - 1; i >= 0; i--)
+	{
+		idx[i] = config % params[i].count;
+		v[i] = params[i].values[idx[i]];
+		config /= params[i].count;
+	}
+	if (v[P_TRACKS] > 0)
+	{
+		return (idx[P_MEDIAN] != 0) || (idx[P_EMA] != 0);
+	}
+	return idx[P_HALF_LIFE] != 0;
+}
+
+/*****************************************************************************/
+/**
+* Loads a trace into memory with the source TDOA as of each record.
+******************************************************************************/
+static int load_trace(corpus_trace_t *t, trace_src_t *src, int synthetic)
+{
+	trace_rec_t	rec;
+	size_t		cap = 0;
+	int32_t		tdoa = 0;
+	int			have = 0;
+
+	memset(t, 0, sizeof(*t));
+	while (trace_next(src, &rec))
+	{
+		if (t->n == cap)
+		{
+			cap = cap ? 2 * cap : 65536;
+			t->recs = realloc(t->recs, cap * sizeof(*t->recs));
+			t->truth = realloc(t->truth, cap * sizeof(*t->truth));
+			t->have_truth = realloc(t->have_truth, cap);
+			if (!t->recs || !t->truth || !t->have_truth)
+			{
+				return -1;
+			}
+		}
+		if (synthetic)
+		{
+			tdoa = src->tdoa;
+			have = 1;
+		}
+		else if (abs((int32_t) (rec.time_1 - rec.time_2)) <= TRACE_MAX_TDOA)
+		{
+			tdoa = (int32_t) (rec.time_1 - rec.time_2);
+			have = 1;
+		}
+		t->recs[t->n] = rec;
+		t->truth[t->n] = tdoa;
+		t->have_truth[t->n] = (char) have;
+		t->n++;
+	}
+	if (t->n > 0)
+	{
+		corpus_secs += (double) (t->recs[t->n - 1].tick + SETTLE_TICKS) / TRACE_FIT_FREQ_HZ;
+	}
+	return 0;
+}
+
+/*****************************************************************************/
+/**
+* Runs the pipeline of one configuration over the corpus.
+******************************************************************************/
+static void run_config(int config, result_t *res)
+{
+	int				v[NUM_PARAMS];
+	BearingTable	table;
+	EdgePairer		pairer;
+	MedianFilter	median;
+	Tracker			tracker;
+	EdgeBatch		batch;
+	EdgePair		pairs[EDGE_MAX_PAIRS];
+	s32				samples[PHASE_RING_SIZE];
+	const Track		*track;
+	trace_rec_t		prev;
+	size_t			r;
+	uint64_t		tick, end, count = 0, cmds = 0, nsamples = 0;
+	int				t, i, n, np, have_truth, phase_diff, old_phase_diff;
+	int32_t			truth;
+	u32				high, servo;
+	double			err, sum_abs = 0.0, sum = 0.0, sum_sq = 0.0, start;
+
+	memset(res, 0, sizeof(*res));
+	if (decode(config, v))
+	{
+		res->skipped = 1;
+		return;
+	}
+	start = cpu_secs();
+	if (BEARING_Initialize(&table, MIC_SPACING_UM, TRACE_CLK2_FREQ_HZ, BEARING_STEP_LOG2 + PHASE_TIME_FRAC_BITS,
+		PWM_CLK_HZ, (u32) v[P_CENTER], (u32) v[P_SPAN]) != XST_SUCCESS)
+	{
+		res->skipped = 1;
+		return;
+	}
+
+	for (t = 0; t < corpus_len; t++)
+	{
+		const corpus_trace_t *ct = &corpus[t];
+
+		if (ct->n == 0)
+		{
+			continue;
+		}
+		EDGE_PairerInitialize(&pairer, (u32) v[P_WINDOW]);
+		if (((v[P_TRACKS] == 0) && (MEDIAN_Initialize(&median, v[P_MEDIAN], v[P_EMA]) != XST_SUCCESS)) ||
+			((v[P_TRACKS] > 0) && (TRACK_Initialize(&tracker, TRACK_BINS, v[P_WINDOW], v[P_TRACKS],
+				TRACK_SELECT_STRONGEST, BATCH_TICKS, (u32) v[P_HALF_LIFE] * BATCH_TICKS) != XST_SUCCESS)))
+		{
+			res->skipped = 1;
+			return;
+		}
+		memset(&prev, 0, sizeof(prev));
+		servo = table.center_ticks;			// the firmware starts the servo at neutral
+		phase_diff = 0;
+		old_phase_diff = 0;
+		have_truth = 0;
+		truth = 0;
+		r = 0;
+		end = ct->recs[ct->n - 1].tick + SETTLE_TICKS;
+
+		for (tick = BATCH_TICKS; tick <= end; tick += BATCH_TICKS)
+		{
+			// Capture_Handler(): pair the edges of each record on its tick
+			np = 0;
+			while ((r < ct->n) && (ct->recs[r].tick <= tick))
+			{
+				batch.n_1 = (ct->recs[r].time_1 != prev.time_1) ? 1 : 0;
+				batch.n_2 = (ct->recs[r].time_2 != prev.time_2) ? 1 : 0;
+				batch.time_1[0] = ct->recs[r].time_1;
+				batch.time_2[0] = ct->recs[r].time_2;
+				n = EDGE_Pair(&pairer, &batch, pairs);
+				for (i = 0; (i < n) && (np < PHASE_RING_SIZE); i++)
+				{
+					samples[np++] = (s32) (pairs[i].time_1 - pairs[i].time_2);
+				}
+				if (ct->have_truth[r])
+				{
+					truth = ct->truth[r];
+					have_truth = 1;
+				}
+				prev = ct->recs[r++];
+			}
+			nsamples += np;
+
+			// phase_task()
+			if (v[P_TRACKS] > 0)
+			{
+				for (i = 0; i < np; i++)
+				{
+					TRACK_Add(&tracker, samples[i], (u32) tick);
+				}
+				track = TRACK_Update(&tracker, (u32) tick);
+				if (track != NULL)
+				{
+					phase_diff = track->phase_diff;
+				}
+			}
+			else
+			{
+				for (i = 0; i < np; i++)
+				{
+					phase_diff = MEDIAN_Update(&median, samples[i]);
+				}
+			}
+			if (phase_diff != old_phase_diff)
+			{
+				old_phase_diff = phase_diff;
+				high = BEARING_PulseTicks(&table, phase_diff);
+				if ((u32) abs((int) (high - servo)) >= (u32) v[P_DEADBAND])
+				{
+					servo = high;
+					cmds++;
+				}
+			}
+
+			// score where the real servo points against the source
+			if (have_truth)
+			{
+				err = (((double) servo - truth_table.center_ticks) * 90.0 / (SERVO_SPAN_NS * (PWM_CLK_HZ / 1e9))) -
+					BEARING_Lookup(&truth_table, truth) / 1000.0;
+				sum_abs += fabs(err);
+				sum += err;
+				sum_sq += err * err;
+				count++;
+			}
+		}
+	}
+
+	if (count > 0)
+	{
+		res->error = sum_abs / count;
+		res->jitter = sqrt(fmax(sum_sq / count - (sum / count) * (sum / count), 0.0));
+	}
+	res->updates = (corpus_secs > 0.0) ? cmds / corpus_secs : 0.0;
+	res->cost = nsamples ? (cpu_secs() - start) * 1e9 / nsamples : 0.0;
+}
+
+/*****************************************************************************/
+/**
+* Work stealing: a thread runs its own range front to back and, once it is empty, takes
+* the back half of the largest range left.
+******************************************************************************/
+static int take(worker_t *w)
+{
+	int config = -1;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->next < w->end)
+	{
+		config = w->next++;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return config;
+}
+
+static int steal(worker_t *self)
+{
+	worker_t	*victim = NULL;
+	int			i, left, most = 0, first = 0, last = 0;
+
+	for (i = 0; i < num_workers; i++)
+	{
+		if (&workers[i] == self)
+		{
+			continue;
+		}
+		pthread_mutex_lock(&workers[i].lock);
+		left = workers[i].end - workers[i].next;
+		pthread_mutex_unlock(&workers[i].lock);
+		if (left > most)
+		{
+			most = left;
+			victim = &workers[i];
+		}
+	}
+	if (victim == NULL)
+	{
+		return 0;
+	}
+	pthread_mutex_lock(&victim->lock);
+	left = victim->end - victim->next;
+	if (left > 0)
+	{
+		last = victim->end;
+		first = victim->end - (left + 1) / 2;
+		victim->end = first;
+	}
+	pthread_mutex_unlock(&victim->lock);
+	if (left <= 0)
+	{
+		return 1;							// taken meanwhile, look again
+	}
+	pthread_mutex_lock(&self->lock);
+	self->next = first;
+	self->end = last;
+	self->steals++;
+	pthread_mutex_unlock(&self->lock);
+	return 1;
+}
+
+static void *worker(void *arg)
+{
+	worker_t	*self = arg;
+	int			config;
+
+	for (;;)
+	{
+		while ((config = take(self)) >= 0)
+		{
+			run_config(config, &results[config]);
+		}
+		if (!steal(self))
+		{
+			return NULL;
+		}
+	}
+}
+
+/*****************************************************************************/
+/**
+* Gives the configurations of each pipeline the least cost measured for any of them.
+******************************************************************************/
+static void share_cost(void)
+{
+	int		group = params[P_DEADBAND].count * params[P_CENTER].count * params[P_SPAN].count;
+	int		first, i;
+	double	cost;
+
+	for (first = 0; first < num_configs; first += group)
+	{
+		cost = -1.0;
+		for (i = first; i < first + group; i++)
+		{
+			if (!results[i].skipped && ((cost < 0.0) || (results[i].cost < cost)))
+			{
+				cost = results[i].cost;
+			}
+		}
+		for (i = first; i < first + group; i++)
+		{
+			results[i].cost = results[i].skipped ? 0.0 : cost;
+		}
+	}
+}
+
+/*****************************************************************************/
+/**
+* Marks the configurations that no other one beats on every measure.
+******************************************************************************/
+static void pareto(void)
+{
+	const result_t	*a, *b;
+	int				i, j;
+
+	for (i = 0; i < num_configs; i++)
+	{
+		a = &results[i];
+		if (a->skipped)
+		{
+			continue;
+		}
+		results[i].pareto = 1;
+		for (j = 0; (j < num_configs) && results[i].pareto; j++)
+		{
+			b = &results[j];
+			if ((j == i) || b->skipped)
+			{
+				continue;
+			}
+			if ((b->error <= a->error) && (b->jitter <= a->jitter) && (b->updates <= a->updates) &&
+				(b->cost <= a->cost) && ((b->error < a->error) || (b->jitter < a->jitter) ||
+				(b->updates < a->updates) || (b->cost < a->cost)))
+			{
+				results[i].pareto = 0;
+			}
+		}
+	}
+}
+
+static int by_error(const void *a, const void *b)
+{
+	double d = results[*(const int *) a].error - results[*(const int *) b].error;
+
+	return (d > 0.0) - (d < 0.0);
+}
+
+// the parameters the pipeline does not use are left blank
+static void print_config(FILE *fp, int config, const char *sep)
+{
+	int v[NUM_PARAMS], i, unused;
+
+	decode(config, v);
+	for (i = 0; i < NUM_PARAMS; i++)
+	{
+		unused = (v[P_TRACKS] > 0) ? ((i == P_MEDIAN) || (i == P_EMA)) : (i == P_HALF_LIFE);
+		if (unused)
+		{
+			fprintf(fp, (*sep == ',') ? "%s" : "%9s%s", (*sep == ',') ? sep : "-", sep);
+		}
+		else
+		{
+			fprintf(fp, (*sep == ',') ? "%d%s" : "%9d%s", v[i], sep);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	trace_synth_t	synth;
+	trace_src_t		src;
+	const char		*csv_path = NULL;
+	char			optstring[64] = "t:n:s:r:j:o:";
+	FILE			*csv;
+	int				opt, i, j, num_synth = 4, run = 0, front = 0, steals = 0, *order;
+	double			wall;
+
+	trace_synth_defaults(&synth);
+	synth.seconds = 30.0;
+	for (i = 0; i < NUM_PARAMS; i++)
+	{
+		parse_list(&params[i], params[i].defaults);
+		sprintf(optstring + strlen(optstring), "%c:", params[i].opt);
+	}
+	num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, optstring)) != -1)
+	{
+		switch (opt)
+		{
+			case 't': num_workers = atoi(optarg); continue;
+			case 'n': num_synth = atoi(optarg); continue;
+			case 's': synth.seconds = atof(optarg); continue;
+			case 'r': synth.event_rate = atof(optarg); continue;
+			case 'j': synth.jitter = atoi(optarg); continue;
+			case 'o': csv_path = optarg; continue;
+			default: break;
+		}
+		for (i = 0; (i < NUM_PARAMS) && (params[i].opt != opt); i++)
+		{
+		}
+		if ((i == NUM_PARAMS) || (parse_list(&params[i], optarg) != 0))
+		{
+			fprintf(stderr, "usage: %s [-W windows] [-k tracks] [-m medians] [-e shifts] [-h half_lives_ms] "
+				"[-d steps] [-c centers_ns] [-g spans_ns] [-t threads] [-n traces] [-s secs] [-r rate] "
+				"[-j counts] [-o csv] [trace-file ...]\n", argv[0]);
+			return 2;
+		}
+	}
+	num_workers = (num_workers < 1) ? 1 : num_workers;
+
+	// the corpus: the trace files, or synthetic sweeps and jumps
+	corpus_len = (optind < argc) ? argc - optind : num_synth;
+	corpus = calloc((size_t) corpus_len, sizeof(*corpus));
+	for (i = 0; i < corpus_len; i++)
+	{
+		if (optind < argc)
+		{
+			if (trace_open(&src, argv[optind + i]) != 0)
+			{
+				perror(argv[optind + i]);
+				return 1;
+			}
+		}
+		else
+		{
+			synth.seed = (uint32_t) i + 1;
+			synth.hop_period = (i & 1) ? 2.0 : 0.0;
+			trace_open_synth(&src, &synth);
+		}
+		if (load_trace(&corpus[i], &src, optind >= argc) != 0)
+		{
+			perror("corpus");
+			return 1;
+		}
+		trace_close(&src);
+	}
+	if (BEARING_Initialize(&truth_table, MIC_SPACING_UM, TRACE_CLK2_FREQ_HZ, BEARING_STEP_LOG2 + PHASE_TIME_FRAC_BITS,
+		PWM_CLK_HZ, SERVO_CENTER_NS, SERVO_SPAN_NS) != XST_SUCCESS)
+	{
+		fprintf(stderr, "bearing table\n");
+		return 1;
+	}
+
+	num_configs = 1;
+	for (i = 0; i < NUM_PARAMS; i++)
+	{
+		num_configs *= params[i].count;
+	}
+	results = calloc((size_t) num_configs, sizeof(*results));
+	workers = calloc((size_t) num_workers, sizeof(*workers));
+	for (i = 0; i < num_workers; i++)
+	{
+		pthread_mutex_init(&workers[i].lock, NULL);
+		workers[i].next = (int) ((long) num_configs * i / num_workers);
+		workers[i].end = (int) ((long) num_configs * (i + 1) / num_workers);
+	}
+	wall = now_secs();
+	for (i = 0; i < num_workers; i++)
+	{
+		pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+	}
+	for (i = 0; i < num_workers; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		steals += workers[i].steals;
+	}
+	wall = now_secs() - wall;
+	share_cost();
+	pareto();
+
+	order = malloc((size_t) num_configs * sizeof(int));
+	for (i = 0, j = 0; i < num_configs; i++)
+	{
+		run += !results[i].skipped;
+		front += results[i].pareto;
+		if (results[i].pareto)
+		{
+			order[j++] = i;
+		}
+	}
+	qsort(order, (size_t) front, sizeof(int), by_error);
+
+	printf("corpus          %d traces, %.0f s\n", corpus_len, corpus_secs);
+	printf("configurations  %d (%d skipped: invalid or the same as another), %.2f s wall, %d threads, %d steals\n",
+		run, num_configs - run, wall, num_workers, steals);
+	printf("pareto front    %d configurations, by error\n", front);
+	for (i = 0; i < NUM_PARAMS; i++)
+	{
+		printf("%9s ", params[i].name);
+	}
+	printf("  error deg  jitter deg  updates/s  ns/sample\n");
+	for (i = 0; i < front; i++)
+	{
+		print_config(stdout, order[i], " ");
+		printf("%11.2f %11.2f %10.1f %10.1f\n", results[order[i]].error, results[order[i]].jitter,
+			results[order[i]].updates, results[order[i]].cost);
+	}
+
+	if (csv_path)
+	{
+		if ((csv = fopen(csv_path, "w")) == NULL)
+		{
+			perror(csv_path);
+			return 1;
+		}
+		for (i = 0; i < NUM_PARAMS; i++)
+		{
+			fprintf(csv, "%s,", params[i].name);
+		}
+		fprintf(csv, "error_deg,jitter_deg,updates_per_sec,ns_per_sample,pareto\n");
+		for (i = 0; i < num_configs; i++)
+		{
+			if (!results[i].skipped)
+			{
+				print_config(csv, i, ",");
+				fprintf(csv, "%.3f,%.3f,%.2f,%.1f,%d\n", results[i].error, results[i].jitter,
+					results[i].updates, results[i].cost, results[i].pareto);
+			}
+		}
+		fclose(csv);
+	}
+	return 0;
+}
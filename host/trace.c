@@ -0,0 +1,211 @@
+/**
+*
+* @file trace.c
+*
+* Capture-register traces for host replay.  See trace.h for the format.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "trace.h"
+
+/************************** Function Prototypes ******************************/
+static uint32_t	rng_next(trace_src_t *src);
+static void		synth_event(trace_src_t *src);
+
+/*****************************************************************************/
+/**
+* Fill in the synthetic trace defaults: one minute of 20 events/sec from a
+* source sweeping across the full validity window every 10 seconds.
+******************************************************************************/
+void trace_synth_defaults(trace_synth_t *synth)
+{
+	synth->seconds = 60.0;
+	synth->event_rate = 20.0;
+	synth->sweep_period = 10.0;
+	synth->hop_period = 0.0;
+	synth->max_tdoa = TRACE_MAX_TDOA;
+	synth->jitter = 200 << PHASE_TIME_FRAC_BITS;
+	synth->noise_pct = 0;
+	synth->clk2_hz = TRACE_CLK2_FREQ_HZ;
+	synth->seed = 1;
+}
+
+/*****************************************************************************/
+/**
+* Open a trace file.  "-" reads stdin.
+*
+* @return	0 on success, -1 if the file cannot be opened
+******************************************************************************/
+int trace_open(trace_src_t *src, const char *path)
+{
+	memset(src, 0, sizeof(*src));
+	src->fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+	return (src->fp != NULL) ? 0 : -1;
+}
+
+void trace_open_synth(trace_src_t *src, const trace_synth_t *synth)
+{
+	memset(src, 0, sizeof(*src));
+	src->synth = *synth;
+	src->rng = synth->seed ? synth->seed : 1;
+}
+
+void trace_close(trace_src_t *src)
+{
+	if (src->fp && (src->fp != stdin))
+	{
+		fclose(src->fp);
+	}
+	src->fp = NULL;
+}
+
+/*****************************************************************************/
+/**
+* Return the next record in tick order.
+*
+* @return	1 if a record was returned, 0 at the end of the trace
+******************************************************************************/
+int trace_next(trace_src_t *src, trace_rec_t *rec)
+{
+	char	buf[128];
+	char	*p, *end;
+	double	events;
+
+	if (src->fp)
+	{
+		while (fgets(buf, sizeof(buf), src->fp))
+		{
+			src->line++;
+			p = buf + strspn(buf, " \t");
+			if ((*p == '#') || (*p == '\n') || (*p == '\r') || (*p == '\0'))
+			{
+				continue;
+			}
+			rec->tick = strtoull(p, &end, 0);
+			rec->time_1 = (uint32_t) strtoul(end, &end, 0);
+			rec->time_2 = (uint32_t) strtoul(end, &end, 0);
+			return 1;
+		}
+		return 0;
+	}
+
+	events = src->synth.seconds * src->synth.event_rate;
+	while ((src->npending == 0) && (src->event < (uint64_t) events))
+	{
+		synth_event(src);
+	}
+	if (src->npending == 0)
+	{
+		return 0;
+	}
+	*rec = src->pending[0];
+	src->npending--;
+	memmove(&src->pending[0], &src->pending[1], src->npending * sizeof(trace_rec_t));
+	return 1;
+}
+
+void trace_write(FILE *fp, const trace_rec_t *rec)
+{
+	fprintf(fp, "%" PRIu64 " %" PRIu32 " %" PRIu32 "\n", rec->tick, rec->time_1, rec->time_2);
+}
+
+/*****************************************************************************/
+/**
+* Synthetic source
+******************************************************************************/
+static uint32_t rng_next(trace_src_t *src)
+{
+	// xorshift32 - deterministic for a given seed
+	src->rng ^= src->rng << 13;
+	src->rng ^= src->rng >> 17;
+	src->rng ^= src->rng << 5;
+	return src->rng;
+}
+
+static void push_edge(trace_src_t *src, uint64_t edge, int channel)
+{
+	const trace_synth_t *s = &src->synth;
+	uint64_t	tick;
+	trace_rec_t	*rec;
+
+	// the capture register changes at the edge and is first seen on the next FIT tick
+	tick = (edge * TRACE_FIT_FREQ_HZ) / s->clk2_hz + 1;
+	if (channel == 1)
+	{
+		src->time_1 = (uint32_t) edge;
+	}
+	else
+	{
+		src->time_2 = (uint32_t) edge;
+	}
+
+	if ((src->npending > 0) && (src->pending[src->npending - 1].tick == tick))
+	{
+		rec = &src->pending[src->npending - 1];
+	}
+	else
+	{
+		rec = &src->pending[src->npending++];
+		rec->tick = tick;
+	}
+	rec->time_1 = src->time_1;
+	rec->time_2 = src->time_2;
+}
+
+static void synth_event(trace_src_t *src)
+{
+	const trace_synth_t *s = &src->synth;
+	double		t;
+	int64_t		tdoa;
+	uint64_t	center, edge_1, edge_2;
+	uint32_t	span;
+
+	// events are evenly spaced; the source bearing follows a slow sine sweep, or jumps
+	// every hop period (hashed from the hop number so it does not use up the rng)
+	t = (double) src->event / s->event_rate;
+	if (s->hop_period > 0.0)
+	{
+		span = ((uint32_t) (t / s->hop_period) + 1) * 2654435761u ^ s->seed;
+		span ^= span >> 15;
+		span *= 2246822519u;
+		span ^= span >> 13;
+		tdoa = (int64_t) (span % (2 * (uint32_t) s->max_tdoa + 1)) - s->max_tdoa;
+	}
+	else
+	{
+		tdoa = (int64_t) llround(s->max_tdoa * sin(2.0 * M_PI * t / s->sweep_period));
+	}
+	src->tdoa = (int32_t) tdoa;
+	if (s->jitter > 0)
+	{
+		tdoa += (int64_t) (rng_next(src) % (2 * (uint32_t) s->jitter + 1)) - s->jitter;
+	}
+	center = (uint64_t) llround(t * s->clk2_hz) + (uint64_t) s->max_tdoa + (uint64_t) s->jitter;
+	edge_1 = center + tdoa / 2;
+	edge_2 = edge_1 - tdoa;
+	src->event++;
+
+	if (edge_1 <= edge_2)
+	{
+		push_edge(src, edge_1, 1);
+		push_edge(src, edge_2, 2);
+	}
+	else
+	{
+		push_edge(src, edge_2, 2);
+		push_edge(src, edge_1, 1);
+	}
+
+	// a spurious edge on one channel, before the next event arrives
+	if (s->noise_pct && ((rng_next(src) % 100) < s->noise_pct))
+	{
+		span = (uint32_t) (s->clk2_hz / (2.0 * s->event_rate)) + 1;
+		push_edge(src, ((edge_1 > edge_2) ? edge_1 : edge_2) + (rng_next(src) % span) + 1,
+			(rng_next(src) & 1) + 1);
+	}
+}
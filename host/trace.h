@@ -0,0 +1,73 @@
+/**
+*
+* @file trace.h
+*
+* Capture-register traces for host replay of the localization firmware.
+*
+* A trace is a sequence of records giving the values of the Phase_Detection
+* time_1/time_2 registers (as seen on GPIO 1 channels 1 and 2) starting at a
+* given FIT tick.  The values hold until the next record.  Traces come either
+* from a text file, one record per line:
+*
+*	<fit tick> <time_1> <time_2>
+*
+* with '#' starting a comment, or from the built-in synthetic generator which
+* models a single source sweeping back and forth across the array, or jumping
+* from one random bearing to another.
+*
+******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/************************** Constant Definitions *****************************/
+#ifndef PHASE_TIME_FRAC_BITS
+#define PHASE_TIME_FRAC_BITS	0				// Phase_Detection sub-clock timestamp bits
+#endif
+#define TRACE_FIT_FREQ_HZ		40000			// FIT interrupt rate
+#define TRACE_CLK2_FREQ_HZ		(100000000u << PHASE_TIME_FRAC_BITS)	// Phase_Detection timestamp counts per second
+#define TRACE_MAX_TDOA			(25000 << PHASE_TIME_FRAC_BITS)		// FIT_Handler validity window, counts
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	uint64_t	tick;			// FIT tick at which the registers take these values
+	uint32_t	time_1;			// signal 1 rising edge timestamp, counts
+	uint32_t	time_2;			// signal 2 rising edge timestamp, counts
+} trace_rec_t;
+
+typedef struct {
+	double		seconds;		// length of the trace
+	double		event_rate;		// sound events per second
+	double		sweep_period;	// seconds for the source to sweep left-right-left
+	double		hop_period;		// seconds between jumps to a random bearing, 0 = sweep
+	int32_t		max_tdoa;		// sweep amplitude, counts
+	int32_t		jitter;			// uniform TDOA jitter, +/- counts
+	uint32_t	noise_pct;		// percent of events with a spurious extra edge
+	uint32_t	clk2_hz;		// timestamp counts per second
+	uint32_t	seed;
+} trace_synth_t;
+
+typedef struct {
+	FILE			*fp;			// file source, or NULL for synthetic
+	trace_synth_t	synth;
+	uint64_t		event;			// synthetic: next event number
+	uint32_t		rng;
+	uint32_t		time_1, time_2;	// synthetic: current register values
+	trace_rec_t		pending[4];		// synthetic: records not yet returned
+	int				npending;
+	int32_t			tdoa;			// synthetic: source TDOA of the latest event, before jitter
+	uint64_t		line;			// file: current line number
+} trace_src_t;
+
+/************************** Function Prototypes ******************************/
+void trace_synth_defaults(trace_synth_t *synth);
+int  trace_open(trace_src_t *src, const char *path);
+void trace_open_synth(trace_src_t *src, const trace_synth_t *synth);
+int  trace_next(trace_src_t *src, trace_rec_t *rec);
+void trace_close(trace_src_t *src);
+void trace_write(FILE *fp, const trace_rec_t *rec);
+
+#endif
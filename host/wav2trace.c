@@ -0,0 +1,575 @@
+/**
+*
+* @file wav2trace.c
+*
+* Converts stereo recordings into capture-register traces (see trace.h) that host/replay
+* runs the firmware against, so a field recording goes through the same pairing, filtering
+* and servo logic as the board.  Each of the two microphone channels goes through a model
+* of the comparator in front of Phase_Detection: the output rises when the sample reaches
+* threshold + hysteresis/2 and falls when it drops to threshold - hysteresis/2.  A rise is
+* timestamped where the signal crossed the upper level, interpolated between the samples,
+* on the clk2 time base (TRACE_CLK2_FREQ_HZ), and lands in the trace on the next FIT tick.
+*
+* The recording is memory mapped and read once from start to end in blocks; the pages
+* behind the block are dropped as it goes, so files of any size convert in a few MB.  The
+* trace is written as it is produced, to stdout by default, so it can be piped straight
+* into replay:
+*
+*	wav2trace field.wav | replay -
+*
+* Given a directory, every .wav file in it is converted to a .trace file of the same name,
+* the files spread over a thread per core.  PCM 16, 24 and 32-bit, IEEE float 32-bit and
+* WAVE_FORMAT_EXTENSIBLE files are read, as RIFF or RF64 (larger than 4 GB).
+*
+* usage: wav2trace [-t level] [-H level] [-c ch1,ch2] [-j threads] [-o out] wav-file|directory
+*	-t		comparator threshold, fraction of full scale (0.05)
+*	-H		comparator hysteresis, fraction of full scale (0.01)
+*	-c		channels that feed mic 1 and mic 2, from 0 (0,1)
+*	-j		threads for a directory (one per core)
+*	-o		trace file for a wav file ("-" is stdout, the default), output directory for
+*			a directory (the directory itself)
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+/************************** Constant Definitions *****************************/
+#define WAV_FORMAT_PCM			0x0001
+#define WAV_FORMAT_FLOAT		0x0003
+#define WAV_FORMAT_EXTENSIBLE	0xFFFE
+#define BLOCK_FRAMES			4096					// frames decoded at a time
+#define DROP_BYTES				(16 * 1024 * 1024)		// mapped bytes read before dropping them
+#define OUT_BUFFER_BYTES		(1024 * 1024)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	uint16_t		format;			// WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+	uint16_t		channels;
+	uint16_t		bits;
+	uint32_t		block;			// bytes per frame
+	uint32_t		rate;			// frames per second
+	const uint8_t	*data;
+	uint64_t		frames;
+} wav_t;
+
+typedef struct {
+	FILE			*fp;
+	trace_rec_t		rec;			// record being built
+	int				have;
+	uint64_t		records;
+} emitter_t;
+
+typedef struct {
+	char			*path;
+	char			*out_path;		// NULL is stdout
+	// results
+	char			error[128];		// empty if the conversion succeeded
+	wav_t			wav;
+	uint64_t		edges[2];
+	uint64_t		records;
+	double			wall;
+} job_t;
+
+/************************** Variable Definitions *****************************/
+static float			threshold = 0.05f;
+static float			hysteresis = 0.01f;
+static int				chan[2] = { 0, 1 };
+
+static job_t			*jobs;
+static int				num_jobs;
+static int				next_job;
+static pthread_mutex_t	job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************/
+static double now_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+	return get32(p) | ((uint64_t) get32(p + 4) << 32);
+}
+
+/*****************************************************************************/
+/**
+* Finds the format and the sample data of a mapped WAV file.
+*
+* @return	NULL on success, otherwise what is wrong with the file
+******************************************************************************/
+static const char *wav_parse(wav_t *wav, const uint8_t *map, uint64_t len)
+{
+	const uint8_t	*p = map + 12, *end = map + len;
+	uint64_t		size, ds64_data = 0;
+	int				rf64, have_fmt = 0;
+
+	if ((len < 12) || (memcmp(map + 8, "WAVE", 4) != 0))
+	{
+		return "not a WAV file";
+	}
+	rf64 = (memcmp(map, "RF64", 4) == 0);
+	if (!rf64 && (memcmp(map, "RIFF", 4) != 0))
+	{
+		return "not a WAV file";
+	}
+
+	while (end - p >= 8)
+	{
+		size = get32(p + 4);
+		if ((memcmp(p, "ds64", 4) == 0) && (size >= 16) && (end - p >= 24))
+		{
+			ds64_data = get64(p + 16);
+		}
+		else if ((memcmp(p, "fmt ", 4) == 0) && (size >= 16) && (end - p >= 24))
+		{
+			wav->format = get16(p + 8);
+			wav->channels = get16(p + 10);
+			wav->rate = get32(p + 12);
+			wav->block = get16(p + 20);
+			wav->bits = get16(p + 22);
+			if ((wav->format == WAV_FORMAT_EXTENSIBLE) && (size >= 26) && (end - p >= 34))
+			{
+				wav->format = get16(p + 32);	// the first two bytes of the sub-format GUID
+			}
+			have_fmt = 1;
+		}
+		else if (memcmp(p, "data", 4) == 0)
+		{
+			if (!have_fmt)
+			{
+				return "no fmt chunk before the data";
+			}
+			if (rf64 && (size == 0xFFFFFFFF))
+			{
+				size = ds64_data;
+			}
+			// a recorder that was cut off leaves the sizes too large
+			if (size > (uint64_t) (end - p - 8))
+			{
+				size = (uint64_t) (end - p - 8);
+			}
+			if ((wav->format != WAV_FORMAT_PCM) && (wav->format != WAV_FORMAT_FLOAT))
+			{
+				return "not PCM or float samples";
+			}
+			if (((wav->format == WAV_FORMAT_PCM) && (wav->bits != 16) && (wav->bits != 24) && (wav->bits != 32)) ||
+				((wav->format == WAV_FORMAT_FLOAT) && (wav->bits != 32)))
+			{
+				return "unsupported sample size";
+			}
+			if ((wav->rate == 0) || (wav->block < wav->channels * (wav->bits / 8)))
+			{
+				return "bad fmt chunk";
+			}
+			if ((chan[0] >= wav->channels) || (chan[1] >= wav->channels))
+			{
+				return "fewer channels than -c selects";
+			}
+			wav->data = p + 8;
+			wav->frames = size / wav->block;
+			return NULL;
+		}
+		p += 8 + size + (size & 1);
+		if (p < map + 12)
+		{
+			break;									// size wrapped the pointer
+		}
+	}
+	return "no data chunk";
+}
+
+/*****************************************************************************/
+/**
+* Decodes one channel of frames [0, n) of a block to full scale = 1.0.
+******************************************************************************/
+static void wav_decode(const wav_t *wav, const uint8_t *frames, int channel, int n, float *out)
+{
+	const uint8_t	*p = frames + channel * (wav->bits / 8);
+	uint32_t		u;
+	int				i;
+
+	if (wav->format == WAV_FORMAT_FLOAT)
+	{
+		for (i = 0; i < n; i++, p += wav->block)
+		{
+			u = get32(p);
+			memcpy(&out[i], &u, sizeof(float));
+		}
+	}
+	else if (wav->bits == 16)
+	{
+		for (i = 0; i < n; i++, p += wav->block)
+		{
+			out[i] = (int16_t) get16(p) * (1.0f / 32768.0f);
+		}
+	}
+	else if (wav->bits == 24)
+	{
+		for (i = 0; i < n; i++, p += wav->block)
+		{
+			out[i] = (int32_t) ((uint32_t) (p[0] << 8 | p[1] << 16 | (uint32_t) p[2] << 24)) *
+				(1.0f / 2147483648.0f);
+		}
+	}
+	else
+	{
+		for (i = 0; i < n; i++, p += wav->block)
+		{
+			out[i] = (int32_t) get32(p) * (1.0f / 2147483648.0f);
+		}
+	}
+}
+
+/*****************************************************************************/
+/**
+* Adds an edge to the trace.  The capture register changes at the edge and is first seen
+* on the next FIT tick; edges seen on the same tick share a record (as trace.c's synthetic
+* source builds them).
+******************************************************************************/
+static void emit_edge(emitter_t *em, uint64_t edge, int channel)
+{
+	uint64_t tick = (edge * TRACE_FIT_FREQ_HZ) / TRACE_CLK2_FREQ_HZ + 1;
+
+	if (em->have && (em->rec.tick != tick))
+	{
+		trace_write(em->fp, &em->rec);
+		em->records++;
+	}
+	em->have = 1;
+	em->rec.tick = tick;
+	if (channel == 0)
+	{
+		em->rec.time_1 = (uint32_t) edge;
+	}
+	else
+	{
+		em->rec.time_2 = (uint32_t) edge;
+	}
+}
+
+static void emit_flush(emitter_t *em)
+{
+	if (em->have)
+	{
+		trace_write(em->fp, &em->rec);
+		em->records++;
+		em->have = 0;
+	}
+}
+
+/*****************************************************************************/
+/**
+* Runs both channels of a mapped recording through the comparators and writes the trace.
+******************************************************************************/
+static void convert(job_t *job, const uint8_t *map, FILE *out)
+{
+	const wav_t	*wav = &job->wav;
+	const float	upper = threshold + hysteresis / 2, lower = threshold - hysteresis / 2;
+	const double counts_per_frame = (double) TRACE_CLK2_FREQ_HZ / wav->rate;
+	float		x[2][BLOCK_FRAMES], last[2] = { 0.0f, 0.0f };
+	int			high[2] = { 0, 0 }, n, i, c;
+	double		rise[2], frac;
+	uint64_t	frame, dropped = 0, offset;
+	long		page = sysconf(_SC_PAGESIZE);
+	emitter_t	em;
+
+	memset(&em, 0, sizeof(em));
+	em.fp = out;
+	for (frame = 0; frame < wav->frames; frame += n)
+	{
+		n = (wav->frames - frame < BLOCK_FRAMES) ? (int) (wav->frames - frame) : BLOCK_FRAMES;
+		for (c = 0; c < 2; c++)
+		{
+			wav_decode(wav, wav->data + frame * wav->block, chan[c], n, x[c]);
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			for (c = 0; c < 2; c++)
+			{
+				rise[c] = -1.0;
+				if (!high[c] && (x[c][i] >= upper))
+				{
+					// the crossing lies between the last sample and this one
+					high[c] = 1;
+					frac = (x[c][i] > last[c]) ? (double) (upper - last[c]) / (x[c][i] - last[c]) : 1.0;
+					frac = (frac < 0.0) ? 0.0 : frac;
+					rise[c] = ((double) (frame + i) - 1.0 + frac) * counts_per_frame;
+					rise[c] = (rise[c] < 0.0) ? 0.0 : rise[c];
+					job->edges[c]++;
+				}
+				else if (high[c] && (x[c][i] <= lower))
+				{
+					high[c] = 0;
+				}
+				last[c] = x[c][i];
+			}
+			// both channels rising in one sample reach Phase_Detection in time order
+			if ((rise[0] >= 0.0) && (rise[1] >= 0.0) && (rise[1] < rise[0]))
+			{
+				emit_edge(&em, (uint64_t) rise[1], 1);
+				emit_edge(&em, (uint64_t) rise[0], 0);
+			}
+			else
+			{
+				for (c = 0; c < 2; c++)
+				{
+					if (rise[c] >= 0.0)
+					{
+						emit_edge(&em, (uint64_t) rise[c], c);
+					}
+				}
+			}
+		}
+
+		// the pages read so far are not needed again
+		offset = (uint64_t) (wav->data - map) + (frame + n) * wav->block;
+		if (offset - dropped >= DROP_BYTES)
+		{
+			offset -= offset % (uint64_t) page;
+			madvise((void *) (map + dropped), offset - dropped, MADV_DONTNEED);
+			dropped = offset;
+		}
+	}
+	emit_flush(&em);
+	job->records = em.records;
+}
+
+/*****************************************************************************/
+/**
+* Converts one file; on failure job->error says why.
+******************************************************************************/
+static void run_job(job_t *job)
+{
+	struct stat	st;
+	uint8_t		*map;
+	const char	*error;
+	FILE		*out;
+	char		*buf;
+	int			fd;
+	double		start = now_secs();
+
+	if (((fd = open(job->path, O_RDONLY)) < 0) || (fstat(fd, &st) != 0))
+	{
+		snprintf(job->error, sizeof(job->error), "cannot open");
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return;
+	}
+	map = (st.st_size > 0) ? mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		snprintf(job->error, sizeof(job->error), "cannot map");
+		return;
+	}
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	if ((error = wav_parse(&job->wav, map, (uint64_t) st.st_size)) != NULL)
+	{
+		snprintf(job->error, sizeof(job->error), "%s", error);
+	}
+	else if ((out = job->out_path ? fopen(job->out_path, "w") : stdout) == NULL)
+	{
+		snprintf(job->error, sizeof(job->error), "cannot write %s", job->out_path);
+	}
+	else
+	{
+		buf = malloc(OUT_BUFFER_BYTES);
+		setvbuf(out, buf, _IOFBF, OUT_BUFFER_BYTES);
+		fprintf(out, "# %s through a comparator at %.4f +/- %.4f, FIT tick, time_1, time_2\n",
+			job->path, threshold, hysteresis / 2);
+		convert(job, map, out);
+		// stdout keeps its buffer until the exit
+		if (((out == stdout) ? fflush(out) : fclose(out)) != 0)
+		{
+			snprintf(job->error, sizeof(job->error), "write error");
+		}
+		if (out != stdout)
+		{
+			free(buf);
+		}
+	}
+	munmap(map, (size_t) st.st_size);
+	job->wall = now_secs() - start;
+}
+
+static void *worker(void *arg)
+{
+	int i;
+
+	(void) arg;
+	for (;;)
+	{
+		pthread_mutex_lock(&job_lock);
+		i = next_job++;
+		pthread_mutex_unlock(&job_lock);
+		if (i >= num_jobs)
+		{
+			return NULL;
+		}
+		run_job(&jobs[i]);
+	}
+}
+
+/*****************************************************************************/
+static int by_name(const void *a, const void *b)
+{
+	return strcmp(((const job_t *) a)->path, ((const job_t *) b)->path);
+}
+
+/**
+* Makes a job for every .wav file in dir, writing to outdir.
+******************************************************************************/
+static int list_dir(const char *dir, const char *outdir)
+{
+	DIR				*d = opendir(dir);
+	struct dirent	*e;
+	size_t			len, cap = 0;
+
+	if (d == NULL)
+	{
+		return -1;
+	}
+	while ((e = readdir(d)) != NULL)
+	{
+		len = strlen(e->d_name);
+		if ((len <= 4) || (strcasecmp(e->d_name + len - 4, ".wav") != 0))
+		{
+			continue;
+		}
+		if ((size_t) num_jobs == cap)
+		{
+			cap = cap ? 2 * cap : 64;
+			jobs = realloc(jobs, cap * sizeof(job_t));
+		}
+		memset(&jobs[num_jobs], 0, sizeof(job_t));
+		jobs[num_jobs].path = malloc(strlen(dir) + len + 2);
+		sprintf(jobs[num_jobs].path, "%s/%s", dir, e->d_name);
+		jobs[num_jobs].out_path = malloc(strlen(outdir) + len + 4);
+		sprintf(jobs[num_jobs].out_path, "%s/%.*s.trace", outdir, (int) (len - 4), e->d_name);
+		num_jobs++;
+	}
+	closedir(d);
+	qsort(jobs, (size_t) num_jobs, sizeof(job_t), by_name);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char	*out_arg = NULL;
+	struct stat	st;
+	pthread_t	*threads;
+	FILE		*report;
+	int			opt, num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN), i, failed = 0;
+	double		start, wall, audio = 0.0, bytes = 0.0;
+	job_t		*job;
+
+	while ((opt = getopt(argc, argv, "t:H:c:j:o:")) != -1)
+	{
+		switch (opt)
+		{
+			case 't': threshold = (float) atof(optarg); break;
+			case 'H': hysteresis = (float) atof(optarg); break;
+			case 'c':
+				if (sscanf(optarg, "%d,%d", &chan[0], &chan[1]) != 2)
+				{
+					chan[0] = -1;
+				}
+				break;
+			case 'j': num_threads = atoi(optarg); break;
+			case 'o': out_arg = optarg; break;
+			default: optind = argc; break;
+		}
+	}
+	if ((optind != argc - 1) || (hysteresis < 0.0f) || (chan[0] < 0) || (chan[1] < 0) ||
+		(chan[0] == chan[1]) || (stat(argv[optind], &st) != 0))
+	{
+		fprintf(stderr, "usage: %s [-t level] [-H level] [-c ch1,ch2] [-j threads] [-o out] "
+			"wav-file|directory\n", argv[0]);
+		return 2;
+	}
+	num_threads = (num_threads < 1) ? 1 : num_threads;
+
+	if (S_ISDIR(st.st_mode))
+	{
+		if (list_dir(argv[optind], out_arg ? out_arg : argv[optind]) != 0)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	else
+	{
+		jobs = calloc(1, sizeof(job_t));
+		jobs[0].path = strdup(argv[optind]);
+		jobs[0].out_path = (out_arg && strcmp(out_arg, "-")) ? strdup(out_arg) : NULL;
+		num_jobs = 1;
+	}
+	num_threads = (num_threads > num_jobs) ? num_jobs : num_threads;
+
+	start = now_secs();
+	threads = calloc((size_t) num_threads + 1, sizeof(pthread_t));
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_create(&threads[i], NULL, worker, NULL);
+	}
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	wall = now_secs() - start;
+
+	// the report goes to stderr when the trace goes to stdout
+	report = (num_jobs == 1 && jobs[0].out_path == NULL) ? stderr : stdout;
+	for (i = 0; i < num_jobs; i++)
+	{
+		job = &jobs[i];
+		if (job->error[0])
+		{
+			fprintf(report, "%s: %s\n", job->path, job->error);
+			failed++;
+			continue;
+		}
+		audio += (double) job->wav.frames / job->wav.rate;
+		bytes += (double) job->wav.frames * job->wav.block;
+		fprintf(report, "%s: %.1f s at %" PRIu32 " Hz, %" PRIu64 " + %" PRIu64 " edges, %" PRIu64
+			" records, %.0fx real time\n", job->path, (double) job->wav.frames / job->wav.rate,
+			job->wav.rate, job->edges[0], job->edges[1], job->records,
+			job->wall > 0.0 ? (double) job->wav.frames / job->wav.rate / job->wall : 0.0);
+	}
+	fprintf(report, "files           %d converted, %d failed, %d threads\n", num_jobs - failed, failed,
+		num_threads);
+	fprintf(report, "audio           %.1f s in %.2f s wall (%.0fx real time, %.0f MB/s)\n", audio, wall,
+		wall > 0.0 ? audio / wall : 0.0, wall > 0.0 ? bytes / wall / 1e6 : 0.0);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/**
+*
+* @file latency_trace.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the latency trace buffer.  Records are appended until the
+* buffer is full and then dropped, so a capture covers the first LTRACE_SIZE
+* trace points after LTRACE_Initialize().  LTRACE_Record() may be called from the
+* FIT interrupt and from the main loop; it is kept short and takes the buffer slot
+* with interrupts disabled.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "latency_trace.h"
+
+#ifdef LTRACE_ENABLE
+#include "mb_interface.h"
+
+
+/************************** Variable Definitions *****************************/
+u32					LTRACE_LastTag[LTRACE_NUM_STAGES];	// tag of the latest record per stage
+
+static LTraceRec	trace_buf[LTRACE_SIZE];
+static volatile u32	trace_count;
+
+
+/*****************************************************************************/
+/**
+* Empties the trace buffer and starts a new capture
+******************************************************************************/
+void LTRACE_Initialize(void)
+{
+	int i;
+
+	for (i = 0; i < LTRACE_NUM_STAGES; i++)
+	{
+		LTRACE_LastTag[i] = 0;
+	}
+	trace_count = 0;
+}
+
+
+/*****************************************************************************/
+/**
+* Appends a trace record
+*
+* @param	stage is the pipeline stage (LTRACE_EDGE .. LTRACE_TLR)
+* @param	tag identifies the measurement passing through the stage
+* @param	time is the Phase_Detection counter value at the stage
+*
+******************************************************************************/
+void LTRACE_Record(int stage, u32 tag, u32 time)
+{
+	u32 msr = mfmsr();
+	u32 n;
+
+	microblaze_disable_interrupts();
+	n = trace_count;
+	if (n < LTRACE_SIZE)
+	{
+		trace_count = n + 1;
+	}
+	if (msr & 0x2)		// MSR[IE]
+	{
+		microblaze_enable_interrupts();
+	}
+	LTRACE_LastTag[stage] = tag;
+	if (n < LTRACE_SIZE)
+	{
+		trace_buf[n].time = time;
+		trace_buf[n].tag_stage = (tag & LTRACE_TAG_MASK) | ((u32) stage << LTRACE_STAGE_SHIFT);
+	}
+}
+
+
+/*****************************************************************************/
+/**
+* Returns non-zero once the capture is complete
+******************************************************************************/
+int LTRACE_Full(void)
+{
+	return trace_count >= LTRACE_SIZE;
+}
+#endif
+
+
+/*****************************************************************************/
+/**
+* Writes the trace buffer in binary
+*
+* @param	put is called with each byte of the dump (outbyte() to send it on
+*			the console UART)
+*
+* @return
+*
+*   - XST_SUCCESS if the buffer was dumped
+*	- XST_FAILURE if tracing is not compiled in (nothing is written)
+*
+******************************************************************************/
+#ifdef LTRACE_ENABLE
+static void put_u32(void (*put)(u8 byte), u32 v)
+{
+	put((u8) v);
+	put((u8) (v >> 8));
+	put((u8) (v >> 16));
+	put((u8) (v >> 24));
+}
+#endif
+
+int LTRACE_Dump(void (*put)(u8 byte))
+{
+#ifdef LTRACE_ENABLE
+	u32 i, n = trace_count;
+
+	put_u32(put, LTRACE_MAGIC);
+	put_u32(put, LTRACE_VERSION | (sizeof(LTraceRec) << 16));
+	put_u32(put, n);
+	put_u32(put, LTRACE_CLOCK_HZ);
+	for (i = 0; i < n; i++)
+	{
+		put_u32(put, trace_buf[i].time);
+		put_u32(put, trace_buf[i].tag_stage);
+	}
+	return XST_SUCCESS;
+#else
+	(void) put;
+	return XST_FAILURE;
+#endif
+}
@@ -0,0 +1,119 @@
+/**
+*
+* @file latency_trace.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions, macros and function prototypes for
+* latency_trace.c.  latency_trace.c records a timestamp at each stage between a sound
+* arriving at the microphones and the servo PWM being reprogrammed:
+*
+*	LTRACE_EDGE		edge captured by Phase_Detection (the later edge of the pair)
+*	LTRACE_READ		edge pair read by Capture_Handler()
+*	LTRACE_PHASE	accepted as a new (filtered) phase_diff by phase_task()
+*	LTRACE_DUTY		duty cycle computed from it
+*	LTRACE_TLR		timer load register written by the PWM driver
+*
+* Timestamps are Phase_Detection counter values (clk2 counts), read through GPIO 3,
+* so they share a time base with the edge timestamps.  Each record carries a tag, the
+* FIT tick the edge pair was read on, that follows the measurement through the
+* stages.  Records go into a fixed RAM buffer until it is full and are dumped in
+* binary (see LTRACE_Dump()) for host/ltrace_decode.
+*
+* Tracing is compiled in only when LTRACE_ENABLE is defined.  Otherwise the trace
+* points expand to nothing and the module is empty.
+*
+******************************************************************************/
+
+#ifndef LATENCY_TRACE_H	/* prevent circular inclusions */
+#define LATENCY_TRACE_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+// Trace stages, in pipeline order
+#define LTRACE_EDGE				0
+#define LTRACE_READ				1
+#define LTRACE_PHASE			2
+#define LTRACE_DUTY				3
+#define LTRACE_TLR				4
+#define LTRACE_NUM_STAGES		5
+
+#ifndef LTRACE_SIZE
+#define LTRACE_SIZE				2048		// records in the buffer (8 bytes each)
+#endif
+
+// Binary dump layout (all fields little endian):
+//	header	u32 magic, u16 version, u16 record size, u32 record count, u32 clock Hz
+//	records	u32 timestamp, u32 tag (bits 27:0) | stage (bits 31:28)
+#define LTRACE_MAGIC			0x4352544C	// "LTRC"
+#define LTRACE_VERSION			1
+#define LTRACE_TAG_MASK			0x0FFFFFFF
+#define LTRACE_STAGE_SHIFT		28
+
+#ifndef LTRACE_CLOCK_HZ
+#ifdef PHASE_TIME_FRAC_BITS
+#define LTRACE_CLOCK_HZ			(100000000u << PHASE_TIME_FRAC_BITS)	// Phase_Detection counter rate
+#else
+#define LTRACE_CLOCK_HZ			100000000	// Phase_Detection counter clock (clk2)
+#endif
+#endif
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		time;					// Phase_Detection counter
+	u32		tag_stage;				// tag | stage << LTRACE_STAGE_SHIFT
+} LTraceRec;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+#ifdef LTRACE_ENABLE
+
+#include "xparameters.h"
+#include "xil_io.h"
+
+#ifndef LTRACE_CLOCK_BASEADDR
+#define LTRACE_CLOCK_BASEADDR	XPAR_AXI_GPIO_3_BASEADDR	// GPIO 3 channel 1 data
+#endif
+#define LTRACE_NOW()			Xil_In32(LTRACE_CLOCK_BASEADDR)
+
+// record stage now / at a known time, for the measurement tagged tag
+#define LTRACE(stage, tag)			LTRACE_Record((stage), (tag), LTRACE_NOW())
+#define LTRACE_AT(stage, tag, time)	LTRACE_Record((stage), (tag), (time))
+// record stage for the measurement that last passed the previous stage
+#define LTRACE_NEXT(stage)			LTRACE_Record((stage), LTRACE_LastTag[(stage) - 1], LTRACE_NOW())
+#define LTRACE_INIT()				LTRACE_Initialize()
+
+#else
+
+#define LTRACE_INIT()
+#define LTRACE(stage, tag)
+#define LTRACE_AT(stage, tag, time)
+#define LTRACE_NEXT(stage)
+
+#endif
+
+/************************** Function Prototypes ******************************/
+#ifdef LTRACE_ENABLE
+void LTRACE_Initialize(void);
+void LTRACE_Record(int stage, u32 tag, u32 time);
+int  LTRACE_Full(void);
+#endif
+int  LTRACE_Dump(void (*put)(u8 byte));
+
+/************************** Variable Definitions *****************************/
+#ifdef LTRACE_ENABLE
+extern u32	LTRACE_LastTag[LTRACE_NUM_STAGES];
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -0,0 +1,251 @@
+/**
+*
+* @file median_filter.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides a streaming sliding-window median with an optional exponential
+* smoother.
+*
+* The window is kept as two heaps sharing one array of slot numbers, indexed by a
+* signed heap position: position 0 is the median, negative positions are a max-heap of
+* the samples below it and positive positions a min-heap of the samples above it.  The
+* parent of position p is p / 2 (rounding toward zero), so both heaps hang off the
+* median.  Each slot of the circular sample buffer records its heap position, so the
+* oldest sample can be overwritten in place by the new one and sifted to its new
+* position: O(log window) compares and swaps per sample, no searching and no
+* allocation.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "median_filter.h"
+
+
+/***************** Macros (Inline Functions) Definitions *********************/
+#define HEAP(m, p)			((m)->heap[(p) + (MEDIAN_MAX_WINDOW / 2)])
+#define VAL(m, p)			((m)->value[HEAP(m, p)])
+#define LO_COUNT(m)			((m)->count / 2)			// samples in the max-heap (below)
+#define HI_COUNT(m)			(((m)->count - 1) / 2)		// samples in the min-heap (above)
+
+
+/************************** Function Prototypes ******************************/
+static void swap(MedianFilter *m, int a, int b);
+static bool sift_up(MedianFilter *m, int p);
+static void hi_sift_down(MedianFilter *m, int p);
+static void lo_sift_down(MedianFilter *m, int p);
+
+
+/*****************************************************************************/
+/**
+* Initializes a median filter
+*
+* @param    InstancePtr is a pointer to the filter instance
+* @param	window is the number of samples the median is taken over (odd
+*			windows give a true median; 1 disables the median)
+* @param	ema_shift sets the smoother weight to 1/2^ema_shift; 0 disables it
+*
+* @return
+*
+*   - XST_SUCCESS if the filter was initialized
+*	- XST_INVALID_PARAM if the window or shift is out of range
+*
+******************************************************************************/
+int MEDIAN_Initialize(MedianFilter *InstancePtr, int window, int ema_shift)
+{
+	int slot, p;
+
+	if ((window < 1) || (window > MEDIAN_MAX_WINDOW) || (ema_shift < 0) || (ema_shift > 15))
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->window = window;
+	InstancePtr->count = 0;
+	InstancePtr->oldest = 0;
+	InstancePtr->ema_shift = ema_shift;
+	InstancePtr->ema = 0;
+
+	// lay the slots out so the n-th sample lands where the n-th sample belongs
+	// while the window fills: 0, -1, 1, -2, 2, ...
+	for (slot = 0; slot < window; slot++)
+	{
+		p = ((slot + 1) / 2) * ((slot & 1) ? -1 : 1);
+		InstancePtr->pos[slot] = (s16) p;
+		HEAP(InstancePtr, p) = (s16) slot;
+		InstancePtr->value[slot] = 0;
+	}
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Adds a sample and returns the filtered value
+*
+* @param    InstancePtr is a pointer to the filter instance
+* @param	sample is the new phase sample
+*
+* @return	the median of the last "window" samples (of all samples while the
+*			window fills), smoothed if enabled
+*
+******************************************************************************/
+int MEDIAN_Update(MedianFilter *InstancePtr, int sample)
+{
+	MedianFilter	*m = InstancePtr;
+	int				slot = m->oldest;
+	int				p = m->pos[slot];
+	bool			filling = (m->count < m->window);
+	s32				old = m->value[slot];
+	s32				median;
+
+	// overwrite the oldest sample in place
+	m->value[slot] = sample;
+	m->oldest = (slot + 1 == m->window) ? 0 : slot + 1;
+	if (filling)
+	{
+		m->count++;
+	}
+
+	// move it to where it now belongs
+	if (p > 0)
+	{
+		// in the upper heap - it can only sink if it grew, otherwise it may rise past the median
+		if (!filling && (sample > old))
+		{
+			hi_sift_down(m, p);
+		}
+		else if (sift_up(m, p))
+		{
+			lo_sift_down(m, 0);
+		}
+	}
+	else if (p < 0)
+	{
+		if (!filling && (sample < old))
+		{
+			lo_sift_down(m, p);
+		}
+		else if (sift_up(m, p))
+		{
+			hi_sift_down(m, 0);
+		}
+	}
+	else
+	{
+		// the median itself was replaced - it may belong on either side
+		lo_sift_down(m, 0);
+		hi_sift_down(m, 0);
+	}
+
+	median = VAL(m, 0);
+	if ((m->count & 1) == 0)
+	{
+		median = (median + VAL(m, -1)) / 2;
+	}
+
+	if (m->ema_shift == 0)
+	{
+		return median;
+	}
+	if (m->count == 1)
+	{
+		m->ema = median << MEDIAN_EMA_FRAC;
+	}
+	else
+	{
+		m->ema += ((median << MEDIAN_EMA_FRAC) - m->ema) >> m->ema_shift;
+	}
+	return m->ema >> MEDIAN_EMA_FRAC;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+static void swap(MedianFilter *m, int a, int b)
+{
+	s16 t = HEAP(m, a);
+
+	HEAP(m, a) = HEAP(m, b);
+	HEAP(m, b) = t;
+	m->pos[HEAP(m, a)] = (s16) a;
+	m->pos[HEAP(m, b)] = (s16) b;
+}
+
+
+/****************************************************************************/
+/**
+* Moves the sample at position p toward the median while it is out of order
+* with its parent.  Returns true if it reached the median position.
+*****************************************************************************/
+static bool sift_up(MedianFilter *m, int p)
+{
+	while (p > 0)
+	{
+		if (!(VAL(m, p) < VAL(m, p / 2)))
+		{
+			return false;
+		}
+		swap(m, p, p / 2);
+		p /= 2;
+	}
+	while (p < 0)
+	{
+		if (!(VAL(m, p / 2) < VAL(m, p)))
+		{
+			return false;
+		}
+		swap(m, p, p / 2);
+		p /= 2;
+	}
+	return true;
+}
+
+
+/****************************************************************************/
+/**
+* Restores the min-heap (positive positions) below position p.  The median
+* (p = 0) has the single child 1 on this side.
+*****************************************************************************/
+static void hi_sift_down(MedianFilter *m, int p)
+{
+	int c;
+
+	for (c = p ? 2 * p : 1; c <= HI_COUNT(m); c = 2 * p)
+	{
+		if ((p != 0) && (c < HI_COUNT(m)) && (VAL(m, c + 1) < VAL(m, c)))
+		{
+			c++;
+		}
+		if (!(VAL(m, c) < VAL(m, p)))
+		{
+			break;
+		}
+		swap(m, c, p);
+		p = c;
+	}
+}
+
+
+/****************************************************************************/
+/**
+* Restores the max-heap (negative positions) below position p.  The median
+* (p = 0) has the single child -1 on this side.
+*****************************************************************************/
+static void lo_sift_down(MedianFilter *m, int p)
+{
+	int c;
+
+	for (c = p ? 2 * p : -1; c >= -LO_COUNT(m); c = 2 * p)
+	{
+		if ((p != 0) && (c > -LO_COUNT(m)) && (VAL(m, c) < VAL(m, c - 1)))
+		{
+			c--;
+		}
+		if (!(VAL(m, p) < VAL(m, c)))
+		{
+			break;
+		}
+		swap(m, c, p);
+		p = c;
+	}
+}
@@ -0,0 +1,55 @@
+/**
+*
+* @file median_filter.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for median_filter.c.
+* median_filter.c is a streaming sliding-window median for phase samples, optionally
+* followed by an exponential smoother.  It rejects the isolated outliers a spurious edge
+* pair produces before they reach the servo.  Memory is fixed by MEDIAN_MAX_WINDOW and
+* each sample costs O(log window) integer operations.
+*
+******************************************************************************/
+
+#ifndef MEDIAN_FILTER_H	/* prevent circular inclusions */
+#define MEDIAN_FILTER_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef MEDIAN_MAX_WINDOW
+#define MEDIAN_MAX_WINDOW	31			// largest supported window (samples)
+#endif
+#define MEDIAN_EMA_FRAC		8			// fraction bits kept by the smoother
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	int		window;						// samples in the window
+	int		count;						// samples seen, up to window
+	int		oldest;						// slot holding the oldest sample
+	s32		value[MEDIAN_MAX_WINDOW];	// samples, by slot
+	s16		pos[MEDIAN_MAX_WINDOW];		// heap position of each slot
+	s16		heap[MEDIAN_MAX_WINDOW];	// slots by heap position, centred on the median
+
+	int		ema_shift;					// smoother weight 1/2^ema_shift, 0 = no smoothing
+	s32		ema;						// smoother state, MEDIAN_EMA_FRAC fraction bits
+} MedianFilter;
+
+/************************** Function Prototypes ******************************/
+int MEDIAN_Initialize(MedianFilter *InstancePtr, int window, int ema_shift);
+int MEDIAN_Update(MedianFilter *InstancePtr, int sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
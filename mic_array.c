@@ -0,0 +1,490 @@
+/**
+*
+* @file mic_array.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides sound event grouping and least squares direction finding for a
+* microphone array.
+*
+* A plane wave reaches microphone i (position p_i) at t_i = t0 + p_i . s, where s is
+* the slowness vector (arrival delay per unit distance along the propagation
+* direction).  Stacking the N arrival times gives N equations in the unknowns
+* (t0, s); their least squares solution is x = (H'H)^-1 H' t with H = [1 p_i].  Using
+* the arrival time of every microphone in one solve is equivalent to fitting all
+* N(N-1)/2 pairwise TDOAs at once, while costing only N multiply-adds per unknown.
+* The pseudo-inverse (H'H)^-1 H' depends only on the geometry, so it is computed
+* (in floating point) at initialization and kept as fixed-point weights.
+*
+* Events: the edges of each FIT tick are merged in time order.  The first edge
+* opens an event; each microphone contributes its first edge within "window"
+* counts (the longest delay across the array plus a margin).  The event is solved
+* as soon as every microphone has been heard, or closed when a later edge or the
+* passage of time shows it cannot complete.  An incomplete event that still has
+* mics 1 and 2 falls back to their plain difference.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "mic_array.h"
+
+
+/************************** Constant Definitions *****************************/
+#define WINDOW_MARGIN_SHIFT		5			// window margin = 1/32 of the longest delay
+#define SINGULAR_TOLERANCE		1.0e-9		// relative pivot size below which the geometry is rejected
+#define CORDIC_ITERATIONS		16
+
+// atan(2^-i) in micro degrees
+static const s32 cordic_atan_udeg[CORDIC_ITERATIONS] = {
+	45000000, 26565051, 14036243, 7125016, 3576334, 1789911, 895174, 447614,
+	223811, 111906, 55953, 27976, 13988, 6994, 3497, 1749
+};
+
+/************************** Function Prototypes ******************************/
+static void close_event(MicArray *InstancePtr, ArrayEvent *events, int *n_events, int max_events);
+static void solve(const MicArray *InstancePtr, ArrayEvent *EventPtr);
+static double square_root(double x);
+static s32 round_fixed(double x, int frac);
+static s32 cordic_atan2(s32 y, s32 x, s32 *magnitude);
+
+
+/*****************************************************************************/
+/**
+* Initializes the microphone array
+*
+* @param    InstancePtr is a pointer to the array instance
+* @param	num_mics is the number of microphones (2 to ARRAY_MAX_MICS).  Mic 1
+*			and mic 2 form the baseline the phase difference is reported on
+* @param	pos_um is the position (x, y, z) of each microphone in micrometers
+* @param	dims is the number of slowness components to solve for: 1 (x only),
+*			2 (x, y: bearing) or 3 (x, y, z: bearing and elevation)
+* @param	clk_hz is the Phase_Detection timestamp clock
+* @param	tick_hz is the rate ARRAY_AddBatch() is called at (the FIT rate)
+*
+* @return
+*
+*   - XST_SUCCESS if the array was initialized
+*	- XST_INVALID_PARAM if the parameters are out of range or the geometry cannot
+*	  resolve dims components (e.g. a planar array and dims = 3)
+*
+******************************************************************************/
+int ARRAY_Initialize(MicArray *InstancePtr, int num_mics, const s32 (*pos_um)[3], int dims,
+		u32 clk_hz, u32 tick_hz)
+{
+	double	h[ARRAY_MAX_MICS][ARRAY_MAX_DIMS + 1];
+	double	a[ARRAY_MAX_DIMS + 1][2 * (ARRAY_MAX_DIMS + 1)];
+	double	pinv[ARRAY_MAX_DIMS + 1][ARRAY_MAX_MICS];
+	double	w, scale, d2, max_d2;
+	int		k = dims + 1;
+	int		i, j, d, r, c, piv;
+
+	if ((num_mics < 2) || (num_mics > ARRAY_MAX_MICS) || (dims < 1) || (dims > ARRAY_MAX_DIMS) ||
+		(num_mics < k) || (clk_hz == 0) || (tick_hz == 0) || (clk_hz < tick_hz))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	// H = [1 p_i], positions in mm
+	for (i = 0; i < num_mics; i++)
+	{
+		h[i][0] = 1.0;
+		for (d = 0; d < dims; d++)
+		{
+			h[i][d + 1] = pos_um[i][d] / 1000.0;
+		}
+	}
+
+	// invert H'H by Gauss-Jordan elimination on [H'H | I]
+	scale = 0.0;
+	for (r = 0; r < k; r++)
+	{
+		for (c = 0; c < k; c++)
+		{
+			for (w = 0.0, i = 0; i < num_mics; i++)
+			{
+				w += h[i][r] * h[i][c];
+			}
+			a[r][c] = w;
+			a[r][k + c] = (r == c) ? 1.0 : 0.0;
+		}
+		scale = (a[r][r] > scale) ? a[r][r] : scale;
+	}
+	for (c = 0; c < k; c++)
+	{
+		for (piv = c, r = c + 1; r < k; r++)
+		{
+			if (((a[r][c] < 0.0) ? -a[r][c] : a[r][c]) > ((a[piv][c] < 0.0) ? -a[piv][c] : a[piv][c]))
+			{
+				piv = r;
+			}
+		}
+		if (((a[piv][c] < 0.0) ? -a[piv][c] : a[piv][c]) < SINGULAR_TOLERANCE * scale)
+		{
+			return XST_INVALID_PARAM;
+		}
+		for (j = 0; j < 2 * k; j++)
+		{
+			w = a[c][j];
+			a[c][j] = a[piv][j];
+			a[piv][j] = w;
+		}
+		for (w = a[c][c], j = 0; j < 2 * k; j++)
+		{
+			a[c][j] /= w;
+		}
+		for (r = 0; r < k; r++)
+		{
+			if (r != c)
+			{
+				for (w = a[r][c], j = 0; j < 2 * k; j++)
+				{
+					a[r][j] -= w * a[c][j];
+				}
+			}
+		}
+	}
+
+	// pseudo-inverse (H'H)^-1 H'; row 0 is t0, rows 1.. the slowness components
+	for (r = 0; r < k; r++)
+	{
+		for (i = 0; i < num_mics; i++)
+		{
+			for (w = 0.0, c = 0; c < k; c++)
+			{
+				w += a[r][k + c] * h[i][c];
+			}
+			pinv[r][i] = w;
+		}
+	}
+
+	InstancePtr->num_mics = num_mics;
+	InstancePtr->dims = dims;
+	for (i = 0; i < num_mics; i++)
+	{
+		// projection onto the mic 1 - mic 2 baseline: (p_1 - p_2) . s
+		for (w = 0.0, d = 0; d < dims; d++)
+		{
+			w += (h[0][d + 1] - h[1][d + 1]) * pinv[d + 1][i];
+		}
+		InstancePtr->w_proj[i] = round_fixed(w, ARRAY_PROJ_FRAC);
+		for (d = 0; d < dims; d++)
+		{
+			InstancePtr->w_slow[d][i] = round_fixed(pinv[d + 1][i], ARRAY_WEIGHT_FRAC);
+		}
+	}
+
+	// the longest delay between any two microphones, plus a margin
+	max_d2 = 0.0;
+	for (i = 0; i < num_mics; i++)
+	{
+		for (j = i + 1; j < num_mics; j++)
+		{
+			for (d2 = 0.0, d = 0; d < 3; d++)
+			{
+				w = (double) pos_um[i][d] - pos_um[j][d];
+				d2 += w * w;
+			}
+			max_d2 = (d2 > max_d2) ? d2 : max_d2;
+		}
+	}
+	InstancePtr->window = (u32) (square_root(max_d2) * clk_hz / ARRAY_SOUND_UM_PER_SEC);
+	InstancePtr->window += InstancePtr->window >> WINDOW_MARGIN_SHIFT;
+	// an edge is read on the FIT tick after it happens
+	InstancePtr->window_ticks = InstancePtr->window / (clk_hz / tick_hz) + 2;
+
+	InstancePtr->open = false;
+	InstancePtr->solved = 0;
+	InstancePtr->partial = 0;
+	InstancePtr->dropped = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Groups one FIT tick's worth of edges into sound events
+*
+* @param    InstancePtr is a pointer to the array instance
+* @param	batch is the edges drained from each bank (mics 2b+1 and 2b+2 in
+*			batch[b].time_1 and batch[b].time_2)
+* @param	num_banks is the number of entries in batch
+* @param	tick is the current FIT tick
+* @param	events receives the events completed by this batch
+* @param	max_events is the size of events; further events are dropped
+*
+* @return	the number of events written to events
+*
+******************************************************************************/
+int ARRAY_AddBatch(MicArray *InstancePtr, const EdgeBatch *batch, int num_banks, u32 tick,
+		ArrayEvent *events, int max_events)
+{
+	int		next[ARRAY_MAX_MICS] = { 0 };
+	int		mics = (2 * num_banks < InstancePtr->num_mics) ? 2 * num_banks : InstancePtr->num_mics;
+	u32		all = (1u << InstancePtr->num_mics) - 1;
+	int		n_events = 0;
+	int		m, n, best;
+	u32		t, t_best;
+
+	for (;;)
+	{
+		// oldest unprocessed edge over all microphones
+		best = -1;
+		t_best = 0;
+		for (m = 0; m < mics; m++)
+		{
+			n = (m & 1) ? batch[m >> 1].n_2 : batch[m >> 1].n_1;
+			if (next[m] < n)
+			{
+				t = (m & 1) ? batch[m >> 1].time_2[next[m]] : batch[m >> 1].time_1[next[m]];
+				if ((best < 0) || ((s32) (t - t_best) < 0))
+				{
+					best = m;
+					t_best = t;
+				}
+			}
+		}
+		if (best < 0)
+		{
+			break;
+		}
+		next[best]++;
+
+		// an edge beyond the window belongs to the next event
+		if (InstancePtr->open && (t_best - InstancePtr->t0 > InstancePtr->window))
+		{
+			close_event(InstancePtr, events, &n_events, max_events);
+		}
+		if (!InstancePtr->open)
+		{
+			InstancePtr->open = true;
+			InstancePtr->t0 = t_best;
+			InstancePtr->open_tick = tick;
+			InstancePtr->mask = 0;
+		}
+
+		// the first edge of each microphone counts, later ones (echoes) do not
+		if (!(InstancePtr->mask & (1u << best)))
+		{
+			InstancePtr->t[best] = t_best;
+			InstancePtr->mask |= 1u << best;
+			InstancePtr->last = t_best;
+			if (InstancePtr->mask == all)
+			{
+				close_event(InstancePtr, events, &n_events, max_events);
+			}
+		}
+	}
+
+	// no edge can join an event once its window has been read
+	if (InstancePtr->open && (tick - InstancePtr->open_tick > InstancePtr->window_ticks))
+	{
+		close_event(InstancePtr, events, &n_events, max_events);
+	}
+	return n_events;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the direction of the source of a solved event
+*
+* @param    EventPtr is the event
+* @param	azimuth_mdeg receives the bearing in the x-y plane, in millidegrees
+*			counterclockwise from +x (-180000 to 180000)
+* @param	elevation_mdeg receives the angle above the x-y plane in millidegrees
+*			(0 unless the array was initialized with dims = 3)
+*
+* @return
+*
+*   - XST_SUCCESS if the direction was computed
+*	- XST_FAILURE if the event was not solved in at least two dimensions
+*
+* @note
+* Integer only (CORDIC), so it costs no floating point on the MicroBlaze.
+*
+******************************************************************************/
+int ARRAY_Bearing(const ArrayEvent *EventPtr, int *azimuth_mdeg, int *elevation_mdeg)
+{
+	s32 horizontal;
+
+	if (!EventPtr->solved || (EventPtr->dims < 2) || ((EventPtr->slow[0] == 0) && (EventPtr->slow[1] == 0)))
+	{
+		return XST_FAILURE;
+	}
+
+	// the source lies opposite the propagation direction
+	*azimuth_mdeg = cordic_atan2(-EventPtr->slow[1], -EventPtr->slow[0], &horizontal) / 1000;
+	*elevation_mdeg = cordic_atan2(-EventPtr->slow[2], horizontal, NULL) / 1000;
+	return XST_SUCCESS;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Ends the event in progress and reports it if it can be used
+*****************************************************************************/
+static void close_event(MicArray *InstancePtr, ArrayEvent *events, int *n_events, int max_events)
+{
+	ArrayEvent	*ev = &events[*n_events];
+	u32			all = (1u << InstancePtr->num_mics) - 1;
+	int			d;
+
+	InstancePtr->open = false;
+	if ((InstancePtr->mask & 0x3) != 0x3)
+	{
+		InstancePtr->dropped++;
+		return;
+	}
+	if (*n_events >= max_events)
+	{
+		InstancePtr->dropped++;
+		return;
+	}
+	(*n_events)++;
+
+	ev->mask = InstancePtr->mask;
+	ev->time = InstancePtr->last;
+	if (InstancePtr->mask == all)
+	{
+		solve(InstancePtr, ev);
+		InstancePtr->solved++;
+	}
+	else
+	{
+		ev->phase_diff = (s32) (InstancePtr->t[0] - InstancePtr->t[1]);
+		for (d = 0; d < ARRAY_MAX_DIMS; d++)
+		{
+			ev->slow[d] = 0;
+		}
+		ev->dims = 0;
+		ev->solved = false;
+		InstancePtr->partial++;
+	}
+}
+
+
+/****************************************************************************/
+/**
+* Least squares solution of a complete event: N multiply-adds per output
+*****************************************************************************/
+static void solve(const MicArray *InstancePtr, ArrayEvent *EventPtr)
+{
+	s32		rel[ARRAY_MAX_MICS];
+	s64		acc;
+	int		i, d;
+
+	for (i = 0; i < InstancePtr->num_mics; i++)
+	{
+		rel[i] = (s32) (InstancePtr->t[i] - InstancePtr->t0);
+	}
+
+	for (acc = 0, i = 0; i < InstancePtr->num_mics; i++)
+	{
+		acc += (s64) InstancePtr->w_proj[i] * rel[i];
+	}
+	EventPtr->phase_diff = (int) ((acc + (1 << (ARRAY_PROJ_FRAC - 1))) >> ARRAY_PROJ_FRAC);
+
+	for (d = 0; d < ARRAY_MAX_DIMS; d++)
+	{
+		if (d >= InstancePtr->dims)
+		{
+			EventPtr->slow[d] = 0;
+			continue;
+		}
+		for (acc = 0, i = 0; i < InstancePtr->num_mics; i++)
+		{
+			acc += (s64) InstancePtr->w_slow[d][i] * rel[i];
+		}
+		EventPtr->slow[d] = (s32) ((acc + (1 << (ARRAY_WEIGHT_FRAC - ARRAY_SLOW_FRAC - 1))) >>
+			(ARRAY_WEIGHT_FRAC - ARRAY_SLOW_FRAC));
+	}
+	EventPtr->dims = InstancePtr->dims;
+	EventPtr->solved = true;
+}
+
+
+/****************************************************************************/
+/**
+* Square root by Newton's method (initialization only, avoids libm)
+*****************************************************************************/
+static double square_root(double x)
+{
+	double	r = (x > 1.0) ? x : 1.0;
+	int		i;
+
+	if (x <= 0.0)
+	{
+		return 0.0;
+	}
+	for (i = 0; i < 100; i++)
+	{
+		double next = 0.5 * (r + x / r);
+
+		if (next >= r)
+		{
+			break;
+		}
+		r = next;
+	}
+	return r;
+}
+
+
+static s32 round_fixed(double x, int frac)
+{
+	x *= (double) (1 << frac);
+	return (s32) ((x >= 0.0) ? x + 0.5 : x - 0.5);
+}
+
+
+/****************************************************************************/
+/**
+* atan2(y, x) in micro degrees by CORDIC vectoring.  If magnitude is not NULL
+* it receives sqrt(x^2 + y^2).
+*****************************************************************************/
+static s32 cordic_atan2(s32 y, s32 x, s32 *magnitude)
+{
+	s32		angle = 0;
+	s32		xn;
+	int		i;
+
+	// bring the vector into the right half plane
+	if (x < 0)
+	{
+		angle = (y >= 0) ? 180000000 : -180000000;
+		x = -x;
+		y = -y;
+	}
+	for (i = 0; i < CORDIC_ITERATIONS; i++)
+	{
+		if (y > 0)
+		{
+			xn = x + (y >> i);
+			y -= x >> i;
+			angle += cordic_atan_udeg[i];
+		}
+		else
+		{
+			xn = x - (y >> i);
+			y += x >> i;
+			angle -= cordic_atan_udeg[i];
+		}
+		x = xn;
+	}
+	if (magnitude)
+	{
+		// remove the CORDIC gain (1.64676)
+		*magnitude = (s32) (((s64) x * 39797) >> 16);
+	}
+	if (angle > 180000000)
+	{
+		angle -= 360000000;
+	}
+	else if (angle < -180000000)
+	{
+		angle += 360000000;
+	}
+	return angle;
+}
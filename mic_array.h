@@ -0,0 +1,88 @@
+/**
+*
+* @file mic_array.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for mic_array.c.
+* mic_array.c generalizes the two microphone phase difference to an array of up to
+* ARRAY_MAX_MICS microphones.  Edges from all microphones are grouped into sound
+* events and each event is solved by least squares for the slowness vector of the
+* wavefront (arrival time difference per mm along x, y and z).  The solution is also
+* projected back onto the mic 1 - mic 2 baseline, so the rest of the firmware keeps
+* working with a single phase_diff that now uses every microphone.
+*
+* The pseudo-inverse of the array geometry is computed once by ARRAY_Initialize(), so
+* solving an event is a fixed-point product of a (dims x N) matrix with the N arrival
+* times: the cost grows with the number of microphones, not the number of pairs.
+*
+******************************************************************************/
+
+#ifndef MIC_ARRAY_H	/* prevent circular inclusions */
+#define MIC_ARRAY_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+#include "edge_fifo.h"
+
+/************************** Constant Definitions *****************************/
+#define ARRAY_MAX_MICS			8			// JD[7:0]
+#define ARRAY_MAX_DIMS			3
+#define ARRAY_MAX_EVENTS		8			// events returned per ARRAY_AddBatch() call
+
+#define ARRAY_SOUND_UM_PER_SEC	343000000	// speed of sound, um/sec
+#define ARRAY_PROJ_FRAC			16			// fraction bits of the projection weights
+#define ARRAY_WEIGHT_FRAC		24			// fraction bits of the slowness weights
+#define ARRAY_SLOW_FRAC			16			// fraction bits of ArrayEvent.slow
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		mask;						// microphones heard (bit m = mic m+1)
+	u32		time;						// timestamp of the last edge of the event
+	int		phase_diff;					// mic 1 - mic 2 arrival difference, clock counts
+	s32		slow[ARRAY_MAX_DIMS];		// slowness, clock counts per mm << ARRAY_SLOW_FRAC
+	int		dims;						// components of slow[] solved for
+	bool	solved;						// every microphone heard and slow[] is valid
+} ArrayEvent;
+
+typedef struct {
+	int		num_mics;
+	int		dims;						// solution dimensions: 1 (baseline), 2 (bearing), 3 (+elevation)
+	u32		window;						// longest possible event, clock counts
+	u32		window_ticks;				// ... in ARRAY_AddBatch() calls
+	s32		w_proj[ARRAY_MAX_MICS];						// baseline projection weights
+	s32		w_slow[ARRAY_MAX_DIMS][ARRAY_MAX_MICS];		// pseudo-inverse rows
+
+	// event being assembled
+	bool	open;
+	u32		t0;							// first edge of the event
+	u32		open_tick;
+	u32		mask;
+	u32		last;						// latest edge of the event
+	u32		t[ARRAY_MAX_MICS];			// first edge per microphone
+
+	// statistics
+	u32		solved;						// events heard on every microphone
+	u32		partial;					// events missing a microphone, mic 1 - mic 2 only
+	u32		dropped;					// events missing mic 1 or mic 2
+} MicArray;
+
+/************************** Function Prototypes ******************************/
+int ARRAY_Initialize(MicArray *InstancePtr, int num_mics, const s32 (*pos_um)[3], int dims,
+		u32 clk_hz, u32 tick_hz);
+int ARRAY_AddBatch(MicArray *InstancePtr, const EdgeBatch *batch, int num_banks, u32 tick,
+		ArrayEvent *events, int max_events);
+int ARRAY_Bearing(const ArrayEvent *EventPtr, int *azimuth_mdeg, int *elevation_mdeg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
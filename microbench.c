@@ -0,0 +1,467 @@
+/**
+*
+* @file microbench.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the hot path microbenchmarks.  See microbench.h.
+*
+* The trace is a single source sweeping from one end of the valid phase difference window
+* to the other and back, with jitter on every pair and a spurious unpaired edge in every
+* eighth event, the same kind of input host/replay synthesizes.  One operation is:
+*
+*	edge_pair			EDGE_Pair() over one batch of MBENCH_BATCH_EVENTS events
+*	median				MEDIAN_Update() with one phase sample
+*	track_add			TRACK_Add() with one phase sample
+*	track_update		TRACK_Add() and TRACK_Update() one phase task period later
+*	pulse_ticks			BEARING_PulseTicks(), the duty mapping in phase_task()
+*	pwm_set_params		PWM_SetParams() at the servo frequency
+*	pwm_get_params		PWM_GetParams()
+*	pwm_set_high_ticks	PWM_SetHighTicks(), the servo_task() update
+*	ring				RING_Push(), and RING_PopBatch() every MBENCH_POP_BATCH pushes
+*	stream				STREAM_Push(), and STREAM_Run() every MBENCH_POP_BATCH pushes
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "microbench.h"
+#include "pwm_tmrctr.h"
+#include "edge_fifo.h"
+#include "median_filter.h"
+#include "tracker.h"
+#include "phase_ring.h"
+#include "edge_stream.h"
+
+
+/************************** Constant Definitions *****************************/
+#define MBENCH_BATCH_EVENTS		4			// sound events per edge batch
+#define MBENCH_SPURIOUS_MASK	7			// an unpaired edge every 8th event
+#define MBENCH_POP_BATCH		16			// queue pushes per main loop drain
+#define MBENCH_SEED				0x2545F491
+
+// the phase filter and tracker settings and servo frequency of finalproject.c
+#define MBENCH_MEDIAN_WINDOW	5
+#define MBENCH_EMA_SHIFT		1
+#define MBENCH_TRACK_BINS		64
+#define MBENCH_TRACKS			3
+#define MBENCH_TRACK_PERIOD		40			// FIT ticks per phase task run
+#define MBENCH_TRACK_HALF_LIFE	40000
+#define MBENCH_SERVO_FREQ		50
+#define MBENCH_STREAM_FLUSH		4000
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	const char	*name;
+	void		(*prepare)(void);
+	u32			(*run)(u32 ops);
+} MBench;
+
+
+/************************** Function Prototypes ******************************/
+static void prepare_none(void);
+static void prepare_pair(void);
+static void prepare_median(void);
+static void prepare_track(void);
+static void prepare_ring(void);
+static void prepare_stream(void);
+static u32 run_pair(u32 ops);
+static u32 run_median(u32 ops);
+static u32 run_track_add(u32 ops);
+static u32 run_track_update(u32 ops);
+static u32 run_pulse_ticks(u32 ops);
+static u32 run_set_params(u32 ops);
+static u32 run_get_params(u32 ops);
+static u32 run_set_high_ticks(u32 ops);
+static u32 run_ring(u32 ops);
+static u32 run_stream(u32 ops);
+static void stream_put(u8 byte);
+static u32 rand_next(u32 *state);
+
+
+/************************** Variable Definitions *****************************/
+static const MBench Benchmarks[] = {
+	{ "edge_pair",			prepare_pair,	run_pair },
+	{ "median",				prepare_median,	run_median },
+	{ "track_add",			prepare_track,	run_track_add },
+	{ "track_update",		prepare_track,	run_track_update },
+	{ "pulse_ticks",		prepare_none,	run_pulse_ticks },
+	{ "pwm_set_params",		prepare_none,	run_set_params },
+	{ "pwm_get_params",		prepare_none,	run_get_params },
+	{ "pwm_set_high_ticks",	prepare_none,	run_set_high_ticks },
+	{ "ring",				prepare_ring,	run_ring },
+	{ "stream",				prepare_stream,	run_stream },
+};
+#define MBENCH_COUNT	((int) (sizeof(Benchmarks) / sizeof(Benchmarks[0])))
+
+static XTmrCtr				*Timer;			// PWM timer, initialized by PWM_Initialize()
+static const BearingTable	*Bearing;
+static s32					Window;			// largest valid phase difference
+static u32					ClkPerTick;		// capture clock counts per FIT tick
+static bool					Ready = false;
+
+// the trace
+static s32					Phase[MBENCH_TRACE_LEN];		// time_1 - time_2 of each event
+static u32					PulseTicks[MBENCH_TRACE_LEN];	// servo pulse width for each event
+static EdgeBatch			Batch[MBENCH_BATCHES];
+
+// state the benchmarks work on
+static EdgePairer			Pairer;
+static MedianFilter			Median;
+static Tracker				Tracks;
+static PhaseRing			Ring;
+static EdgeStream			Stream;
+static u32					Tick;
+static u32					StreamSink;
+
+
+/*****************************************************************************/
+/**
+* Builds the trace
+*
+* @param    TimerPtr is the PWM timer, initialized with PWM_Initialize() and not started
+* @param	BearingPtr is the phase difference to pulse width table
+* @param	window is the largest valid phase difference, in capture clock counts
+* @param	clk_per_tick is the capture clock counts per FIT tick
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_INVALID_PARAM if a parameter is out of range
+*
+******************************************************************************/
+int MBENCH_Initialize(XTmrCtr *TimerPtr, const BearingTable *BearingPtr, s32 window, u32 clk_per_tick)
+{
+	u32 rng = MBENCH_SEED;
+	u32 t, time_1, time_2;
+	s32 sweep, jitter;
+	int i, b, e;
+	EdgeBatch *bp;
+
+	if ((TimerPtr == NULL) || (BearingPtr == NULL) || (window < 64) || (clk_per_tick == 0))
+	{
+		return XST_INVALID_PARAM;
+	}
+	Timer = TimerPtr;
+	Bearing = BearingPtr;
+	Window = window;
+	ClkPerTick = clk_per_tick;
+
+	// sweep +/- 7/8 of the window and back over the trace, jitter +/- 1/64 of the window
+	for (i = 0; i < MBENCH_TRACE_LEN; i++)
+	{
+		sweep = (s32) ((s64) window * 7 / 8 * (4 * i - MBENCH_TRACE_LEN) / MBENCH_TRACE_LEN);
+		sweep = (i < MBENCH_TRACE_LEN / 2) ? sweep : (window * 7 / 4 - sweep);
+		jitter = (s32) (rand_next(&rng) % (u32) (window / 32)) - window / 64;
+		Phase[i] = sweep + jitter;
+		PulseTicks[i] = BEARING_PulseTicks(BearingPtr, Phase[i]);
+	}
+
+	// events 4 windows apart, so a spurious edge 2.5 windows after one is never paired
+	t = 0;
+	for (b = 0; b < MBENCH_BATCHES; b++)
+	{
+		bp = &Batch[b];
+		bp->n_1 = 0;
+		bp->n_2 = 0;
+		for (e = 0; e < MBENCH_BATCH_EVENTS; e++)
+		{
+			i = (b * MBENCH_BATCH_EVENTS + e) & MBENCH_TRACE_MASK;
+			time_1 = t + (u32) (window + Phase[i] / 2);
+			time_2 = time_1 - (u32) Phase[i];
+			bp->time_1[bp->n_1++] = time_1;
+			bp->time_2[bp->n_2++] = time_2;
+			if ((i & MBENCH_SPURIOUS_MASK) == MBENCH_SPURIOUS_MASK)
+			{
+				if (i & (MBENCH_SPURIOUS_MASK + 1))
+				{
+					bp->time_1[bp->n_1++] = t + (u32) (window * 5 / 2);
+				}
+				else
+				{
+					bp->time_2[bp->n_2++] = t + (u32) (window * 5 / 2);
+				}
+			}
+			t += (u32) (4 * window);
+		}
+	}
+
+	Ready = true;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the number of benchmarks
+******************************************************************************/
+int MBENCH_Count(void)
+{
+	return MBENCH_COUNT;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns the name of benchmark index, or NULL if there is no such benchmark
+******************************************************************************/
+const char *MBENCH_Name(int index)
+{
+	return ((index >= 0) && (index < MBENCH_COUNT)) ? Benchmarks[index].name : NULL;
+}
+
+
+/*****************************************************************************/
+/**
+* Resets the state benchmark index works on.  Call before every timed MBENCH_Run().
+*
+* @param	index is the benchmark
+*
+* @return
+*
+*   - XST_SUCCESS if the benchmark is ready to run
+*   - XST_INVALID_PARAM if there is no such benchmark
+*   - XST_FAILURE if MBENCH_Initialize() has not succeeded
+*
+******************************************************************************/
+int MBENCH_Prepare(int index)
+{
+	if ((index < 0) || (index >= MBENCH_COUNT))
+	{
+		return XST_INVALID_PARAM;
+	}
+	if (!Ready)
+	{
+		return XST_FAILURE;
+	}
+	Tick = 0;
+	Benchmarks[index].prepare();
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Runs ops operations of benchmark index
+*
+* @param	index is the benchmark, prepared with MBENCH_Prepare()
+* @param	ops is the number of operations
+*
+* @return	a checksum of the results, for the harness to keep so the work is not optimized away
+*
+******************************************************************************/
+u32 MBENCH_Run(int index, u32 ops)
+{
+	if ((index < 0) || (index >= MBENCH_COUNT) || !Ready)
+	{
+		return 0;
+	}
+	return Benchmarks[index].run(ops);
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Benchmark set up
+*****************************************************************************/
+static void prepare_none(void)
+{
+}
+
+static void prepare_pair(void)
+{
+	EDGE_PairerInitialize(&Pairer, (u32) Window);
+}
+
+static void prepare_median(void)
+{
+	MEDIAN_Initialize(&Median, MBENCH_MEDIAN_WINDOW, MBENCH_EMA_SHIFT);
+}
+
+static void prepare_track(void)
+{
+	int i;
+
+	// start with the sweep already being tracked
+	TRACK_Initialize(&Tracks, MBENCH_TRACK_BINS, Window, MBENCH_TRACKS, TRACK_SELECT_STRONGEST,
+		MBENCH_TRACK_PERIOD, MBENCH_TRACK_HALF_LIFE);
+	for (i = 0; i < MBENCH_TRACE_LEN; i++)
+	{
+		Tick += MBENCH_TRACK_PERIOD;
+		TRACK_Add(&Tracks, Phase[i], Tick);
+		TRACK_Update(&Tracks, Tick);
+	}
+}
+
+static void prepare_ring(void)
+{
+	RING_Initialize(&Ring);
+}
+
+static void prepare_stream(void)
+{
+	STREAM_Initialize(&Stream, stream_put, ClkPerTick, MBENCH_STREAM_FLUSH, STREAM_TX_SIZE);
+	StreamSink = 0;
+}
+
+
+/****************************************************************************/
+/**
+* Benchmark bodies
+*****************************************************************************/
+static u32 run_pair(u32 ops)
+{
+	EdgePair pairs[EDGE_MAX_PAIRS];
+	u32 sum = 0, op;
+	int n;
+
+	for (op = 0; op < ops; op++)
+	{
+		n = EDGE_Pair(&Pairer, &Batch[op & MBENCH_BATCH_MASK], pairs);
+		sum += (u32) n + ((n > 0) ? pairs[n - 1].time_1 - pairs[n - 1].time_2 : 0);
+	}
+	return sum;
+}
+
+static u32 run_median(u32 ops)
+{
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		sum += (u32) MEDIAN_Update(&Median, Phase[op & MBENCH_TRACE_MASK]);
+	}
+	return sum;
+}
+
+static u32 run_track_add(u32 ops)
+{
+	u32 op;
+
+	for (op = 0; op < ops; op++)
+	{
+		TRACK_Add(&Tracks, Phase[op & MBENCH_TRACE_MASK], Tick);
+	}
+	return Tracks.bins[MBENCH_TRACK_BINS / 2];
+}
+
+static u32 run_track_update(u32 ops)
+{
+	const Track *track;
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		Tick += MBENCH_TRACK_PERIOD;
+		TRACK_Add(&Tracks, Phase[op & MBENCH_TRACE_MASK], Tick);
+		track = TRACK_Update(&Tracks, Tick);
+		sum += (track != NULL) ? (u32) track->phase_diff : 0;
+	}
+	return sum;
+}
+
+static u32 run_pulse_ticks(u32 ops)
+{
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		sum += BEARING_PulseTicks(Bearing, Phase[op & MBENCH_TRACE_MASK]);
+	}
+	return sum;
+}
+
+static u32 run_set_params(u32 ops)
+{
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		sum += (u32) PWM_SetParams(Timer, MBENCH_SERVO_FREQ, 5 + (op & 3));
+	}
+	return sum;
+}
+
+static u32 run_get_params(u32 ops)
+{
+	u32 sum = 0, op, freq, duty;
+
+	for (op = 0; op < ops; op++)
+	{
+		PWM_GetParams(Timer, &freq, &duty);
+		sum += freq + duty;
+	}
+	return sum;
+}
+
+static u32 run_set_high_ticks(u32 ops)
+{
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		sum += (u32) PWM_SetHighTicks(Timer, PulseTicks[op & MBENCH_TRACE_MASK]);
+	}
+	return sum;
+}
+
+static u32 run_ring(u32 ops)
+{
+	PhaseSample samples[MBENCH_POP_BATCH];
+	u32 sum = 0, op;
+
+	for (op = 0; op < ops; op++)
+	{
+		RING_Push(&Ring, op, Phase[op & MBENCH_TRACE_MASK]);
+		if ((op % MBENCH_POP_BATCH) == MBENCH_POP_BATCH - 1)
+		{
+			sum += (u32) RING_PopBatch(&Ring, samples, MBENCH_POP_BATCH);
+		}
+	}
+	return sum;
+}
+
+static u32 run_stream(u32 ops)
+{
+	u32 op, time_1;
+
+	// one pair a FIT tick
+	for (op = 0; op < ops; op++)
+	{
+		Tick++;
+		time_1 = Tick * ClkPerTick + (u32) Window;
+		STREAM_Push(&Stream, Tick, time_1, time_1 - (u32) Phase[op & MBENCH_TRACE_MASK]);
+		if ((op % MBENCH_POP_BATCH) == MBENCH_POP_BATCH - 1)
+		{
+			STREAM_Run(&Stream, Tick);
+		}
+	}
+	return StreamSink + Stream.pairs_sent;
+}
+
+
+/****************************************************************************/
+/**
+* stream output - the bytes are only folded into a checksum
+*****************************************************************************/
+static void stream_put(u8 byte)
+{
+	StreamSink = (StreamSink << 1) ^ byte;
+}
+
+
+/****************************************************************************/
+/**
+* xorshift32 pseudo-random number generator
+*****************************************************************************/
+static u32 rand_next(u32 *state)
+{
+	u32 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
@@ -0,0 +1,59 @@
+/**
+*
+* @file microbench.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for microbench.c.
+* microbench.c runs the localization hot paths - edge pairing, the phase filter, the
+* tracker, the phase difference to pulse width mapping, the PWM driver updates and the
+* ISR to main loop queues - over a representative edge trace, so their cost per
+* operation can be measured the same way on the host (host/microbench) and on the
+* MicroBlaze (finalproject.c built with MICROBENCH).
+*
+* The benchmarks only do the work.  The harness times MBENCH_Run() with whatever clock
+* it has and reports the result as a line of key=value fields:
+*
+*	MBENCH name=<benchmark> ops=<operations> ...
+*
+* MBENCH_Prepare() builds the trace and resets the state a benchmark works on, so every
+* run of it does the same work.  All data is static: nothing is allocated.
+*
+******************************************************************************/
+
+#ifndef MICROBENCH_H	/* prevent circular inclusions */
+#define MICROBENCH_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xtmrctr.h"
+#include "bearing.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef MBENCH_TRACE_LEN
+#define MBENCH_TRACE_LEN		256			// sound events in the trace, must be a power of 2
+#endif
+#define MBENCH_TRACE_MASK		(MBENCH_TRACE_LEN - 1)
+#ifndef MBENCH_BATCHES
+#define MBENCH_BATCHES			32			// edge batches in the trace, must be a power of 2
+#endif
+#define MBENCH_BATCH_MASK		(MBENCH_BATCHES - 1)
+
+/************************** Function Prototypes ******************************/
+int  MBENCH_Initialize(XTmrCtr *TimerPtr, const BearingTable *BearingPtr, s32 window, u32 clk_per_tick);
+int  MBENCH_Count(void);
+const char *MBENCH_Name(int index);
+int  MBENCH_Prepare(int index);
+u32  MBENCH_Run(int index, u32 ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
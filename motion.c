@@ -0,0 +1,257 @@
+/**
+*
+* @file motion.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the servo motion planner.  Each measurement (the pulse width that
+* points at the source, and the FIT tick it was measured on) updates an alpha-beta
+* estimate of the source position and velocity:
+*
+*	predicted = pos + vel * dt
+*	pos = predicted + alpha * (measured - predicted)
+*	vel = vel + beta * (measured - predicted) / dt
+*
+* A residual larger than the reset threshold (the tracker switched sources) or a
+* measurement after more than the hold time without one restarts the estimate at the
+* measurement with no velocity.  Each step extrapolates the estimate to lead ticks after
+* the step, for at most the hold time past the last measurement so a source that goes
+* quiet is not chased off the end of the range, and moves the setpoint toward it.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <stdlib.h>
+
+#include "motion.h"
+
+
+/************************** Function Prototypes ******************************/
+static void restart(MotionPlanner *InstancePtr, u32 ticks, u32 tick);
+
+
+/*****************************************************************************/
+/**
+* Initializes the motion planner
+*
+* The filter and profile start as a plain follower: the setpoint jumps to each measurement
+* (alpha 1, beta 0, no slew limit, no deadband, no lead).  Set them with MOTION_SetFilter()
+* and MOTION_SetProfile().
+*
+* @param    InstancePtr is a pointer to the MotionPlanner instance
+* @param	setpoint is the pulse width the servo is at now, in PWM timer ticks
+* @param	min is the shortest pulse width to command
+* @param	max is the longest pulse width to command
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_INVALID_PARAM if setpoint is not within [min, max] or max is too large
+*
+******************************************************************************/
+int MOTION_Initialize(MotionPlanner *InstancePtr, u32 setpoint, u32 min, u32 max)
+{
+	if ((min > max) || (setpoint < min) || (setpoint > max) || (max > (0x7FFFFFFF >> MOTION_POS_FRAC)))
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->alpha = MOTION_GAIN_ONE;
+	InstancePtr->beta = 0;
+	InstancePtr->hold = 0;
+	InstancePtr->reset = max - min;
+	InstancePtr->slew = max - min;
+	InstancePtr->deadband = 0;
+	InstancePtr->lead = 0;
+	InstancePtr->min = min;
+	InstancePtr->max = max;
+	InstancePtr->have = false;
+	InstancePtr->pos = 0;
+	InstancePtr->vel = 0;
+	InstancePtr->tick = 0;
+	InstancePtr->setpoint = setpoint;
+	InstancePtr->measurements = 0;
+	InstancePtr->resets = 0;
+	InstancePtr->steps = 0;
+	InstancePtr->writes = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Sets the estimator gains
+*
+* alpha near 1 follows the measurements closely, smaller values average their noise.
+* beta sets how quickly the velocity follows a change in speed; beta = 0 is a plain
+* exponential smoother.  For a critically damped filter beta is about alpha^2 / (2 - alpha).
+*
+* @param    InstancePtr is a pointer to the MotionPlanner instance
+* @param	alpha is the position gain, MOTION_GAIN_ONE = 1.0
+* @param	beta is the velocity gain, MOTION_GAIN_ONE = 1.0
+* @param	hold is the longest time to extrapolate past the last measurement, FIT ticks
+* @param	reset is the residual that restarts the estimate, in PWM timer ticks
+*
+* @return
+*
+*   - XST_SUCCESS if the gains were set
+*   - XST_INVALID_PARAM if alpha is not in (0, 1] or beta is not in [0, 1]
+*
+******************************************************************************/
+int MOTION_SetFilter(MotionPlanner *InstancePtr, s32 alpha, s32 beta, u32 hold, u32 reset)
+{
+	if ((alpha <= 0) || (alpha > MOTION_GAIN_ONE) || (beta < 0) || (beta > MOTION_GAIN_ONE))
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->alpha = alpha;
+	InstancePtr->beta = beta;
+	InstancePtr->hold = hold;
+	InstancePtr->reset = reset;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Sets the motion profile
+*
+* @param    InstancePtr is a pointer to the MotionPlanner instance
+* @param	slew is the largest setpoint change per step, in PWM timer ticks
+* @param	deadband is the smallest setpoint change worth writing, in PWM timer ticks
+* @param	lead is how far past the step to aim, in FIT ticks - the time until the
+*			pulse width takes effect plus the delay of the measurements
+*
+* @return
+*
+*   - XST_SUCCESS if the profile was set
+*   - XST_INVALID_PARAM if slew is 0
+*
+******************************************************************************/
+int MOTION_SetProfile(MotionPlanner *InstancePtr, u32 slew, u32 deadband, u32 lead)
+{
+	if (slew == 0)
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->slew = slew;
+	InstancePtr->deadband = deadband;
+	InstancePtr->lead = lead;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Adds a measurement
+*
+* Measurements must come in tick order; one that is older than the estimate is taken as
+* if it were measured on the estimate's tick.
+*
+* @param    InstancePtr is a pointer to the MotionPlanner instance
+* @param	ticks is the pulse width that points at the source, in PWM timer ticks
+* @param	tick is the FIT tick it was measured on
+*
+******************************************************************************/
+void MOTION_Measure(MotionPlanner *InstancePtr, u32 ticks, u32 tick)
+{
+	s32	dt, residual;
+	s64	predicted;
+
+	InstancePtr->measurements++;
+	dt = (s32) (tick - InstancePtr->tick);
+	dt = (dt < 0) ? 0 : dt;
+	if (!InstancePtr->have || ((u32) dt > InstancePtr->hold))
+	{
+		restart(InstancePtr, ticks, tick);
+		return;
+	}
+
+	predicted = InstancePtr->pos +
+		(((s64) InstancePtr->vel * dt) >> (MOTION_VEL_FRAC - MOTION_POS_FRAC));
+	residual = (s32) (((s64) ticks << MOTION_POS_FRAC) - predicted);
+	if ((u32) abs(residual >> MOTION_POS_FRAC) > InstancePtr->reset)
+	{
+		restart(InstancePtr, ticks, tick);
+		return;
+	}
+
+	InstancePtr->pos = (s32) (predicted + (((s64) InstancePtr->alpha * residual) >> 16));
+	if (dt > 0)
+	{
+		// beta is Q16, the residual Q(POS_FRAC) and the velocity Q(VEL_FRAC)
+		InstancePtr->vel += (s32) ((((s64) InstancePtr->beta * residual) >>
+			(16 + MOTION_POS_FRAC - MOTION_VEL_FRAC)) / dt);
+	}
+	InstancePtr->tick = tick;
+}
+
+
+/*****************************************************************************/
+/**
+* Plans the next setpoint
+*
+* Call once per PWM period, just after the period starts, and write the setpoint with
+* PWM_SetHighTicks() if one is returned: it takes effect at the start of the next period.
+*
+* @param    InstancePtr is a pointer to the MotionPlanner instance
+* @param	tick is the current FIT tick
+* @param	setpoint receives the new setpoint, in PWM timer ticks
+*
+* @return	true if the setpoint moved, false if there is no estimate yet or the planned
+*			setpoint is within the deadband of the last one
+*
+******************************************************************************/
+bool MOTION_Step(MotionPlanner *InstancePtr, u32 tick, u32 *setpoint)
+{
+	u32	ahead;
+	s64	target;
+	s32	step;
+
+	if (!InstancePtr->have)
+	{
+		return false;
+	}
+	InstancePtr->steps++;
+
+	// extrapolate to the time the pulse goes out, but not far past the last measurement
+	ahead = tick - InstancePtr->tick;
+	ahead = ((s32) ahead < 0) ? 0 : ahead;
+	ahead = (ahead > InstancePtr->hold) ? InstancePtr->hold : ahead;
+	ahead += InstancePtr->lead;
+	target = (InstancePtr->pos +
+		(((s64) InstancePtr->vel * ahead) >> (MOTION_VEL_FRAC - MOTION_POS_FRAC))) >> MOTION_POS_FRAC;
+	target = (target < InstancePtr->min) ? InstancePtr->min : target;
+	target = (target > InstancePtr->max) ? InstancePtr->max : target;
+
+	// move toward it no faster than the slew limit, and not at all for a small change
+	step = (s32) (target - InstancePtr->setpoint);
+	if ((step == 0) || ((u32) abs(step) < InstancePtr->deadband))
+	{
+		return false;
+	}
+	step = (step > (s32) InstancePtr->slew) ? (s32) InstancePtr->slew : step;
+	step = (step < -(s32) InstancePtr->slew) ? -(s32) InstancePtr->slew : step;
+	InstancePtr->setpoint += step;
+	InstancePtr->writes++;
+	*setpoint = InstancePtr->setpoint;
+	return true;
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Starts the estimate over at a measurement, with no velocity
+*****************************************************************************/
+static void restart(MotionPlanner *InstancePtr, u32 ticks, u32 tick)
+{
+	if (InstancePtr->have)
+	{
+		InstancePtr->resets++;
+	}
+	InstancePtr->have = true;
+	InstancePtr->pos = (s32) (ticks << MOTION_POS_FRAC);
+	InstancePtr->vel = 0;
+	InstancePtr->tick = tick;
+}
@@ -0,0 +1,77 @@
+/**
+*
+* @file motion.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for motion.c.
+* motion.c plans the servo motion between phase samples.  The pulse widths that point at
+* the source are measurements for an alpha-beta filter, which estimates where the source
+* is and how fast it moves.  Once per PWM period MOTION_Step() predicts where it will be
+* when the next pulse goes out and moves the setpoint toward it by at most the slew limit,
+* so the servo follows a moving source instead of lagging a step behind it, and takes a
+* large jump as a ramp instead of a step it would overshoot.  Changes smaller than the
+* deadband are not written.
+*
+* All quantities are in PWM timer ticks (pulse width) and FIT ticks (time), in integer
+* arithmetic.  The position estimate has MOTION_POS_FRAC fraction bits, the velocity
+* MOTION_VEL_FRAC.
+*
+******************************************************************************/
+
+#ifndef MOTION_H	/* prevent circular inclusions */
+#define MOTION_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#define MOTION_GAIN_ONE			(1 << 16)	// alpha and beta of 1.0
+#define MOTION_POS_FRAC			8			// fraction bits of the position estimate
+#define MOTION_VEL_FRAC			16			// fraction bits of the velocity estimate
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	// filter
+	s32		alpha;				// position gain, MOTION_GAIN_ONE = 1.0
+	s32		beta;				// velocity gain, MOTION_GAIN_ONE = 1.0
+	u32		hold;				// longest extrapolation past the last measurement, FIT ticks
+	u32		reset;				// a residual this large is a new source, PWM ticks
+	// profile
+	u32		slew;				// largest setpoint change per step, PWM ticks
+	u32		deadband;			// smallest setpoint change written, PWM ticks
+	u32		lead;				// how far ahead of the step to aim, FIT ticks
+	u32		min;				// setpoint limits, PWM ticks
+	u32		max;
+	// state
+	bool	have;				// there is an estimate
+	s32		pos;				// position estimate at tick, PWM ticks << MOTION_POS_FRAC
+	s32		vel;				// velocity estimate, PWM ticks per FIT tick << MOTION_VEL_FRAC
+	u32		tick;				// FIT tick of the estimate
+	u32		setpoint;			// last setpoint, PWM ticks
+	// statistics
+	u32		measurements;
+	u32		resets;				// estimates restarted (new source or stale estimate)
+	u32		steps;				// MOTION_Step() calls with an estimate
+	u32		writes;				// steps that moved the setpoint
+} MotionPlanner;
+
+/************************** Function Prototypes ******************************/
+int  MOTION_Initialize(MotionPlanner *InstancePtr, u32 setpoint, u32 min, u32 max);
+int  MOTION_SetFilter(MotionPlanner *InstancePtr, s32 alpha, s32 beta, u32 hold, u32 reset);
+int  MOTION_SetProfile(MotionPlanner *InstancePtr, u32 slew, u32 deadband, u32 lead);
+void MOTION_Measure(MotionPlanner *InstancePtr, u32 ticks, u32 tick);
+bool MOTION_Step(MotionPlanner *InstancePtr, u32 tick, u32 *setpoint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -10,19 +10,63 @@
 // Description:
 // ------------
 // This module provides the top level for the final project hardware.
-// The module assumes that the two amplified microphone signals come from
-// JD[0] and JD[1]; and the pwm output to the servo is at JC[0].
+// The module assumes that the NUM_MICS amplified microphone signals come from
+// JD[0] upward (mic 1 on JD[0], mic 2 on JD[1], ...); and the pwm output to the
+// servo is at JC[0].  A pair of PDM microphones (PDM_Frontend) has its data on
+// JD[4] (mic 1) and JD[5] (mic 2) and its clock on JC[1].
 //
 // It creates an instance of Phase_Detection outside of the system EMBSYS which
-// reads from the microphone inputs and outputs 2 time stamps of the rising edges
+// reads from the microphone inputs and outputs the time stamps of the rising edges
 // of the signals, which are then used to calculate the phase difference and
-// direction.
+// direction.  The time stamps are queued in Phase_Detection, one bank of two
+// microphones per GPIO pair: GPIO 1 reads the mic 1/2 FIFO heads and GPIO 2
+// carries their queue status in (channel 1) and the pop toggles out (channel 2).
+// GPIO 4 and 5 do the same for mics 3/4.  GPIO 3 reads the Phase_Detection
+// timestamp counter for firmware latency tracing.  NUM_MICS defaults to 2, to
+// match the firmware default (PHASE_NUM_MICS 2 does not drain mics 3/4, and their
+// FIFOs would otherwise fill and keep interrupting); set NUM_MICS = 4 for a build
+// with PHASE_NUM_MICS 4, when GPIO 4 and 5 read zeros no longer.  More microphones
+// (up to JD[3], the PDM microphones have JD[4] and JD[5]) need another GPIO pair
+// in the block design per bank.
+// GPIO 9 reads the last mic 1/2 pair Phase_Detection latched (channel 1 the mic 1
+// timestamp, channel 2 the difference, valid flag and sequence number), so firmware
+// built with PHASE_PAIR_LATCH reads one word per interrupt when nothing is new.
+// Phase_Detection's capture_irq goes to the axi_intc (input 2, rising edge, with
+// input synchronizers) so the firmware drains the FIFOs only when an edge pair is
+// ready instead of on every FIT tick.  Its wake_irq (axi_intc input 4, rising
+// edge, with input synchronizers) fires when the timestamp counter reaches the
+// time last written to its WAKE register, so a firmware that sleeps between its
+// tasks (TICKLESS_IDLE) can mask the FIT and still wake for the next one.
+// With TIME_FRAC_BITS set Phase_Detection timestamps the edges between clk2 edges
+// as well (on both edges of clk2, and of clk2_90, clk2 delayed by a quarter period,
+// from the clock wizard), so every timestamp and the counter on GPIO 3 carry that
+// many fraction bits; the firmware must be built with the same PHASE_TIME_FRAC_BITS.
+//
+// Servo_Pipeline pairs the mic 1 and mic 2 edges in the fabric and generates the
+// servo PWM itself, so the servo follows a sound within a few clk2 cycles whatever
+// the processor is doing.  The processor configures it through GPIO 6 (register data
+// on channel 1, address and write toggle on channel 2) and supervises it through
+// GPIO 7 (last phase difference on channel 1, status on channel 2).  When it is
+// enabled its PWM replaces the axi_timer PWM on JC[0].
+//
+// The GPIO 6 register port is shared: addresses 8 to 15 go to Phase_Detection's edge
+// filters (glitch filter, holdoff and onset mode).  Both modules synchronize the same
+// write toggle the same way, so Servo_Pipeline's acknowledge on GPIO 7 covers both.
+//
+// PDM_Frontend decimates the PDM microphones to 48.8 kHz PCM and writes it in
+// frames to a double buffered block RAM.  The processor reads a frame through GPIO 8
+// (sample or status on channel 1, select and release toggle on channel 2) when
+// frame_irq (axi_intc input 3, rising edge, with input synchronizers) says one is
+// ready, and runs GCC-PHAT over it.
 //
 // Most of this module is the same as n4fpga.v provided for Getting Started, 
 // with the main changes being the instance of Phase_Detection (at the bottom) 
 // and a few wires to make the GPIO connections.
 /******************************************************/
-module n4fpga(
+module n4fpga
+	#(parameter TIME_FRAC_BITS = 0,		// sub-clock timestamp bits (PHASE_TIME_FRAC_BITS in finalproject.c)
+	parameter NUM_MICS = 2)				// microphones, 2 or 4 (PHASE_NUM_MICS in finalproject.c)
+	(
     input				clk,			// 100Mhz clock input
     input				btnC,			// center pushbutton
     input				btnU,			// UP (North) pusbhbutton
@@ -72,8 +116,8 @@ wire            pwm_out;                // PWM output from the axi_timer
 // your hardware pulse-width detect logic with the Microblaze.  Our application
 // is simple.
 
-// The FIT interrupt routine synthesizes a 20KHz signal and makes it
-// available on GPIO2[0].  Bring it to the top level as an
+// The FIT interrupt routine synthesizes a 500Hz signal (20KHz when the firmware polls
+// the edge FIFOs) and makes it available on GPIO2[0].  Bring it to the top level as an
 // indicator that the system is running...could be handy for debug
 wire            clk_20khz;
 assign clk_20khz = gpio_out[0];
@@ -87,14 +131,46 @@ the GPIO 1 system inputs.
 
 // Signals for final project
 wire    clk2;
-wire    [31:0] time_1;  // Timestamp of signal 1's posedge
-wire    [31:0] time_2;  // Timestamp of signal 2's posedge
-wire    signal_1, signal_2;  // Input pulses from mic amplifier
+wire    clk2_90;                         // clk2 a quarter period later, for TIME_FRAC_BITS = 2
+wire    [NUM_MICS-1:0] signal;           // Input pulses from mic amplifiers
+wire    [32*NUM_MICS-1:0] timestamps;    // Timestamp of each signal's posedge, 32 bits per mic
+wire    [32*(NUM_MICS/2)-1:0] fifo_status; // Timestamp FIFO occupancy/ack/overflow, 32 bits per bank
+wire    [NUM_MICS-1:0] fifo_pop;         // Timestamp FIFO pop toggles from GPIO 2 (mics 1/2) and 5 (3/4)
+wire    [32*(NUM_MICS/2)-1:0] pair_time; // Last pair latched per bank: mic 1 timestamp
+wire    [32*(NUM_MICS/2)-1:0] pair_info; // and difference/valid/sequence, mics 1/2 on GPIO 9
+wire    [127:0] gpio_times;              // timestamps for GPIO 1 and 4, zero past NUM_MICS
+wire    [63:0] gpio_status;              // fifo_status for GPIO 2 and 5, zero past NUM_MICS
+wire    [3:0] gpio_pop;                  // pop toggles from GPIO 2 and 5, unused past NUM_MICS
+wire    [31:0] clk2_count;   // Phase_Detection timestamp counter, read by GPIO 3
+wire    [NUM_MICS-1:0] edges;            // captured edge strobes from Phase_Detection
+wire    [32*NUM_MICS-1:0] edge_times;    // and their timestamps
+wire    edge_cfg_ack;                    // edge filter register write acknowledge (same as servo_ack)
+wire    capture_irq;                     // edge pair ready, to the axi_intc
+wire    wake_irq;                        // WAKE time reached, to the axi_intc
+
+// Fabric servo pipeline
+wire    [31:0] servo_data;               // register write data (GPIO 6 channel 1)
+wire    [7:0] servo_ctl;                 // [3:0] register, [7] write toggle (GPIO 6 channel 2)
+wire    [31:0] servo_phase;              // last paired phase difference (GPIO 7 channel 1)
+wire    [31:0] servo_status;             // [0] enabled, [7] write ack, [31:16] pairs (GPIO 7 channel 2)
+wire    [15:0] servo_pairs;
+wire    servo_enabled, servo_ack, servo_pwm;
+
+// PDM microphone front end
+wire    pdm_clk;                         // PDM microphone clock (JC[1])
+wire    [1:0] pdm_data;                  // PDM microphone data (JD[4], JD[5])
+wire    [31:0] pdm_rd_data;              // frame sample or status (GPIO 8 channel 1)
+wire    [15:0] pdm_ctl;                  // [11:0] sample, [14] status, [15] release toggle (GPIO 8 channel 2)
+wire    pdm_irq;                         // frame ready, to the axi_intc
 
 // make the connections
-assign signal_2 = JD[1];
-assign signal_1 = JD[0];
-assign JC = {7'b0, pwm_out};
+assign signal = JD[NUM_MICS-1:0];
+assign gpio_times = timestamps;         // zero extended when mics 3/4 are not built
+assign gpio_status = fifo_status;
+assign fifo_pop = gpio_pop[NUM_MICS-1:0];
+assign pdm_data = JD[5:4];
+assign JC = {6'b0, pdm_clk, servo_enabled ? servo_pwm : pwm_out};
+assign servo_status = {servo_pairs, 8'b0, servo_ack, 6'b0, servo_enabled};
 
 // system-wide signals
 assign sysclk = clk;
@@ -138,16 +214,71 @@ system EMBSYS
 
         // These are the added signals for final project hardware solution
         .clk2(clk2),
-        .time_1_tri_i(time_1),
-        .time_2_tri_i(time_2));
+        .clk2_90(clk2_90),
+        .time_1_tri_i(gpio_times[31:0]),
+        .time_2_tri_i(gpio_times[63:32]),
+        .fifo_status_tri_i(gpio_status[31:0]),
+        .fifo_pop_tri_o(gpio_pop[1:0]),
+        .clk2_count_tri_i(clk2_count),
+        .time_3_tri_i(gpio_times[95:64]),
+        .time_4_tri_i(gpio_times[127:96]),
+        .fifo_status_2_tri_i(gpio_status[63:32]),
+        .fifo_pop_2_tri_o(gpio_pop[3:2]),
+        .pair_time_tri_i(pair_time[31:0]),
+        .pair_info_tri_i(pair_info[31:0]),
+        .servo_data_tri_o(servo_data),
+        .servo_ctl_tri_o(servo_ctl),
+        .servo_phase_tri_i(servo_phase),
+        .servo_status_tri_i(servo_status),
+        .capture_irq(capture_irq),
+        .wake_irq(wake_irq),
+        .pdm_data_tri_i(pdm_rd_data),
+        .pdm_ctl_tri_o(pdm_ctl),
+        .pdm_irq(pdm_irq));
 
 // Instance of hardware phase detection module
-Phase_Detection Hardware_detect
-    (.signal_1(signal_1), 
-    .signal_2(signal_2), 
+Phase_Detection #(.NUM_MICS(NUM_MICS), .PAIR_WINDOW(25000 << TIME_FRAC_BITS), .FRAC_BITS(TIME_FRAC_BITS))
+    Hardware_detect
+    (.signal(signal),
     .clock(clk2), 
-    .time_1(time_1),
-    .time_2(time_2));
+    .clock_90(clk2_90),
+    .pop(fifo_pop),
+    .timestamps(timestamps),
+    .fifo_status(fifo_status),
+    .pair_time(pair_time),
+    .pair_info(pair_info),
+    .now(clk2_count),
+    .edges(edges),
+    .edge_times(edge_times),
+    .capture_irq(capture_irq),
+    .wake_irq(wake_irq),
+    .cfg_toggle(servo_ctl[7]),
+    .cfg_addr(servo_ctl[3:0]),
+    .cfg_data(servo_data),
+    .cfg_ack(edge_cfg_ack));
+
+// Instance of the fabric TDOA to servo pipeline (mic 1 and mic 2)
+Servo_Pipeline #(.TIME_FRAC_BITS(TIME_FRAC_BITS)) Servo_pipe
+    (.clock(clk2),
+    .edges(edges[1:0]),
+    .times(edge_times[63:0]),
+    .wr_toggle(servo_ctl[7]),
+    .wr_addr(servo_ctl[3:0]),
+    .wr_data(servo_data),
+    .wr_ack(servo_ack),
+    .enabled(servo_enabled),
+    .pairs(servo_pairs),
+    .phase_diff(servo_phase),
+    .pwm(servo_pwm));
+
+// Instance of the PDM microphone front end (PCM frames for GCC-PHAT)
+PDM_Frontend PDM_mics
+    (.clock(clk2),
+    .pdm_clk(pdm_clk),
+    .pdm_data(pdm_data),
+    .rd_ctl(pdm_ctl),
+    .rd_data(pdm_rd_data),
+    .frame_irq(pdm_irq));
 
 endmodule
 
@@ -0,0 +1,176 @@
+/**
+*
+* @file pdm_frontend.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the driver for PDM_Frontend, the PDM microphone front end.  The
+* hardware selects a word from the select written on GPIO 8 channel 2 and returns it on
+* channel 1 a few clocks later, across the clock domain crossing.  A read right after the
+* write can still see the previous word, so every read selects, reads once to let the word
+* settle and keeps the second read.  A frame is released by flipping the release toggle;
+* the hardware echoes it in the status word once the frame is free.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "pdm_frontend.h"
+
+
+/************************** Function Prototypes ******************************/
+static u32 pdm_read(PdmFrontend *InstancePtr, u32 select);
+static int pdm_release(PdmFrontend *InstancePtr);
+
+
+/*****************************************************************************/
+/**
+* Initializes the PDM front end driver
+*
+* A frame that is already waiting is left for the first PDM_ReadFrame().
+*
+* @param    InstancePtr is a pointer to the PdmFrontend instance
+* @param	DeviceId is the device id of the GPIO of the read port
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_FAILURE if the GPIO could not be initialized or the front end does not answer
+*
+******************************************************************************/
+int PDM_Initialize(PdmFrontend *InstancePtr, u16 DeviceId)
+{
+	int status;
+	u32 sts;
+
+	status = XGpio_Initialize(&InstancePtr->GpioInst, DeviceId);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	XGpio_SetDataDirection(&InstancePtr->GpioInst, PDM_DATA_CHANNEL, 0xFFFFFFFF);
+	XGpio_SetDataDirection(&InstancePtr->GpioInst, PDM_CTL_CHANNEL, 0x00000000);
+
+	// the GPIO output resets to 0, and the release acknowledge follows it
+	InstancePtr->ctl = 0;
+	sts = pdm_read(InstancePtr, PDM_CTL_STATUS_MASK);
+
+	// the frame length is built into the hardware
+	InstancePtr->frame_log2 = (sts & PDM_STS_LOG2_MASK) >> PDM_STS_LOG2_SHIFT;
+	if ((InstancePtr->frame_log2 < PDM_MIN_FRAME_LOG2) || (InstancePtr->frame_log2 > PDM_MAX_FRAME_LOG2))
+	{
+		return XST_FAILURE;
+	}
+	InstancePtr->frame_len = 1 << InstancePtr->frame_log2;
+	InstancePtr->overruns_last = (sts & PDM_STS_OVERRUNS_MASK) >> PDM_STS_OVERRUNS_SHIFT;
+	InstancePtr->frames = 0;
+	InstancePtr->overruns = 0;
+	InstancePtr->discarded = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns true if a frame is waiting to be read
+******************************************************************************/
+bool PDM_FrameReady(PdmFrontend *InstancePtr)
+{
+	return (pdm_read(InstancePtr, PDM_CTL_STATUS_MASK) & PDM_STS_READY_MASK) != 0;
+}
+
+
+/*****************************************************************************/
+/**
+* Reads the waiting frame and releases it
+*
+* @param    InstancePtr is a pointer to the PdmFrontend instance
+* @param	signal_1 receives InstancePtr->frame_len samples from microphone 1
+* @param	signal_2 receives InstancePtr->frame_len samples from microphone 2
+*
+* @return
+*
+*   - XST_SUCCESS if a frame was read
+*   - XST_NO_DATA if no frame is waiting
+*   - XST_FAILURE if the hardware did not acknowledge the release
+*
+******************************************************************************/
+int PDM_ReadFrame(PdmFrontend *InstancePtr, s16 *signal_1, s16 *signal_2)
+{
+	u32 sts, overruns, word;
+	int i;
+
+	sts = pdm_read(InstancePtr, PDM_CTL_STATUS_MASK);
+	if ((sts & PDM_STS_READY_MASK) == 0)
+	{
+		return XST_NO_DATA;
+	}
+	overruns = (sts & PDM_STS_OVERRUNS_MASK) >> PDM_STS_OVERRUNS_SHIFT;
+	InstancePtr->overruns += (overruns - InstancePtr->overruns_last) &
+		(PDM_STS_OVERRUNS_MASK >> PDM_STS_OVERRUNS_SHIFT);
+	InstancePtr->overruns_last = overruns;
+
+	for (i = 0; i < InstancePtr->frame_len; i++)
+	{
+		word = pdm_read(InstancePtr, i);
+		signal_1[i] = (s16) (word & 0xFFFF);
+		signal_2[i] = (s16) (word >> 16);
+	}
+	InstancePtr->frames++;
+	return pdm_release(InstancePtr);
+}
+
+
+/*****************************************************************************/
+/**
+* Releases the waiting frame unread
+*
+* The hardware starts handing over frames again once it has seen the release; the next
+* one is ready when the frame being written completes.
+*
+* @param    InstancePtr is a pointer to the PdmFrontend instance
+*
+* @return
+*
+*   - XST_SUCCESS if the release was acknowledged
+*   - XST_FAILURE otherwise
+*
+******************************************************************************/
+int PDM_Release(PdmFrontend *InstancePtr)
+{
+	InstancePtr->discarded++;
+	return pdm_release(InstancePtr);
+}
+
+
+/*****************************************************************************/
+/**
+* Selects a word (a sample index, or PDM_CTL_STATUS_MASK) and reads it
+******************************************************************************/
+static u32 pdm_read(PdmFrontend *InstancePtr, u32 select)
+{
+	XGpio_DiscreteWrite(&InstancePtr->GpioInst, PDM_CTL_CHANNEL, InstancePtr->ctl | select);
+	(void) XGpio_DiscreteRead(&InstancePtr->GpioInst, PDM_DATA_CHANNEL);
+	return XGpio_DiscreteRead(&InstancePtr->GpioInst, PDM_DATA_CHANNEL);
+}
+
+
+/*****************************************************************************/
+/**
+* Flips the release toggle and waits for the hardware to acknowledge it
+******************************************************************************/
+static int pdm_release(PdmFrontend *InstancePtr)
+{
+	u32 sts;
+	int spin;
+
+	InstancePtr->ctl ^= PDM_CTL_RELEASE_MASK;
+	for (spin = 0; spin < PDM_ACK_SPIN_LIMIT; spin++)
+	{
+		sts = pdm_read(InstancePtr, PDM_CTL_STATUS_MASK);
+		if (((sts & PDM_STS_ACK_MASK) != 0) == ((InstancePtr->ctl & PDM_CTL_RELEASE_MASK) != 0))
+		{
+			return XST_SUCCESS;
+		}
+	}
+	return XST_FAILURE;
+}
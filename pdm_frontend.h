@@ -0,0 +1,84 @@
+/**
+*
+* @file pdm_frontend.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for pdm_frontend.c.
+* pdm_frontend.c reads the PCM frames of PDM_Frontend, the fabric front end that decimates
+* a pair of PDM microphones to 16-bit samples and writes them in frames to a double
+* buffered block RAM.  Everything goes through GPIO 8: channel 2 selects a sample of the
+* ready frame (or the status word) and carries the release toggle, channel 1 returns the
+* selected word.  See pdm_frontend.v for the layout.
+*
+* A frame belongs to the processor from the time it is ready (frame_irq) until it is
+* released; the hardware drops the frames that complete in the meantime and counts them
+* as overruns.
+*
+******************************************************************************/
+
+#ifndef PDM_FRONTEND_H	/* prevent circular inclusions */
+#define PDM_FRONTEND_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xgpio.h"
+
+/************************** Constant Definitions *****************************/
+#define PDM_DATA_CHANNEL		1			// GPIO 8 channels
+#define PDM_CTL_CHANNEL			2
+
+// control and status fields
+#define PDM_CTL_INDEX_MASK		0x0FFF
+#define PDM_CTL_STATUS_MASK		0x4000
+#define PDM_CTL_RELEASE_MASK	0x8000
+#define PDM_STS_READY_MASK		0x00000001
+#define PDM_STS_LOG2_MASK		0x00000078
+#define PDM_STS_LOG2_SHIFT		3
+#define PDM_STS_ACK_MASK		0x00000080
+#define PDM_STS_OVERRUNS_MASK	0x0000FF00
+#define PDM_STS_OVERRUNS_SHIFT	8
+#define PDM_STS_FRAMES_MASK		0xFFFF0000
+#define PDM_STS_FRAMES_SHIFT	16
+
+#define PDM_MIN_FRAME_LOG2		4
+#define PDM_MAX_FRAME_LOG2		12
+
+// PCM rate: pdm_clk is PDM_CLK_DIV clk2 clocks, decimated by PDM_DECIMATION
+#define PDM_CLK_DIV				32
+#define PDM_DECIMATION			64
+#define PDM_SAMPLE_HZ(clk2_hz)	((clk2_hz) / (PDM_CLK_DIV * PDM_DECIMATION))
+
+// status polls to wait for a release acknowledge before giving up
+#define PDM_ACK_SPIN_LIMIT		64
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	XGpio	GpioInst;			// GPIO 8 - read port
+	u32		ctl;				// release toggle last written
+	int		frame_log2;			// samples per frame = 2^frame_log2
+	int		frame_len;
+	u32		overruns_last;		// hardware overrun counter at the last frame
+	u32		frames;				// frames read
+	u32		overruns;			// frames the hardware dropped while one was held
+	u32		discarded;			// frames released unread
+} PdmFrontend;
+
+/************************** Function Prototypes ******************************/
+int  PDM_Initialize(PdmFrontend *InstancePtr, u16 DeviceId);
+bool PDM_FrameReady(PdmFrontend *InstancePtr);
+int  PDM_ReadFrame(PdmFrontend *InstancePtr, s16 *signal_1, s16 *signal_2);
+int  PDM_Release(PdmFrontend *InstancePtr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
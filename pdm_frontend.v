@@ -0,0 +1,433 @@
+/******************************************************/
+// MODULE: PDM_Frontend
+//
+// FILE NAME:	pdm_frontend.v
+// VERSION: 1.0
+// DATE:	3/16/16
+// AUTHOR:	Chris Dean, Meng Lei
+//
+// DESCRIPTION:
+// Sampled audio front end for a pair of PDM (pulse
+// density modulated) MEMS microphones, next to
+// Phase_Detection.  Where Phase_Detection only sees the
+// comparator edges, this gives the processor the audio
+// itself, so the time difference of arrival can be
+// found by cross-correlation (gcc_phat.c) over a whole
+// block of samples instead of from one edge per mic.
+//
+// Both microphones share pdm_clk, CLK_DIV clocks per
+// period (3.125 MHz from the 100 MHz clk2), and each has
+// its own data line.  Each mic's bit is taken just
+// before pdm_clk rises, as a mic with its L/R select
+// tied low presents it (the data lines are synchronized
+// first; the mic drives them after the falling edge).
+//
+// Each channel is decimated to 16-bit PCM in two
+// stages:
+//	PDM_CIC		4th order CIC, decimate by 32, to
+//				97.66 kHz (gain 32^4 = 2^20)
+//	PDM_FIR		47-tap compensation FIR, decimate by
+//				2, to 48.83 kHz.  Flat to +/-0.02 dB
+//				up to 20 kHz with the CIC droop taken
+//				out, 68 dB down from 28.8 kHz so
+//				nothing aliases into the passband
+// A PDM density of d (-1 to +1) gives d * 32768.
+//
+// The samples are written in frames of 2^FRAME_LOG2
+// into a double buffered block RAM, one 32-bit word per
+// sample, {mic 2, mic 1}.  When a frame is complete it
+// is handed to the processor (ready goes high, and so
+// does frame_irq, for a rising edge axi_intc input) and
+// the writer moves to the other half.  The processor
+// owns the frame until it releases it; if the writer
+// fills its half before then, that frame is dropped and
+// counted as an overrun and the half is written again,
+// so the frame the processor is reading never changes
+// under it.
+//
+// The processor reads through one GPIO: rd_ctl (AXI
+// clock domain) selects a word, which appears on
+// rd_data:
+//	rd_ctl	[11:0]	sample index in the ready frame
+//			[14]	read the status word instead
+//			[15]	toggle to release the ready frame
+// rd_ctl is synchronized and the word registered, so
+// rd_data follows a change of rd_ctl about 4 clk2 clocks
+// later - within two AXI accesses.  The status word:
+//	[0]		ready: a frame is waiting to be read
+//	[1]		half of the buffer it is in
+//	[6:3]	FRAME_LOG2
+//	[7]		release acknowledge, follows rd_ctl[15]
+//	[15:8]	frames dropped (overruns), wraps
+//	[31:16]	frames completed, wraps
+//
+/******************************************************/
+
+
+// MODULE
+module PDM_Frontend
+	#(parameter CLK_DIV = 32,				// clocks per pdm_clk period, even
+	  parameter FRAME_LOG2 = 8)				// samples per frame = 2^FRAME_LOG2, 4 to 12
+	(clock, pdm_clk, pdm_data, rd_ctl, rd_data, frame_irq);
+
+	input clock;							// Reference clock (clk2)
+	output pdm_clk;							// microphone clock
+	input [1:0] pdm_data;					// microphone data lines, mic 1 in bit 0
+	input [15:0] rd_ctl;					// read select and release toggle from the processor
+	output [31:0] rd_data;					// selected sample or status
+	output frame_irq;						// a frame is ready
+
+	localparam FRAME_LEN = 1 << FRAME_LOG2;
+	localparam [3:0] FRAME_LOG2_FIELD = FRAME_LOG2;
+	localparam CTL_STATUS = 14;
+	localparam CTL_RELEASE = 15;
+
+	// PDM clock and data
+	reg [7:0] div;							// clock divider
+	reg clk_out;
+	reg [1:0] data_meta, data_sync;			// 2-FF synchronizer
+
+	// decimators
+	wire sample = (div == CLK_DIV/2 - 1) && !clk_out;	// pdm_clk about to rise
+	wire [1:0] cic_valid, pcm_valid;
+	wire signed [21:0] cic_1, cic_2;
+	wire signed [15:0] pcm_1, pcm_2;
+
+	// frame buffer
+	reg [31:0] frames [0:2*FRAME_LEN-1];
+	reg [FRAME_LOG2-1:0] wr_index;			// next sample in the frame being written
+	reg wr_bank;							// half being written
+	reg rd_bank;							// half handed to the processor
+	reg ready;								// the processor owns rd_bank
+	reg [15:0] frame_count;
+	reg [7:0] overruns;
+
+	// processor read port
+	reg [15:0] ctl_meta, ctl_sync;			// 2-FF synchronizer (held static while read)
+	reg [2:0] rel_sync;						// 2-FF synchronizer plus previous value
+	reg [31:0] rd_word, status_reg;
+	reg rd_status;
+
+	wire freed = (rel_sync[2] != rel_sync[1]);
+	wire [31:0] status = {frame_count, overruns, rel_sync[2], FRAME_LOG2_FIELD, 1'b0, rd_bank, ready};
+
+	// Initialize values to zero
+	initial
+	begin
+		div = 0;
+		clk_out = 0;
+		data_meta = 0;
+		data_sync = 0;
+		wr_index = 0;
+		wr_bank = 0;
+		rd_bank = 0;
+		ready = 0;
+		frame_count = 0;
+		overruns = 0;
+		ctl_meta = 0;
+		ctl_sync = 0;
+		rel_sync = 0;
+		rd_word = 0;
+		status_reg = 0;
+		rd_status = 0;
+	end
+
+	// Generate pdm_clk and sample the microphones
+	always @(posedge clock)
+	begin
+		data_meta <= pdm_data;
+		data_sync <= data_meta;
+		if (div == CLK_DIV/2 - 1)
+		begin
+			div <= 0;
+			clk_out <= ~clk_out;
+		end
+		else
+			div <= div + 1;
+	end
+
+	assign pdm_clk = clk_out;
+
+	PDM_CIC CIC_1
+		(.clock(clock),
+		.sample(sample),
+		.data(data_sync[0]),
+		.valid(cic_valid[0]),
+		.out(cic_1));
+
+	PDM_CIC CIC_2
+		(.clock(clock),
+		.sample(sample),
+		.data(data_sync[1]),
+		.valid(cic_valid[1]),
+		.out(cic_2));
+
+	PDM_FIR FIR_1
+		(.clock(clock),
+		.in_valid(cic_valid[0]),
+		.in(cic_1),
+		.out_valid(pcm_valid[0]),
+		.out(pcm_1));
+
+	PDM_FIR FIR_2
+		(.clock(clock),
+		.in_valid(cic_valid[1]),
+		.in(cic_2),
+		.out_valid(pcm_valid[1]),
+		.out(pcm_2));
+
+	// Write the frames and hand them over.  Both channels run in lock step
+	always @(posedge clock)
+	begin
+		rel_sync <= {rel_sync[1:0], rd_ctl[CTL_RELEASE]};
+		if (freed)
+			ready <= 0;
+
+		if (pcm_valid[0])
+		begin
+			frames[{wr_bank, wr_index}] <= {pcm_2, pcm_1};
+			wr_index <= wr_index + 1;
+			if (wr_index == FRAME_LEN - 1)
+			begin
+				if (!ready || freed)
+				begin
+					ready <= 1;
+					rd_bank <= wr_bank;
+					wr_bank <= ~wr_bank;
+					frame_count <= frame_count + 1;
+				end
+				else
+					overruns <= overruns + 1;
+			end
+		end
+	end
+
+	// Processor reads
+	always @(posedge clock)
+	begin
+		ctl_meta <= rd_ctl;
+		ctl_sync <= ctl_meta;
+		rd_word <= frames[{rd_bank, ctl_sync[FRAME_LOG2-1:0]}];
+		rd_status <= ctl_sync[CTL_STATUS];
+		status_reg <= status;
+	end
+
+	assign rd_data = rd_status ? status_reg : rd_word;
+	assign frame_irq = ready;
+
+endmodule
+
+
+/******************************************************/
+// MODULE: PDM_CIC
+//
+// DESCRIPTION:
+// 4th order cascaded integrator-comb decimator, rate
+// change 32, for one PDM channel.  The bit is taken as
+// +1 or -1 on every sample strobe; out is the decimated
+// value, +/-2^20 full scale, strobed by valid every 32
+// samples.  The integrators wrap (two's complement), the
+// combs undo it.
+//
+/******************************************************/
+module PDM_CIC
+	(clock, sample, data, valid, out);
+
+	input clock;
+	input sample;							// take data this clock
+	input data;								// PDM bit
+	output reg valid;						// out is new
+	output reg signed [21:0] out;
+
+	reg signed [21:0] int_1, int_2, int_3, int_4;	// integrators
+	reg signed [21:0] dly_1, dly_2, dly_3, dly_4;	// comb delays
+	reg [4:0] phase;						// decimation count
+
+	wire signed [21:0] comb_1 = int_4 - dly_1;
+	wire signed [21:0] comb_2 = comb_1 - dly_2;
+	wire signed [21:0] comb_3 = comb_2 - dly_3;
+	wire signed [21:0] comb_4 = comb_3 - dly_4;
+
+	initial
+	begin
+		valid = 0;
+		out = 0;
+		int_1 = 0;
+		int_2 = 0;
+		int_3 = 0;
+		int_4 = 0;
+		dly_1 = 0;
+		dly_2 = 0;
+		dly_3 = 0;
+		dly_4 = 0;
+		phase = 0;
+	end
+
+	always @(posedge clock)
+	begin
+		valid <= 0;
+		if (sample)
+		begin
+			// integrators at the PDM rate (pipelined, one stage per clock)
+			int_1 <= int_1 + (data ? 22'sd1 : -22'sd1);
+			int_2 <= int_2 + int_1;
+			int_3 <= int_3 + int_2;
+			int_4 <= int_4 + int_3;
+
+			// combs at the decimated rate
+			phase <= phase + 1;
+			if (phase == 31)
+			begin
+				dly_1 <= int_4;
+				dly_2 <= comb_1;
+				dly_3 <= comb_2;
+				dly_4 <= comb_3;
+				out <= comb_4;
+				valid <= 1;
+			end
+		end
+	end
+
+endmodule
+
+
+/******************************************************/
+// MODULE: PDM_FIR
+//
+// DESCRIPTION:
+// CIC compensation and decimate-by-2 FIR for one
+// channel: 47 symmetric taps, Q15, DC gain 1.  Samples
+// arrive every 1024 clocks, so one multiplier works
+// through the taps in turn once every second sample;
+// out is ready 50 clocks after that sample, rounded and
+// saturated to 16 bits.
+//
+// The taps are a weighted least squares fit of 1/CIC
+// droop over 0 to 20 kHz and 0 from 28.8 kHz, at the
+// 97.66 kHz input rate.
+//
+/******************************************************/
+module PDM_FIR
+	(clock, in_valid, in, out_valid, out);
+
+	input clock;
+	input in_valid;							// in is a new sample
+	input signed [21:0] in;					// CIC output
+	output reg out_valid;					// out is a new sample
+	output reg signed [15:0] out;			// PCM
+
+	localparam TAPS = 47;
+
+	reg signed [21:0] line [0:63];			// delay line, newest at wr_ptr - 1
+	reg [5:0] wr_ptr;
+	reg [5:0] tap;							// next tap to multiply
+	reg odd;								// every second sample is filtered
+	reg busy;
+	reg mul_valid, mul_last, acc_last;		// multiply-accumulate pipeline
+	reg signed [37:0] product;
+	reg signed [39:0] acc;
+
+	wire [5:0] rd_ptr = wr_ptr - 6'd1 - tap;
+	wire signed [39:0] rounded = acc + 40'sd524288;
+	wire signed [19:0] scaled = rounded[39:20];
+
+	integer i;
+
+	// Q15 taps, symmetric: tap k = tap 46 - k
+	function signed [15:0] coef;
+		input [5:0] k;
+		reg [5:0] j;
+		begin
+			j = (k < 23) ? k : 46 - k;
+			case (j)
+				0:	coef = -16'sd2;
+				1:	coef = 16'sd9;
+				2:	coef = 16'sd19;
+				3:	coef = -16'sd21;
+				4:	coef = -16'sd53;
+				5:	coef = 16'sd40;
+				6:	coef = 16'sd118;
+				7:	coef = -16'sd64;
+				8:	coef = -16'sd227;
+				9:	coef = 16'sd92;
+				10:	coef = 16'sd399;
+				11:	coef = -16'sd120;
+				12:	coef = -16'sd659;
+				13:	coef = 16'sd141;
+				14:	coef = 16'sd1049;
+				15:	coef = -16'sd141;
+				16:	coef = -16'sd1647;
+				17:	coef = 16'sd84;
+				18:	coef = 16'sd2647;
+				19:	coef = 16'sd149;
+				20:	coef = -16'sd4679;
+				21:	coef = -16'sd1272;
+				22:	coef = 16'sd11231;
+				default:	coef = 16'sd18596;	// center tap
+			endcase
+		end
+	endfunction
+
+	initial
+	begin
+		for (i = 0; i < 64; i = i + 1)
+			line[i] = 0;
+		wr_ptr = 0;
+		tap = 0;
+		odd = 0;
+		busy = 0;
+		mul_valid = 0;
+		mul_last = 0;
+		acc_last = 0;
+		product = 0;
+		acc = 0;
+		out_valid = 0;
+		out = 0;
+	end
+
+	always @(posedge clock)
+	begin
+		out_valid <= 0;
+
+		// Shift in the new sample, start the taps on every second one
+		if (in_valid)
+		begin
+			line[wr_ptr] <= in;
+			wr_ptr <= wr_ptr + 1;
+			odd <= ~odd;
+			if (odd)
+			begin
+				busy <= 1;
+				tap <= 0;
+				acc <= 0;
+			end
+		end
+
+		// multiply, then accumulate
+		mul_valid <= busy;
+		mul_last <= busy && (tap == TAPS - 1);
+		if (busy)
+		begin
+			product <= coef(tap) * line[rd_ptr];
+			tap <= tap + 1;
+			if (tap == TAPS - 1)
+				busy <= 0;
+		end
+		if (mul_valid)
+			acc <= acc + product;
+
+		// round and saturate
+		acc_last <= mul_last;
+		if (acc_last)
+		begin
+			if (scaled > 20'sd32767)
+				out <= 16'sd32767;
+			else if (scaled < -20'sd32768)
+				out <= -16'sd32768;
+			else
+				out <= scaled[15:0];
+			out_valid <= 1;
+		end
+	end
+
+endmodule
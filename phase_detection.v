@@ -1,76 +1,640 @@
 /******************************************************/
-// MODULE: Phase_Detection 
+// MODULE: Phase_Detection
 //
 // FILE NAME:	phase_detection.v
-// VERSION: 1.0
+// VERSION: 1.9
 // DATE:	3/16/16
 // AUTHOR:	Chris Dean, Meng Lei
 //
-// DESCRIPTION:	
+// DESCRIPTION:
 // Custom module for phase detection hardware used in
 // ECE 544 final project.
 //
+// Every rising edge on each of the NUM_MICS microphone
+// inputs that passes its edge filter (below) is
+// timestamped and queued in a per-microphone
+// FIFO (Edge_FIFO) so edges arriving between two FIT
+// polls are not lost.  timestamps presents the oldest
+// unread timestamp of each FIFO (microphone m in bits
+// [32*m+31:32*m]).  The processor pops an entry by
+// toggling the corresponding pop input; the pop is
+// acknowledged by the matching ack bit in fifo_status
+// following the toggle.
+//
+// The microphones are grouped in banks of two, each
+// with its own 32-bit status word, so every bank maps
+// onto one pair of GPIOs (heads, status/pop) exactly as
+// the original two microphone design did.
+//
+// Each input goes through an Edge_Filter before its
+// FIFO: a glitch filter (the input must be high for
+// MIN_HIGH clocks for a rising edge to count), a holdoff
+// (edges within HOLDOFF counts of a capture are ignored)
+// and an onset mode (only the first edge after QUIET
+// counts without one is captured, one edge per sound
+// burst).  The filters power up off and are set through
+// a register write port in the AXI clock domain that
+// shares GPIO 6 with Servo_Pipeline: the processor sets
+// cfg_addr/cfg_data and toggles cfg_toggle; cfg_ack
+// follows the toggle once the register is written.
+// Registers (addresses 0 to 7 belong to Servo_Pipeline),
+// in timestamp counts, apply to every channel:
+//	8	EDGE_CTRL	[0] onset mode
+//	9	HOLDOFF		ignore edges this long after a capture
+//	10	MIN_HIGH	[15:0] clocks high to accept an edge
+//	11	QUIET		onset: silence before a new burst
+//	12	WAKE		timestamp to raise wake_irq at
+// A filtered edge keeps the timestamp of its rising edge.
+// EDGE_CTRL[1] (latch only) stops the FIFOs from being
+// pushed, for a processor that reads the latched pair.
+//
+// Writing WAKE arms a one-shot wakeup: once the
+// timestamp counter reaches the written value (or is
+// past it by less than 2^31 counts, so a time already
+// gone fires at once) wake_irq strobes for IRQ_CYCLES
+// clocks.  A processor that sleeps between its tasks
+// sets it to its next task release instead of taking
+// every FIT interrupt.  A new write replaces the armed
+// time.
+//
+// Sub-clock timestamps: with FRAC_BITS set each input is
+// also sampled between the rising clock edges, on the
+// falling edge (FRAC_BITS = 1), or on the falling edge
+// and both edges of clock_90, clock delayed by a quarter
+// period (FRAC_BITS = 2).  Each clock period then holds
+// 2^FRAC_BITS evenly spaced samples, the last on the
+// rising edge, and a rising edge is timestamped with the
+// start of the step it rose in.  The timestamp counter
+// counts in these steps: it advances by 2^FRAC_BITS per
+// clock, so a timestamp is the clock count with FRAC_BITS
+// fraction bits appended, and every time in counts
+// (PAIR_WINDOW, the registers, pair_info) is in these
+// finer counts too.  The counter wraps 2^FRAC_BITS times
+// sooner.  The samples are counted rather than searched
+// for the first high one, so a sample that resolves late
+// near the edge moves the timestamp by one step at most.
+// The samples between the rising edges must be placed
+// close to the inputs (IOB registers), as each has less
+// than a clock to reach the rising edge registers.  With
+// FRAC_BITS = 0 clock_90 is not used.
+//
+// now is the free-running timestamp counter itself, so
+// the processor can timestamp its own events on the same
+// time base as the edges (latency tracing).  edges
+// strobes each microphone's captured edges as they are
+// accepted by its filter, with their timestamps on
+// edge_times (Servo_Pipeline pairs them in the fabric).
+//
+// capture_irq tells the processor there is something
+// to drain, so it does not have to poll the FIFOs.  A
+// bank strobes when an edge completes a pair - it
+// follows an unpaired edge on the other channel of the
+// bank by at most PAIR_WINDOW counts, the rule
+// FIT_Handler pairs by - or when a push leaves a FIFO
+// half full, so a channel with no partner is drained
+// before it overflows.  The strobes of all banks are
+// ORed and stretched to IRQ_CYCLES clocks for an edge
+// sensitive axi_intc input (with input synchronizers:
+// clk2 is not related to the AXI clock).  Strobes that
+// fall within one stretch make a single interrupt; the
+// processor drains everything queued either way.
+//
+// fifo_status layout of bank b (microphones 2b and 2b+1,
+// "1" and "2" below), in bits [32*b+31:32*b]:
+//	[4:0]	entries in FIFO 1, Gray coded
+//	[7]		pop acknowledge 1
+//	[12:8]	entries in FIFO 2, Gray coded
+//	[15]	pop acknowledge 2
+//	[23:16]	edges dropped on channel 1 (FIFO full), wraps
+//	[31:24]	edges dropped on channel 2 (FIFO full), wraps
+// fifo_status is read from the AXI clock domain.  The
+// entry counts come from flops and change by one per
+// clock, so in Gray code a read that lands on a change
+// sees the old or the new count, never a mix.  A pop
+// acknowledge changes a clock after the count the pop
+// left, so a read that sees the acknowledge sees that
+// count too.
+//
+// Each bank also latches its last pair, so a processor
+// that only wants the latest pair reads two words instead
+// of draining the FIFOs.  Both words change together, in
+// the clock the pair completes:
+//	pair_time	[31:0]	timestamp of the channel 1 edge
+//	pair_info	[15:0]	channel 1 - channel 2 timestamp,
+//						signed (PAIR_WINDOW < 32768,
+//						in counts with FRAC_BITS)
+//				[16]	valid: a pair has been latched
+//				[31:17]	pair sequence number, Gray
+//						coded, wraps
+// The words are read from another clock domain, so a read
+// can land on an update.  The processor reads pair_info,
+// then pair_time, then pair_info again, and keeps the pair
+// only if both pair_info reads agree.  The Gray code makes
+// a single read of the sequence number either the old or
+// the new one, so an unchanged pair is recognized from the
+// first read alone.
+//
 /******************************************************/
 
 
 // MODULE
-module Phase_Detection(clock, signal_1, signal_2, time_1, time_2);
+module Phase_Detection
+	#(parameter NUM_MICS = 2,				// microphones, even, 2 to 8
+	  parameter FIFO_DEPTH_LOG2 = 4,		// entries per channel = 2^FIFO_DEPTH_LOG2, at most 16
+	  parameter PAIR_WINDOW = 25000,		// largest phase difference of a pair (PHASE_VALID_WINDOW)
+	  parameter IRQ_CYCLES = 4,				// capture_irq pulse width
+	  parameter FRAC_BITS = 0)				// sub-clock timestamp bits, 0 to 2 (PHASE_TIME_FRAC_BITS)
+	(clock, clock_90, signal, pop, timestamps, fifo_status, pair_time, pair_info, now, edges, edge_times,
+	 capture_irq, wake_irq, cfg_toggle, cfg_addr, cfg_data, cfg_ack);
+
+	localparam NUM_BANKS = NUM_MICS / 2;
 
 	input clock;				           	// Reference clock
-	input signal_1;				        	// Input signal from mic1
-	input signal_2;                        // Input signal from mic2
-	output reg [31:0] time_1, time_2;      // Measured arrival timestamp 
-
-	reg [31:0] counter;						// local timestamp counter
-	
-	// These 2 variables are needed because it's generally not allowed to
-	// perform edge detection in standard i/o.
+	input clock_90;							// clock a quarter period later, for FRAC_BITS = 2
+	input [NUM_MICS-1:0] signal;			// Input signals from the mic amplifiers
+	input [NUM_MICS-1:0] pop;				// Pop toggles from the processor (any clock domain)
+	output [32*NUM_MICS-1:0] timestamps;	// Oldest queued arrival timestamp per mic
+	output [32*NUM_BANKS-1:0] fifo_status;	// FIFO occupancy, pop acknowledge and overflow counts
+	output [32*NUM_BANKS-1:0] pair_time;	// last pair of each bank: channel 1 timestamp
+	output [32*NUM_BANKS-1:0] pair_info;	// and its difference, valid flag and sequence number
+	output [31:0] now;						// current timestamp counter value
+	output [NUM_MICS-1:0] edges;			// captured edge strobes
+	output [32*NUM_MICS-1:0] edge_times;	// timestamps of the edges strobed on edges
+	output capture_irq;						// an edge pair (or half a FIFO) is ready to drain
+	output wake_irq;						// the timestamp counter reached WAKE
+	input cfg_toggle;						// each change writes cfg_data to register cfg_addr
+	input [3:0] cfg_addr;
+	input [31:0] cfg_data;
+	output cfg_ack;							// follows cfg_toggle once the write is done
+
+	localparam REG_EDGE_CTRL = 8;
+	localparam REG_HOLDOFF = 9;
+	localparam REG_MIN_HIGH = 10;
+	localparam REG_QUIET = 11;
+	localparam REG_WAKE = 12;
+
+	reg [31:0] counter;						// local timestamp counter, 2^FRAC_BITS per clock
+
 	// Used to store "old" signal levels in order to achieve "edge detection"
-	reg prev_1, prev_2;
+	reg [NUM_MICS-1:0] prev;
+
+	// edge filter configuration
+	reg onset;
+	reg latch_only;							// FIFOs not pushed
+	reg [31:0] holdoff, quiet;
+	reg [15:0] min_high;
+	reg [2:0] cfg_sync;						// 2-FF synchronizer plus previous value
+
+	wire [NUM_MICS-1:0] captured;			// edge accepted by its filter
+	wire [NUM_MICS-1:0] push;				// and queued
+	wire [32*NUM_MICS-1:0] stamps;			// and its timestamp
+	wire [32*NUM_MICS-1:0] rise_times;		// sub-clock time of a rise in this clock
+	wire [NUM_MICS-1:0] half_full;			// push leaving a FIFO at least half full
+	wire [NUM_BANKS-1:0] paired;			// edge completing a pair, per bank
+	reg [2:0] irq_count;					// capture_irq stretch
+	reg [31:0] wake_time;					// WAKE
+	reg wake_armed;
+	reg [2:0] wake_count;					// wake_irq stretch
+	wire wake_due = wake_armed && !(counter - wake_time >= 32'h80000000);
 
 	// Initialize values to zero
 	initial
 	begin
 	   counter = 0;
-	   time_1 = 0;
-	   time_2 = 0;
-	   prev_1 = 0;
-	   prev_2 = 0;
+	   prev = 0;
+	   irq_count = 0;
+	   onset = 0;
+	   latch_only = 0;
+	   holdoff = 0;
+	   min_high = 0;
+	   quiet = 0;
+	   cfg_sync = 0;
+	   wake_time = 0;
+	   wake_armed = 0;
+	   wake_count = 0;
+	end
+
+	// On each clock tick sample the signals and update counters
+	always @(posedge clock)
+	begin
+        // Increment counter, wrapping to zero at max
+        counter <= counter + (1 << FRAC_BITS);
+
+		// Store current levels for the next edge comparison
+        prev <= signal;
+	end
+
+	// Register writes from the processor, and the wakeup they arm
+	always @(posedge clock)
+	begin
+		cfg_sync <= {cfg_sync[1:0], cfg_toggle};
+		if (wake_due)
+			wake_armed <= 0;
+		if (cfg_sync[2] != cfg_sync[1])
+		begin
+			case (cfg_addr)
+				REG_EDGE_CTRL:
+				begin
+					onset <= cfg_data[0];
+					latch_only <= cfg_data[1];
+				end
+				REG_HOLDOFF:	holdoff <= cfg_data;
+				REG_MIN_HIGH:	min_high <= cfg_data[15:0];
+				REG_QUIET:		quiet <= cfg_data;
+				REG_WAKE:
+				begin
+					wake_time <= cfg_data;
+					wake_armed <= 1;
+				end
+				default:		;
+			endcase
+		end
 	end
-	
-	// On each clock tick sample the signal and update counters
+
+	assign cfg_ack = cfg_sync[2];
+
+	// Captured edges are pushed into the FIFOs with their timestamps
+	assign now = counter;
+	assign edges = captured;
+	assign edge_times = stamps;
+	assign push = latch_only ? 0 : captured;
+
+	// Capture interrupt
+	always @(posedge clock)
+	begin
+		if ((paired != 0) || (half_full != 0))
+			irq_count <= IRQ_CYCLES;
+		else if (irq_count != 0)
+			irq_count <= irq_count - 1;
+	end
+
+	assign capture_irq = (irq_count != 0);
+
+	// Wake interrupt
 	always @(posedge clock)
 	begin
-        // Increment counter
-        if (counter < 0'hFFFFFFFF)
-            counter = counter + 1;
-       
-        // If counter is at max, reset to zero
-        else
-          counter = 0;
-          
-        
-		// Detect signal 1 rising edge
-		if ((prev_1 == 0) && (signal_1 == 1))
-			// Record the time stamp
-            time_1 = counter;
-		
-		// Store current timestamp for next comparison
-        prev_1 = signal_1;
-			
-		// Detect signal 2 rising edge	
-        if ((prev_2 == 0) && (signal_2 == 1))
-			//Record the time stamp
-            time_2 = counter; 
-			
-		// Store current timestamp for next comparison
-        prev_2 = signal_2; 
-          
+		if (wake_due)
+			wake_count <= IRQ_CYCLES;
+		else if (wake_count != 0)
+			wake_count <= wake_count - 1;
+	end
+
+	assign wake_irq = (wake_count != 0);
+
+	genvar m, b;
+	generate
+		for (m = 0; m < NUM_MICS; m = m + 1)
+		begin : mic
+			wire [FIFO_DEPTH_LOG2:0] count, count_gray;
+			wire [7:0] overflow;
+			wire ack;
+			wire [2:0] highs;					// samples high in this clock, the last one included
+
+			// Sub-clock samples, taken a quarter, a half and three quarters of a clock
+			// after the last rising edge.  On a rise the samples of the clock read
+			// 0..01..1, and the rise is timestamped the counter value (the time of the
+			// last rising edge) plus the samples that were still low
+			if (FRAC_BITS == 2)
+			begin : quarter
+				reg s1, s2, s3;
+
+				always @(posedge clock_90)
+					s1 <= signal[m];
+				always @(negedge clock)
+					s2 <= signal[m];
+				always @(negedge clock_90)
+					s3 <= signal[m];
+
+				assign highs = s1 + s2 + s3 + signal[m];
+			end
+			else if (FRAC_BITS == 1)
+			begin : half
+				reg s2;
+
+				always @(negedge clock)
+					s2 <= signal[m];
+
+				assign highs = s2 + signal[m];
+			end
+			else
+			begin : whole
+				assign highs = signal[m];
+			end
+
+			assign rise_times[32*m +: 32] = (signal[m] && !prev[m]) ? counter + (1 << FRAC_BITS) - highs : counter;
+
+			Edge_Filter Filter
+				(.clock(clock),
+				.signal(signal[m]),
+				.prev(prev[m]),
+				.counter(rise_times[32*m +: 32]),
+				.holdoff(holdoff),
+				.min_high(min_high),
+				.quiet(quiet),
+				.onset(onset),
+				.strobe(captured[m]),
+				.stamp(stamps[32*m +: 32]));
+
+			Edge_FIFO #(.DEPTH_LOG2(FIFO_DEPTH_LOG2)) FIFO
+				(.clock(clock),
+				.push(push[m]),
+				.push_data(stamps[32*m +: 32]),
+				.pop_toggle(pop[m]),
+				.head(timestamps[32*m +: 32]),
+				.count(count),
+				.count_gray(count_gray),
+				.overflow(overflow),
+				.pop_ack(ack));
+
+			// even mics are channel 1 of their bank, odd mics channel 2
+			assign fifo_status[32*(m/2) + 8*(m%2) +: 8] = {ack, {(6-FIFO_DEPTH_LOG2){1'b0}}, count_gray};
+			assign fifo_status[32*(m/2) + 16 + 8*(m%2) +: 8] = overflow;
+			// not once full: a push dropped there would strobe on every edge of an undrained channel
+			assign half_full[m] = push[m] && (count >= (1 << (FIFO_DEPTH_LOG2 - 1)) - 1) && (count != (1 << FIFO_DEPTH_LOG2));
+		end
+
+		// Pair edges as the processor will: a channel 1 edge first pairs with the
+		// outstanding channel 2 edge, then a channel 2 edge with the outstanding
+		// channel 1 edge (which may be from the same clock).  The glitch filter can
+		// accept an edge after a later edge on the other channel, so the timestamps
+		// are compared either way round
+		for (b = 0; b < NUM_BANKS; b = b + 1)
+		begin : bank
+			reg [31:0] last_1, last_2;			// unpaired edge timestamps
+			reg have_1, have_2;
+			reg [14:0] seq;						// pairs latched, wraps
+			reg [31:0] latch_time, latch_info;
+
+			wire edge_1 = captured[2*b];
+			wire edge_2 = captured[2*b+1];
+			wire [31:0] time_1 = stamps[32*(2*b) +: 32];
+			wire [31:0] time_2 = stamps[32*(2*b+1) +: 32];
+			wire [31:0] diff_1 = time_1 - last_2;
+			wire [31:0] diff_2 = time_2 - last_1;
+			wire near_1 = (diff_1[31] ? -diff_1 : diff_1) <= PAIR_WINDOW;
+			wire near_2 = (diff_2[31] ? -diff_2 : diff_2) <= PAIR_WINDOW;
+			wire pair_1 = edge_1 && have_2 && near_1;
+			wire pair_2 = edge_2 && !pair_1 && (edge_1 || (have_1 && near_2));
+
+			// the edges of the pair, and the next sequence number
+			wire [31:0] pair_1_time = edge_1 ? time_1 : last_1;
+			wire [31:0] pair_2_time = pair_1 ? last_2 : time_2;
+			wire [31:0] pair_diff = pair_1_time - pair_2_time;
+			wire [14:0] seq_next = seq + 1;
+
+			initial
+			begin
+				have_1 = 0;
+				have_2 = 0;
+				seq = 0;
+				latch_time = 0;
+				latch_info = 0;
+			end
+
+			always @(posedge clock)
+			begin
+				if (pair_1 || pair_2)
+				begin
+					seq <= seq_next;
+					latch_time <= pair_1_time;
+					latch_info <= {seq_next ^ (seq_next >> 1), 1'b1, pair_diff[15:0]};
+				end
+			end
+
+			assign pair_time[32*b +: 32] = latch_time;
+			assign pair_info[32*b +: 32] = latch_info;
+
+			always @(posedge clock)
+			begin
+				if (pair_1)
+				begin
+					have_1 <= 0;
+					have_2 <= edge_2;			// a channel 2 edge in the same clock waits
+					last_2 <= time_2;
+				end
+				else if (pair_2)
+				begin
+					have_1 <= 0;
+					have_2 <= 0;
+				end
+				else
+				begin
+					if (edge_1)
+					begin
+						have_1 <= 1;
+						last_1 <= time_1;
+					end
+					if (edge_2)
+					begin
+						have_2 <= 1;
+						last_2 <= time_2;
+					end
+				end
+			end
+
+			assign paired[b] = pair_1 || pair_2;
+		end
+	endgenerate
+
+endmodule
+
+
+/******************************************************/
+// MODULE: Edge_Filter
+//
+// DESCRIPTION:
+// Decides which rising edges of one channel are captured.
+// holdoff and quiet are in timestamp counts, min_high
+// in clocks; 0 turns a filter off.
+//
+// Glitch filter: a rising edge starts a candidate edge
+// with the timestamp of the rise.  It is accepted once
+// the input has been high for min_high clocks in all,
+// and dropped if the input is low for min_high clocks in
+// a row first.  A noise spike is dropped, and chatter on
+// a real edge (a short drop and a second rise) is folded
+// into it without moving its timestamp.
+//
+// Holdoff: an accepted edge less than holdoff counts
+// after the last captured edge is ignored (ringing).
+//
+// Onset: with onset set, an accepted edge is captured
+// only if no edge was accepted in the quiet counts
+// before it, so a tone burst gives its first edge.  Every
+// accepted edge, captured or not, restarts the silence.
+//
+// strobe is high for one clock, the clock the edge is
+// accepted in (its rise when min_high is 0 or 1), with
+// the edge's timestamp on stamp.  Edges are forgotten
+// 2^31 counts later so the timestamps can wrap.
+//
+/******************************************************/
+module Edge_Filter
+	(clock, signal, prev, counter, holdoff, min_high, quiet, onset, strobe, stamp);
+
+	input clock;
+	input signal;							// input level
+	input prev;								// input level in the last clock
+	input [31:0] counter;					// timestamp counter, or the time of a rise in this clock
+	input [31:0] holdoff;
+	input [15:0] min_high;
+	input [31:0] quiet;
+	input onset;
+	output strobe;							// an edge is captured
+	output [31:0] stamp;					// its timestamp
+
+	reg pending;							// a candidate edge is being qualified
+	reg [31:0] start;						// its timestamp
+	reg [15:0] high_count;					// clocks it has been high
+	reg [15:0] low_count;					// clocks it has been low in a row
+	reg [31:0] last_edge;					// last accepted edge
+	reg [31:0] last_capture;				// last captured edge
+	reg have_edge, have_capture;
+
+	wire rising = ~prev & signal;
+	wire begin_edge = !pending && rising;
+	wire accepted = (begin_edge && (min_high <= 1)) ||
+		(pending && signal && (high_count + 1 >= min_high));
+	wire held_off = have_capture && (stamp - last_capture < holdoff);
+	wire new_burst = !have_edge || (stamp - last_edge >= quiet);
+
+	assign stamp = pending ? start : counter;
+	assign strobe = accepted && !held_off && (!onset || new_burst);
+
+	initial
+	begin
+		pending = 0;
+		start = 0;
+		high_count = 0;
+		low_count = 0;
+		last_edge = 0;
+		last_capture = 0;
+		have_edge = 0;
+		have_capture = 0;
 	end
 
+	always @(posedge clock)
+	begin
+		// Qualify the candidate edge
+		if (accepted)
+			pending <= 0;
+		else if (begin_edge)
+		begin
+			pending <= 1;
+			start <= counter;
+			high_count <= 1;
+			low_count <= 0;
+		end
+		else if (pending && signal)
+		begin
+			high_count <= high_count + 1;
+			low_count <= 0;
+		end
+		else if (pending)
+		begin
+			if (low_count + 1 >= min_high)
+				pending <= 0;
+			low_count <= low_count + 1;
+		end
+
+		// Remember the last accepted and captured edges
+		if (accepted)
+		begin
+			last_edge <= stamp;
+			have_edge <= 1;
+		end
+		else if (counter - last_edge >= 32'h80000000)
+			have_edge <= 0;
+
+		if (strobe)
+		begin
+			last_capture <= stamp;
+			have_capture <= 1;
+		end
+		else if (counter - last_capture >= 32'h80000000)
+			have_capture <= 0;
+	end
 
 endmodule
 
 
+/******************************************************/
+// MODULE: Edge_FIFO
+//
+// DESCRIPTION:
+// First-word-fall-through FIFO of edge timestamps for
+// one channel.  head shows the oldest entry (or the last
+// popped entry when empty).  pop_toggle comes from the
+// AXI clock domain so it is synchronized before use;
+// each change pops one entry and pop_ack follows the
+// synchronized toggle once the pop has taken effect.
+// A push into a full FIFO is dropped and counted.
+// count_gray is the entry count for the bus side: Gray
+// coded from a register, and ahead of pop_ack by a clock.
+// count is combinational, for this clock domain only.
+//
+/******************************************************/
+module Edge_FIFO
+	#(parameter DEPTH_LOG2 = 4)
+	(clock, push, push_data, pop_toggle, head, count, count_gray, overflow, pop_ack);
+
+	input clock;
+	input push;								// queue push_data this cycle
+	input [31:0] push_data;
+	input pop_toggle;						// each change pops one entry
+	output [31:0] head;						// oldest queued entry
+	output [DEPTH_LOG2:0] count;			// entries queued
+	output reg [DEPTH_LOG2:0] count_gray;	// entries queued, registered and Gray coded
+	output reg [7:0] overflow;				// pushes dropped because the FIFO was full
+	output reg pop_ack;						// follows pop_toggle once the pop is done
+
+	localparam DEPTH = 1 << DEPTH_LOG2;
+
+	reg [31:0] mem [0:DEPTH-1];
+	reg [DEPTH_LOG2:0] wr_ptr, rd_ptr;		// extra bit tells full from empty
+	reg [2:0] pop_sync;						// 2-FF synchronizer plus previous value
+	reg [31:0] last;						// last popped entry
+
+	wire pop = (pop_sync[2] != pop_sync[1]) && (count != 0);
+	wire full = (count == DEPTH);
+	wire [DEPTH_LOG2:0] count_next = count + (push && !full) - pop;
 
+	assign count = wr_ptr - rd_ptr;
 
+	// Present the oldest entry; hold the last popped value when empty
+	assign head = (count != 0) ? mem[rd_ptr[DEPTH_LOG2-1:0]] : last;
+
+	initial
+	begin
+		wr_ptr = 0;
+		rd_ptr = 0;
+		pop_sync = 0;
+		last = 0;
+		overflow = 0;
+		count_gray = 0;
+		pop_ack = 0;
+	end
+
+	always @(posedge clock)
+	begin
+		pop_sync <= {pop_sync[1:0], pop_toggle};
+		count_gray <= count_next ^ (count_next >> 1);
+		pop_ack <= pop_sync[2];
+
+		// Queue the new edge, or count it as lost
+		if (push && !full)
+		begin
+			mem[wr_ptr[DEPTH_LOG2-1:0]] <= push_data;
+			wr_ptr <= wr_ptr + 1;
+		end
+		else if (push)
+			overflow <= overflow + 1;
+
+		if (pop)
+		begin
+			last <= head;
+			rd_ptr <= rd_ptr + 1;
+		end
+	end
+
+endmodule
@@ -0,0 +1,56 @@
+/**
+*
+* @file phase_ring.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the consumer side of the phase sample ring.  See phase_ring.h.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "phase_ring.h"
+
+
+/*****************************************************************************/
+/**
+* Empties the ring and clears its statistics.  Call before the producer starts.
+******************************************************************************/
+void RING_Initialize(PhaseRing *RingPtr)
+{
+	RingPtr->head = 0;
+	RingPtr->tail = 0;
+	RingPtr->overflows = 0;
+	RingPtr->high_water = 0;
+	RingPtr->pushed = 0;
+}
+
+
+/*****************************************************************************/
+/**
+* Removes up to "max" samples, oldest first.  Consumer side only.
+*
+* @param    RingPtr is a pointer to the ring
+* @param	SamplesPtr receives the samples
+* @param	max is the capacity of SamplesPtr
+*
+* @return	the number of samples removed
+*
+******************************************************************************/
+int RING_PopBatch(PhaseRing *RingPtr, PhaseSample *SamplesPtr, int max)
+{
+	u32 tail = RingPtr->tail;
+	u32 avail = RING_LOAD_ACQUIRE(&RingPtr->head) - tail;
+	int i;
+
+	if (avail > (u32) max)
+	{
+		avail = (u32) max;
+	}
+	for (i = 0; i < (int) avail; i++)
+	{
+		SamplesPtr[i] = RingPtr->buf[(tail + i) & PHASE_RING_MASK];
+	}
+	RING_STORE_RELEASE(&RingPtr->tail, tail + avail);
+	return (int) avail;
+}
@@ -0,0 +1,100 @@
+/**
+*
+* @file phase_ring.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the single-producer/single-consumer ring of timestamped phase
+* samples that carries every phase difference measured by Capture_Handler() to the
+* main loop.  The producer (interrupt level - handlers do not nest) and the consumer
+* (the main loop) each own one index, so no locks or interrupt masking are needed.
+* Indices run freely and are masked on access; the release store of an index
+* publishes the slots it covers.
+*
+* A push into a full ring drops the new sample and counts an overflow.  The producer
+* also keeps the high water mark of ring occupancy.
+*
+* RING_Push() is inline so it costs a handful of instructions in the ISR.
+*
+******************************************************************************/
+
+#ifndef PHASE_RING_H	/* prevent circular inclusions */
+#define PHASE_RING_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef PHASE_RING_SIZE
+#define PHASE_RING_SIZE		64				// entries, must be a power of 2
+#endif
+#define PHASE_RING_MASK		(PHASE_RING_SIZE - 1)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		tick;			// FIT tick the sample was measured on
+	int		phase_diff;		// time_1 - time_2 in clock counts
+} PhaseSample;
+
+typedef struct {
+	PhaseSample	buf[PHASE_RING_SIZE];
+	u32			head;			// next slot to write - written by the producer only
+	u32			tail;			// next slot to read - written by the consumer only
+	u32			overflows;		// samples dropped because the ring was full (producer)
+	u32			high_water;		// most samples ever queued (producer)
+	u32			pushed;			// samples queued (producer)
+} PhaseRing;
+
+/***************** Macros (Inline Functions) Definitions *********************/
+// Index hand-off between the ISR and the main loop (or two host threads)
+#if defined(__GNUC__)
+#define RING_LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define RING_LOAD_ACQUIRE(p)		(*(volatile u32 *)(p))
+#define RING_STORE_RELEASE(p, v)	(*(volatile u32 *)(p) = (v))
+#endif
+
+/*****************************************************************************/
+/**
+* Queues one sample.  Producer side only.
+*
+* @return	true if the sample was queued, false if the ring was full
+******************************************************************************/
+static inline bool RING_Push(PhaseRing *RingPtr, u32 tick, int phase_diff)
+{
+	u32 head = RingPtr->head;
+	u32 used = head - RING_LOAD_ACQUIRE(&RingPtr->tail);
+
+	if (used >= PHASE_RING_SIZE)
+	{
+		RingPtr->overflows++;
+		return false;
+	}
+	RingPtr->buf[head & PHASE_RING_MASK].tick = tick;
+	RingPtr->buf[head & PHASE_RING_MASK].phase_diff = phase_diff;
+	RING_STORE_RELEASE(&RingPtr->head, head + 1);
+
+	RingPtr->pushed++;
+	if (used + 1 > RingPtr->high_water)
+	{
+		RingPtr->high_water = used + 1;
+	}
+	return true;
+}
+
+/************************** Function Prototypes ******************************/
+void RING_Initialize(PhaseRing *RingPtr);
+int  RING_PopBatch(PhaseRing *RingPtr, PhaseSample *SamplesPtr, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
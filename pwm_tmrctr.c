@@ -20,6 +20,7 @@
 ******************************************************************************/
 /***************************** Include Files *********************************/
 #include "pwm_tmrctr.h"
+#include "latency_trace.h"
 
 
 /************************** Constant Definitions *****************************/
@@ -31,10 +32,18 @@
 
 
 /************************** Function Prototypes ******************************/
+static void write_duty_tlr(XTmrCtr *InstancePtr, u32 tlr1);
 
 
 /************************** Variable Definitions *****************************/
 float clock_frequency;		// clock frequency for the timer.  Usually the AXI bus clock
+u32	clock_hz;				// integer copy of clock_frequency
+
+// TLR1 (duty cycle count) for each duty cycle at the period last set by PWM_SetParams().
+// Lets PWM_SetDuty() change the duty cycle without any arithmetic.
+u32	duty_tlr[PWM_DUTY_STEPS + 1];
+u32	period_tlr;				// TLR0 the table was built for
+bool duty_tlr_valid = false;
 
 /*****************************************************************************/
 /**
@@ -89,6 +98,8 @@ int PWM_Initialize(XTmrCtr *InstancePtr, u16 DeviceId, bool EnableInterrupts, u3
 
 	// save the timer clock frequency
 	clock_frequency = (float) clkfreq;
+	clock_hz = clkfreq;
+	duty_tlr_valid = false;
 
 	return XST_SUCCESS;
 }
@@ -206,6 +217,8 @@ int PWM_SetParams(XTmrCtr *InstancePtr, u32 freq, u32 dutyfactor)
 			pwm_dc,
 			tlr0,
 			tlr1;
+	u32		duty;
+	u64		high;
      	
     if (InstancePtr->IsReady != XIL_COMPONENT_IS_READY) // check that instance is initialized
     {
@@ -239,6 +252,16 @@ int PWM_SetParams(XTmrCtr *InstancePtr, u32 freq, u32 dutyfactor)
     PWM_BaseAddress = InstancePtr->BaseAddress;
     XTmrCtr_SetLoadReg(PWM_BaseAddress, PWM_PERIOD_TIMER, (u32) tlr0);
   	XTmrCtr_SetLoadReg(PWM_BaseAddress, PWM_DUTY_TIMER, (u32) tlr1);
+
+	// precompute the duty cycle counts for PWM_SetDuty() at this period
+	// TLR1 = (CLOCK_FREQ * DUTY) / (FREQ * 100) - 2, in 64-bit integer math
+	for (duty = 0; duty <= PWM_DUTY_STEPS; duty++)
+	{
+		high = ((u64) clock_hz * duty) / ((u64) freq * PWM_DUTY_STEPS);
+		duty_tlr[duty] = (high > 2) ? (u32) (high - 2) : 0;
+	}
+	period_tlr = (u32) tlr0;
+	duty_tlr_valid = true;
 	return XST_SUCCESS;
 }
 
@@ -306,5 +329,127 @@ int PWM_GetParams(XTmrCtr *InstancePtr, u32 *freq, u32 *dutyfactor)
 	*dutyfactor = lroundf(pwm_dc * 100.00);
 	return XST_SUCCESS;
 }
-        	
-    	
+
+
+/*****************************************************************************/
+/**
+*
+* PWM_SetDuty() - Change the PWM duty cycle without stopping the timer
+*
+* Writes only the duty cycle load register (TLR1).  The timer keeps running and
+* the new count is picked up when the counters reload at the end of the current
+* period, so the output never glitches.  If the period timer is within
+* PWM_RELOAD_GUARD counts of its reload the write waits for the reload so the
+* new value cannot straddle it.  The count comes from a table built by the last
+* PWM_SetParams() call, so no arithmetic (and no floating point) is done here.
+*
+* @param    InstancePtr is a pointer to the PWM instance to be worked on.
+* @param	PWM high time (in pct of PWM period - 0 to 100)
+*
+* @return
+*
+*   - XST_SUCCESS if the duty cycle was loaded
+*   - XST_FAILURE if the PWM instance is not initialized or PWM_SetParams() has
+*	  not been called to set the period
+*	- XST_INVALID_PARAM if the duty cycle is > 100%
+*
+******************************************************************************/
+int PWM_SetDuty(XTmrCtr *InstancePtr, u32 dutyfactor)
+{
+    if ((InstancePtr->IsReady != XIL_COMPONENT_IS_READY) || !duty_tlr_valid)
+    {
+	    return XST_FAILURE;
+    }
+    if (dutyfactor > PWM_DUTY_STEPS)  // cannot have a duty cylce > 100%
+    {
+	   return XST_INVALID_PARAM;
+	}
+
+	write_duty_tlr(InstancePtr, duty_tlr[dutyfactor]);
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+*
+* PWM_SetHighTicks() - Change the PWM high time, in timer ticks, without stopping the timer
+*
+* Like PWM_SetDuty() but with the full resolution of the timer instead of whole
+* percents, e.g. 0.5 usec steps of a servo pulse at 100 MHz are 50 ticks.
+*
+* @param    InstancePtr is a pointer to the PWM instance to be worked on.
+* @param	ticks is the PWM high time in timer clock periods (0 to the period)
+*
+* @return
+*
+*   - XST_SUCCESS if the high time was loaded
+*   - XST_FAILURE if the PWM instance is not initialized or PWM_SetParams() has
+*	  not been called to set the period
+*	- XST_INVALID_PARAM if the high time is longer than the period
+*
+******************************************************************************/
+int PWM_SetHighTicks(XTmrCtr *InstancePtr, u32 ticks)
+{
+    if ((InstancePtr->IsReady != XIL_COMPONENT_IS_READY) || !duty_tlr_valid)
+    {
+	    return XST_FAILURE;
+    }
+    if (ticks > period_tlr + 2)  // cannot be high for longer than the period
+    {
+	   return XST_INVALID_PARAM;
+	}
+
+	// TLR1 = high time - 2, as for PWM_SetParams()
+	write_duty_tlr(InstancePtr, (ticks > 2) ? ticks - 2 : 0);
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+*
+* PWM_SetHighNs() - Change the PWM high time, in nanoseconds, without stopping the timer
+*
+* Converts to timer ticks (rounded) and calls PWM_SetHighTicks().  The conversion
+* costs a 64-bit division, so callers on a fast path should convert once and use
+* PWM_SetHighTicks().
+*
+* @param    InstancePtr is a pointer to the PWM instance to be worked on.
+* @param	ns is the PWM high time in nanoseconds
+*
+* @return	as for PWM_SetHighTicks()
+*
+******************************************************************************/
+int PWM_SetHighNs(XTmrCtr *InstancePtr, u32 ns)
+{
+	return PWM_SetHighTicks(InstancePtr, (u32) (((u64) clock_hz * ns + 500000000) / 1000000000));
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Loads TLR1 while the timer runs
+*
+* If the period timer is within PWM_RELOAD_GUARD counts of its reload the write
+* waits for the reload so the new value cannot straddle it.
+*****************************************************************************/
+static void write_duty_tlr(XTmrCtr *InstancePtr, u32 tlr1)
+{
+	u32		PWM_BaseAddress;
+
+    // stay clear of the period reload (the period timer counts down to 0)
+    PWM_BaseAddress = InstancePtr->BaseAddress;
+    if ((period_tlr > 2 * PWM_RELOAD_GUARD) &&
+		(XTmrCtr_GetControlStatusReg(PWM_BaseAddress, PWM_PERIOD_TIMER) & XTC_CSR_ENABLE_TMR_MASK))
+    {
+		while (XTmrCtr_GetTimerCounterReg(PWM_BaseAddress, PWM_PERIOD_TIMER) < PWM_RELOAD_GUARD)
+		{
+			// spin until the period reloads
+		}
+	}
+  	XTmrCtr_SetLoadReg(PWM_BaseAddress, PWM_DUTY_TIMER, tlr1);
+	LTRACE_NEXT(LTRACE_TLR);
+}
@@ -42,6 +42,9 @@ extern "C" {
 #define PWM_PERIOD_TIMER	0
 #define PWM_DUTY_TIMER		1
 
+#define PWM_DUTY_STEPS		100		// duty cycle table resolution (percent)
+#define PWM_RELOAD_GUARD	64		// timer counts before the period reload in which TLR1 is not written
+
 /**************************** Type Definitions *******************************/
 
 
@@ -54,6 +57,9 @@ int PWM_Start(XTmrCtr *InstancePtr);
 int PWM_Stop(XTmrCtr *InstancePtr);
 int PWM_SetParams(XTmrCtr *InstancePtr, u32 freq, u32 dutyfactor);
 int PWM_GetParams(XTmrCtr *InstancePtr, u32 *freq, u32 *dutyfactor);
+int PWM_SetDuty(XTmrCtr *InstancePtr, u32 dutyfactor);
+int PWM_SetHighTicks(XTmrCtr *InstancePtr, u32 ticks);
+int PWM_SetHighNs(XTmrCtr *InstancePtr, u32 ns);
 
 /************************** Variable Definitions *****************************/
 
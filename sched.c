@@ -0,0 +1,218 @@
+/**
+*
+* @file sched.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides a small cooperative task scheduler driven by the FIT tick count.
+* SCHED_Run() is called from the main loop; it runs every task whose release time has
+* passed, earliest deadline first, and returns.  Tasks must not block.
+*
+* A periodic task is re-released every "period" ticks from its previous release; if
+* the loop falls more than a period behind, the skipped releases are counted as misses
+* rather than run back to back.  A one-shot task runs once per SCHED_Release().
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "sched.h"
+
+
+/***************** Macros (Inline Functions) Definitions *********************/
+// true if tick "a" is at or after tick "b" (handles counter wrap)
+#define TICK_AFTER_EQ(a, b)		((s32)((a) - (b)) >= 0)
+
+
+/*****************************************************************************/
+/**
+* Initializes the scheduler
+*
+* @param    InstancePtr is a pointer to the scheduler instance
+* @param	clock points to the FIT tick counter
+*
+******************************************************************************/
+void SCHED_Initialize(Sched *InstancePtr, volatile u32 *clock)
+{
+	InstancePtr->clock = clock;
+	InstancePtr->num_tasks = 0;
+}
+
+
+/*****************************************************************************/
+/**
+* Registers a task
+*
+* Periodic tasks (period != 0) are released immediately.  One-shot tasks
+* (period == 0) wait for SCHED_Release().
+*
+* @param    InstancePtr is a pointer to the scheduler instance
+* @param	TaskPtr is the task control block (must stay valid)
+* @param	name is a short name for reporting
+* @param	fn is the task function
+* @param	CallBackRef is passed to fn
+* @param	period is the release period in ticks, or 0 for a one-shot task
+* @param	deadline is the deadline in ticks relative to each release
+*
+* @return
+*
+*   - XST_SUCCESS if the task was added
+*   - XST_FAILURE if the task table is full
+*
+******************************************************************************/
+int SCHED_AddTask(Sched *InstancePtr, SchedTask *TaskPtr, const char *name, SchedTaskFn fn,
+		void *CallBackRef, u32 period, u32 deadline)
+{
+	if (InstancePtr->num_tasks >= SCHED_MAX_TASKS)
+	{
+		return XST_FAILURE;
+	}
+
+	TaskPtr->name = name;
+	TaskPtr->fn = fn;
+	TaskPtr->CallBackRef = CallBackRef;
+	TaskPtr->period = period;
+	TaskPtr->deadline = deadline;
+	TaskPtr->release = *InstancePtr->clock;
+	TaskPtr->armed = (period != 0);
+	TaskPtr->runs = 0;
+	TaskPtr->misses = 0;
+	TaskPtr->run_ticks = 0;
+	TaskPtr->run_ticks_max = 0;
+	TaskPtr->late_max = 0;
+
+	InstancePtr->tasks[InstancePtr->num_tasks++] = TaskPtr;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Releases a one-shot task "delay" ticks from now
+*
+* If the task is already pending the earlier of the two releases is kept.
+* Safe to call from a task.
+*
+******************************************************************************/
+void SCHED_Release(Sched *InstancePtr, SchedTask *TaskPtr, u32 delay)
+{
+	u32 release = *InstancePtr->clock + delay;
+
+	if (!TaskPtr->armed || TICK_AFTER_EQ(TaskPtr->release, release))
+	{
+		TaskPtr->release = release;
+	}
+	TaskPtr->armed = true;
+}
+
+
+/*****************************************************************************/
+/**
+* Cancels a pending release of a task
+******************************************************************************/
+void SCHED_Cancel(SchedTask *TaskPtr)
+{
+	TaskPtr->armed = false;
+}
+
+
+/*****************************************************************************/
+/**
+* Finds the earliest pending release
+*
+* @param    InstancePtr is a pointer to the scheduler instance
+* @param	release receives the tick of the earliest pending release (it may have passed)
+*
+* @return	true if a task has a pending release, false if none will run until released
+*
+******************************************************************************/
+bool SCHED_NextRelease(Sched *InstancePtr, u32 *release)
+{
+	SchedTask	*task;
+	bool		found = false;
+	int			i;
+
+	for (i = 0; i < InstancePtr->num_tasks; i++)
+	{
+		task = InstancePtr->tasks[i];
+		if (task->armed && (!found || !TICK_AFTER_EQ(task->release, *release)))
+		{
+			*release = task->release;
+			found = true;
+		}
+	}
+	return found;
+}
+
+
+/*****************************************************************************/
+/**
+* Runs all released tasks, earliest deadline first
+*
+* @param    InstancePtr is a pointer to the scheduler instance
+*
+* @return	the number of tasks run
+*
+******************************************************************************/
+int SCHED_Run(Sched *InstancePtr)
+{
+	SchedTask	*task, *next;
+	u32			now, start, ran, late, skipped;
+	int			i, count = 0;
+
+	for (;;)
+	{
+		// pick the released task with the earliest absolute deadline
+		now = *InstancePtr->clock;
+		next = NULL;
+		for (i = 0; i < InstancePtr->num_tasks; i++)
+		{
+			task = InstancePtr->tasks[i];
+			if (task->armed && TICK_AFTER_EQ(now, task->release) &&
+				((next == NULL) ||
+				 ((s32)((task->release + task->deadline) - (next->release + next->deadline)) < 0)))
+			{
+				next = task;
+			}
+		}
+		if (next == NULL)
+		{
+			return count;
+		}
+
+		// run it and account for the time taken
+		start = now;
+		late = start - next->release;
+		next->armed = false;
+		next->fn(next->CallBackRef);
+		ran = *InstancePtr->clock - start;
+
+		next->runs++;
+		next->run_ticks += ran;
+		if (ran > next->run_ticks_max)
+		{
+			next->run_ticks_max = ran;
+		}
+		if (late > next->late_max)
+		{
+			next->late_max = late;
+		}
+		if ((late + ran) > next->deadline)
+		{
+			next->misses++;
+		}
+
+		// schedule the next release of a periodic task, dropping any that were missed
+		if (next->period != 0)
+		{
+			next->release += next->period;
+			if (!TICK_AFTER_EQ(next->release, start))
+			{
+				skipped = (start - next->release) / next->period + 1;
+				next->release += skipped * next->period;
+				next->misses += skipped;
+			}
+			next->armed = true;
+		}
+		count++;
+	}
+}
@@ -0,0 +1,71 @@
+/**
+*
+* @file sched.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for sched.c.
+* sched.c is a small cooperative (run-to-completion) task scheduler for the main loop.
+* Time is the FIT tick count maintained by FIT_Handler(), so a tick is 1/FIT_CLOCK_FREQ_HZ
+* (25 usec).  Tasks are periodic or one-shot and each has a relative deadline; the
+* scheduler keeps per-task run counts, run times and deadline misses.
+* SCHED_NextRelease() tells an idle loop how long it can sleep.
+*
+******************************************************************************/
+
+#ifndef SCHED_H	/* prevent circular inclusions */
+#define SCHED_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#define SCHED_MAX_TASKS		8
+
+/**************************** Type Definitions *******************************/
+typedef void (*SchedTaskFn)(void *CallBackRef);
+
+typedef struct {
+	const char	*name;
+	SchedTaskFn	fn;
+	void		*CallBackRef;
+	u32			period;			// ticks between releases, 0 for a one-shot task
+	u32			deadline;		// ticks after release by which the task must complete
+	u32			release;		// tick of the next (or pending) release
+	bool		armed;			// task has a pending release
+
+	// statistics
+	u32			runs;
+	u32			misses;			// releases completed late or skipped
+	u32			run_ticks;		// total ticks spent running
+	u32			run_ticks_max;	// longest single run
+	u32			late_max;		// worst release-to-start delay
+} SchedTask;
+
+typedef struct {
+	volatile u32	*clock;		// FIT tick counter
+	SchedTask		*tasks[SCHED_MAX_TASKS];
+	int				num_tasks;
+} Sched;
+
+/************************** Function Prototypes ******************************/
+void SCHED_Initialize(Sched *InstancePtr, volatile u32 *clock);
+int  SCHED_AddTask(Sched *InstancePtr, SchedTask *TaskPtr, const char *name, SchedTaskFn fn,
+		void *CallBackRef, u32 period, u32 deadline);
+void SCHED_Release(Sched *InstancePtr, SchedTask *TaskPtr, u32 delay);
+void SCHED_Cancel(SchedTask *TaskPtr);
+int  SCHED_Run(Sched *InstancePtr);
+bool SCHED_NextRelease(Sched *InstancePtr, u32 *release);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
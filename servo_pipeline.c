@@ -0,0 +1,313 @@
+/**
+*
+* @file servo_pipeline.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the driver for Servo_Pipeline, the fabric TDOA to servo path.  The
+* processor is off the hot path: it loads the pairing window and the phase difference to
+* pulse width mapping, switches the servo between the fabric and the axi_timer PWM, and
+* watches the pair counter.  Each register write sets the data and address and flips the
+* write toggle; the hardware echoes the toggle in the status register once the register
+* has been written, so writes are never lost across the clock domain crossing.
+* Phase_Detection's edge filters are set through the same port.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include "servo_pipeline.h"
+
+
+/*****************************************************************************/
+/**
+* Initializes the servo pipeline driver
+*
+* The pipeline is left as it is (it powers up disabled).
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	CtlDeviceId is the device id of the GPIO used for register writes
+* @param	StsDeviceId is the device id of the GPIO used for the phase difference and status
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_FAILURE if the GPIOs could not be initialized
+*
+******************************************************************************/
+int SPIPE_Initialize(ServoPipe *InstancePtr, u16 CtlDeviceId, u16 StsDeviceId)
+{
+	int status;
+	u32 sts;
+
+	status = XGpio_Initialize(&InstancePtr->CtlInst, CtlDeviceId);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	status = XGpio_Initialize(&InstancePtr->StsInst, StsDeviceId);
+	if (status != XST_SUCCESS)
+	{
+		return XST_FAILURE;
+	}
+	XGpio_SetDataDirection(&InstancePtr->CtlInst, SPIPE_DATA_CHANNEL, 0x00000000);
+	XGpio_SetDataDirection(&InstancePtr->CtlInst, SPIPE_CTL_CHANNEL, 0x00000000);
+	XGpio_SetDataDirection(&InstancePtr->StsInst, SPIPE_PHASE_CHANNEL, 0xFFFFFFFF);
+	XGpio_SetDataDirection(&InstancePtr->StsInst, SPIPE_STATUS_CHANNEL, 0xFFFFFFFF);
+
+	// start from the toggle state the hardware is already in so nothing is written
+	sts = XGpio_DiscreteRead(&InstancePtr->StsInst, SPIPE_STATUS_CHANNEL);
+	InstancePtr->ctl = (sts & SPIPE_STS_ACK_MASK) ? SPIPE_CTL_WRITE_MASK : 0;
+	XGpio_DiscreteWrite(&InstancePtr->CtlInst, SPIPE_CTL_CHANNEL, InstancePtr->ctl);
+	InstancePtr->pairs_last = (sts & SPIPE_STS_PAIRS_MASK) >> SPIPE_STS_PAIRS_SHIFT;
+	InstancePtr->pairs = 0;
+	InstancePtr->mapping = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Writes a pipeline register
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	reg is the register (SPIPE_REG_*), a Servo_Pipeline or an edge filter register
+* @param	value is the value to write
+*
+* @return
+*
+*   - XST_SUCCESS if the write was acknowledged
+*   - XST_INVALID_PARAM if reg is not a register
+*   - XST_FAILURE if the hardware did not acknowledge the write
+*
+******************************************************************************/
+int SPIPE_Write(ServoPipe *InstancePtr, int reg, u32 value)
+{
+	u32 sts;
+	int spin;
+
+	if (((reg < SPIPE_REG_CTRL) || (reg > SPIPE_REG_TABLE)) &&
+		((reg < SPIPE_REG_EDGE_CTRL) || (reg > SPIPE_REG_WAKE)))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	// data first, then the address with the toggled write bit
+	XGpio_DiscreteWrite(&InstancePtr->CtlInst, SPIPE_DATA_CHANNEL, value);
+	InstancePtr->ctl = ((InstancePtr->ctl ^ SPIPE_CTL_WRITE_MASK) & SPIPE_CTL_WRITE_MASK) |
+		(reg & SPIPE_CTL_ADDR_MASK);
+	XGpio_DiscreteWrite(&InstancePtr->CtlInst, SPIPE_CTL_CHANNEL, InstancePtr->ctl);
+
+	for (spin = 0; spin < SPIPE_ACK_SPIN_LIMIT; spin++)
+	{
+		sts = XGpio_DiscreteRead(&InstancePtr->StsInst, SPIPE_STATUS_CHANNEL);
+		if (((sts & SPIPE_STS_ACK_MASK) != 0) == ((InstancePtr->ctl & SPIPE_CTL_WRITE_MASK) != 0))
+		{
+			return XST_SUCCESS;
+		}
+	}
+	return XST_FAILURE;
+}
+
+
+/*****************************************************************************/
+/**
+* Loads the pairing window and the phase difference to pulse width mapping
+*
+* pulse width = center + (phase_diff * gain) >> SPIPE_GAIN_FRAC, clamped to [min, max],
+* unless SPIPE_UseTable() maps by the pulse width table (which is clamped the same way).
+* All times are in Phase_Detection clock counts.
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	window is the largest valid phase difference
+* @param	gain is the pulse width change per count of phase difference, << SPIPE_GAIN_FRAC
+* @param	center is the pulse width for a phase difference of 0
+* @param	min is the shortest pulse width
+* @param	max is the longest pulse width
+* @param	period is the PWM period
+*
+* @return
+*
+*   - XST_SUCCESS if every register was written
+*   - XST_INVALID_PARAM if the pulse widths do not fit in the period
+*   - XST_FAILURE if the hardware did not acknowledge a write
+*
+******************************************************************************/
+int SPIPE_SetMapping(ServoPipe *InstancePtr, u32 window, s32 gain, u32 center, u32 min,
+		u32 max, u32 period)
+{
+	const u32	regs[] = { SPIPE_REG_WINDOW, SPIPE_REG_GAIN, SPIPE_REG_CENTER, SPIPE_REG_MIN,
+						   SPIPE_REG_MAX, SPIPE_REG_PERIOD };
+	const u32	values[] = { window, (u32) gain, center, min, max, period };
+	int			i;
+
+	if ((min > center) || (center > max) || (max >= period))
+	{
+		return XST_INVALID_PARAM;
+	}
+	for (i = 0; i < (int) (sizeof(regs) / sizeof(regs[0])); i++)
+	{
+		if (SPIPE_Write(InstancePtr, regs[i], values[i]) != XST_SUCCESS)
+		{
+			return XST_FAILURE;
+		}
+	}
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Writes one entry of the pulse width table
+*
+* The table is used once SPIPE_UseTable() selects it.
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	index is the entry, 0 to SPIPE_TABLE_ENTRIES - 1
+* @param	width is the pulse width for the entry's phase difference, in clock counts
+*
+* @return
+*
+*   - XST_SUCCESS if the entry was written
+*   - XST_INVALID_PARAM if index is not an entry or width does not fit
+*   - XST_FAILURE if the hardware did not acknowledge the write
+*
+******************************************************************************/
+int SPIPE_SetTableEntry(ServoPipe *InstancePtr, int index, u32 width)
+{
+	if ((index < 0) || (index >= SPIPE_TABLE_ENTRIES) || (width > SPIPE_TABLE_WIDTH_MASK))
+	{
+		return XST_INVALID_PARAM;
+	}
+	return SPIPE_Write(InstancePtr, SPIPE_REG_TABLE, ((u32) index << SPIPE_TABLE_INDEX_SHIFT) | width);
+}
+
+
+/*****************************************************************************/
+/**
+* Maps phase differences by the pulse width table instead of the gain and center
+*
+* Entry i is the pulse width for a phase difference of (i - SPIPE_TABLE_HALF) << step_log2,
+* and the pipeline interpolates linearly in between.  The pairing window has to stay
+* below (SPIPE_TABLE_HALF - 1) << step_log2 so every valid difference has an entry on
+* either side.  The output enable is left as it is.
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	step_log2 is the phase difference step between entries, 2^n counts
+*
+* @return
+*
+*   - XST_SUCCESS if the pipeline acknowledged the change
+*   - XST_INVALID_PARAM if step_log2 is more than SPIPE_TABLE_STEP_MAX
+*   - XST_FAILURE if the hardware did not acknowledge the write
+*
+******************************************************************************/
+int SPIPE_UseTable(ServoPipe *InstancePtr, int step_log2)
+{
+	if ((step_log2 < 0) || (step_log2 > SPIPE_TABLE_STEP_MAX))
+	{
+		return XST_INVALID_PARAM;
+	}
+	InstancePtr->mapping = SPIPE_CTRL_TABLE | ((u32) step_log2 << SPIPE_CTRL_STEP_SHIFT);
+	return SPIPE_Write(InstancePtr, SPIPE_REG_CTRL,
+		InstancePtr->mapping | (SPIPE_IsEnabled(InstancePtr) ? SPIPE_CTRL_ENABLE : 0));
+}
+
+
+/*****************************************************************************/
+/**
+* Hands the servo to the fabric pipeline (enable) or back to the axi_timer PWM
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	enable is true to drive the servo from the fabric
+*
+* @return
+*
+*   - XST_SUCCESS if the pipeline acknowledged the change
+*   - XST_FAILURE otherwise
+*
+******************************************************************************/
+int SPIPE_Enable(ServoPipe *InstancePtr, bool enable)
+{
+	return SPIPE_Write(InstancePtr, SPIPE_REG_CTRL, InstancePtr->mapping | (enable ? SPIPE_CTRL_ENABLE : 0));
+}
+
+
+/*****************************************************************************/
+/**
+* Sets Phase_Detection's edge filters, for every microphone
+*
+* A rising edge is captured with the timestamp of the rise once the input has been high
+* for min_high clocks (the input dropping for fewer clocks in a row does not cancel it),
+* unless it is within holdoff counts of the last captured edge.  With onset, only an edge
+* that follows quiet counts with no edge is captured, the first edge of a sound burst.
+* With latch only the edges are not queued in the FIFOs, for firmware that reads the
+* latched pair instead.  The filters power up off (all 0).
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	min_high is the glitch filter, in Phase_Detection clocks (0 or 1 = off)
+* @param	holdoff is the time to ignore edges after a capture, in clock counts (0 = off)
+* @param	ctrl is SPIPE_EDGE_CTRL_ONSET to capture only the first edge of each burst,
+*			ORed with SPIPE_EDGE_CTRL_LATCH for latch only
+* @param	quiet is the silence that starts a new burst, in clock counts
+*
+* @return
+*
+*   - XST_SUCCESS if every register was written
+*   - XST_INVALID_PARAM if min_high is more than SPIPE_MIN_HIGH_MAX
+*   - XST_FAILURE if the hardware did not acknowledge a write
+*
+******************************************************************************/
+int SPIPE_SetEdgeFilter(ServoPipe *InstancePtr, u32 min_high, u32 holdoff, u32 ctrl, u32 quiet)
+{
+	const u32	regs[] = { SPIPE_REG_MIN_HIGH, SPIPE_REG_HOLDOFF, SPIPE_REG_QUIET, SPIPE_REG_EDGE_CTRL };
+	const u32	values[] = { min_high, holdoff, quiet, ctrl };
+	int			i;
+
+	if (min_high > SPIPE_MIN_HIGH_MAX)
+	{
+		return XST_INVALID_PARAM;
+	}
+	for (i = 0; i < (int) (sizeof(regs) / sizeof(regs[0])); i++)
+	{
+		if (SPIPE_Write(InstancePtr, regs[i], values[i]) != XST_SUCCESS)
+		{
+			return XST_FAILURE;
+		}
+	}
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Returns true if the fabric is driving the servo
+******************************************************************************/
+bool SPIPE_IsEnabled(ServoPipe *InstancePtr)
+{
+	return (XGpio_DiscreteRead(&InstancePtr->StsInst, SPIPE_STATUS_CHANNEL) & SPIPE_STS_ENABLED_MASK) != 0;
+}
+
+
+/*****************************************************************************/
+/**
+* Reads the pipeline's progress
+*
+* @param    InstancePtr is a pointer to the ServoPipe instance
+* @param	phase_diff receives the last phase difference the fabric mapped
+*
+* @return	the number of pairs the fabric has mapped since the last call.  The
+*			hardware counter wraps at 65536, so poll at least that often.
+*
+******************************************************************************/
+int SPIPE_Poll(ServoPipe *InstancePtr, int *phase_diff)
+{
+	u32 sts, pairs, n;
+
+	sts = XGpio_DiscreteRead(&InstancePtr->StsInst, SPIPE_STATUS_CHANNEL);
+	*phase_diff = (int) XGpio_DiscreteRead(&InstancePtr->StsInst, SPIPE_PHASE_CHANNEL);
+	pairs = (sts & SPIPE_STS_PAIRS_MASK) >> SPIPE_STS_PAIRS_SHIFT;
+	n = (pairs - InstancePtr->pairs_last) & (SPIPE_STS_PAIRS_MASK >> SPIPE_STS_PAIRS_SHIFT);
+	InstancePtr->pairs_last = pairs;
+	InstancePtr->pairs += n;
+	return (int) n;
+}
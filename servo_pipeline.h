@@ -0,0 +1,112 @@
+/**
+*
+* @file servo_pipeline.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for servo_pipeline.c.
+* servo_pipeline.c configures and supervises Servo_Pipeline, the fabric path that pairs
+* the mic 1 and mic 2 edges and drives the servo PWM without the processor.  Registers
+* are written through GPIO 6 (channel 1 = data, channel 2 = address and write toggle)
+* and the pipeline is monitored through GPIO 7 (channel 1 = last phase difference,
+* channel 2 = status).  See servo_pipeline.v for the register map.
+*
+* The same write port carries Phase_Detection's edge filter registers (glitch filter,
+* holdoff and onset mode, see phase_detection.v), set with SPIPE_SetEdgeFilter().  They
+* apply whether or not the fabric drives the servo.  Phase_Detection's WAKE register,
+* the timestamp its wake interrupt fires at, is written the same way with SPIPE_Write().
+*
+******************************************************************************/
+
+#ifndef SERVO_PIPELINE_H	/* prevent circular inclusions */
+#define SERVO_PIPELINE_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xgpio.h"
+
+/************************** Constant Definitions *****************************/
+#define SPIPE_DATA_CHANNEL		1			// GPIO 6 channels
+#define SPIPE_CTL_CHANNEL		2
+#define SPIPE_PHASE_CHANNEL		1			// GPIO 7 channels
+#define SPIPE_STATUS_CHANNEL	2
+
+// registers
+#define SPIPE_REG_CTRL			0
+#define SPIPE_REG_WINDOW		1
+#define SPIPE_REG_GAIN			2
+#define SPIPE_REG_CENTER		3
+#define SPIPE_REG_MIN			4
+#define SPIPE_REG_MAX			5
+#define SPIPE_REG_PERIOD		6
+#define SPIPE_REG_TABLE			7			// pulse width table entry
+
+// Phase_Detection registers: edge filters and the wakeup
+#define SPIPE_REG_EDGE_CTRL		8
+#define SPIPE_REG_HOLDOFF		9
+#define SPIPE_REG_MIN_HIGH		10
+#define SPIPE_REG_QUIET			11
+#define SPIPE_REG_WAKE			12			// one-shot wake interrupt time
+
+#define SPIPE_CTRL_ENABLE		0x01
+#define SPIPE_CTRL_TABLE		0x02		// map by the table instead of GAIN and CENTER
+#define SPIPE_CTRL_STEP_SHIFT	8			// table step log2
+#define SPIPE_EDGE_CTRL_ONSET	0x01
+#define SPIPE_EDGE_CTRL_LATCH	0x02		// latch only: the edge FIFOs are not pushed
+#define SPIPE_MIN_HIGH_MAX		0xFFFF		// MIN_HIGH is 16 bits
+
+// control and status fields
+#define SPIPE_CTL_ADDR_MASK		0x0F
+#define SPIPE_CTL_WRITE_MASK	0x80
+#define SPIPE_STS_ENABLED_MASK	0x00000001
+#define SPIPE_STS_ACK_MASK		0x00000080
+#define SPIPE_STS_PAIRS_MASK	0xFFFF0000
+#define SPIPE_STS_PAIRS_SHIFT	16
+
+#define SPIPE_GAIN_FRAC			16			// fraction bits of the gain register
+
+// pulse width table: entry i is the pulse width for a phase difference of
+// (i - SPIPE_TABLE_HALF) << step, interpolated in between
+#define SPIPE_TABLE_ENTRIES		64
+#define SPIPE_TABLE_HALF		32
+#define SPIPE_TABLE_STEP_MAX	16
+#define SPIPE_TABLE_INDEX_SHIFT	24
+#define SPIPE_TABLE_WIDTH_MASK	0x00FFFFFF
+
+// status polls to wait for a write acknowledge before giving up
+#define SPIPE_ACK_SPIN_LIMIT	64
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	XGpio	CtlInst;			// GPIO 6 - register writes
+	XGpio	StsInst;			// GPIO 7 - phase difference and status
+	u32		ctl;				// control word last written
+	u32		mapping;			// CTRL table bits, kept across SPIPE_Enable()
+	u32		pairs_last;			// pair counter at the last SPIPE_Poll()
+	u32		pairs;				// pairs mapped by the fabric since initialization
+} ServoPipe;
+
+/************************** Function Prototypes ******************************/
+int SPIPE_Initialize(ServoPipe *InstancePtr, u16 CtlDeviceId, u16 StsDeviceId);
+int SPIPE_Write(ServoPipe *InstancePtr, int reg, u32 value);
+int SPIPE_SetMapping(ServoPipe *InstancePtr, u32 window, s32 gain, u32 center, u32 min,
+		u32 max, u32 period);
+int SPIPE_SetTableEntry(ServoPipe *InstancePtr, int index, u32 width);
+int SPIPE_UseTable(ServoPipe *InstancePtr, int step_log2);
+int SPIPE_Enable(ServoPipe *InstancePtr, bool enable);
+int SPIPE_SetEdgeFilter(ServoPipe *InstancePtr, u32 min_high, u32 holdoff, u32 ctrl, u32 quiet);
+bool SPIPE_IsEnabled(ServoPipe *InstancePtr);
+int SPIPE_Poll(ServoPipe *InstancePtr, int *phase_diff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */
@@ -0,0 +1,299 @@
+/******************************************************/
+// MODULE: Servo_Pipeline
+//
+// FILE NAME:	servo_pipeline.v
+// VERSION: 1.3
+// DATE:	3/16/16
+// AUTHOR:	Chris Dean, Meng Lei
+//
+// DESCRIPTION:
+// Fabric path from the microphone edges to the servo,
+// next to Phase_Detection, so the processor is not in
+// the loop between a sound and the servo command.
+//
+// The mic 1 and mic 2 captured edge strobes from
+// Phase_Detection are paired the same way FIT_Handler()
+// pairs them: an edge pairs with the outstanding edge on
+// the other channel if their timestamps are at most
+// WINDOW counts apart, otherwise it waits for a partner.
+// (The timestamps come with the strobes: with its glitch
+// filter on, Phase_Detection strobes an edge some clocks
+// after the rise it is timestamped with.)  The
+// signed difference (positive when mic 1 is later) is
+// mapped to a servo pulse width, linearly:
+//
+//	high = CENTER + (diff * GAIN) >>> 16
+//
+// or, with CTRL[1] set, by interpolating in a table of
+// 64 pulse widths, entry i for diff = (i - 32) << STEP:
+//
+//	high = TABLE[i] + ((TABLE[i+1] - TABLE[i]) * f) >>> 16
+//
+// where i = (diff >>> STEP) + 32 and f is the rest of
+// diff, scaled to 16 bits.  Either way the pulse width
+// is clamped to [MIN, MAX], and drives a PWM of PERIOD
+// counts.  The table lets the fabric point by the
+// arcsine bearing, as phase_task() does (bearing.c); a
+// linear mapping only matches it near broadside.  The
+// firmware loads it from the same BearingTable.  STEP
+// must be at most 16 and |diff| up to WINDOW must stay
+// below 31 << STEP.
+//
+// A new pulse width is ready 3 clocks after the edge
+// that completes the pair; like the axi_timer PWM it
+// takes effect at the start of the next PWM period so
+// no pulse is cut short.
+// The output only drives the servo when CTRL[0] is set;
+// otherwise the axi_timer PWM does (see n4fpga.v).
+//
+// The processor configures the pipeline through one
+// register write port in the AXI clock domain: it sets
+// wr_addr/wr_data and toggles wr_toggle; wr_ack follows
+// the toggle once the register has been written (the
+// same handshake as the Edge_FIFO pops).  Registers and
+// their power-up values, in clk2 counts (addresses 8 to
+// 15 are Phase_Detection's edge filter registers):
+//	0 CTRL		[0] servo output enable			0
+//				[1] table mapping				0
+//				[12:8] STEP, table step log2	0
+//	1 WINDOW	largest valid |diff|			25000
+//	2 GAIN		signed, pulse counts per diff count
+//				<< 16							209715
+//	3 CENTER	pulse width at diff = 0			140000
+//	4 MIN		shortest pulse width			60000
+//	5 MAX		longest pulse width				220000
+//	6 PERIOD	PWM period						2000000
+//	7 TABLE		[29:24] entry, [23:0] pulse width	0
+// The power-up mapping is linear, 7% +/- 4% of a 50 Hz
+// period over +/- 25000 counts at 100 MHz; phase_task()
+// points over the same pulse widths but by the arcsine.
+// With TIME_FRAC_BITS sub-clock timestamp bits (see
+// Phase_Detection FRAC_BITS) the differences are in
+// fine counts, and the power-up WINDOW and GAIN are
+// scaled to match; the pulse widths stay in clocks.
+//
+// For supervision the last paired difference, the
+// number of pairs (wraps) and the enable are readable.
+//
+/******************************************************/
+
+
+// MODULE
+module Servo_Pipeline
+	#(parameter TIME_FRAC_BITS = 0)			// timestamp counts per clock = 2^TIME_FRAC_BITS
+	(clock, edges, times, wr_toggle, wr_addr, wr_data, wr_ack, enabled, pairs, phase_diff, pwm);
+
+	input clock;							// clk2, the Phase_Detection clock
+	input [1:0] edges;						// mic 1 / mic 2 captured edge strobes from Phase_Detection
+	input [63:0] times;						// their timestamps, mic 2 in [63:32]
+	input wr_toggle;						// each change writes wr_data to register wr_addr
+	input [3:0] wr_addr;
+	input [31:0] wr_data;
+	output wr_ack;							// follows wr_toggle once the write is done
+	output enabled;							// CTRL[0]
+	output reg [15:0] pairs;				// pairs mapped since power up, wraps
+	output reg signed [31:0] phase_diff;	// last paired time_1 - time_2
+	output reg pwm;							// servo PWM
+
+	localparam REG_CTRL = 0;
+	localparam REG_WINDOW = 1;
+	localparam REG_GAIN = 2;
+	localparam REG_CENTER = 3;
+	localparam REG_MIN = 4;
+	localparam REG_MAX = 5;
+	localparam REG_PERIOD = 6;
+	localparam REG_TABLE = 7;
+	localparam TABLE_HALF = 32;				// entry for diff = 0
+
+	// configuration registers
+	reg [31:0] ctrl, window, period;
+	reg signed [31:0] gain, center, min_high, max_high;
+	reg [2:0] wr_sync;						// 2-FF synchronizer plus previous value
+	reg signed [31:0] widths [0:2*TABLE_HALF-1];	// TABLE pulse widths, distributed RAM
+	integer i;
+
+	// pairing state
+	reg [31:0] pend_1, pend_2;				// unpaired edge timestamps
+	reg have_1, have_2;
+
+	// pipeline
+	reg s1_valid, s2_valid;
+	reg signed [31:0] s1_diff;
+	reg signed [31:0] s2_base;				// CENTER or the table entry below diff
+	reg signed [63:0] s2_prod;
+	reg signed [31:0] high;					// pulse width for the next period
+
+	// PWM
+	reg [31:0] pwm_count;
+	reg [31:0] pwm_high;					// pulse width of the current period
+
+	wire wr = (wr_sync[2] != wr_sync[1]);
+	wire [31:0] time_1 = times[31:0];
+	wire [31:0] time_2 = times[63:32];
+	wire [31:0] diff_1 = time_1 - pend_2;	// a mic 1 edge against the outstanding mic 2 edge
+	wire [31:0] diff_2 = pend_1 - time_2;	// the outstanding mic 1 edge against a mic 2 edge
+	wire near_1 = have_2 && ((diff_1[31] ? -diff_1 : diff_1) <= window);
+	wire near_2 = have_1 && ((diff_2[31] ? -diff_2 : diff_2) <= window);
+	wire [4:0] step = ctrl[12:8];
+	wire [5:0] entry = (s1_diff >>> step) + TABLE_HALF;
+	wire [31:0] below = s1_diff & ((32'd1 << step) - 1);		// diff past the entry
+	wire signed [31:0] frac = below << (16 - step);
+	wire [5:0] next = entry + 1;			// wraps, past the last entry is out of range anyway
+	wire signed [31:0] rise = widths[next] - widths[entry];
+	wire signed [31:0] scaled = s2_prod >>> 16;
+	wire signed [31:0] sum = s2_base + scaled;
+
+	assign wr_ack = wr_sync[2];
+	assign enabled = ctrl[0];
+
+	initial
+	begin
+		ctrl = 0;
+		window = 25000 << TIME_FRAC_BITS;
+		gain = 209715 >> TIME_FRAC_BITS;
+		center = 140000;
+		min_high = 60000;
+		max_high = 220000;
+		period = 2000000;
+		wr_sync = 0;
+		have_1 = 0;
+		have_2 = 0;
+		pend_1 = 0;
+		pend_2 = 0;
+		s1_valid = 0;
+		s2_valid = 0;
+		s1_diff = 0;
+		s2_base = 0;
+		s2_prod = 0;
+		for (i = 0; i < 2*TABLE_HALF; i = i + 1)
+			widths[i] = 0;
+		high = 140000;
+		pairs = 0;
+		phase_diff = 0;
+		pwm_count = 0;
+		pwm_high = 140000;
+		pwm = 0;
+	end
+
+	// Register writes from the processor
+	always @(posedge clock)
+	begin
+		wr_sync <= {wr_sync[1:0], wr_toggle};
+		if (wr)
+		begin
+			case (wr_addr)
+				REG_CTRL:	ctrl <= wr_data;
+				REG_WINDOW:	window <= wr_data;
+				REG_GAIN:	gain <= wr_data;
+				REG_CENTER:	center <= wr_data;
+				REG_MIN:	min_high <= wr_data;
+				REG_MAX:	max_high <= wr_data;
+				REG_PERIOD:	period <= wr_data;
+				REG_TABLE:	widths[wr_data[29:24]] <= wr_data[23:0];
+				default:	;
+			endcase
+		end
+	end
+
+	// Stage 1: pair the edges
+	always @(posedge clock)
+	begin
+		s1_valid <= 0;
+		if ((edges == 2'b11) && near_1)
+		begin
+			// both at once: mic 1 takes the outstanding mic 2 edge, as time_1
+			// sorts first in FIT_Handler(), and this mic 2 edge waits
+			s1_diff <= diff_1;
+			s1_valid <= 1;
+			pend_2 <= time_2;
+			have_1 <= 0;
+		end
+		else if (edges == 2'b11)
+		begin
+			// simultaneous arrival
+			s1_diff <= time_1 - time_2;
+			s1_valid <= 1;
+			have_1 <= 0;
+			have_2 <= 0;
+		end
+		else if (edges[0])
+		begin
+			if (near_1)
+			begin
+				s1_diff <= diff_1;
+				s1_valid <= 1;
+				have_1 <= 0;
+				have_2 <= 0;
+			end
+			else
+			begin
+				pend_1 <= time_1;
+				have_1 <= 1;
+			end
+		end
+		else if (edges[1])
+		begin
+			if (near_2)
+			begin
+				s1_diff <= diff_2;
+				s1_valid <= 1;
+				have_1 <= 0;
+				have_2 <= 0;
+			end
+			else
+			begin
+				pend_2 <= time_2;
+				have_2 <= 1;
+			end
+		end
+	end
+
+	// Stage 2: scale, or look up and interpolate
+	always @(posedge clock)
+	begin
+		s2_valid <= s1_valid;
+		if (s1_valid)
+		begin
+			if (ctrl[1])
+			begin
+				s2_base <= widths[entry];
+				s2_prod <= rise * frac;
+			end
+			else
+			begin
+				s2_base <= center;
+				s2_prod <= s1_diff * gain;
+			end
+			phase_diff <= s1_diff;
+		end
+	end
+
+	// Stage 3: offset and clamp
+	always @(posedge clock)
+	begin
+		if (s2_valid)
+		begin
+			pairs <= pairs + 1;
+			if (sum < min_high)
+				high <= min_high;
+			else if (sum > max_high)
+				high <= max_high;
+			else
+				high <= sum;
+		end
+	end
+
+	// Servo PWM, the pulse width is picked up at the start of each period
+	always @(posedge clock)
+	begin
+		if (pwm_count + 1 >= period)
+		begin
+			pwm_count <= 0;
+			pwm_high <= high;
+		end
+		else
+			pwm_count <= pwm_count + 1;
+		pwm <= (pwm_count < pwm_high);
+	end
+
+endmodule
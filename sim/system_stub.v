@@ -0,0 +1,94 @@
+/******************************************************/
+// MODULE: system (simulation stand-in)
+//
+// FILE NAME:	system_stub.v
+// VERSION: 1.0
+// AUTHOR:	Chris Dean, Meng Lei
+//
+// DESCRIPTION:
+// Port-compatible stand-in for the EMBSYS block design
+// so n4fpga can be simulated without Vivado.  clk2 is
+// taken straight from sysclk (100 MHz), clk2_90 is it
+// delayed by a quarter period, and the GPIO
+// outputs to Phase_Detection (the FIFO pop toggles)
+// come from the testbench, which plays the part of the
+// MicroBlaze (mics 1 and 2 and the Servo_Pipeline
+// registers).  The GPIO inputs are read by the testbench
+// through this module's ports.  The PDM_Frontend read
+// port is tied off (tb_pdm_frontend.v tests it on its
+// own).  Everything else is tied off.
+//
+/******************************************************/
+
+
+module system
+	(PmodCLP_DataBus, PmodCLP_E, PmodCLP_RS, PmodCLP_RW,
+	PmodENC_A, PmodENC_B, PmodENC_BTN, PmodENC_SWT,
+	RGB1_Blue, RGB1_Green, RGB1_Red, RGB2_Blue, RGB2_Green, RGB2_Red,
+	an, btnC, btnD, btnL, btnR, btnU, dp, led, seg, sw,
+	sysreset_n, sysclk, uart_rtl_rxd, uart_rtl_txd,
+	gpio_0_GPIO2_tri_o, gpio_0_GPIO_tri_i, pwm0,
+	clk2, clk2_90, time_1_tri_i, time_2_tri_i, fifo_status_tri_i, fifo_pop_tri_o, clk2_count_tri_i,
+	time_3_tri_i, time_4_tri_i, fifo_status_2_tri_i, fifo_pop_2_tri_o,
+	pair_time_tri_i, pair_info_tri_i,
+	servo_data_tri_o, servo_ctl_tri_o, servo_phase_tri_i, servo_status_tri_i, capture_irq,
+	wake_irq, pdm_data_tri_i, pdm_ctl_tri_o, pdm_irq);
+
+	output [7:0] PmodCLP_DataBus;
+	output PmodCLP_E, PmodCLP_RS, PmodCLP_RW;
+	input PmodENC_A, PmodENC_B, PmodENC_BTN, PmodENC_SWT;
+	output RGB1_Blue, RGB1_Green, RGB1_Red, RGB2_Blue, RGB2_Green, RGB2_Red;
+	output [7:0] an;
+	input btnC, btnD, btnL, btnR, btnU;
+	output dp;
+	output [15:0] led;
+	output [6:0] seg;
+	input [15:0] sw;
+	input sysreset_n, sysclk;
+	input uart_rtl_rxd;
+	output uart_rtl_txd;
+	output [7:0] gpio_0_GPIO2_tri_o;
+	input [7:0] gpio_0_GPIO_tri_i;
+	output pwm0;
+
+	output clk2;
+	output clk2_90;								// clock wizard: clk2 at 90 degrees
+	input [31:0] time_1_tri_i, time_2_tri_i;	// GPIO 1
+	input [31:0] fifo_status_tri_i;				// GPIO 2 channel 1
+	output [1:0] fifo_pop_tri_o;				// GPIO 2 channel 2
+	input [31:0] clk2_count_tri_i;				// GPIO 3
+	input [31:0] time_3_tri_i, time_4_tri_i;	// GPIO 4
+	input [31:0] fifo_status_2_tri_i;			// GPIO 5 channel 1
+	output [1:0] fifo_pop_2_tri_o;				// GPIO 5 channel 2
+	input [31:0] pair_time_tri_i;				// GPIO 9 channel 1
+	input [31:0] pair_info_tri_i;				// GPIO 9 channel 2
+	output [31:0] servo_data_tri_o;				// GPIO 6 channel 1
+	output [7:0] servo_ctl_tri_o;				// GPIO 6 channel 2
+	input [31:0] servo_phase_tri_i;				// GPIO 7 channel 1
+	input [31:0] servo_status_tri_i;			// GPIO 7 channel 2
+	input capture_irq;							// axi_intc input 2
+	input [31:0] pdm_data_tri_i;				// GPIO 8 channel 1
+	output [15:0] pdm_ctl_tri_o;				// GPIO 8 channel 2
+	input pdm_irq;								// axi_intc input 3
+	input wake_irq;								// axi_intc input 4
+
+	assign clk2 = sysclk;
+	assign #2.5 clk2_90 = sysclk;
+	assign fifo_pop_tri_o = tb_phase_detection.pop;
+	assign fifo_pop_2_tri_o = 2'b0;
+	assign servo_data_tri_o = tb_phase_detection.servo_data;
+	assign servo_ctl_tri_o = tb_phase_detection.servo_ctl;
+	assign pdm_ctl_tri_o = 16'b0;
+
+	assign PmodCLP_DataBus = 8'b0;
+	assign {PmodCLP_E, PmodCLP_RS, PmodCLP_RW} = 3'b0;
+	assign {RGB1_Blue, RGB1_Green, RGB1_Red, RGB2_Blue, RGB2_Green, RGB2_Red} = 6'b0;
+	assign an = 8'hFF;
+	assign seg = 7'h7F;
+	assign dp = 1'b1;
+	assign led = 16'b0;
+	assign uart_rtl_txd = 1'b1;
+	assign gpio_0_GPIO2_tri_o = 8'b0;
+	assign pwm0 = 1'b0;
+
+endmodule
@@ -0,0 +1,323 @@
+/******************************************************/
+// MODULE: tb_pdm_frontend
+//
+// FILE NAME:	tb_pdm_frontend.v
+// VERSION: 1.0
+// AUTHOR:	Chris Dean, Meng Lei
+//
+// DESCRIPTION:
+// Testbench for PDM_Frontend.  Runs under Icarus Verilog
+// or Verilator (see sim/Makefile).
+//
+// The two microphones are modelled in software: a tone
+// reaches mic 2 and mic 1 spacing*sin(angle)/c apart and
+// each mic's pressure is turned into a bit stream by a
+// second order sigma-delta modulator, as in a MEMS PDM
+// microphone, driven after each falling edge of pdm_clk.
+//
+// The testbench plays the MicroBlaze: on each rising
+// edge of frame_irq it reads the status word and the
+// frame through the read port, allowing two AXI
+// accesses (+bus clocks each) for every read, and
+// releases the frame.  Every frame after the first two
+// (the filters settling) is checked, per channel:
+//	- a sine of the tone frequency is fitted to it; the
+//	  amplitude must be the modulator's to 0.5 dB and the
+//	  rest (noise and distortion) +min_snr dB down
+//	- the phase must follow on from the previous frame,
+//	  allowing for the frames dropped in between, so no
+//	  sample is lost or repeated
+// and the delay of mic 1 behind mic 2 measured from the
+// two phases must be the modelled one to 1 usec.
+//
+// With +stall=<n> the processor holds frame n for 2.5
+// frame periods; exactly two frames must be dropped
+// (overruns) while the frame it holds stays intact.
+// Otherwise no frame may be dropped.
+//
+// Plusargs (defaults in brackets):
+//	+tone=<Hz>		tone frequency [1000]
+//	+amp=<pct>		tone amplitude, percent of full scale [50]
+//	+angle=<deg>	arrival angle, positive toward mic 2 [30]
+//	+spacing=<um>	microphone spacing [85000]
+//	+frames=<n>		frames to read [8]
+//	+bus=<n>		clocks per AXI access [8]
+//	+stall=<n>		frame to hold past the next two [0 = none]
+//	+min_snr=<dB>	least signal to noise ratio [60]
+//
+/******************************************************/
+
+`timescale 1ns / 1ps
+
+module tb_pdm_frontend;
+
+	parameter CLK_HZ = 100000000;			// clk2
+	parameter CLK_DIV = 32;					// clk2 clocks per pdm_clk period
+	parameter FRAME_LOG2 = 8;
+	parameter SKIP = 2;						// frames not checked while the filters settle
+
+	localparam CLK_NS = 1000000000 / CLK_HZ;
+	localparam FRAME_LEN = 1 << FRAME_LOG2;
+	localparam FRAME_CLOCKS = FRAME_LEN * CLK_DIV * 64;	// 64 PDM bits per PCM sample
+	localparam SOUND_UM_PER_SEC = 343000000;
+	localparam PI = 3.14159265358979;
+	localparam FULL_SCALE = 32768.0;
+
+	reg clk;
+	wire pdm_clk;
+	reg [1:0] pdm_data;						// mic 1 in bit 0
+	reg [15:0] rd_ctl;						// GPIO 8 channel 2
+	wire [31:0] rd_data;					// GPIO 8 channel 1
+	wire frame_irq;							// axi_intc input 3
+
+	PDM_Frontend #(.CLK_DIV(CLK_DIV), .FRAME_LOG2(FRAME_LOG2)) dut
+		(.clock(clk),
+		.pdm_clk(pdm_clk),
+		.pdm_data(pdm_data),
+		.rd_ctl(rd_ctl),
+		.rd_data(rd_data),
+		.frame_irq(frame_irq));
+
+	// run configuration
+	integer tone, amp, angle, spacing, frames, bus, stall, min_snr;
+	real delay_s;							// mic 1 behind mic 2, seconds
+	real fs;								// PCM sample rate
+	real w;									// tone, radians per sample
+
+	// microphone models: second order sigma-delta modulators
+	real acc1_1, acc2_1, acc1_2, acc2_2;	// integrators, per mic
+	real fb_1, fb_2;						// last output bit, +/-1
+
+	// processor model
+	integer s1 [0:FRAME_LEN-1];
+	integer s2 [0:FRAME_LEN-1];
+	reg [31:0] sts;
+	integer frame, k, checked, failures;
+	integer frames_base, overruns, overruns_base, dropped;
+	real amp_1, amp_2, ph_1, ph_2, snr_1, snr_2, ph_last, d, err, worst_snr, worst_delay, worst_step;
+
+	initial clk = 0;
+	always #(CLK_NS / 2) clk = ~clk;
+
+
+	/**************************** microphones ****************************/
+
+	task modulate;
+		input real u;
+		inout real acc1, acc2, fb;
+		begin
+			acc1 = acc1 + u - fb;
+			acc2 = acc2 + acc1 - fb;
+			fb = (acc2 >= 0.0) ? 1.0 : -1.0;
+		end
+	endtask
+
+	always @(negedge pdm_clk)
+	begin
+		modulate(amp / 100.0 * $sin(2.0 * PI * tone * ($realtime * 1e-9 - delay_s)), acc1_1, acc2_1, fb_1);
+		modulate(amp / 100.0 * $sin(2.0 * PI * tone * $realtime * 1e-9), acc1_2, acc2_2, fb_2);
+		pdm_data = {fb_2 > 0.0, fb_1 > 0.0};
+	end
+
+
+	/************************** processor model **************************/
+
+	// Read one word: the data follows rd_ctl within two AXI accesses
+	task read_word;
+		input [15:0] ctl;
+		output [31:0] data;
+		begin
+			rd_ctl = ctl;
+			repeat (2 * bus) @(posedge clk);
+			#1 data = rd_data;
+		end
+	endtask
+
+	task read_status;
+		begin
+			read_word({rd_ctl[15], 1'b1, 14'b0}, sts);
+		end
+	endtask
+
+	task read_frame;
+		reg [31:0] word;
+		begin
+			for (k = 0; k < FRAME_LEN; k = k + 1)
+			begin
+				read_word({rd_ctl[15], 1'b0, k[13:0]}, word);
+				s1[k] = $signed(word[15:0]);
+				s2[k] = $signed(word[31:16]);
+			end
+		end
+	endtask
+
+	task release_frame;
+		begin
+			rd_ctl[15] = ~rd_ctl[15];
+			read_status;
+			while (sts[7] != rd_ctl[15])
+				read_status;
+		end
+	endtask
+
+	// Least squares fit of a sin(w k) + b cos(w k) to one channel of the frame;
+	// amplitude, phase at the first sample and the signal to residual ratio in dB
+	task fit;
+		input integer ch;
+		output real amplitude, phase, snr;
+		real ss, cc, sc, xs, xc, det, a, b, x, r, p;
+		begin
+			ss = 0.0;
+			cc = 0.0;
+			sc = 0.0;
+			xs = 0.0;
+			xc = 0.0;
+			for (k = 0; k < FRAME_LEN; k = k + 1)
+			begin
+				x = (ch == 1) ? s1[k] : s2[k];
+				ss = ss + $sin(w * k) * $sin(w * k);
+				cc = cc + $cos(w * k) * $cos(w * k);
+				sc = sc + $sin(w * k) * $cos(w * k);
+				xs = xs + x * $sin(w * k);
+				xc = xc + x * $cos(w * k);
+			end
+			det = ss * cc - sc * sc;
+			a = (xs * cc - xc * sc) / det;
+			b = (xc * ss - xs * sc) / det;
+			p = 0.0;
+			for (k = 0; k < FRAME_LEN; k = k + 1)
+			begin
+				x = (ch == 1) ? s1[k] : s2[k];
+				r = x - a * $sin(w * k) - b * $cos(w * k);
+				p = p + r * r;
+			end
+			amplitude = $sqrt(a * a + b * b);
+			phase = $atan2(b, a);
+			snr = 10.0 * $log10((a * a + b * b) / 2.0 / (p / FRAME_LEN + 1e-9));
+		end
+	endtask
+
+	// angle difference folded into (-pi, pi]
+	function real wrap;
+		input real x;
+		begin
+			wrap = x - 2.0 * PI * $floor((x + PI) / (2.0 * PI));
+		end
+	endfunction
+
+	function real absr;
+		input real x;
+		begin
+			absr = (x < 0.0) ? -x : x;
+		end
+	endfunction
+
+	initial
+	begin
+		pdm_data = 2'b00;
+		rd_ctl = 16'b0;
+		acc1_1 = 0.0;
+		acc2_1 = 0.0;
+		acc1_2 = 0.0;
+		acc2_2 = 0.0;
+		fb_1 = -1.0;
+		fb_2 = -1.0;
+		if (!$value$plusargs("tone=%d", tone)) tone = 1000;
+		if (!$value$plusargs("amp=%d", amp)) amp = 50;
+		if (!$value$plusargs("angle=%d", angle)) angle = 30;
+		if (!$value$plusargs("spacing=%d", spacing)) spacing = 85000;
+		if (!$value$plusargs("frames=%d", frames)) frames = 8;
+		if (!$value$plusargs("bus=%d", bus)) bus = 8;
+		if (!$value$plusargs("stall=%d", stall)) stall = 0;
+		if (!$value$plusargs("min_snr=%d", min_snr)) min_snr = 60;
+
+		delay_s = 1.0 * spacing * $sin(angle * PI / 180.0) / SOUND_UM_PER_SEC;
+		fs = 1.0 * CLK_HZ / CLK_DIV / 64;
+		w = 2.0 * PI * tone / fs;
+
+		$display("PDM_Frontend testbench");
+		$display("tone %0d Hz at %0d%%, angle %0d deg, spacing %0d um: mic 1 %0d ns behind mic 2",
+			tone, amp, angle, spacing, $rtoi(delay_s * 1e9));
+		$display("%0d sample frames at %0d Hz, %0d clocks per AXI access", FRAME_LEN, $rtoi(fs), bus);
+		$display("%6s %8s %8s %8s %8s %10s %8s", "frame", "amp 1", "amp 2", "snr 1", "snr 2", "delay ns", "dropped");
+
+		checked = 0;
+		failures = 0;
+		worst_snr = 1000.0;
+		worst_delay = 0.0;
+		worst_step = 0.0;
+		frames_base = 0;
+		overruns_base = 0;
+		for (frame = 1; frame <= frames; frame = frame + 1)
+		begin
+			@(posedge frame_irq);
+			read_status;
+			overruns = sts[15:8];
+			dropped = overruns - overruns_base;
+			if ((sts[0] != 1'b1) || (sts[6:3] != FRAME_LOG2) || (sts[31:16] != frames_base + 1))
+			begin
+				$display("frame %0d: bad status %h", frame, sts);
+				failures = failures + 1;
+			end
+			frames_base = sts[31:16];
+			overruns_base = overruns;
+			read_frame;
+
+			fit(1, amp_1, ph_1, snr_1);
+			fit(2, amp_2, ph_2, snr_2);
+			d = wrap(ph_2 - ph_1) / (2.0 * PI * tone);
+			$display("%6d %8d %8d %8.1f %8.1f %10d %8d", frame, $rtoi(amp_1), $rtoi(amp_2), snr_1, snr_2,
+				$rtoi(d * 1e9), dropped);
+			if (frame > SKIP)
+			begin
+				checked = checked + 1;
+				if (snr_1 < worst_snr)
+					worst_snr = snr_1;
+				if (snr_2 < worst_snr)
+					worst_snr = snr_2;
+				if ((snr_1 < min_snr) || (snr_2 < min_snr) ||
+					(absr(20.0 * $log10(amp_1 / (amp / 100.0 * FULL_SCALE))) > 0.5) ||
+					(absr(20.0 * $log10(amp_2 / (amp / 100.0 * FULL_SCALE))) > 0.5))
+				begin
+					$display("frame %0d: level or snr out of range", frame);
+					failures = failures + 1;
+				end
+				err = absr(d - delay_s);
+				if (err > worst_delay)
+					worst_delay = err;
+				if (err > 1e-6)
+				begin
+					$display("frame %0d: delay off by %0d ns", frame, $rtoi(err * 1e9));
+					failures = failures + 1;
+				end
+
+				// the frame starts (1 + dropped) frames after the last one
+				err = absr(wrap(ph_2 - ph_last - w * FRAME_LEN * (1 + dropped)));
+				if (err > worst_step)
+					worst_step = err;
+				if ((frame > SKIP + 1) && (err > 0.01))
+				begin
+					$display("frame %0d: samples lost or repeated (phase step off by %f rad)", frame, err);
+					failures = failures + 1;
+				end
+			end
+			ph_last = ph_2;
+
+			if (frame == stall)
+				#(FRAME_CLOCKS * CLK_NS * 5 / 2);
+			release_frame;
+		end
+
+		$display("%0d frames checked: worst snr %f dB, delay error %0d ns, phase step error %f rad",
+			checked, worst_snr, $rtoi(worst_delay * 1e9), worst_step);
+		$display("frames dropped: %0d", overruns);
+		if ((stall > 0) && (stall < frames) ? (overruns != 2) : (overruns != 0))
+			failures = failures + 1;
+		if ((failures == 0) && (checked > 0))
+			$display("PASSED");
+		else
+			$display("FAILED");
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,814 @@
+/******************************************************/
+// MODULE: tb_phase_detection
+//
+// FILE NAME:	tb_phase_detection.v
+// VERSION: 1.7
+// AUTHOR:	Chris Dean, Meng Lei
+//
+// DESCRIPTION:
+// Testbench for Phase_Detection, on its own (TB_UNIT
+// defined) or inside n4fpga with the block design
+// replaced by system_stub.v.  Runs under Icarus Verilog
+// or Verilator (see sim/Makefile).
+//
+// The microphone comparator outputs are generated from
+// sound events at a given arrival angle: each event is
+// a burst of tone cycles (a single cycle is a click)
+// reaching mic 2 and mic 1 spacing*sin(angle)/c apart.
+// Noise is modelled at the comparator output: edge
+// timing jitter of 1/(2*pi*f*sqrt(2*SNR)) and, with a
+// probability growing with the noise, a chatter glitch
+// (a short drop and second rising edge) after an edge.
+// With +spikes a noise spike (a 1 to 3 clock pulse) can
+// come shortly before an edge as well.
+//
+// Phase_Detection's edge filters are set through its
+// register port (+holdoff, +min_high, +quiet) before the
+// run.  The report counts the edges the processor has to
+// read, so runs with and without the filters show how
+// many edges they take off the processor and what that
+// does to the pairing.
+//
+// The testbench plays the MicroBlaze: every FIT period
+// it drains both timestamp FIFOs through the pop
+// toggle handshake and pairs the edges exactly as
+// FIT_Handler() does.  Each phase difference is checked
+// against the delay of the event it belongs to; pairs
+// outside the tolerance are mis-pairs.  Events with no
+// correct pair are missed.  The capture interrupt is
+// counted (the model still polls, like a PHASE_POLLED
+// build); a run with pairs but no interrupt fails.
+//
+// With +latch the model reads the latched pair instead,
+// as a PHASE_PAIR_LATCH build does: the FIFOs are turned
+// off (EDGE_CTRL latch only) and every poll reads
+// pair_info, and only if its sequence number changed,
+// pair_time and pair_info again, LATCH_GAP clocks apart
+// like separate bus reads.  A pair whose two pair_info
+// reads differ is torn and read again.  Only the last
+// pair of each poll is seen, so at high event rates the
+// missed count is the price of the single read.
+//
+// Inside n4fpga the testbench also enables the fabric
+// servo path (Servo_Pipeline) and checks every phase
+// difference it maps, and how many clocks after the
+// edge completing a pair the new pulse width is ready.
+//
+// After the runs the wakeup is checked: WAKE is set
+// ahead of the timestamp counter, and wake_irq must rise
+// within WAKE_SLACK clocks of that time; then WAKE is
+// set to a time already gone, which must fire as soon as
+// the write lands.  No other wake_irq may come.
+//
+// Then the sub-clock resolution is measured: pairs of
+// single edges are injected RES_STEPS delays apart from
+// 0 to RES_SPAN clocks (mic 1 later), each at RES_PHASES
+// offsets from the clock, and the latched difference is
+// compared with the injected delay.  The largest error
+// must be under one timestamp step, 1/2^FRAC_BITS of a
+// clock; build with FRAC_BITS 0 and 2 (make unit FRAC=2)
+// to compare the two.  The other checks only inject
+// edges at whole clock counts, so their differences are
+// exact in either mode.
+//
+// With +sweep the event rate is doubled each pass from
+// +rate up to +rate_max and the highest rate with no
+// FIFO overflow, no missed events and at most +maxbad
+// percent mis-pairs is reported as the maximum
+// sustainable event rate.
+//
+// Plusargs (defaults in brackets):
+//	+angle=<deg>	arrival angle, positive toward mic 2 [30]
+//	+snr=<dB>		signal to noise ratio, 0 = noiseless [40]
+//	+rate=<n>		events per second [500]
+//	+rate_max=<n>	last sweep rate [64000]
+//	+events=<n>		events per run / sweep pass [50]
+//	+tone=<Hz>		tone frequency [2000]
+//	+burst=<n>		tone cycles per event [1]
+//	+spacing=<um>	microphone spacing [85000]
+//	+maxbad=<pct>	mis-pairs allowed when sweeping [1]
+//	+spikes=<pct>	chance of a noise spike before an edge [0]
+//	+holdoff=<n>	edge filter holdoff, timestamp counts [0 = off]
+//	+min_high=<n>	edge filter glitch filter, clocks [0 = off]
+//	+quiet=<n>		edge filter onset mode silence, timestamp counts [0 = off]
+//	+seed=<n>		random seed [1]
+//	+latch			read the latched pair, not the FIFOs
+//	+sweep			sweep the event rate
+//
+/******************************************************/
+
+`timescale 1ns / 1ps
+
+module tb_phase_detection;
+
+	parameter CLK_HZ = 100000000;			// clk2, Phase_Detection timestamp clock
+	parameter FIT_HZ = 40000;				// processor polling rate
+	parameter WINDOW = 25000;				// PHASE_VALID_WINDOW in finalproject.c
+	parameter MAX_EVENTS = 4096;
+	parameter LATCH_GAP = 3;				// clocks between the reads of the latched pair
+	parameter WAKE_AHEAD = 2000;			// counts ahead of the counter to set WAKE
+	parameter WAKE_SLACK = 2;				// clocks wake_irq may rise after the WAKE time
+	parameter FRAC_BITS = 0;				// sub-clock timestamp bits (Phase_Detection FRAC_BITS)
+	parameter RES_SPAN = 4;					// resolution check: delays from 0 to RES_SPAN clocks,
+	parameter RES_STEPS = 40;				// RES_STEPS + 1 of them,
+	parameter RES_PHASES = 4;				// each at RES_PHASES offsets from the clock
+
+	localparam CLK_NS = 1000000000 / CLK_HZ;
+	localparam STEPS = 1 << FRAC_BITS;		// timestamp counts per clock
+	localparam PAIR_WINDOW = WINDOW << FRAC_BITS;
+	localparam POLL = CLK_HZ / FIT_HZ;		// clocks between FIFO drains
+	localparam SOUND_UM_PER_SEC = 343000000;
+
+	reg clk;
+	reg clk_90;								// clk a quarter period later
+	reg [1:0] sig;							// mic comparator outputs (JD[1:0])
+	reg [1:0] pop;							// FIFO pop toggles (GPIO 2 channel 2)
+	wire [31:0] time_1, time_2, fifo_status;
+	wire [31:0] pair_time, pair_info;		// latched pair (GPIO 9)
+	wire capture_irq;						// axi_intc input 2
+	wire wake_irq;							// axi_intc input 4
+	wire [31:0] now;						// timestamp counter (GPIO 3)
+
+`ifdef TB_UNIT
+	wire [1:0] edges;
+	wire [63:0] edge_times;
+	reg cfg_toggle;							// edge filter register port
+	reg [3:0] cfg_addr;
+	reg [31:0] cfg_data;
+	wire cfg_ack;
+
+	Phase_Detection #(.PAIR_WINDOW(PAIR_WINDOW), .FRAC_BITS(FRAC_BITS)) dut
+		(.clock(clk),
+		.clock_90(clk_90),
+		.signal(sig),
+		.pop(pop),
+		.timestamps({time_2, time_1}),
+		.fifo_status(fifo_status),
+		.pair_time(pair_time),
+		.pair_info(pair_info),
+		.now(now),
+		.edges(edges),
+		.edge_times(edge_times),
+		.capture_irq(capture_irq),
+		.wake_irq(wake_irq),
+		.cfg_toggle(cfg_toggle),
+		.cfg_addr(cfg_addr),
+		.cfg_data(cfg_data),
+		.cfg_ack(cfg_ack));
+`else
+	wire [15:0] led;
+	wire [7:0] an, JA, JB, JC;
+	wire [6:0] seg;
+	wire dp, uart_rtl_txd;
+	wire RGB1_Blue, RGB1_Green, RGB1_Red, RGB2_Blue, RGB2_Green, RGB2_Red;
+
+	n4fpga #(.TIME_FRAC_BITS(FRAC_BITS)) dut
+		(.clk(clk),
+		.btnC(1'b0), .btnU(1'b0), .btnL(1'b0), .btnD(1'b0), .btnR(1'b0),
+		.btnCpuReset(1'b1),
+		.sw(16'b0),
+		.led(led),
+		.RGB1_Blue(RGB1_Blue), .RGB1_Green(RGB1_Green), .RGB1_Red(RGB1_Red),
+		.RGB2_Blue(RGB2_Blue), .RGB2_Green(RGB2_Green), .RGB2_Red(RGB2_Red),
+		.an(an), .seg(seg), .dp(dp),
+		.uart_rtl_rxd(1'b1), .uart_rtl_txd(uart_rtl_txd),
+		.JA(JA), .JB(JB), .JC(JC),
+		.JD({6'b0, sig}));		// mics 3 and 4 idle
+
+	// what the MicroBlaze sees on its GPIO inputs
+	assign time_1 = dut.EMBSYS.time_1_tri_i;
+	assign time_2 = dut.EMBSYS.time_2_tri_i;
+	assign fifo_status = dut.EMBSYS.fifo_status_tri_i;
+	assign pair_time = dut.EMBSYS.pair_time_tri_i;
+	assign pair_info = dut.EMBSYS.pair_info_tri_i;
+	assign capture_irq = dut.EMBSYS.capture_irq;
+	assign wake_irq = dut.EMBSYS.wake_irq;
+	assign now = dut.EMBSYS.clk2_count_tri_i;
+`endif
+
+	// run configuration
+	integer angle, snr, rate, rate_max, events, tone, burst, spacing, maxbad, seed, sweep;
+	integer spike_pct, holdoff, min_high, quiet, latch;
+	integer delay;							// time_1 - time_2 injected, clocks
+	integer delay_fine;						// and expected, timestamp counts
+	integer tol;							// phase difference tolerance, timestamp counts
+	integer period;							// tone period, clock counts
+	real jitter_sd;							// edge jitter, clock counts
+	integer glitch_pct;						// chance of a chatter glitch per edge
+
+	// expected events
+	integer ev_start [0:MAX_EVENTS-1];		// clock count the event starts at
+	integer ev_ok [0:MAX_EVENTS-1];			// correct pairs seen for the event
+	integer ev_count;						// events generated this pass
+	integer chk;							// event the next pair is checked against
+
+	// results of a pass
+	integer pairs, bad, missed, overflow, bad_max, edges_read;
+	reg [7:0] ovf1_base, ovf2_base;
+
+	// processor model state (FIT_Handler)
+	integer b1 [0:31];
+	integer b2 [0:31];
+	reg [31:0] pend_1, pend_2;
+	reg have_1, have_2;
+	reg [14:0] latch_seq;					// sequence number of the last latched pair read
+	integer torn;							// latched pair reads that landed on an update
+
+	// capture interrupts (rising edges of capture_irq), and wake interrupts
+	integer irqs, wakes;
+	reg irq_prev, wake_prev;
+	integer wake_late, wake_past;			// clocks from the WAKE time to wake_irq
+	reg [31:0] wake_at;
+
+	// sub-clock resolution check
+	reg poll_off;							// the processor model stops polling for it
+	integer res_n, res_lost;
+	real res_max, res_sum;					// largest and summed squared error, clocks
+
+	initial
+	begin
+		irqs = 0;
+		irq_prev = 0;
+		wakes = 0;
+		wake_prev = 0;
+	end
+
+	always @(posedge clk)
+	begin
+		if (capture_irq && !irq_prev)
+			irqs = irqs + 1;
+		irq_prev <= capture_irq;
+		if (wake_irq && !wake_prev)
+			wakes = wakes + 1;
+		wake_prev <= wake_irq;
+	end
+
+	reg [31:0] rng_state;
+	integer pass, pass_rate, best_rate;
+
+	// posedge n at n*CLK_NS - 3*CLK_NS/8, counter = n after it: no clock edge (of clk or
+	// clk_90) falls on a whole count, where the stimulus switches
+	initial
+	begin
+		clk = 0;
+		#(CLK_NS / 8.0);
+		forever #(CLK_NS / 2) clk = ~clk;
+	end
+	always @(clk)
+		clk_90 <= #(CLK_NS / 4.0) clk;
+
+
+	/**************************** helpers ****************************/
+
+	task next_rand;
+		output [31:0] r;
+		begin
+			rng_state = rng_state ^ (rng_state << 13);
+			rng_state = rng_state ^ (rng_state >> 17);
+			rng_state = rng_state ^ (rng_state << 5);
+			r = rng_state;
+		end
+	endtask
+
+	// approximately normal, sd counts (sum of four uniforms)
+	task gauss;
+		input real sd;
+		output integer n;
+		reg [31:0] r;
+		real s;
+		integer k, u;
+		begin
+			s = 0.0;
+			for (k = 0; k < 4; k = k + 1)
+			begin
+				next_rand(r);
+				u = r % 2001;
+				s = s + (u - 1000) / 1000.0;
+			end
+			n = $rtoi(s * sd * 0.866);		// sd of the sum of four U(-1,1) is 2/sqrt(3)
+		end
+	endtask
+
+	// wait until between posedge t and t+1, so an edge driven now gets timestamp t
+	task automatic wait_count;
+		input integer t;
+		begin
+			if (t * CLK_NS > $realtime)
+				#(t * CLK_NS - $realtime);
+		end
+	endtask
+
+	// one microphone's comparator output for one event
+	task automatic drive_burst;
+		input integer ch;
+		input integer start;
+		reg [31:0] r;
+		integer k, t, j, g;
+		begin
+			for (k = 0; k < burst; k = k + 1)
+			begin
+				gauss(jitter_sd, j);
+				t = start + k * period + j;
+				next_rand(r);
+				if ((r % 100) < spike_pct)
+				begin
+					// noise spike as the input nears the threshold
+					next_rand(r);
+					g = t - 20 - (r % 200);
+					if (g * CLK_NS > $time)
+					begin
+						wait_count(g);
+						sig[ch] = 1'b1;
+						wait_count(g + 1 + (r >> 8) % 3);
+						sig[ch] = 1'b0;
+					end
+				end
+				wait_count(t);
+				sig[ch] = 1'b1;
+				next_rand(r);
+				if ((r % 100) < glitch_pct)
+				begin
+					next_rand(r);
+					g = 2 + (r % 16);
+					wait_count(t + g);
+					sig[ch] = 1'b0;
+					wait_count(t + g + 1 + (r >> 8) % 3);
+					sig[ch] = 1'b1;
+				end
+				wait_count(t + period / 2);
+				sig[ch] = 1'b0;
+			end
+		end
+	endtask
+
+	// check a phase difference measured on the pair whose earlier edge is at first
+	task check_pair;
+		input [31:0] first;
+		input integer diff;
+		integer d;
+		begin
+			pairs = pairs + 1;
+			while ((chk + 1 < ev_count) &&
+				(ev_start[chk + 1] <= ($signed(first) >>> FRAC_BITS) + 4 * $rtoi(jitter_sd) + 1))
+				chk = chk + 1;
+			d = diff - delay_fine;
+			if (d < 0)
+				d = -d;
+			if ((ev_count > 0) && (d <= tol))
+				ev_ok[chk] = ev_ok[chk] + 1;
+			else
+			begin
+				bad = bad + 1;
+				if (d > bad_max)
+					bad_max = d;
+			end
+		end
+	endtask
+
+
+	/************************ processor model ************************/
+
+	// fifo_status entry counts are Gray coded
+	function integer gray_count;
+		input [4:0] gray;
+		integer i;
+		begin
+			gray_count = gray[4];
+			for (i = 3; i >= 0; i = i - 1)
+				gray_count = (gray_count << 1) | ((gray_count & 1) ^ gray[i]);
+		end
+	endfunction
+
+	// Drain both FIFOs through the pop toggle handshake, then pair the edges
+	// in time order exactly as FIT_Handler() does
+	task drain;
+		integer n1, n2, x, y;
+		reg [31:0] t;
+		begin
+			n1 = gray_count(fifo_status[4:0]);
+			n2 = gray_count(fifo_status[12:8]);
+			edges_read = edges_read + n1 + n2;
+			for (x = 0; x < n1; x = x + 1)
+			begin
+				b1[x] = time_1;
+				pop[0] = ~pop[0];
+				while (fifo_status[7] != pop[0])
+					@(posedge clk) #1;
+			end
+			for (y = 0; y < n2; y = y + 1)
+			begin
+				b2[y] = time_2;
+				pop[1] = ~pop[1];
+				while (fifo_status[15] != pop[1])
+					@(posedge clk) #1;
+			end
+
+			x = 0;
+			y = 0;
+			while ((x < n1) || (y < n2))
+			begin
+				if ((y >= n2) || ((x < n1) && ($signed(b1[x] - b2[y]) <= 0)))
+				begin
+					t = b1[x];
+					x = x + 1;
+					if (have_2 && (t - pend_2 <= PAIR_WINDOW))
+					begin
+						check_pair(pend_2, t - pend_2);
+						have_1 = 0;
+						have_2 = 0;
+					end
+					else
+					begin
+						pend_1 = t;
+						have_1 = 1;
+					end
+				end
+				else
+				begin
+					t = b2[y];
+					y = y + 1;
+					if (have_1 && (t - pend_1 <= PAIR_WINDOW))
+					begin
+						check_pair(pend_1, -(t - pend_1));
+						have_1 = 0;
+						have_2 = 0;
+					end
+					else
+					begin
+						pend_2 = t;
+						have_2 = 1;
+					end
+				end
+			end
+		end
+	endtask
+
+	// Read the latched pair if it is new, as EDGE_ReadLatch() does
+	task read_latch;
+		reg [31:0] info, t, check;
+		reg done;
+		integer d;
+		begin
+			info = pair_info;
+			done = 0;
+			while (!done && info[16] && (info[31:17] != latch_seq))
+			begin
+				repeat (LATCH_GAP) @(posedge clk) #1;
+				t = pair_time;
+				repeat (LATCH_GAP) @(posedge clk) #1;
+				check = pair_info;
+				if (check == info)
+				begin
+					latch_seq = info[31:17];
+					edges_read = edges_read + 2;
+					d = $signed(info[15:0]);			// time_1 - time_2
+					check_pair((d > 0) ? t - d : t, d);
+					done = 1;
+				end
+				else
+				begin
+					torn = torn + 1;
+					info = check;
+				end
+			end
+		end
+	endtask
+
+	initial
+	begin
+		pop = 2'b00;
+		have_1 = 0;
+		have_2 = 0;
+		latch_seq = 0;
+		torn = 0;
+		poll_off = 0;
+		forever
+		begin
+			#(POLL * CLK_NS);
+			@(posedge clk) #1;
+			if (poll_off)
+				;
+			else if (latch)
+				read_latch;
+			else
+				drain;
+		end
+	end
+
+
+`ifndef TB_UNIT
+	/*********************** fabric servo path ***********************/
+
+	reg [31:0] servo_data;					// Servo_Pipeline register write (GPIO 6)
+	reg [7:0] servo_ctl;
+	reg [15:0] fab_seen;					// pair count last seen on GPIO 7
+	reg [1:0] sig_prev;
+	integer fab_pairs, fab_bad, fab_lat_max, last_edge, fab_d;
+
+	// write a Servo_Pipeline (or Phase_Detection) register through the toggle handshake
+	task servo_write;
+		input [3:0] addr;
+		input [31:0] value;
+		begin
+			servo_data = value;
+			servo_ctl = {~servo_ctl[7], 3'b0, addr};
+			while (dut.EMBSYS.servo_status_tri_i[7] != servo_ctl[7])
+				@(posedge clk) #1;
+		end
+	endtask
+
+	initial
+	begin
+		servo_data = 0;
+		servo_ctl = 0;
+		fab_seen = 0;
+		sig_prev = 0;
+		last_edge = 0;
+	end
+
+	// check every pair the fabric maps against the event delay
+	always @(posedge clk)
+	begin
+		#1;
+		if (|(sig & ~sig_prev))
+			last_edge = $time / CLK_NS;
+		sig_prev = sig;
+		if (dut.EMBSYS.servo_status_tri_i[31:16] != fab_seen)
+		begin
+			fab_seen = dut.EMBSYS.servo_status_tri_i[31:16];
+			if (!poll_off)
+				fab_pairs = fab_pairs + 1;
+			fab_d = $signed(dut.EMBSYS.servo_phase_tri_i) - delay_fine;
+			if (fab_d < 0)
+				fab_d = -fab_d;
+			if (!poll_off && (fab_d > tol))
+				fab_bad = fab_bad + 1;
+			if (($time / CLK_NS) - last_edge > fab_lat_max)
+				fab_lat_max = ($time / CLK_NS) - last_edge;
+		end
+	end
+`endif
+
+
+	/************************ register writes ************************/
+
+	// write a Phase_Detection edge filter register
+	task edge_write;
+		input [3:0] addr;
+		input [31:0] value;
+		begin
+`ifdef TB_UNIT
+			cfg_data = value;
+			cfg_addr = addr;
+			cfg_toggle = ~cfg_toggle;
+			while (cfg_ack != cfg_toggle)
+				@(posedge clk) #1;
+`else
+			servo_write(addr, value);
+`endif
+		end
+	endtask
+
+	task configure;
+		begin
+`ifdef TB_UNIT
+			cfg_toggle = 0;
+			cfg_addr = 0;
+			cfg_data = 0;
+`endif
+			@(posedge clk) #1;
+`ifndef TB_UNIT
+			servo_write(0, 1);				// CTRL: fabric drives the servo
+			servo_write(1, PAIR_WINDOW);	// WINDOW, in timestamp counts
+`endif
+			edge_write(9, holdoff);			// HOLDOFF
+			edge_write(10, min_high);		// MIN_HIGH
+			edge_write(11, quiet);			// QUIET
+			edge_write(8, (quiet != 0) | (latch << 1));		// EDGE_CTRL: onset mode, latch only
+		end
+	endtask
+
+
+	/*************************** stimulus ***************************/
+
+	// generate ev_count events at pass_rate and wait for them to drain
+	task run_pass;
+		integer interval, start, k;
+		reg [31:0] r;
+		begin
+			pairs = 0;
+			bad = 0;
+			bad_max = 0;
+			edges_read = 0;
+			missed = 0;
+			chk = 0;
+`ifndef TB_UNIT
+			fab_pairs = 0;
+			fab_bad = 0;
+			fab_lat_max = 0;
+`endif
+			ev_count = 0;
+			ovf1_base = fifo_status[23:16];
+			ovf2_base = fifo_status[31:24];
+			interval = CLK_HZ / pass_rate;
+			start = ($time / CLK_NS) + WINDOW + POLL;
+
+			for (k = 0; k < events; k = k + 1)
+			begin
+				ev_start[k] = start;
+				ev_ok[k] = 0;
+				ev_count = k + 1;
+				// the later microphone hears it delay counts after the earlier one
+				fork
+					drive_burst(0, start + ((delay > 0) ? delay : 0));
+					drive_burst(1, start + ((delay < 0) ? -delay : 0));
+				join
+				// next event interval +/- 50%
+				next_rand(r);
+				start = start + interval / 2 + (r % (interval + 1));
+				if (start < $time / CLK_NS)
+					start = $time / CLK_NS;
+			end
+
+			// let the last edges be drained and any unpaired edge age out
+			wait_count(($time / CLK_NS) + WINDOW + 4 * POLL);
+			for (k = 0; k < ev_count; k = k + 1)
+				if (ev_ok[k] == 0)
+					missed = missed + 1;
+			overflow = ((fifo_status[23:16] - ovf1_base) & 8'hFF) + ((fifo_status[31:24] - ovf2_base) & 8'hFF);
+		end
+	endtask
+
+	// set WAKE ahead of the counter, then behind it, and time wake_irq both ways
+	task wake_check;
+		begin
+			wake_at = now + WAKE_AHEAD;
+			edge_write(12, wake_at);
+			while (!wake_irq)
+				@(posedge clk) #1;
+			wake_late = now - wake_at;
+			wait_count(($time / CLK_NS) + 16);		// past the stretched strobe
+
+			wake_at = now - WAKE_AHEAD;
+			edge_write(12, wake_at);
+			while (!wake_irq)
+				@(posedge clk) #1;
+			wake_past = now - wake_at;
+			wait_count(($time / CLK_NS) + 16);		// past the stretched strobe
+		end
+	endtask
+
+	// inject single edge pairs at known sub-clock delays and measure the latched difference
+	task res_check;
+		integer k, o, t, gap;
+		real d, err;
+		reg [31:0] info;
+		begin
+			poll_off = 1;
+			res_n = 0;
+			res_lost = 0;
+			res_max = 0.0;
+			res_sum = 0.0;
+			gap = (((quiet > holdoff) ? quiet : holdoff) >> FRAC_BITS) + min_high + 64;
+			info = pair_info;
+			for (k = 0; k <= RES_STEPS; k = k + 1)
+			begin
+				for (o = 0; o < RES_PHASES; o = o + 1)
+				begin
+					d = (1.0 * RES_SPAN * k) / RES_STEPS;
+					t = ($time / CLK_NS) + gap;
+					#((t + (o + 0.25) / RES_PHASES) * CLK_NS - $realtime);	// off the sample instants
+					sig[1] = 1'b1;
+					#(d * CLK_NS);
+					sig[0] = 1'b1;
+					wait_count(t + RES_SPAN + min_high + 8);
+					sig = 2'b00;
+					wait_count(t + RES_SPAN + min_high + 16);
+					if (pair_info[31:17] == info[31:17])
+						res_lost = res_lost + 1;
+					else
+					begin
+						info = pair_info;
+						err = ($signed(info[15:0]) * 1.0) / STEPS - d;
+						err = (err < 0.0) ? -err : err;
+						res_max = (err > res_max) ? err : res_max;
+						res_sum = res_sum + err * err;
+						res_n = res_n + 1;
+					end
+				end
+			end
+		end
+	endtask
+
+	task report_pass;
+		begin
+			$display("%9d %7d %7d %7d %6d (%0d%%) %7d %7d %9d", pass_rate, ev_count, edges_read, pairs, bad,
+				pairs ? (100 * bad) / pairs : 0, missed, overflow, bad_max);
+		end
+	endtask
+
+	initial
+	begin
+		sig = 2'b00;
+		if (!$value$plusargs("angle=%d", angle)) angle = 30;
+		if (!$value$plusargs("snr=%d", snr)) snr = 40;
+		if (!$value$plusargs("rate=%d", rate)) rate = 500;
+		if (!$value$plusargs("rate_max=%d", rate_max)) rate_max = 64000;
+		if (!$value$plusargs("events=%d", events)) events = 50;
+		if (!$value$plusargs("tone=%d", tone)) tone = 2000;
+		if (!$value$plusargs("burst=%d", burst)) burst = 1;
+		if (!$value$plusargs("spacing=%d", spacing)) spacing = 85000;
+		if (!$value$plusargs("maxbad=%d", maxbad)) maxbad = 1;
+		if (!$value$plusargs("seed=%d", seed)) seed = 1;
+		if (!$value$plusargs("spikes=%d", spike_pct)) spike_pct = 0;
+		if (!$value$plusargs("holdoff=%d", holdoff)) holdoff = 0;
+		if (!$value$plusargs("min_high=%d", min_high)) min_high = 0;
+		if (!$value$plusargs("quiet=%d", quiet)) quiet = 0;
+		latch = $test$plusargs("latch");
+		sweep = $test$plusargs("sweep");
+		if (events > MAX_EVENTS)
+			events = MAX_EVENTS;
+		rng_state = (seed * 32'h9E3779B1) | 1;
+
+		// arrival geometry and the comparator noise model
+		delay = $rtoi(1.0 * spacing * $sin(angle * 3.14159265358979 / 180.0) * CLK_HZ / SOUND_UM_PER_SEC);
+		delay_fine = delay << FRAC_BITS;
+		period = CLK_HZ / tone;
+		if (snr > 0)
+		begin
+			jitter_sd = CLK_HZ / (2.0 * 3.14159265358979 * tone * $sqrt(2.0 * $pow(10.0, snr / 10.0)));
+			glitch_pct = $rtoi(200.0 / $pow(10.0, snr / 20.0));
+			if (glitch_pct > 100)
+				glitch_pct = 100;
+		end
+		else
+		begin
+			jitter_sd = 0.0;
+			glitch_pct = 0;
+		end
+		tol = (4 * $rtoi(jitter_sd) + 2) << FRAC_BITS;
+
+`ifdef TB_UNIT
+		$display("Phase_Detection testbench");
+`else
+		$display("n4fpga / Phase_Detection testbench");
+`endif
+		$display("angle %0d deg, spacing %0d um: expected time_1 - time_2 = %0d counts (%0d per clock)",
+			angle, spacing, delay_fine, STEPS);
+		$display("tone %0d Hz x %0d cycles, snr %0d dB: jitter sd %0d counts, glitch %0d%%",
+			tone, burst, snr, $rtoi(jitter_sd), glitch_pct);
+		$display("spikes %0d%%, edge filters: holdoff %0d, min_high %0d, onset quiet %0d",
+			spike_pct, holdoff, min_high, quiet);
+		$display("%9s %7s %7s %7s %12s %7s %7s %9s", "rate/s", "events", "edges", "pairs", "mis-paired",
+			"missed", "ovf", "worst err");
+		configure;
+
+		pass_rate = rate;
+		best_rate = 0;
+		for (pass = 0; (pass == 0) || (sweep && (pass_rate <= rate_max)); pass = pass + 1)
+		begin
+			run_pass;
+			report_pass;
+			if ((overflow == 0) && (missed == 0) && (100 * bad <= maxbad * pairs))
+				best_rate = pass_rate;
+			else if (sweep)
+				pass_rate = rate_max;		// stop after the first failing rate
+			pass_rate = pass_rate * 2;
+		end
+
+		res_check;
+		wake_check;
+		$display("capture interrupts: %0d", irqs);
+		$display("sub-clock resolution: %0d pairs 0 to %0d clocks apart, error max %0.3f rms %0.3f clocks (step %0.3f), %0d lost",
+			res_n, RES_SPAN, res_max, res_n ? $sqrt(res_sum / res_n) : 0.0, 1.0 / STEPS, res_lost);
+		$display("wakeup: %0d clocks after the WAKE time; a time gone fired %0d clocks after the write; %0d interrupts",
+			wake_late >>> FRAC_BITS, (wake_past - WAKE_AHEAD) >>> FRAC_BITS, wakes);
+		if (latch)
+			$display("latched pair: %0d torn reads, FIFO entries %0d/%0d (0 with the FIFOs off)",
+				torn, fifo_status[4:0], fifo_status[12:8]);
+`ifndef TB_UNIT
+		$display("fabric path: %0d pairs, %0d mis-paired, pulse width ready %0d clocks after the edge",
+			fab_pairs, fab_bad, fab_lat_max);
+`endif
+		if (sweep)
+		begin
+			if (best_rate)
+				$display("max sustainable event rate: %0d/s (+/-50%% interval jitter)", best_rate);
+			else
+				$display("max sustainable event rate: below %0d/s", rate);
+		end
+		else if ((bad == 0) && (missed == 0) && (overflow == 0) && ((pairs == 0) || (irqs > 0)) &&
+			(wake_late >= 0) && (wake_late <= (WAKE_SLACK << FRAC_BITS)) && (wakes == 2) &&
+			(res_lost == 0) && (res_max < 1.0 / STEPS) &&
+			(!latch || ((fifo_status[4:0] == 0) && (fifo_status[12:8] == 0)))
+`ifndef TB_UNIT
+			&& (fab_bad == 0) && (fab_pairs > 0)
+`endif
+			)
+			$display("PASSED");
+		else
+			$display("FAILED");
+		$finish;
+	end
+
+endmodule
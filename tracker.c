@@ -0,0 +1,434 @@
+/**
+*
+* @file tracker.c
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file provides the multi-source tracker.
+*
+* Histogram: each sample adds TRACK_ONE to the bin it falls in.  The histogram decays
+* exponentially with time; rather than touching every bin on every tick, TRACK_Update()
+* applies all the decay steps since the last update in one pass (the factor for n steps is
+* computed by repeated squaring), so samples cost O(1) and updates O(bins).
+*
+* Peaks: local maxima of the histogram smoothed with a [1 2 1] kernel, strongest first, at
+* most max_tracks of them.  A peak of TRACK_MIN_WEIGHT starts a track; an existing track
+* survives down to half of that, so a source near the threshold does not flicker.
+*
+* Tracks: a peak within TRACK_KEEP_BINS of a track is that track; the wider gate lets the
+* track run ahead of the peak of a moving source, which lags by the histogram's memory.
+* Other peaks that near a track are its trail and do not start tracks, nor do peaks that
+* have had no samples since the last update.  A track's position is an exponential
+* average of the samples that fall within TRACK_GATE_BINS of it, which is finer than the
+* bins, and its strength is the count of those samples decaying with the histogram, so a
+* moving source, whose samples spread along its trail, is not taken for a weaker one.  A
+* track whose peak has gone is dropped and its ID is not reused.
+*
+* Selection: the strongest track, changing only when another is 1/2^TRACK_SWITCH_SHIFT
+* stronger, or the newest track, so a sound that starts takes the servo.
+*
+******************************************************************************/
+/***************************** Include Files *********************************/
+#include <math.h>
+
+#include "tracker.h"
+
+
+/************************** Function Prototypes ******************************/
+static u32 decay_factor(u32 q16, u32 steps);
+static u32 smoothed(const Tracker *InstancePtr, int i);
+static u32 mass(const Tracker *InstancePtr, int i);
+static bool hit_near(const Tracker *InstancePtr, int i);
+static int nearest_track(Tracker *InstancePtr, s32 phase_diff, s32 gate, u32 exclude);
+
+
+/*****************************************************************************/
+/**
+* Initializes the tracker
+*
+* @param    InstancePtr is a pointer to the Tracker instance
+* @param	num_bins is the number of histogram bins (2 to TRACK_MAX_BINS)
+* @param	window is the largest phase difference; the bins cover +/- window
+* @param	max_tracks is the most sources to follow (1 to TRACK_MAX_TRACKS)
+* @param	select is TRACK_SELECT_STRONGEST or TRACK_SELECT_NEWEST
+* @param	decay_ticks is the interval between histogram decay steps, in ticks
+* @param	half_life_ticks is the time for a sample's weight to halve, in ticks
+*
+* @return
+*
+*   - XST_SUCCESS if initialization was successful
+*   - XST_INVALID_PARAM if a parameter is out of range
+*
+* @note
+* Uses floating point once, for the decay factor.
+*
+******************************************************************************/
+int TRACK_Initialize(Tracker *InstancePtr, int num_bins, s32 window, int max_tracks, int select,
+		u32 decay_ticks, u32 half_life_ticks)
+{
+	int i;
+
+	if ((num_bins < 2) || (num_bins > TRACK_MAX_BINS) || (window < num_bins) ||
+		(max_tracks < 1) || (max_tracks > TRACK_MAX_TRACKS) ||
+		((select != TRACK_SELECT_STRONGEST) && (select != TRACK_SELECT_NEWEST)) ||
+		(decay_ticks == 0) || (half_life_ticks < decay_ticks))
+	{
+		return XST_INVALID_PARAM;
+	}
+
+	InstancePtr->num_bins = num_bins;
+	InstancePtr->window = window;
+	InstancePtr->bin_width = (2 * window + num_bins - 1) / num_bins;
+	InstancePtr->bin_recip = (u32) ((((u64) 1 << 32) + InstancePtr->bin_width - 1) / InstancePtr->bin_width);
+	InstancePtr->select = select;
+	InstancePtr->max_tracks = max_tracks;
+	InstancePtr->decay_ticks = decay_ticks;
+	InstancePtr->decay_q16 = (u32) lround(65536.0 * pow(0.5, (double) decay_ticks / half_life_ticks));
+	InstancePtr->decay_tick = 0;
+	InstancePtr->decay_started = false;
+	for (i = 0; i < num_bins; i++)
+	{
+		InstancePtr->bins[i] = 0;
+	}
+	for (i = 0; i < (TRACK_MAX_BINS + 31) / 32; i++)
+	{
+		InstancePtr->hit[i] = 0;
+	}
+	for (i = 0; i < TRACK_MAX_TRACKS; i++)
+	{
+		InstancePtr->tracks[i].id = 0;
+	}
+	InstancePtr->selected = -1;
+	InstancePtr->next_id = 1;
+	InstancePtr->created = 0;
+	InstancePtr->switches = 0;
+	return XST_SUCCESS;
+}
+
+
+/*****************************************************************************/
+/**
+* Adds a phase sample
+*
+* The sample goes into the histogram and refines the position of the track it falls
+* near, if any.  Call from the main loop, not from an interrupt handler.
+*
+* @param    InstancePtr is a pointer to the Tracker instance
+* @param	phase_diff is the sample, in clock counts
+* @param	tick is the FIT tick it was measured on
+*
+******************************************************************************/
+void TRACK_Add(Tracker *InstancePtr, s32 phase_diff, u32 tick)
+{
+	s32		offset;
+	u32		bin;
+	int		k;
+	Track	*t;
+
+	offset = phase_diff + InstancePtr->window;
+	offset = (offset < 0) ? 0 : offset;
+	bin = (u32) (((u64) offset * InstancePtr->bin_recip) >> 32);
+	bin = (bin >= (u32) InstancePtr->num_bins) ? (u32) InstancePtr->num_bins - 1 : bin;
+	if (InstancePtr->bins[bin] < 0x40000000)	// leave headroom for the peak search
+	{
+		InstancePtr->bins[bin] += TRACK_ONE;
+	}
+	InstancePtr->hit[bin >> 5] |= 1u << (bin & 31);
+
+	k = nearest_track(InstancePtr, phase_diff, TRACK_GATE_BINS * InstancePtr->bin_width, 0);
+	if (k >= 0)
+	{
+		t = &InstancePtr->tracks[k];
+		t->phase_diff += (phase_diff - t->phase_diff) >> TRACK_EMA_SHIFT;
+		t->strength += (t->strength < 0x40000000) ? TRACK_ONE : 0;
+		t->seen_tick = tick;
+		t->samples++;
+	}
+}
+
+
+/*****************************************************************************/
+/**
+* Decays the histogram, updates the tracks from its peaks and selects a track
+*
+* @param    InstancePtr is a pointer to the Tracker instance
+* @param	tick is the current FIT tick
+*
+* @return	the selected track, or NULL if there is none
+*
+******************************************************************************/
+const Track *TRACK_Update(Tracker *InstancePtr, u32 tick)
+{
+	u32		peak_s[TRACK_MAX_TRACKS];		// smoothed weight of each peak, descending
+	int		peak_bin[TRACK_MAX_TRACKS];
+	u32		matched = 0;					// track slots that kept a peak
+	u32		steps, g, prev, cur, next, left, right, sum;
+	int		num_peaks = 0, n = InstancePtr->num_bins;
+	s32		keep_gate = TRACK_KEEP_BINS * InstancePtr->bin_width;
+	int		i, j, k, best;
+	bool	has_sel;
+	Track	*t;
+
+	// apply the decay steps due since the last update in one pass.  The decay clock starts
+	// at the first update, so the ticks before it (since boot) do not wipe the histogram
+	if (!InstancePtr->decay_started)
+	{
+		InstancePtr->decay_tick = tick;
+		InstancePtr->decay_started = true;
+	}
+	steps = (tick - InstancePtr->decay_tick) / InstancePtr->decay_ticks;
+	if (steps != 0)
+	{
+		InstancePtr->decay_tick += steps * InstancePtr->decay_ticks;
+		g = decay_factor(InstancePtr->decay_q16, steps);
+		for (i = 0; i < n; i++)
+		{
+			InstancePtr->bins[i] = (u32) (((u64) InstancePtr->bins[i] * g) >> 16);
+		}
+		for (k = 0; k < InstancePtr->max_tracks; k++)
+		{
+			InstancePtr->tracks[k].strength = (u32) (((u64) InstancePtr->tracks[k].strength * g) >> 16);
+		}
+	}
+
+	// the strongest local maxima of the smoothed histogram
+	prev = 0;
+	cur = smoothed(InstancePtr, 0);
+	for (i = 0; i < n; i++)
+	{
+		next = (i < n - 1) ? smoothed(InstancePtr, i + 1) : 0;
+		if ((cur >= TRACK_MIN_WEIGHT) && (cur > prev) && (cur >= next))
+		{
+			for (j = num_peaks; (j > 0) && (peak_s[j - 1] < cur); j--)
+			{
+				if (j < InstancePtr->max_tracks)
+				{
+					peak_s[j] = peak_s[j - 1];
+					peak_bin[j] = peak_bin[j - 1];
+				}
+			}
+			if (j < InstancePtr->max_tracks)
+			{
+				peak_s[j] = cur;
+				peak_bin[j] = i;
+				num_peaks += (num_peaks < InstancePtr->max_tracks);
+			}
+		}
+		prev = cur;
+		cur = next;
+	}
+
+	// a peak near a track keeps it alive; a strong peak on its own starts a track
+	for (j = 0; j < num_peaks; j++)
+	{
+		s32 center = -InstancePtr->window + peak_bin[j] * InstancePtr->bin_width + InstancePtr->bin_width / 2;
+
+		k = nearest_track(InstancePtr, center, keep_gate, matched);
+		if (k >= 0)
+		{
+			matched |= 1u << k;
+			continue;
+		}
+		// a second peak near a track is the trail of a moving source, not a new one, and
+		// so is a peak that is not getting samples
+		i = peak_bin[j];
+		if ((peak_s[j] < 2 * TRACK_MIN_WEIGHT) || (nearest_track(InstancePtr, center, keep_gate, 0) >= 0) ||
+			!(hit_near(InstancePtr, i)))
+		{
+			continue;
+		}
+		for (k = 0; (k < InstancePtr->max_tracks) && (InstancePtr->tracks[k].id != 0); k++)
+		{
+			// find a free slot
+		}
+		if (k == InstancePtr->max_tracks)
+		{
+			continue;
+		}
+
+		// start at the centroid of the peak and its neighbours
+		left = (i > 0) ? InstancePtr->bins[i - 1] : 0;
+		right = (i < n - 1) ? InstancePtr->bins[i + 1] : 0;
+		sum = left + InstancePtr->bins[i] + right;
+		t = &InstancePtr->tracks[k];
+		t->id = InstancePtr->next_id++;
+		t->phase_diff = center + (s32) (((s64) InstancePtr->bin_width * ((s32) (right >> 8) - (s32) (left >> 8))) /
+			(s32) ((sum >> 8) | 1));
+		t->strength = mass(InstancePtr, i);
+		t->born_tick = tick;
+		t->seen_tick = tick;
+		t->samples = 0;
+		matched |= 1u << k;
+		InstancePtr->created++;
+	}
+
+	// tracks without a peak are gone
+	for (k = 0; k < InstancePtr->max_tracks; k++)
+	{
+		if (!(matched & (1u << k)))
+		{
+			InstancePtr->tracks[k].id = 0;
+		}
+	}
+	for (i = 0; i < (n + 31) / 32; i++)
+	{
+		InstancePtr->hit[i] = 0;
+	}
+
+	// select a track; with TRACK_SELECT_NEWEST a new track must have had a few samples
+	// before it takes over from another
+	k = InstancePtr->selected;
+	has_sel = (k >= 0) && (InstancePtr->tracks[k].id != 0);
+	best = -1;
+	for (k = 0; k < InstancePtr->max_tracks; k++)
+	{
+		t = &InstancePtr->tracks[k];
+		if ((t->id == 0) ||
+			((InstancePtr->select == TRACK_SELECT_NEWEST) && (t->samples < TRACK_CONFIRM_SAMPLES) && has_sel))
+		{
+			continue;
+		}
+		if ((best < 0) ||
+			((InstancePtr->select == TRACK_SELECT_STRONGEST) && (t->strength > InstancePtr->tracks[best].strength)) ||
+			((InstancePtr->select == TRACK_SELECT_NEWEST) && (t->id > InstancePtr->tracks[best].id)))
+		{
+			best = k;
+		}
+	}
+	k = InstancePtr->selected;
+	if ((best >= 0) && (best != k))
+	{
+		if ((k < 0) || (InstancePtr->tracks[k].id == 0) ||
+			(InstancePtr->select == TRACK_SELECT_NEWEST) ||
+			(InstancePtr->tracks[best].strength >
+			 InstancePtr->tracks[k].strength + (InstancePtr->tracks[k].strength >> TRACK_SWITCH_SHIFT)))
+		{
+			if ((k >= 0) && (InstancePtr->tracks[k].id != 0))
+			{
+				InstancePtr->switches++;
+			}
+			InstancePtr->selected = best;
+		}
+	}
+	else if (best < 0)
+	{
+		InstancePtr->selected = -1;
+	}
+	return (InstancePtr->selected >= 0) ? &InstancePtr->tracks[InstancePtr->selected] : NULL;
+}
+
+
+/*****************************************************************************/
+/**
+* Changes the track selection (TRACK_SELECT_STRONGEST or TRACK_SELECT_NEWEST)
+******************************************************************************/
+void TRACK_SetSelect(Tracker *InstancePtr, int select)
+{
+	if ((select == TRACK_SELECT_STRONGEST) || (select == TRACK_SELECT_NEWEST))
+	{
+		InstancePtr->select = select;
+	}
+}
+
+
+/**************************** HELPER FUNCTIONS ******************************/
+
+/****************************************************************************/
+/**
+* Returns q16^steps (both 1/65536), by repeated squaring
+*****************************************************************************/
+static u32 decay_factor(u32 q16, u32 steps)
+{
+	u32 g = 1 << 16;
+
+	while ((steps != 0) && (g != 0))
+	{
+		if (steps & 1)
+		{
+			g = (u32) (((u64) g * q16) >> 16);
+		}
+		q16 = (u32) (((u64) q16 * q16) >> 16);
+		steps >>= 1;
+	}
+	return g;
+}
+
+
+/****************************************************************************/
+/**
+* Returns bin i of the histogram smoothed with [1 2 1]
+*****************************************************************************/
+static u32 smoothed(const Tracker *InstancePtr, int i)
+{
+	return ((i > 0) ? InstancePtr->bins[i - 1] : 0) + 2 * InstancePtr->bins[i] +
+		((i < InstancePtr->num_bins - 1) ? InstancePtr->bins[i + 1] : 0);
+}
+
+
+/****************************************************************************/
+/**
+* Returns the histogram weight within TRACK_GATE_BINS of bin i, the recent samples of
+* the source there whether it holds still or moves across bins
+*****************************************************************************/
+static u32 mass(const Tracker *InstancePtr, int i)
+{
+	u32 sum = 0;
+	int b;
+
+	for (b = i - TRACK_GATE_BINS; b <= i + TRACK_GATE_BINS; b++)
+	{
+		if ((b >= 0) && (b < InstancePtr->num_bins))
+		{
+			sum += InstancePtr->bins[b];
+		}
+	}
+	return sum;
+}
+
+
+/****************************************************************************/
+/**
+* Returns true if a sample fell in bin i or a neighbour since the last update
+*****************************************************************************/
+static bool hit_near(const Tracker *InstancePtr, int i)
+{
+	int b;
+
+	for (b = i - 1; b <= i + 1; b++)
+	{
+		if ((b >= 0) && (b < InstancePtr->num_bins) && (InstancePtr->hit[b >> 5] & (1u << (b & 31))))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/****************************************************************************/
+/**
+* Returns the slot of the active track nearest phase_diff within gate counts, or -1.
+* Slots set in exclude are skipped.
+*****************************************************************************/
+static int nearest_track(Tracker *InstancePtr, s32 phase_diff, s32 gate, u32 exclude)
+{
+	s32 d;
+	int k, best = -1;
+
+	for (k = 0; k < InstancePtr->max_tracks; k++)
+	{
+		if ((InstancePtr->tracks[k].id == 0) || (exclude & (1u << k)))
+		{
+			continue;
+		}
+		d = phase_diff - InstancePtr->tracks[k].phase_diff;
+		d = (d < 0) ? -d : d;
+		if (d <= gate)
+		{
+			gate = d;
+			best = k;
+		}
+	}
+	return best;
+}
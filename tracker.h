@@ -0,0 +1,99 @@
+/**
+*
+* @file tracker.h
+*
+* @author Christopher Dean (cdean@pdx.edu)
+* @author Meng Lei (lmeng@pdx.edu)
+*
+* This file contains the constant definitions and function prototypes for tracker.c.
+* tracker.c follows several sound sources at once.  Phase samples go into a decaying
+* histogram over the valid phase difference window; its peaks are sources.  Each peak is
+* kept as a track with an ID, a strength, an age and a position refined from the samples
+* near it, and one track is selected for the servo.  With two sources (two talkers, a
+* talker and a fan) the servo then holds on one instead of swinging between them.
+*
+* Memory is fixed by TRACK_MAX_BINS and TRACK_MAX_TRACKS.  A sample costs O(tracks);
+* an update (decay, peak search, track association) costs O(bins * tracks) with no
+* division except when a track is created.
+*
+******************************************************************************/
+
+#ifndef TRACKER_H	/* prevent circular inclusions */
+#define TRACKER_H	/* by using protection macros */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************** Include Files *********************************/
+#include "stdbool.h"
+#include "xil_types.h"
+#include "xstatus.h"
+
+/************************** Constant Definitions *****************************/
+#ifndef TRACK_MAX_BINS
+#define TRACK_MAX_BINS			128			// largest histogram
+#endif
+#ifndef TRACK_MAX_TRACKS
+#define TRACK_MAX_TRACKS		4			// most sources followed at once
+#endif
+
+#define TRACK_ONE				(1 << 16)	// histogram weight of one sample
+#define TRACK_MIN_WEIGHT		(3 * TRACK_ONE)	// a peak needs about 3 recent samples
+#ifndef TRACK_GATE_BINS
+#define TRACK_GATE_BINS			3			// a sample this near a track belongs to it
+#endif
+#ifndef TRACK_KEEP_BINS
+#define TRACK_KEEP_BINS			4			// a peak this near a track keeps it alive
+#endif
+#define TRACK_EMA_SHIFT			2			// track position smoother weight 1/2^n
+#define TRACK_CONFIRM_SAMPLES	4			// samples before a new track can take the servo
+#define TRACK_SWITCH_SHIFT		2			// another track must be 1/2^n stronger to take the servo
+
+// track selection
+#define TRACK_SELECT_STRONGEST	0			// the track with the most recent samples
+#define TRACK_SELECT_NEWEST		1			// the track that appeared last (a new sound)
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+	u32		id;							// track ID, 0 = slot free
+	s32		phase_diff;					// position, clock counts
+	u32		strength;					// recent samples, decaying with the histogram (TRACK_ONE each)
+	u32		born_tick;					// tick the track was created (age = now - born_tick)
+	u32		seen_tick;					// tick of the last sample assigned to it
+	u32		samples;					// samples assigned to it
+} Track;
+
+typedef struct {
+	int		num_bins;
+	s32		window;						// bins cover -window to +window
+	s32		bin_width;					// clock counts per bin
+	u32		bin_recip;					// 2^32 / bin_width, rounded up
+	int		select;						// TRACK_SELECT_*
+	int		max_tracks;
+	u32		decay_ticks;				// ticks per decay step
+	u32		decay_q16;					// weight kept per decay step, 1/65536
+	u32		decay_tick;					// tick of the last decay step
+	bool	decay_started;				// decay_tick is set, by the first update
+	u32		bins[TRACK_MAX_BINS];
+	u32		hit[(TRACK_MAX_BINS + 31) / 32];	// bins with a sample since the last update
+
+	Track	tracks[TRACK_MAX_TRACKS];
+	int		selected;					// track slot pointing the servo, -1 = none
+	u32		next_id;
+	u32		created;					// tracks created since initialization
+	u32		switches;					// changes of selected track
+} Tracker;
+
+/************************** Function Prototypes ******************************/
+int TRACK_Initialize(Tracker *InstancePtr, int num_bins, s32 window, int max_tracks, int select,
+		u32 decay_ticks, u32 half_life_ticks);
+void TRACK_Add(Tracker *InstancePtr, s32 phase_diff, u32 tick);
+const Track *TRACK_Update(Tracker *InstancePtr, u32 tick);
+void TRACK_SetSelect(Tracker *InstancePtr, int select);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of protection macro */